@@ -0,0 +1,26 @@
+# arm-none-eabi-gcc toolchain for the STM32F446RE (Cortex-M4F)
+#
+#   cmake -S . -B build-arm -DCMAKE_TOOLCHAIN_FILE=cmake/arm-none-eabi.cmake \
+#         -DCMSIS_DIR=<path with Include/ and Device/ST/STM32F4xx/Include/>
+
+set(CMAKE_SYSTEM_NAME      Generic)
+set(CMAKE_SYSTEM_PROCESSOR arm)
+
+set(CMAKE_C_COMPILER   arm-none-eabi-gcc)
+set(CMAKE_ASM_COMPILER arm-none-eabi-gcc)
+set(CMAKE_OBJCOPY      arm-none-eabi-objcopy CACHE FILEPATH "")
+set(CMAKE_SIZE         arm-none-eabi-size    CACHE FILEPATH "")
+set(CMAKE_AR           arm-none-eabi-gcc-ar      CACHE FILEPATH "")   # O3LTO: fw_common keeps LTO objects
+set(CMAKE_RANLIB       arm-none-eabi-gcc-ranlib  CACHE FILEPATH "")
+
+# Try-compile cannot link without a linker script
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+set(MCU_FLAGS "-mcpu=cortex-m4 -mthumb -mfloat-abi=hard -mfpu=fpv4-sp-d16")
+set(CMAKE_C_FLAGS_INIT   "${MCU_FLAGS} -ffunction-sections -fdata-sections")
+set(CMAKE_ASM_FLAGS_INIT "${MCU_FLAGS} -x assembler-with-cpp")
+set(CMAKE_EXE_LINKER_FLAGS_INIT "${MCU_FLAGS} -Wl,--gc-sections --specs=nano.specs --specs=nosys.specs")
+
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
@@ -0,0 +1,114 @@
+#include "place.h"
+#include "adsr.h"
+
+/* ADSR envelope, see adsr.h */
+
+#define ADSR_FULL   (1UL << 30)              // Q30 1.0
+#define ADSR_FLOOR  (ADSR_FULL >> 10)        // -60 dB of full scale
+
+static uint32_t adsr_ticks(uint32_t ms, uint32_t tick_us){
+	uint32_t n = (uint32_t)(((uint64_t)ms * 1000U + tick_us / 2U) / tick_us);
+	return n ? n : 1U;
+}
+
+// r^n, Q30
+static uint32_t adsr_pow(uint32_t r, uint32_t n){
+	uint64_t acc = ADSR_FULL, b = r;
+	while(n){
+		if(n & 1U) acc = (acc * b) >> 30;
+		b = (b * b) >> 30;
+		n >>= 1;
+	}
+	return (uint32_t)acc;
+}
+
+/*
+ Share of the distance to the target taken per tick, 1 - r, with the
+ largest r for which r^ticks reaches 1/1024: a full-range fall lands
+ within ADSR_FLOOR after ms. Bisection, at init only.
+*/
+static uint32_t adsr_coef(uint32_t ms, uint32_t tick_us){
+	uint32_t n = adsr_ticks(ms, tick_us), lo = 0, hi = ADSR_FULL, mid;
+	if(ms == 0) return ADSR_FULL;
+	while(hi - lo > 1U){
+		mid = lo + (hi - lo) / 2U;
+		if(adsr_pow(mid, n) > ADSR_FLOOR) hi = mid;
+		else                              lo = mid;
+	}
+	return ADSR_FULL - lo;
+}
+
+void adsr_init(adsr_t *env, const adsr_shape_t *shape, uint32_t tick_us){
+	uint32_t n = adsr_ticks(shape->attack_ms, tick_us);
+	env->level        = 0;
+	env->sustain      = shape->sustain >= ADSR_ONE ? ADSR_FULL : (uint32_t)shape->sustain << 15;
+	env->attack_step  = (ADSR_FULL + n - 1U) / n;
+	env->decay_coef   = adsr_coef(shape->decay_ms, tick_us);
+	env->release_coef = adsr_coef(shape->release_ms, tick_us);
+	env->stage        = ADSR_IDLE;
+	env->request      = ADSR_IDLE;
+	env->taken        = env->posted;
+}
+
+void adsr_note_on(adsr_t *env){
+	env->request = ADSR_ATTACK;
+	env->posted++;
+}
+
+void adsr_note_off(adsr_t *env){
+	env->request = ADSR_RELEASE;
+	env->posted++;
+}
+
+// One exponential step towards target, 1 once it is there
+static int adsr_approach(adsr_t *env, uint32_t target, uint32_t coef){
+	int64_t d = (int64_t)target - (int64_t)env->level;
+	if(d <= (int64_t)ADSR_FLOOR && d >= -(int64_t)ADSR_FLOOR){
+		env->level = target;
+		return 1;
+	}
+	env->level = (uint32_t)((int64_t)env->level + ((d * (int64_t)coef) >> 30));
+	return 0;
+}
+
+// One control tick: the latest request, then one step of the stage. Level in Q15.
+RAMFUNC uint32_t adsr_tick(adsr_t *env){
+	uint8_t posted = env->posted;
+	if(posted != env->taken){
+		env->taken = posted;
+		if(env->request == ADSR_ATTACK)   env->stage = ADSR_ATTACK;
+		else if(env->stage != ADSR_IDLE)  env->stage = ADSR_RELEASE;
+	}
+	switch(env->stage){
+		case ADSR_ATTACK:
+			if(env->level >= ADSR_FULL - env->attack_step){
+				env->level = ADSR_FULL;
+				env->stage = ADSR_DECAY;
+			} else {
+				env->level += env->attack_step;
+			}
+			break;
+		case ADSR_DECAY:
+			if(adsr_approach(env, env->sustain, env->decay_coef)) env->stage = ADSR_SUSTAIN;
+			break;
+		case ADSR_RELEASE:
+			if(adsr_approach(env, 0, env->release_coef)) env->stage = ADSR_IDLE;
+			break;
+		default:                                 // idle, sustain
+			break;
+	}
+	return env->level >> 15;
+}
+
+uint32_t adsr_level(const adsr_t *env){
+	return env->level >> 15;
+}
+
+// Gate time of a note: legato holds to the next one, normal releases for the last 1/8, staccato for half
+uint32_t adsr_gate_ms(uint32_t articulation, uint32_t note_ms){
+	switch(articulation){
+		case ADSR_LEGATO:   return note_ms;
+		case ADSR_STACCATO: return note_ms / 2U;
+		default:            return note_ms - note_ms / 8U;
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef ADSR_H
+#define ADSR_H
+
+#include <stdint.h>
+
+/* ADSR amplitude envelope in fixed point
+
+ One envelope per voice, advanced by adsr_tick() once per control tick
+ (dds.h: once per block of DDS_BLOCK samples, DDS_CONTROL_US), never per
+ sample: the cost is one add or one 32x32 multiply per tick whatever the
+ sample rate.
+
+   attack   linear rise to full level in attack_ms
+   decay    exponential fall to the sustain level
+   sustain  held while the note is on
+   release  exponential fall to 0 after adsr_note_off()
+
+ decay_ms and release_ms are the times a fall over the full range takes
+ to reach 1/1024 (-60 dB) of it; the ratio per tick is solved for that
+ in adsr_init(), so they hold for any tick rate. Within 1/1024 of full
+ scale of its target the envelope lands on it: decay ends in sustain,
+ release in idle.
+
+ Levels are Q30 inside and Q15 (ADSR_ONE = 1.0) outside. adsr_note_on()
+ and adsr_note_off() only post a request the next tick takes, so they
+ can be called from thread mode while an interrupt ticks. A new note
+ attacks from the level the envelope is at, without a click.
+
+ Articulation: adsr_gate_ms() is the part of a note the gate stays on.
+ Legato notes keep the gate and the next note is not retriggered,
+ normal notes release for the last 1/8, staccato for the second half.
+
+ host/adsr_sim.c checks the curves (segment times, the exponential
+ against its closed form, continuity on retrigger and early release).
+*/
+
+#define ADSR_ONE  32768U                   // Q15 1.0
+
+enum {
+	ADSR_IDLE = 0,
+	ADSR_ATTACK,
+	ADSR_DECAY,
+	ADSR_SUSTAIN,
+	ADSR_RELEASE
+};
+
+enum {
+	ADSR_LEGATO = 0,
+	ADSR_NORMAL,
+	ADSR_STACCATO
+};
+
+typedef struct {
+	uint16_t attack_ms;
+	uint16_t decay_ms;
+	uint16_t sustain;        // Q15
+	uint16_t release_ms;
+} adsr_shape_t;
+
+typedef struct {
+	uint32_t          level;         // Q30
+	uint32_t          sustain;       // Q30
+	uint32_t          attack_step;   // Q30 per tick
+	uint32_t          decay_coef;    // Q30 share of the distance to the target per tick
+	uint32_t          release_coef;
+	uint8_t           stage;
+	volatile uint8_t  request;       // ADSR_ATTACK / ADSR_RELEASE, the latest posted
+	volatile uint8_t  posted;        // requests posted (thread) ...
+	uint8_t           taken;         // ... and taken (adsr_tick()), no lock needed
+} adsr_t;
+
+void     adsr_init(adsr_t *env, const adsr_shape_t *shape, uint32_t tick_us);
+void     adsr_note_on(adsr_t *env);
+void     adsr_note_off(adsr_t *env);
+uint32_t adsr_tick(adsr_t *env);
+uint32_t adsr_level(const adsr_t *env);
+uint32_t adsr_gate_ms(uint32_t articulation, uint32_t note_ms);
+
+#endif /* ADSR_H */
@@ -0,0 +1,165 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "bam.h"
+
+/* Bit-angle modulation on TIM1 and DMA2, see bam.h */
+
+#define BAM_ARR(b)     ((BAM_LSB_TICKS << (b)) - 1U)
+#define BAM_LFLAGS     (DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 | DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1 | \
+                        DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2)
+#define BAM_HFLAGS     (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
+// Channel 6 (TIM1), memory -> peripheral, words, memory increment, circular, high priority
+#define BAM_DMA_CR     ((6UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 | \
+                        DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0)
+
+// ARR written at the update event that opens plane j: the period of plane j + 1
+static const uint32_t bam_arr[BAM_PLANES] = {
+	BAM_ARR(1), BAM_ARR(2), BAM_ARR(3), BAM_ARR(4), BAM_ARR(5), BAM_ARR(6), BAM_ARR(7), BAM_ARR(0),
+};
+
+static uint32_t bam_bsrr[2][BAM_PLANES];       // GPIOA, GPIOC
+static uint8_t  bam_level[2][16];
+static uint16_t bam_mask[2];
+static uint32_t bam_on, bam_listening;
+
+/*
+ 8x8 bit transpose (Hacker's Delight 7-3) of the levels of pins 0-7 of a
+ half: x holds pins 4-7, y pins 0-3, one byte each, lowest pin lowest.
+ Afterwards byte b of y is plane b (bit p: pin p), byte b of x plane b + 4.
+*/
+static void bam_transpose(uint32_t *px, uint32_t *py){
+	uint32_t x = *px, y = *py, t;
+	t = (x ^ (x >> 7)) & 0x00AA00AAUL;   x = x ^ t ^ (t << 7);
+	t = (y ^ (y >> 7)) & 0x00AA00AAUL;   y = y ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCCUL;  x = x ^ t ^ (t << 14);
+	t = (y ^ (y >> 14)) & 0x0000CCCCUL;  y = y ^ t ^ (t << 14);
+	t = (x & 0xF0F0F0F0UL) | ((y >> 4) & 0x0F0F0F0FUL);
+	y = ((x << 4) & 0xF0F0F0F0UL) | (y & 0x0F0F0F0FUL);
+	*px = t;
+	*py = y;
+}
+
+static uint32_t bam_load(const uint8_t *p){
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// BSRR words of the 8 planes of a port: set the pins of the plane, reset the rest of mask
+void bam_planes(const uint8_t level[16], uint16_t mask, uint32_t bsrr[BAM_PLANES]){
+	uint32_t xl = bam_load(level + 4), yl = bam_load(level);
+	uint32_t xh = bam_load(level + 12), yh = bam_load(level + 8);
+	uint32_t w[4], b, p, m = mask;
+
+	bam_transpose(&xl, &yl);
+	bam_transpose(&xh, &yh);
+	// Pins 8-15 next to 0-7: two 16-bit planes per word
+	w[0] = (yl & 0x00FF00FFUL) | ((yh & 0x00FF00FFUL) << 8);          // planes 0, 2
+	w[1] = ((yl >> 8) & 0x00FF00FFUL) | (yh & 0xFF00FF00UL);          // planes 1, 3
+	w[2] = (xl & 0x00FF00FFUL) | ((xh & 0x00FF00FFUL) << 8);          // planes 4, 6
+	w[3] = ((xl >> 8) & 0x00FF00FFUL) | (xh & 0xFF00FF00UL);          // planes 5, 7
+	for(b=0; b<BAM_PLANES; b++){
+		p = w[(b >> 2) * 2U + (b & 1U)] >> (b & 2U ? 16 : 0);
+		bsrr[b] = (p & m) | ((~p & m) << 16);
+	}
+}
+
+static void bam_stream(DMA_Stream_TypeDef *s, volatile uint32_t *reg, const uint32_t *words){
+	s->CR = 0;
+	while (s->CR & DMA_SxCR_EN);
+	s->PAR  = (uintptr_t)reg;
+	s->M0AR = (uintptr_t)words;
+	s->NDTR = BAM_PLANES;
+	s->CR   = BAM_DMA_CR;
+	s->CR  |= DMA_SxCR_EN;
+}
+
+/*
+ Counter and streams from plane 0. The counter starts on the last tick
+ of a 2-tick lead-in period with plane 0's period preloaded: the next
+ tick is the update event that opens plane 0, as every later one.
+*/
+static void bam_start(void){
+	uint32_t hz = clock_tim_hz(TIM1);
+
+	TIM1->CR1  = 0;
+	TIM1->DIER = 0;
+	DMA2->LIFCR = BAM_LFLAGS;
+	DMA2->HIFCR = BAM_HFLAGS;
+	TIM1->PSC  = hz > BAM_TICK_HZ ? hz / BAM_TICK_HZ - 1U : 0U;
+	TIM1->ARR  = 1;
+	TIM1->CR1  = TIM_CR1_ARPE | TIM_CR1_URS;     // load the shadows, no update request
+	TIM1->EGR  = TIM_EGR_UG;
+	TIM1->CR1  = TIM_CR1_ARPE;
+	TIM1->ARR  = BAM_ARR(0);                     // preloaded, the period of plane 0
+	TIM1->CCR1 = 0;                              // compare at CNT 0: the BSRR words
+	TIM1->CCR2 = 0;
+	TIM1->CNT  = 1;
+
+	bam_stream(DMA2_Stream5, &TIM1->ARR, bam_arr);
+	bam_stream(DMA2_Stream1, &GPIOA->BSRR, bam_bsrr[0]);
+	bam_stream(DMA2_Stream2, &GPIOC->BSRR, bam_bsrr[1]);
+	TIM1->DIER = TIM_DIER_UDE | TIM_DIER_CC1DE | TIM_DIER_CC2DE;
+	TIM1->CR1 |= TIM_CR1_CEN;
+}
+
+// PSC follows the APB2 timer clock; the restart keeps ARR and the BSRR streams in step
+static void bam_clock(void){
+	if(bam_on) bam_start();
+}
+
+static void bam_pins(GPIO_TypeDef *gpio, uint16_t mask){
+	uint32_t pin;
+	gpio->BSRR = (uint32_t)mask << 16;
+	for(pin=0; pin<16U; pin++){
+		if((mask & (1U << pin)) == 0) continue;
+		gpio->MODER &= ~(3UL << (2U * pin));
+		gpio->MODER |=   1UL << (2U * pin);         // output, push-pull
+	}
+}
+
+// Outputs on the pins of mask_a (GPIOA) and mask_c (GPIOC), all at level 0, and the engine running
+void bam_init(uint16_t mask_a, uint16_t mask_c){
+	uint32_t i;
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOCEN | RCC_AHB1ENR_DMA2EN;
+	RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
+
+	bam_mask[0] = mask_a;
+	bam_mask[1] = mask_c;
+	for(i=0; i<16U; i++) bam_level[0][i] = bam_level[1][i] = 0;
+	bam_pins(GPIOA, mask_a);
+	bam_pins(GPIOC, mask_c);
+	bam_show();
+	if(!bam_on){
+		bam_on = 1;
+		idle_hold();                             // TIM1 and DMA2 need their clocks, no Stop
+	}
+	if(!bam_listening){
+		bam_listening = 1;
+		clock_listen(bam_clock);
+	}
+	bam_start();
+}
+
+// Streams and counter off, the pins low
+void bam_stop(void){
+	if(!bam_on) return;
+	TIM1->DIER = 0;
+	TIM1->CR1  = 0;
+	DMA2_Stream5->CR = 0;
+	DMA2_Stream1->CR = 0;
+	DMA2_Stream2->CR = 0;
+	GPIOA->BSRR = (uint32_t)bam_mask[0] << 16;
+	GPIOC->BSRR = (uint32_t)bam_mask[1] << 16;
+	bam_on = 0;
+	idle_release();
+}
+
+void bam_set(GPIO_TypeDef *gpio, uint32_t pin, uint8_t level){
+	bam_level[gpio == GPIOC][pin & 15U] = level;
+}
+
+// The levels set so far to the BSRR words the streams play
+void bam_show(void){
+	bam_planes(bam_level[0], bam_mask[0], bam_bsrr[0]);
+	bam_planes(bam_level[1], bam_mask[1], bam_bsrr[1]);
+}
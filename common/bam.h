@@ -0,0 +1,53 @@
+#ifndef BAM_H
+#define BAM_H
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+/* Bit-angle modulation of LEDs on GPIOA and GPIOC for NUCLEO-F446RE
+
+ Any output pins of the two ports, up to 32 channels, 8-bit brightness,
+ no timer channel needed on the pin. A frame is 8 bit planes: plane b
+ holds every pin whose level has bit b set and lasts BAM_LSB_TICKS << b
+ ticks, so a pin is on for level * BAM_LSB_TICKS of the 255 *
+ BAM_LSB_TICKS ticks of a frame. At 1 MHz ticks and 4 ticks per LSB a
+ frame takes 1020 us (980 Hz refresh).
+
+ TIM1 counts the ticks (PSC from the APB2 timer clock, ARR preloaded).
+ DMA2 does the rest, circular over 8 words each, with no interrupt:
+
+   Stream5 ch6 TIM1_UP   plane periods into ARR, one plane ahead of the
+                         counter (ARR is latched at the update event)
+   Stream1 ch6 TIM1_CH1  the BSRR word of the plane into GPIOA->BSRR
+   Stream2 ch6 TIM1_CH2  the same for GPIOC, at the CCR1 = CCR2 = 0
+                         compare that opens each period
+
+ Only DMA2 reaches the AHB1 GPIO ports, hence TIM1. 24 transfers per
+ frame and nothing for the core to do between bam_show() calls.
+
+ A BSRR word sets the pins of the plane and resets the others of the
+ mask, pins outside the mask are left alone. bam_planes() builds the 8
+ words of a port from 16 levels with an 8x8 bit transpose in two 32-bit
+ words (8 pins per step, no per-bit loop). bam_set() stores a level,
+ bam_show() rebuilds the words in place: a frame in flight may mix old
+ and new planes once. A clock change (clock_listen()) re-derives PSC
+ and restarts the frame at plane 0. The core must not enter Stop while
+ the engine runs (idle_hold()).
+
+ host/bam_bench.c checks bam_planes() against a per-bit reference,
+ measures it, and replays the three DMA streams as TIM1 would run them
+ to check the on time of every pin.
+*/
+
+#define BAM_TICK_HZ     1000000UL
+#define BAM_LSB_TICKS   4U                    // plane 0, plane b lasts BAM_LSB_TICKS << b
+#define BAM_PLANES      8U
+#define BAM_FRAME_TICKS (255U * BAM_LSB_TICKS)
+
+void bam_init(uint16_t mask_a, uint16_t mask_c);
+void bam_stop(void);
+void bam_set(GPIO_TypeDef *gpio, uint32_t pin, uint8_t level);
+void bam_show(void);
+void bam_planes(const uint8_t level[16], uint16_t mask, uint32_t bsrr[BAM_PLANES]);
+
+#endif /* BAM_H */
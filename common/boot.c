@@ -0,0 +1,137 @@
+#include "stm32f446xx.h"
+#include "boot.h"
+#include "clock.h"
+#include "place.h"
+
+/* Startup latency tracing and fast-boot helpers, see boot.h */
+
+#ifdef BOOT_TRACE
+
+uint32_t boot_stamps[BOOT_PHASES];
+
+static const char *const boot_names[BOOT_PHASES] = {
+	"main",
+	"clock_start",
+	"pins",
+	"first_output",
+	"clock_done",
+	"ready",
+};
+
+#ifndef HOST_BUILD
+/*
+ The counter starts ahead of SystemInit(), from this file rather than the
+ pack's RTE system_stm32f4xx.c: armlink binds the startup's call to
+ $Sub$$SystemInit, GNU ld to __wrap_SystemInit (-Wl,--wrap=SystemInit,
+ added by CMakeLists.txt with BOOT_TRACE).
+*/
+static void boot_trace_start(void){
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL  |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+#if defined(__ARMCC_VERSION)
+extern void $Super$$SystemInit(void);
+void $Sub$$SystemInit(void){
+	boot_trace_start();
+	$Super$$SystemInit();
+}
+#else
+void __real_SystemInit(void);
+void __wrap_SystemInit(void){
+	boot_trace_start();
+	__real_SystemInit();
+}
+#endif
+#endif /* HOST_BUILD */
+
+void boot_stamp(uint32_t phase){
+	if(phase < BOOT_PHASES) boot_stamps[phase] = DWT->CYCCNT;
+}
+
+static void boot_puts(const char *s){
+	while(*s) ITM_SendChar((uint32_t)*s++);
+}
+
+static void boot_putu(uint32_t v){
+	char buf[10];
+	int n = 0;
+	do {
+		buf[n++] = (char)('0' + (v % 10));
+		v /= 10;
+	} while(v != 0);
+	while(n > 0) ITM_SendChar((uint32_t)buf[--n]);
+}
+
+// One line per phase: "<name> <cycles since SystemInit> +<cycles since previous phase>"
+void boot_dump(void){
+	uint32_t i, prev = 0;
+	for(i=0; i<BOOT_PHASES; i++){
+		if(boot_stamps[i] == 0) continue;    // phase not reached / not stamped
+		boot_puts(boot_names[i]);
+		boot_puts(" ");   boot_putu(boot_stamps[i]);
+		boot_puts(" +");  boot_putu(boot_stamps[i] - prev);
+		boot_puts("\r\n");
+		prev = boot_stamps[i];
+	}
+}
+
+#endif /* BOOT_TRACE */
+
+/*
+ Fast 84 MHz bring-up, split in two so the PLL lock time overlaps with
+ pin configuration. Same target as enable_HSI():
+ HSI 16 MHz / PLLM 16 * PLLN 336 / PLLP 4 = 84 MHz, APB1 42 MHz, APB2 84 MHz
+
+ Skipped compared to enable_HSI(), because they are already true after reset:
+ HSION + HSIRDY wait, CFGR reset, PLLON clear + PLLRDY wait.
+*/
+COLDFUNC void boot_clock_start(void){
+	BOOT_STAMP(BOOT_CLOCK_START);
+
+	// One write instead of five RMWs, PLLSRC = 0 (HSI)
+	RCC->PLLCFGR = (16UL  << RCC_PLLCFGR_PLLM_Pos)   // VCO input  = 16 MHz / 16 = 1 MHz
+	             | (336UL << RCC_PLLCFGR_PLLN_Pos)   // VCO output = 1 MHz * 336 = 336 MHz
+	             | (1UL   << RCC_PLLCFGR_PLLP_Pos)   // PLLP = 4 (01), 336 / 4 = 84 MHz
+	             | (7UL   << RCC_PLLCFGR_PLLQ_Pos);  // PLLQ = 7, 48 MHz
+	RCC->CR |= RCC_CR_PLLON;                          // Start locking, do not wait here
+
+	// Flash wait states must be raised before the switch, it is harmless at 16 MHz
+	FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_PRFTEN | FLASH_ACR_LATENCY_2WS;
+
+	// AHB /1, APB1 /2, APB2 /1 in one write
+	RCC->CFGR = RCC_CFGR_PPRE1_DIV2;
+}
+
+COLDFUNC void boot_clock_finish(void){
+	while ((RCC->CR & RCC_CR_PLLRDY) == 0);          // Usually already locked by now
+
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_PLL;
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+
+	clock_update();                                    // SystemCoreClock, attached timers, delays
+	BOOT_STAMP(BOOT_CLOCK_DONE);
+}
+
+/*
+ Word copy / clear for .data and .bss, used by the GCC startup.
+ Four words per iteration so the compiler emits LDM/STM pairs.
+ Section boundaries are word aligned by the linker script.
+*/
+void boot_copy_words(uint32_t *dst, const uint32_t *src, const uint32_t *end){
+	while (dst + 4 <= end){
+		uint32_t a = src[0], b = src[1], c = src[2], d = src[3];
+		dst[0] = a;  dst[1] = b;  dst[2] = c;  dst[3] = d;
+		dst += 4;  src += 4;
+	}
+	while (dst < end) *dst++ = *src++;
+}
+
+void boot_zero_words(uint32_t *dst, const uint32_t *end){
+	while (dst + 4 <= end){
+		dst[0] = 0;  dst[1] = 0;  dst[2] = 0;  dst[3] = 0;
+		dst += 4;
+	}
+	while (dst < end) *dst++ = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+
+/* Startup latency tracing and fast-boot helpers for NUCLEO-F446RE
+
+ BOOT_TRACE: boot.c zeroes and starts DWT->CYCCNT ahead of SystemInit()
+ (armlink $Sub$$SystemInit, GNU ld --wrap=SystemInit), every
+ BOOT_STAMP() stores the counter for its phase. Stamps are raw core
+ cycles, the clock changes from 16 MHz to 84 MHz between BOOT_CLOCK_START
+ and BOOT_CLOCK_DONE so compare builds phase by phase.
+
+ FAST_BOOT: the projects use boot_clock_start() / boot_clock_finish()
+ instead of enable_HSI(). The PLL locks while the pins are configured,
+ so the first output no longer waits for PLLRDY.
+
+ Reset state that the fast path relies on (RM0390 6.3):
+ HSI on and selected, PLL off, all bus prescalers /1, FLASH 0WS.
+*/
+
+enum {
+	BOOT_MAIN = 0,           // entered main: SystemInit tail + __main (.data copy, .bss clear)
+	BOOT_CLOCK_START,        // clock setup requested
+	BOOT_PINS,               // output pins configured
+	BOOT_FIRST_OUTPUT,       // outputs driven to their first value
+	BOOT_CLOCK_DONE,         // running from the final clock
+	BOOT_READY,              // non-critical init finished
+	BOOT_PHASES
+};
+
+#ifdef BOOT_TRACE
+
+extern uint32_t boot_stamps[BOOT_PHASES];
+
+void boot_stamp(uint32_t phase);
+void boot_dump(void);
+
+#define BOOT_STAMP(phase)  boot_stamp(phase)
+#define BOOT_DUMP()        boot_dump()
+
+#else
+
+#define BOOT_STAMP(phase)  ((void)0)
+#define BOOT_DUMP()        ((void)0)
+
+#endif
+
+void boot_clock_start(void);
+void boot_clock_finish(void);
+
+void boot_copy_words(uint32_t *dst, const uint32_t *src, const uint32_t *end);
+void boot_zero_words(uint32_t *dst, const uint32_t *end);
+
+#endif /* BOOT_H */
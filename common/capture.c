@@ -0,0 +1,277 @@
+#include <string.h>
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "log.h"
+#include "place.h"
+#include "capture.h"
+
+/* Logic analyzer on TIM8 and DMA2, see capture.h */
+
+#define CAP_SAMPLES    (2U * CAPTURE_BLOCK)
+#define CAP_LFLAGS     (DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3)
+#define CAP_HFLAGS     (DMA_HIFCR_CTCIF4 | DMA_HIFCR_CHTIF4 | DMA_HIFCR_CTEIF4 | DMA_HIFCR_CDMEIF4 | DMA_HIFCR_CFEIF4)
+// Channel 7 (TIM8), peripheral -> memory, half-words, memory increment, circular, very high priority
+#define CAP_DMA_CR     ((7UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_PL_0 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | \
+                        DMA_SxCR_MINC | DMA_SxCR_CIRC)
+#define CAP_RUNS_AT    10U                       // 'B' frame: sync, type, length, first, samples, then the runs
+
+capture_stats_t capture_stats;
+
+static uint16_t       cap_buf[2][CAP_SAMPLES];   // GPIOA, GPIOC
+static capture_sink_t cap_sink;
+static uint32_t       cap_hz, cap_tim_hz, cap_ticks;
+static uint16_t       cap_mask_a, cap_mask_c;
+static uint32_t       cap_vbytes;                // bytes of a packed value
+static uint32_t       cap_index;                 // number of the next sample to compress
+static uint32_t       cap_pos;                   // and its place in the buffers
+static uint32_t       cap_header;                // 'H' frame still to send
+static uint32_t       cap_on, cap_listening;
+static uint8_t        cap_frame[CAPTURE_FRAME_MAX];
+static uint32_t       cap_len, cap_first, cap_count;   // frame being built: bytes, its samples
+
+static void cap_put16(uint8_t *p, uint32_t v){
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void cap_put32(uint8_t *p, uint32_t v){
+	cap_put16(p, v);
+	cap_put16(p + 2, v >> 16);
+}
+
+// Sync, type, length and sum around len payload bytes, then to the sink
+static uint32_t cap_send(uint32_t type, uint32_t len){
+	uint32_t i, sum = 0;
+	cap_frame[0] = CAPTURE_SYNC;
+	cap_frame[1] = (uint8_t)type;
+	cap_put16(cap_frame + 2, len);
+	for(i=1; i<4U+len; i++) sum += cap_frame[i];
+	cap_put16(cap_frame + 4U + len, sum);
+	if(cap_sink == 0 || !cap_sink(cap_frame, len + 6U)){
+		capture_stats.dropped++;
+		return 0;
+	}
+	capture_stats.frames++;
+	capture_stats.bytes += len + 6U;
+	return 1;
+}
+
+static void cap_send_header(void){
+	cap_put32(cap_frame + 4, cap_index);
+	cap_put32(cap_frame + 8, cap_tim_hz);
+	cap_put32(cap_frame + 12, cap_ticks);
+	cap_put16(cap_frame + 16, cap_mask_a);
+	cap_put16(cap_frame + 18, cap_mask_c);
+	if(cap_send(CAPTURE_HEADER, 16U)) cap_header = 0;
+}
+
+static RAMFUNC void cap_close(void){
+	if(cap_count == 0U) return;
+	cap_put32(cap_frame + 4, cap_first);
+	cap_put16(cap_frame + 8, cap_count);
+	cap_send(CAPTURE_DATA, cap_len - 4U);
+	cap_first += cap_count;
+	cap_count = 0;
+	cap_len   = CAP_RUNS_AT;
+}
+
+// A run that does not fit (value, 3 varint bytes, the sum) goes to a new frame
+static RAMFUNC void cap_run(uint32_t v, uint32_t n){
+	uint32_t i;
+	if(cap_len + cap_vbytes + 3U + 2U > CAPTURE_FRAME_MAX) cap_close();
+	for(i=0; i<cap_vbytes; i++, v >>= 8) cap_frame[cap_len++] = (uint8_t)v;
+	cap_count += n;
+	for(; n >= 0x80U; n >>= 7) cap_frame[cap_len++] = (uint8_t)(n | 0x80U);
+	cap_frame[cap_len++] = (uint8_t)n;
+}
+
+// Pins of the masks to consecutive channel bits, GPIOA in the low half of v; runs only at a change
+static RAMFUNC uint32_t cap_pack(uint32_t v){
+	uint32_t m = cap_mask_a | ((uint32_t)cap_mask_c << 16), out = 0, bit = 1;
+	for(; m; m &= m - 1U, bit <<= 1) if(v & m & (0U - m)) out |= bit;
+	return out;
+}
+
+/*
+ Runs of n samples, one frame or more. A run ends at the first sample
+ whose masked pins differ; two samples at a time, a half-word pair per
+ 32-bit load against the run value in both halves, then one at a time
+ for the pair that broke it.
+*/
+static RAMFUNC void cap_chunk(const uint16_t *a, const uint16_t *c, uint32_t n){
+	uint32_t ma = cap_mask_a, mc = cap_mask_c, wma = ma * 0x10001UL, wmc = mc * 0x10001UL;
+	uint32_t i = 0, j, va, vc, wa, wc, xa, xc;
+
+	cap_first = cap_index;
+	cap_count = 0;
+	cap_len   = CAP_RUNS_AT;
+	while(i < n){
+		va = a[i] & ma;
+		vc = c[i] & mc;
+		wa = va * 0x10001UL;
+		wc = vc * 0x10001UL;
+		for(j = i + 1U; j + 2U <= n; j += 2U){
+			memcpy(&xa, a + j, 4);
+			memcpy(&xc, c + j, 4);
+			if(((xa ^ wa) & wma) | ((xc ^ wc) & wmc)) break;
+		}
+		while(j < n && (((a[j] & ma) ^ va) | ((c[j] & mc) ^ vc)) == 0U) j++;
+		cap_run(cap_pack(va | (vc << 16)), j - i);
+		i = j;
+	}
+	cap_close();
+	cap_index += n;
+	capture_stats.samples += n;
+}
+
+// n samples of both ports from the next sample number on; the interrupt path and the host bench
+RAMFUNC void capture_block(const uint16_t *a, const uint16_t *c, uint32_t n){
+	uint32_t k;
+	for(; n; n -= k, a += k, c += k){
+		k = n < CAP_SAMPLES ? n : CAP_SAMPLES;
+		cap_chunk(a, c, k);
+	}
+}
+
+/*
+ Everything the DMA has written since the last call; Stream4 (GPIOC) is
+ the later of the two. A handler more than a half late that finds the
+ DMA less than a half past its last position has been lapped: the
+ oldest samples are overwritten, the newest buffer full goes out after
+ the gap.
+*/
+static RAMFUNC void cap_service(uint32_t late){
+	uint32_t w = CAP_SAMPLES - DMA2_Stream4->NDTR, ahead;
+	if(w >= CAP_SAMPLES) w = 0;
+	if(cap_header) cap_send_header();
+	ahead = (w + CAP_SAMPLES - cap_pos) % CAP_SAMPLES;
+	if(late && ahead < CAPTURE_BLOCK){
+		cap_index += ahead;
+		capture_stats.lost += ahead;
+		cap_pos = w;
+		capture_block(cap_buf[0] + w, cap_buf[1] + w, CAP_SAMPLES - w);
+		capture_block(cap_buf[0], cap_buf[1], w);
+		return;
+	}
+	if(w < cap_pos){
+		capture_block(cap_buf[0] + cap_pos, cap_buf[1] + cap_pos, CAP_SAMPLES - cap_pos);
+		cap_pos = 0;
+	}
+	if(w > cap_pos){
+		capture_block(cap_buf[0] + cap_pos, cap_buf[1] + cap_pos, w - cap_pos);
+		cap_pos = w;
+	}
+}
+
+// PSC only when ARR (16 bits) runs out, the rate rounded to the nearest tick
+static void cap_timing(void){
+	uint32_t hz = clock_tim_hz(TIM8), div = (hz + cap_hz / 2U) / cap_hz, psc, arr;
+	if(div < 2U) div = 2U;
+	psc = (div - 1U) / 0x10000UL;
+	arr = div / (psc + 1U) - 1U;
+	TIM8->PSC  = psc;
+	TIM8->ARR  = arr;
+	cap_tim_hz = hz;
+	cap_ticks  = (psc + 1U) * (arr + 1U);
+}
+
+static void cap_stream(DMA_Stream_TypeDef *s, volatile uint32_t *reg, uint16_t *buf, uint32_t ie){
+	s->PAR  = (uintptr_t)reg;
+	s->M0AR = (uintptr_t)buf;
+	s->NDTR = CAP_SAMPLES;
+	s->CR   = CAP_DMA_CR | ie;
+	s->CR  |= DMA_SxCR_EN;
+}
+
+// Timer and streams from the start of the buffers, a new 'H' frame first
+static void cap_start(void){
+	TIM8->CR1  = 0;
+	TIM8->DIER = 0;
+	DMA2_Stream3->CR = 0;
+	DMA2_Stream4->CR = 0;
+	while ((DMA2_Stream3->CR | DMA2_Stream4->CR) & DMA_SxCR_EN);
+	DMA2->LIFCR = CAP_LFLAGS;
+	DMA2->HIFCR = CAP_HFLAGS;
+
+	cap_timing();
+	TIM8->CCR2 = 0;                              // both requests at CNT 0
+	TIM8->CCR3 = 0;
+	TIM8->CR1  = TIM_CR1_ARPE | TIM_CR1_URS;     // load the shadows, no update request
+	TIM8->EGR  = TIM_EGR_UG;
+	TIM8->CR1  = TIM_CR1_ARPE;
+	cap_pos    = 0;
+	cap_header = 1;
+
+	cap_stream(DMA2_Stream3, &GPIOA->IDR, cap_buf[0], 0);
+	cap_stream(DMA2_Stream4, &GPIOC->IDR, cap_buf[1], DMA_SxCR_HTIE | DMA_SxCR_TCIE);
+	TIM8->DIER = TIM_DIER_CC2DE | TIM_DIER_CC3DE;
+	TIM8->CR1 |= TIM_CR1_CEN;
+}
+
+// Timer stopped, the samples it took compressed, no interrupt left over
+static void cap_flush(void){
+	NVIC_DisableIRQ(DMA2_Stream4_IRQn);
+	TIM8->CR1 = 0;
+	cap_service(0);
+	DMA2->HIFCR = CAP_HFLAGS;
+	NVIC_ClearPendingIRQ(DMA2_Stream4_IRQn);
+}
+
+// Same rate at the new timer clock; the samples during the switch carry the old timing
+static void cap_clock(void){
+	if(!cap_on) return;
+	cap_flush();
+	cap_start();
+	NVIC_EnableIRQ(DMA2_Stream4_IRQn);
+}
+
+// Samples GPIOA/GPIOC at hz (rounded, CAPTURE_MAX_HZ at most) into sink; returns the rate, 0 for hz 0
+uint32_t capture_start(uint32_t hz, uint16_t mask_a, uint16_t mask_c, capture_sink_t sink){
+	uint32_t m, channels = 0;
+	if(hz == 0U) return 0;
+	if(hz > CAPTURE_MAX_HZ) hz = CAPTURE_MAX_HZ;
+	capture_stop();
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOCEN | RCC_AHB1ENR_DMA2EN;
+	RCC->APB2ENR |= RCC_APB2ENR_TIM8EN;
+
+	for(m = mask_a | ((uint32_t)mask_c << 16); m; m &= m - 1U) channels++;
+	cap_hz     = hz;
+	cap_mask_a = mask_a;
+	cap_mask_c = mask_c;
+	cap_vbytes = (channels + 7U) / 8U;
+	cap_sink   = sink;
+	cap_index  = 0;
+	cap_on     = 1;
+	idle_hold();                                 // TIM8 and DMA2 need their clocks, no Stop
+	if(!cap_listening){
+		cap_listening = 1;
+		clock_listen(cap_clock);
+	}
+	cap_start();
+	NVIC_EnableIRQ(DMA2_Stream4_IRQn);
+	return cap_tim_hz / cap_ticks;
+}
+
+// The samples taken so far go out, then timer and streams off
+void capture_stop(void){
+	if(!cap_on) return;
+	cap_flush();
+	DMA2_Stream3->CR = 0;
+	DMA2_Stream4->CR = 0;
+	cap_on = 0;
+	idle_release();
+}
+
+uint32_t capture_to_log(const uint8_t *frame, uint32_t n){
+	return log_write_all((const char *)frame, n);
+}
+
+// Half transfer or transfer complete of GPIOC: compress up to where the DMA is; both flags, a half late
+RAMFUNC void DMA2_Stream4_IRQHandler(void){
+	uint32_t isr = DMA2->HISR, late;
+	DMA2->HIFCR = CAP_HFLAGS;
+	late = (isr & (DMA_HISR_HTIF4 | DMA_HISR_TCIF4)) == (DMA_HISR_HTIF4 | DMA_HISR_TCIF4);
+	capture_stats.overruns += late;
+	cap_service(late);
+}
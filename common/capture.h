@@ -0,0 +1,81 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+/* Logic analyzer on GPIOA/GPIOC for NUCLEO-F446RE
+
+ TIM8 ticks at the sample rate and DMA2 reads both input data registers
+ into two circular half-word buffers of 2 * CAPTURE_BLOCK samples:
+
+   Stream3 ch7 TIM8_CH2  GPIOA->IDR
+   Stream4 ch7 TIM8_CH3  GPIOC->IDR, right after Stream3 (lower stream
+                         first at equal priority)
+
+ CCR2 = CCR3 = 0, so both requests come at the start of each period. Only
+ DMA2 reaches the AHB1 GPIO ports. Streams 1, 2 and 5 stay free for
+ bam.h, which cannot run at the same time (TIM8 would be fine, DMA2
+ arbitration would not).
+
+ The half and full transfer interrupts of Stream4 compress what the DMA
+ has written since the last one (a block) into frames of at most
+ CAPTURE_FRAME_MAX bytes and hand them to a sink. Only the pins of
+ mask_a and mask_c are kept, packed into channels (mask_a bits first,
+ lowest pin lowest). A block is a list of runs: the packed value,
+ (channels + 7) / 8 bytes, then the run length as a LEB128 varint. The
+ scan compares two samples per 32-bit load, so a quiet line costs about
+ a cycle per sample.
+
+ Frame: 0xA5, type, payload length (u16), payload, 16-bit sum of the
+ bytes from type to the end of the payload. Little endian.
+
+   'H'  first sample (u32), timer clock (u32), ticks per sample (u32),
+        mask_a (u16), mask_c (u16): at the start and after each clock
+        change
+   'B'  first sample (u32), samples (u16), runs
+
+ capture_to_log() sends through log_write_all() (common/log.h): over
+ USART2 or ITM, between the printf() text, whole frames or nothing. A
+ frame the sink refuses is lost and counted; the gap shows in the
+ sample numbers. An interrupt taken more than a half late sees both
+ flags (capture_stats.overruns); if the DMA has lapped the compressor
+ by then, the overwritten samples are skipped (capture_stats.lost) and
+ the sample numbers jump over them as well.
+
+ At a clock change (clock_listen()) the samples so far are compressed,
+ PSC/ARR are re-derived for the same rate and the streams start over;
+ an 'H' frame carries the new timing. The core must not enter Stop
+ while capturing (idle_hold()).
+
+ tools/capvcd.py turns a stream of frames (a serial log, a file) into
+ a VCD for GTKWave and tools/vcdstat.py. host/capture_bench.c checks
+ the codec and the interrupt path and measures the compression ratio
+ and speed on recorded-style traces.
+*/
+
+#define CAPTURE_BLOCK      1024U                 // samples per DMA half
+#define CAPTURE_FRAME_MAX  120U                  // bytes, a LOG_BUF_BYTES half takes two
+#define CAPTURE_MAX_HZ     4000000UL
+#define CAPTURE_SYNC       0xA5U
+#define CAPTURE_HEADER     'H'
+#define CAPTURE_DATA       'B'
+
+typedef uint32_t (*capture_sink_t)(const uint8_t *frame, uint32_t n);   // 0: not taken
+
+typedef struct {
+	uint32_t samples;        // compressed
+	uint32_t frames;         // taken by the sink
+	uint32_t bytes;
+	uint32_t dropped;        // frames the sink refused
+	uint32_t overruns;       // interrupts a half late
+	uint32_t lost;           // samples overwritten before they were compressed
+} capture_stats_t;
+
+extern capture_stats_t capture_stats;
+
+uint32_t capture_start(uint32_t hz, uint16_t mask_a, uint16_t mask_c, capture_sink_t sink);
+void     capture_stop(void);
+void     capture_block(const uint16_t *a, const uint16_t *c, uint32_t n);
+uint32_t capture_to_log(const uint8_t *frame, uint32_t n);
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,193 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "place.h"
+#include "evt.h"
+
+/* Clock profiles and clock-change notification, see clock.h */
+
+// HSI / 16 * 336 = 336 MHz VCO, PLLQ 7 keeps the 48 MHz clock, pllp is the PLLP field (0: /2 .. 3: /8)
+#define CLOCK_PLL(pllp)  ((16UL << RCC_PLLCFGR_PLLM_Pos) | (336UL << RCC_PLLCFGR_PLLN_Pos) | \
+                          ((uint32_t)(pllp) << RCC_PLLCFGR_PLLP_Pos) | (7UL << RCC_PLLCFGR_PLLQ_Pos))
+
+#define CLOCK_VOS_SCALE3 PWR_CR_VOS_0
+#define CLOCK_VOS_SCALE1 PWR_CR_VOS
+
+// Wait states for 2.7-3.6 V, RM0390 table 5
+const clock_profile_t clock_profiles[CLOCK_PROFILES] ART_ALIGNED = {
+	{  16000000UL, 0,            0,                                         FLASH_ACR_LATENCY_0WS, CLOCK_VOS_SCALE3 },
+	{  42000000UL, CLOCK_PLL(3), 0,                                         FLASH_ACR_LATENCY_1WS, CLOCK_VOS_SCALE3 },
+	{  84000000UL, CLOCK_PLL(1), RCC_CFGR_PPRE1_DIV2,                       FLASH_ACR_LATENCY_2WS, CLOCK_VOS_SCALE3 },
+	{ 168000000UL, CLOCK_PLL(0), RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2, FLASH_ACR_LATENCY_5WS, CLOCK_VOS_SCALE1 },
+};
+
+typedef struct {
+	TIM_TypeDef *tim;
+	uint32_t     tick_hz;
+} clock_timer_t;
+
+static uint32_t         clock_current = CLOCK_16MHZ;     // reset state
+static uint32_t         clock_cycles_per_us = 16;
+static uint32_t         clock_systick_hz;
+static clock_listener_t clock_listeners[CLOCK_MAX_LISTENERS];
+static uint32_t         clock_nlisteners;
+static clock_timer_t    clock_timers[CLOCK_MAX_TIMERS];
+static uint32_t         clock_ntimers;
+
+static void clock_flash_latency(uint32_t latency){
+	FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_PRFTEN | latency;
+	while ((FLASH->ACR & FLASH_ACR_LATENCY) != latency);   // RM0390 3.4.1: check before the clock changes
+}
+
+// APBx timer clock: PCLK, doubled when the APB prescaler is not 1 (RM0390 6.2)
+static uint32_t clock_apb_timer_hz(uint32_t ppre){
+	if(ppre < 4U) return SystemCoreClock;
+	return (SystemCoreClock >> (ppre - 3U)) * 2U;
+}
+
+// APB1 peripheral clock (USART2/3, UART4/5, I2C), the undoubled PCLK1
+uint32_t clock_pclk1_hz(void){
+	uint32_t ppre = (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+	return ppre < 4U ? SystemCoreClock : SystemCoreClock >> (ppre - 3U);
+}
+
+uint32_t clock_tim_hz(TIM_TypeDef *tim){
+	uint32_t apb2 = (tim == TIM1 || tim == TIM8);
+#if defined(TIM9)
+	apb2 = apb2 || tim == TIM9 || tim == TIM10 || tim == TIM11;
+#endif
+	if(apb2) return clock_apb_timer_hz((RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos);
+	return clock_apb_timer_hz((RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos);
+}
+
+/*
+ PSC for the timer clock running now, into the preload register: the
+ next update event loads it, so the period in flight ends with the old
+ division and the counter is never restarted. clock_set_profile() stages
+ the HSI division before the PLL relock and the final one after, and
+ whichever update comes first gets the division of the clock of the
+ moment. ARR/CCR are untouched.
+*/
+static void clock_tim_apply(const clock_timer_t *t){
+	uint32_t hz = clock_tim_hz(t->tim);
+	t->tim->PSC = hz > t->tick_hz ? hz / t->tick_hz - 1U : 0U;
+}
+
+void clock_set_profile(uint32_t profile){
+	const clock_profile_t *p;
+	uint32_t i;
+	if(profile >= CLOCK_PROFILES) return;
+	p = &clock_profiles[profile];
+
+	RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+
+	// Going up: wait states first, the current clock is fine with more of them
+	if(p->latency > (FLASH->ACR & FLASH_ACR_LATENCY)) clock_flash_latency(p->latency);
+
+	// Run from HSI while the PLL and the bus prescalers are reprogrammed
+	RCC->CR |= RCC_CR_HSION;
+	while ((RCC->CR & RCC_CR_HSIRDY) == 0);
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_HSI;
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSI);
+	RCC->CFGR = p->cfgr | RCC_CFGR_SW_HSI;              // Target dividers are safe at 16 MHz
+	SystemCoreClockUpdate();                            // timers run from HSI until the PLL is back
+	for(i=0; i<clock_ntimers; i++) clock_tim_apply(&clock_timers[i]);
+
+	RCC->CR &= ~RCC_CR_PLLON;
+	while ((RCC->CR & RCC_CR_PLLRDY) != 0);
+	if(p->pllcfgr != 0){
+		PWR->CR = (PWR->CR & ~PWR_CR_VOS) | p->vos;      // Applied when the PLL starts
+		RCC->PLLCFGR = p->pllcfgr;
+		RCC->CR |= RCC_CR_PLLON;
+		while ((RCC->CR & RCC_CR_PLLRDY) == 0);
+		while ((PWR->CSR & PWR_CSR_VOSRDY) == 0);
+		RCC->CFGR = p->cfgr | RCC_CFGR_SW_PLL;
+		while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+	}
+
+	// Going down: drop wait states once the clock is already lower (also turns the caches on)
+	clock_flash_latency(p->latency);
+
+	clock_update();
+}
+
+uint32_t clock_profile(void){
+	return clock_current;
+}
+
+/*
+ Re-derive everything that depends on the core clock. Called by
+ clock_set_profile() and by any code that programs RCC itself.
+*/
+void clock_update(void){
+	uint32_t i;
+
+	SystemCoreClockUpdate();
+	for(i=0; i<CLOCK_PROFILES; i++)
+		if(clock_profiles[i].sysclk_hz == SystemCoreClock) clock_current = i;
+	clock_cycles_per_us = SystemCoreClock / 1000000U;
+
+	if(clock_systick_hz != 0){
+		SysTick->LOAD = SystemCoreClock / clock_systick_hz - 1U;
+		SysTick->VAL  = 0;
+	}
+	for(i=0; i<clock_ntimers; i++) clock_tim_apply(&clock_timers[i]);
+	for(i=0; i<clock_nlisteners; i++) clock_listeners[i]();
+	EVT_RECORD(EVT_CLOCK, clock_current, SystemCoreClock);
+}
+
+// 0 on success, 1 when the table is full (CLOCK_MAX_LISTENERS)
+uint32_t clock_listen(clock_listener_t fn){
+	if(clock_nlisteners >= CLOCK_MAX_LISTENERS) return 1;
+	clock_listeners[clock_nlisteners++] = fn;
+	return 0;
+}
+
+/*
+ The counter of tim ticks at tick_hz from now on, whatever the profile.
+ tick_hz should divide every timer clock of the table (1 or 2 MHz do),
+ otherwise PSC rounds down. 0 on success, 1 when the table is full.
+*/
+uint32_t clock_tim_attach(TIM_TypeDef *tim, uint32_t tick_hz){
+	uint32_t i, cr1;
+	if(tick_hz == 0) return 1;
+	for(i=0; i<clock_ntimers; i++) if(clock_timers[i].tim == tim) break;
+	if(i == clock_ntimers){
+		if(clock_ntimers >= CLOCK_MAX_TIMERS) return 1;
+		clock_ntimers++;
+	}
+	clock_timers[i].tim = tim;
+	clock_timers[i].tick_hz = tick_hz;
+	clock_tim_apply(&clock_timers[i]);
+	cr1 = tim->CR1;                              // attach loads PSC at once, URS: no update interrupt
+	tim->CR1 = cr1 | TIM_CR1_URS;
+	tim->EGR = TIM_EGR_UG;
+	tim->CR1 = cr1;
+	return 0;
+}
+
+// SysTick interrupt at tick_hz, reload follows the core clock. SysTick_Config() return value.
+uint32_t clock_systick_attach(uint32_t tick_hz){
+	if(tick_hz == 0) return 1;
+	clock_systick_hz = tick_hz;
+	return SysTick_Config(SystemCoreClock / tick_hz);
+}
+
+/*
+ Busy-wait delays on DWT->CYCCNT, calibrated from SystemCoreClock at the
+ last clock_update(). Unlike the for(i=0; i<delay; i++) loops they keep
+ their length over clock and optimisation changes.
+*/
+void clock_delay_us(uint32_t us){
+	uint32_t start, cycles;
+	if((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0){
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+	start = DWT->CYCCNT;
+	cycles = us * clock_cycles_per_us;
+	while ((DWT->CYCCNT - start) < cycles);
+}
+
+void clock_delay_ms(uint32_t ms){
+	while(ms-- > 0) clock_delay_us(1000U);
+}
@@ -0,0 +1,71 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+/* Clock profiles and clock-change notification for NUCLEO-F446RE
+
+ Every profile runs from HSI (16 MHz), through the PLL above 16 MHz:
+ HSI / PLLM 16 = 1 MHz VCO input, * PLLN 336 = 336 MHz VCO, / PLLP
+
+                SYSCLK  PLLP  APB1 (timers)  APB2 (timers)  FLASH  VOS
+ CLOCK_16MHZ    16      -     16 (16)        16 (16)        0WS    3
+ CLOCK_42MHZ    42      8     42 (42)        42 (42)        1WS    3
+ CLOCK_84MHZ    84      4     42 (84)        84 (84)        2WS    3
+ CLOCK_168MHZ   168     2     42 (84)        84 (168)       5WS    1
+
+ clock_set_profile() switches between them, then keeps the rest of the
+ firmware in step with the new clock:
+
+ - SystemCoreClock (SystemCoreClockUpdate())
+ - SysTick reload, when attached with clock_systick_attach()
+ - TIM PSC, when attached with clock_tim_attach(): the counter keeps
+   ticking at the requested rate, so ARR/CCR values stay valid.
+   The new PSC is preloaded and taken at the next update event: the
+   period in flight ends with the old division, none is cut short.
+   During the PLL relock the HSI division is staged the same way.
+ - clock_delay_us()/clock_delay_ms(), which count DWT cycles
+ - listeners registered with clock_listen()
+
+ Code that programs RCC by hand (enable_HSI(), boot_clock_finish())
+ calls clock_update() afterwards to run the same notification.
+*/
+
+enum {
+	CLOCK_16MHZ = 0,
+	CLOCK_42MHZ,
+	CLOCK_84MHZ,
+	CLOCK_168MHZ,
+	CLOCK_PROFILES
+};
+
+typedef struct {
+	uint32_t sysclk_hz;
+	uint32_t pllcfgr;        // 0: HSI drives SYSCLK directly
+	uint32_t cfgr;           // HPRE / PPRE1 / PPRE2
+	uint32_t latency;        // FLASH_ACR_LATENCY_xWS
+	uint32_t vos;            // PWR_CR_VOS scale
+} clock_profile_t;
+
+extern const clock_profile_t clock_profiles[CLOCK_PROFILES];
+
+#define CLOCK_MAX_LISTENERS 8
+#define CLOCK_MAX_TIMERS    4
+
+typedef void (*clock_listener_t)(void);
+
+void     clock_set_profile(uint32_t profile);
+uint32_t clock_profile(void);
+void     clock_update(void);
+
+uint32_t clock_listen(clock_listener_t fn);
+uint32_t clock_tim_attach(TIM_TypeDef *tim, uint32_t tick_hz);
+uint32_t clock_systick_attach(uint32_t tick_hz);
+
+uint32_t clock_tim_hz(TIM_TypeDef *tim);
+uint32_t clock_pclk1_hz(void);
+void     clock_delay_us(uint32_t us);
+void     clock_delay_ms(uint32_t ms);
+
+#endif /* CLOCK_H */
@@ -0,0 +1,238 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "place.h"
+#include "dds.h"
+
+/* Direct digital synthesis on TIM5, see dds.h */
+
+#define DDS_PWM1       (TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_2)   // OC1M 0110: active while CNT < CCR1
+#define DDS_DMA_FLAGS  (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+#define DDS_BEND_MAX   4800                  // cents, four octaves either way
+#define DDS_FRAC_BITS  14U                   // interpolation weight, (b - a) * frac stays in 31 bits
+#define DDS_STEP_MAX   0x7FFFFFFFUL          // half the sample rate
+
+dds_stats_t dds_stats;
+
+// One period, Q15
+const int16_t dds_sine[DDS_WAVE_LEN] ART_ALIGNED = {
+	     0,    804,   1608,   2410,   3212,   4011,   4808,   5602,   6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+	 12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,  18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+	 23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,  27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+	 30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,  32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+	 32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,  32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+	 30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,  27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+	 23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,  18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+	 12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,   6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+	     0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,  -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+	-12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+	-23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790, -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+	-30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+	-32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+	-30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683, -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+	-23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+	-12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,  -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+};
+
+// 2^(k/12) for k = 0..12, Q16
+static const uint32_t dds_semitone[13] = {
+	65536, 69433, 73562, 77936, 82570, 87480, 92682, 98193, 104032, 110218, 116772, 123715, 131072
+};
+
+static uint32_t                dds_buf[2U * DDS_BLOCK];
+static uint32_t                dds_phase;
+static volatile uint32_t       dds_base;              // step of the set frequency, 0: silent
+static volatile uint32_t       dds_amp = DDS_AMP_MAX;
+static const int16_t *volatile dds_wave = dds_sine;   // 0: square from the phase MSB
+static volatile int32_t        dds_cents;             // pitch bend
+static volatile uint32_t       dds_lfo_step;          // vibrato phase step per block
+static volatile uint32_t       dds_lfo_depth;         // vibrato depth, cents
+static uint32_t                dds_lfo_phase;
+static adsr_t *volatile        dds_env;               // amplitude envelope, ticked per block
+static volatile dds_source_t   dds_src;               // samples instead of the oscillator, 0: none
+static volatile uint32_t       dds_scale = 512U;      // duty levels, ARR + 1
+static uint32_t                dds_on;
+
+// Phase step per sample for hz_q16, limited to half the sample rate
+uint32_t dds_step(uint32_t hz_q16){
+	uint64_t step = (((uint64_t)hz_q16 << 16) + DDS_SAMPLE_HZ / 2U) / DDS_SAMPLE_HZ;
+	return step > DDS_STEP_MAX ? DDS_STEP_MAX : (uint32_t)step;
+}
+
+/*
+ 2^(cents/1200) in Q16: whole octaves shift, the semitone table covers
+ the rest, linear within the semitone (under 0.7 cent off).
+*/
+uint32_t dds_ratio(int32_t cents){
+	int32_t  oct;
+	uint32_t r, lo, hi;
+	if(cents >  DDS_BEND_MAX) cents =  DDS_BEND_MAX;
+	if(cents < -DDS_BEND_MAX) cents = -DDS_BEND_MAX;
+	oct = (cents + 12000) / 1200 - 10;          // rounds down for negative bends too
+	r   = (uint32_t)(cents - oct * 1200);       // 0..1199
+	lo  = dds_semitone[r / 100U];
+	hi  = dds_semitone[r / 100U + 1U];
+	r   = lo + (hi - lo) * (r % 100U) / 100U;
+	return oct >= 0 ? r << oct : r >> -oct;
+}
+
+uint32_t dds_levels(void){
+	return dds_scale;
+}
+
+void dds_set_hz(uint32_t hz_q16){
+	dds_base = dds_step(hz_q16);
+}
+
+void dds_set_wave(const int16_t *wave){
+	dds_wave = wave;
+}
+
+void dds_set_amp(uint32_t amp){
+	dds_amp = amp > DDS_AMP_MAX ? DDS_AMP_MAX : amp;
+}
+
+void dds_bend(int32_t cents){
+	dds_cents = cents;
+}
+
+// rate_q16 Hz, depth_cents either way; depth 0 turns vibrato off
+void dds_vibrato(uint32_t rate_q16, uint32_t depth_cents){
+	dds_lfo_step  = dds_step(rate_q16) * DDS_BLOCK;
+	dds_lfo_depth = depth_cents;
+}
+
+// Envelope on the amplitude, 0: none
+void dds_envelope(adsr_t *env){
+	dds_env = env;
+}
+
+// Sample source in place of the oscillator, 0: back to the oscillator
+void dds_source(dds_source_t src){
+	dds_src = src;
+}
+
+// Control tick: the step of this block, bend and vibrato applied
+static uint32_t dds_control(void){
+	uint32_t base = dds_base, step;
+	int32_t  cents = dds_cents;
+	if(dds_lfo_depth){
+		dds_lfo_phase += dds_lfo_step;
+		cents += (int32_t)dds_lfo_depth * dds_sine[dds_lfo_phase >> (32U - DDS_WAVE_BITS)] / 32768;
+	}
+	if(cents == 0 || base == 0) return base;
+	step = (uint32_t)(((uint64_t)base * dds_ratio(cents)) >> 16);
+	return step > DDS_STEP_MAX ? DDS_STEP_MAX : step;
+}
+
+/*
+ The next n duty values, 0..dds_levels()-1. The DMA interrupt renders
+ DDS_BLOCK at a time; the step, wave, amplitude and scale are read once
+ and the envelope ticks once per call.
+*/
+RAMFUNC void dds_render(uint32_t *out, uint32_t n){
+	uint32_t step = dds_control(), phase = dds_phase, amp = dds_amp, levels = dds_scale;
+	const int16_t *wave = dds_wave;
+	adsr_t *env = dds_env;
+	dds_source_t src = dds_src;
+	uint32_t i, idx, frac;
+	int32_t  a, b, s, *in = (int32_t *)out;
+
+	if(env)       amp = (amp * adsr_tick(env)) >> 15;
+	if(src){
+		src(in, n);                              // Q15 in place, duty values out
+		for(i=0; i<n; i++){
+			s = (in[i] * (int32_t)amp) >> 15;
+			out[i] = ((uint32_t)(s + 32768) * levels) >> 16;
+		}
+		return;
+	}
+	if(step == 0) amp = 0;
+	if(wave){
+		for(i=0; i<n; i++){
+			idx  = phase >> (32U - DDS_WAVE_BITS);
+			frac = (phase >> (32U - DDS_WAVE_BITS - DDS_FRAC_BITS)) & ((1U << DDS_FRAC_BITS) - 1U);
+			a = wave[idx];
+			b = wave[(idx + 1U) & (DDS_WAVE_LEN - 1U)];
+			s = a + (((b - a) * (int32_t)frac) >> DDS_FRAC_BITS);
+			s = (s * (int32_t)amp) >> 15;
+			out[i] = ((uint32_t)(s + 32768) * levels) >> 16;
+			phase += step;
+		}
+	} else {
+		for(i=0; i<n; i++){
+			s = (phase & 0x80000000UL) ? -32767 : 32767;
+			s = (s * (int32_t)amp) >> 15;
+			out[i] = ((uint32_t)(s + 32768) * levels) >> 16;
+			phase += step;
+		}
+	}
+	dds_phase = phase;
+}
+
+// Sample rate kept over clock changes: PSC 0, one period per sample
+static void dds_clock(void){
+	uint32_t scale = clock_tim_hz(TIM5) / DDS_SAMPLE_HZ;
+	dds_scale = scale;
+	TIM5->PSC = 0;
+	TIM5->ARR = scale - 1U;                      // preloaded, from the next update event
+}
+
+void dds_init(void){
+	uint32_t i, cr1;
+	RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+	dds_phase = 0;
+	dds_base  = 0;
+
+	TIM5->CR1   = TIM_CR1_ARPE;                  // up-counting, ARR preloaded
+	TIM5->DIER  = 0;
+	dds_clock();
+	for(i=0; i<2U * DDS_BLOCK; i++) dds_buf[i] = dds_scale / 2U;
+	TIM5->CCMR1 = DDS_PWM1 | TIM_CCMR1_OC1PE;    // CCR1 preloaded: the DMA writes the next period's duty
+	TIM5->CCR1  = dds_scale / 2U;
+	TIM5->CCER  = TIM_CCER_CC1E;                 // active high
+	cr1 = TIM5->CR1;
+	TIM5->CR1   = cr1 | TIM_CR1_URS;             // load the shadows, no update request
+	TIM5->EGR   = TIM_EGR_UG;
+	TIM5->CR1   = cr1;
+
+	DMA1_Stream0->CR = 0;
+	while (DMA1_Stream0->CR & DMA_SxCR_EN);
+	DMA1->LIFCR = DDS_DMA_FLAGS;
+	DMA1_Stream0->PAR  = (uintptr_t)&TIM5->CCR1;
+	DMA1_Stream0->M0AR = (uintptr_t)dds_buf;
+	DMA1_Stream0->NDTR = 2U * DDS_BLOCK;
+	// Channel 6 (TIM5_UP), memory -> peripheral, words, memory increment, circular, high priority
+	DMA1_Stream0->CR = (6UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+	                   DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0 | DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+	DMA1_Stream0->CR |= DMA_SxCR_EN;
+	NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+	if(!dds_on){
+		dds_on = 1;
+		clock_listen(dds_clock);
+		idle_hold();                             // TIM5 and the DMA need their clocks, no Stop
+	}
+
+	TIM5->DIER  = TIM_DIER_UDE;
+	TIM5->CR1  |= TIM_CR1_CEN;
+}
+
+/*
+ Half transfer: the DMA plays the second half, render the first; transfer
+ complete: the other way round. Both at once means a half was played
+ again while this interrupt waited.
+*/
+RAMFUNC void DMA1_Stream0_IRQHandler(void){
+	uint32_t isr = DMA1->LISR;
+	DMA1->LIFCR = DDS_DMA_FLAGS;
+	if((isr & (DMA_LISR_HTIF0 | DMA_LISR_TCIF0)) == (DMA_LISR_HTIF0 | DMA_LISR_TCIF0)) dds_stats.late++;
+	if(isr & DMA_LISR_HTIF0){
+		dds_render(dds_buf, DDS_BLOCK);
+		dds_stats.blocks++;
+	}
+	if(isr & DMA_LISR_TCIF0){
+		dds_render(dds_buf + DDS_BLOCK, DDS_BLOCK);
+		dds_stats.blocks++;
+	}
+}
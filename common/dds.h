@@ -0,0 +1,77 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <stdint.h>
+#include "adsr.h"
+
+/* Direct digital synthesis on TIM5 channel 1 for NUCLEO-F446RE
+
+ tone.h plays square waves whose pitch is tick_hz / 2 / (ARR + 1), an
+ integer division: 440 Hz at 2 MHz is 439.96 Hz, and every note change
+ or bend retunes the timer. Here TIM5 runs PWM at a fixed sample rate
+ and a 32-bit phase accumulator picks each sample from a wave table:
+
+   phase += step                step = f * 2^32 / DDS_SAMPLE_HZ
+   duty   = wave[phase >> 24]   linear between entries, times the amplitude
+
+ The step resolution is DDS_SAMPLE_HZ / 2^32 (7.3 uHz); frequencies are
+ Q16.16 Hz (DDS_HZ(261.6256)). Pitch bend and vibrato scale the step once
+ per block of DDS_BLOCK samples (the control rate, 977 Hz); the timer is
+ never touched after dds_init() and the phase runs on through every
+ change, so there is no click.
+
+ The duty values go to CCR1 by DMA1 Stream0 channel 6 (TIM5_UP), one per
+ update event, circular over two halves of DDS_BLOCK samples. The half
+ and full transfer interrupts render the half the DMA has just left.
+ CCR1 is preloaded: the value written at an update event is the duty of
+ the next period. PSC is 0 and ARR + 1 = timer clock / DDS_SAMPLE_HZ
+ levels (512 at 16 MHz, 2688 at 84 MHz); 31250 Hz divides the timer
+ clock of every clock.h profile, and a clock change re-derives ARR
+ (clock_listen()). The two blocks already rendered play with the old
+ scale.
+
+ dds_envelope() attaches an adsr.h envelope: it ticks once per block
+ and scales the amplitude, so notes start and end without a click.
+ dds_source() replaces the oscillator with a function that fills each
+ block with Q15 samples (pcm.h), amplitude and envelope still applied.
+
+ Silence (amplitude or frequency 0) is 50 % duty, the resting level of
+ the filtered output. The speaker pin (PA0, AF2) is set up by the caller.
+
+ host/dds_bench.c measures dds_render() in samples/s on the host, the
+ sample rate that fits a CPU budget, and the tuning of the output.
+*/
+
+#define DDS_SAMPLE_HZ  31250UL
+#define DDS_BLOCK      32U                  // samples per DMA half, DDS_SAMPLE_HZ / DDS_BLOCK control rate
+#define DDS_WAVE_BITS  8U
+#define DDS_WAVE_LEN   (1U << DDS_WAVE_BITS)
+#define DDS_AMP_MAX    32768U               // Q15 1.0
+#define DDS_CONTROL_US (DDS_BLOCK * 1000000UL / DDS_SAMPLE_HZ)   // control tick, 1024 us
+
+#define DDS_HZ(hz)     ((uint32_t)((hz) * 65536.0 + 0.5))   // Q16.16 Hz
+
+typedef struct {
+	uint32_t blocks;         // blocks rendered by the DMA interrupt
+	uint32_t late;           // interrupts that found both halves played
+} dds_stats_t;
+
+typedef void (*dds_source_t)(int32_t *out, uint32_t n);   // n Q15 samples at DDS_SAMPLE_HZ
+
+extern dds_stats_t   dds_stats;
+extern const int16_t dds_sine[DDS_WAVE_LEN];
+
+void     dds_init(void);
+void     dds_set_hz(uint32_t hz_q16);
+void     dds_set_wave(const int16_t *wave);
+void     dds_set_amp(uint32_t amp);
+void     dds_bend(int32_t cents);
+void     dds_vibrato(uint32_t rate_q16, uint32_t depth_cents);
+void     dds_envelope(adsr_t *env);
+void     dds_source(dds_source_t src);
+void     dds_render(uint32_t *out, uint32_t n);
+uint32_t dds_step(uint32_t hz_q16);
+uint32_t dds_ratio(int32_t cents);
+uint32_t dds_levels(void);
+
+#endif /* DDS_H */
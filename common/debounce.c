@@ -0,0 +1,129 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "place.h"
+#include "debounce.h"
+
+/* Debounced inputs on TIM7, see debounce.h */
+
+debounce_stats_t debounce_stats;
+
+static debounce_event_t  db_ring[DEBOUNCE_QUEUE];
+static volatile uint32_t db_head;              // written by the scan only
+static volatile uint32_t db_tail;              // written by debounce_get() only
+static uint32_t          db_state[2], db_c0[2], db_c1[2];   // word 0: A | B << 16, word 1: C
+static uint32_t          db_mask[2];
+static uint32_t          db_ticks, db_primed, db_timer;
+
+static RAMFUNC void db_push(uint32_t pin, uint32_t level){
+	uint32_t head = db_head;
+	if(head - db_tail >= DEBOUNCE_QUEUE){
+		debounce_stats.dropped++;
+		return;
+	}
+	db_ring[head % DEBOUNCE_QUEUE].tick  = db_ticks;
+	db_ring[head % DEBOUNCE_QUEUE].pin   = (uint8_t)pin;
+	db_ring[head % DEBOUNCE_QUEUE].level = (uint8_t)level;
+	__DMB();                                     // the slot before the head that publishes it
+	db_head = head + 1U;
+	debounce_stats.events++;
+}
+
+// One vertical counter round over word w; the pins whose new level was taken
+static RAMFUNC uint32_t db_count(uint32_t w, uint32_t idr){
+	uint32_t d = db_state[w] ^ idr;
+	db_c0[w] = ~(db_c0[w] & d);
+	db_c1[w] = db_c0[w] ^ (db_c1[w] & d);
+	d &= db_c0[w] & db_c1[w];
+	db_state[w] ^= d;
+	return d;
+}
+
+// An event per set bit of edges, lowest pin first
+static RAMFUNC void db_emit(uint32_t edges, uint32_t w){
+	uint32_t b;
+	while(edges){
+		b = __CLZ(__RBIT(edges));
+		edges &= edges - 1U;
+		db_push(32U * w + b, (db_state[w] >> b) & 1U);
+	}
+}
+
+// One scan: TIM7_IRQHandler, or the project's own periodic interrupt (hz 0)
+RAMFUNC void debounce_tick(void){
+	uint32_t ab = (GPIOA->IDR & 0xFFFFU) | (GPIOB->IDR << 16);
+	uint32_t c  = GPIOC->IDR & 0xFFFFU;
+	uint32_t e0, e1;
+
+	db_ticks++;
+	debounce_stats.scans++;
+	if(!db_primed){                              // the levels at the start make no events
+		db_state[0] = ab;
+		db_state[1] = c;
+		db_primed = 1;
+		return;
+	}
+	e0 = db_count(0, ab) & db_mask[0];
+	e1 = db_count(1, c) & db_mask[1];
+	if(e0 | e1){
+		db_emit(e0, 0);
+		db_emit(e1, 1);
+	}
+}
+
+RAMFUNC void TIM7_IRQHandler(void){
+	TIM7->SR = ~(uint32_t)TIM_SR_UIF;
+	debounce_tick();
+}
+
+// Scans at hz (0: debounce_tick() called by the project); events for the pins of the masks
+void debounce_start(uint32_t hz, uint16_t mask_a, uint16_t mask_b, uint16_t mask_c){
+	debounce_stop();
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOBEN | RCC_AHB1ENR_GPIOCEN;
+	db_mask[0] = mask_a | ((uint32_t)mask_b << 16);
+	db_mask[1] = mask_c;
+	db_c0[0] = db_c0[1] = db_c1[0] = db_c1[1] = 0xFFFFFFFFUL;
+	db_ticks = db_primed = 0;
+	db_head = db_tail = 0;
+	if(hz == 0) return;
+
+	if(hz > DEBOUNCE_TICK_HZ) hz = DEBOUNCE_TICK_HZ;
+	RCC->APB1ENR |= RCC_APB1ENR_TIM7EN;
+	TIM7->CR1  = TIM_CR1_ARPE;
+	TIM7->DIER = 0;
+	TIM7->ARR  = DEBOUNCE_TICK_HZ / hz - 1U;
+	clock_tim_attach(TIM7, DEBOUNCE_TICK_HZ);    // PSC, loads the shadows; redone on clock changes
+	TIM7->SR   = 0;
+	TIM7->DIER = TIM_DIER_UIE;
+	NVIC_EnableIRQ(TIM7_IRQn);
+	TIM7->CR1 |= TIM_CR1_CEN;
+	db_timer = 1;
+	idle_hold();                                 // TIM7 needs its clock, no Stop
+}
+
+void debounce_stop(void){
+	if(db_timer){
+		TIM7->CR1 &= ~TIM_CR1_CEN;
+		TIM7->DIER = 0;
+		NVIC_DisableIRQ(TIM7_IRQn);
+		NVIC_ClearPendingIRQ(TIM7_IRQn);
+		db_timer = 0;
+		idle_release();
+	}
+}
+
+// Oldest event into *e: 1, or 0 when there is none
+uint32_t debounce_get(debounce_event_t *e){
+	uint32_t tail = db_tail;
+	if(tail == db_head) return 0;
+	__DMB();                                     // the head before the slot it published
+	*e = db_ring[tail % DEBOUNCE_QUEUE];
+	__DMB();                                     // the slot read before it is handed back
+	db_tail = tail + 1U;
+	return 1;
+}
+
+// Debounced level of a pin (DEBOUNCE_PIN()), masked or not
+uint32_t debounce_level(uint32_t pin){
+	return (db_state[pin >> 5] >> (pin & 31U)) & 1U;
+}
@@ -0,0 +1,75 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdint.h>
+
+/* Debounced inputs on GPIOA/GPIOB/GPIOC for NUCLEO-F446RE
+
+ TIM7 interrupts at the scan rate; every scan reads the three IDRs once
+ and runs a 2-bit vertical counter over them. Bit i of the counter words
+ c0/c1 is the counter of pin i, so all pins of a word count at once. A
+ and B share one 32-bit word (B in the upper half), C has the other:
+ 48 inputs cost two rounds of
+
+   d      = state ^ idr         pins away from their debounced level
+   c0     = ~(c0 & d)           counters of the pins that are not
+   c1     = c0 ^ (c1 & d)       reset to 3, the others count down
+   d     &= c0 & c1             wrapped past 0: DEBOUNCE_SCANS in a row
+   state ^= d
+
+ A new level must be read DEBOUNCE_SCANS scans in a row before it is
+ taken, so contact bounce shorter than DEBOUNCE_SCANS - 1 scan periods
+ is never seen (4 scans at DEBOUNCE_HZ: 6-8 ms from the last bounce).
+ Levels are kept for every pin; only the pins of the masks given to
+ debounce_start() make events.
+
+ Events (pin, new level, scan count) go into a single-producer,
+ single-consumer ring: the scan writes the slot and then moves the head,
+ debounce_get() reads the slot and then moves the tail, no locks and no
+ interrupt masking on either side. A full ring drops the event and
+ counts it (debounce_stats.dropped); the level is still right.
+
+ TIM7 counts at DEBOUNCE_TICK_HZ through clock_tim_attach(), so the scan
+ rate holds over clock changes. TIM7 stops in Stop: the core only
+ Sleeps while scanning (idle_hold()). hz 0 leaves TIM7 alone, the
+ project calls debounce_tick() from its own periodic interrupt.
+
+ host/debounce_bench.c replays contact-bounce traces of buttons through
+ the IDRs and checks the queue with the scan on another thread.
+*/
+
+#define DEBOUNCE_HZ       500U                   // default scan rate
+#define DEBOUNCE_SCANS    4U                     // scans of a new level before it is taken
+#define DEBOUNCE_TICK_HZ  10000UL                // TIM7 counter, divides every timer clock
+#define DEBOUNCE_QUEUE    32U                    // events, power of two
+
+#define DEBOUNCE_PIN(port, bit)  ((port) * 16U + (bit))   // port 0 A, 1 B, 2 C
+
+enum {
+	DEBOUNCE_PA = 0,
+	DEBOUNCE_PB = 16,
+	DEBOUNCE_PC = 32
+};
+
+typedef struct {
+	uint32_t tick;           // scan the new level was taken at
+	uint8_t  pin;            // DEBOUNCE_PIN()
+	uint8_t  level;
+	uint16_t reserved;
+} debounce_event_t;
+
+typedef struct {
+	uint32_t scans;
+	uint32_t events;         // queued
+	uint32_t dropped;        // ring full
+} debounce_stats_t;
+
+extern debounce_stats_t debounce_stats;
+
+void     debounce_start(uint32_t hz, uint16_t mask_a, uint16_t mask_b, uint16_t mask_c);
+void     debounce_stop(void);
+void     debounce_tick(void);
+uint32_t debounce_get(debounce_event_t *e);
+uint32_t debounce_level(uint32_t pin);
+
+#endif /* DEBOUNCE_H */
@@ -0,0 +1,115 @@
+#include "evt.h"
+
+/* Event trace, see evt.h */
+
+#ifdef EVT_TRACE
+
+#include "stm32f446xx.h"
+#include "place.h"
+#ifdef HOST_BUILD
+#include <stdio.h>
+#include "model.h"
+#endif
+#if defined(__ARMCC_VERSION)
+#include "RTE_Components.h"
+#endif
+#if defined(RTE_Compiler_EventRecorder)
+#include "EventRecorder.h"
+#endif
+
+evt_log_t evt_log;
+
+static uint32_t evt_dumped;              // head at the end of the previous evt_dump()
+
+static uint32_t evt_now(void){
+#ifdef HOST_BUILD
+	return (uint32_t)model_cycles();
+#else
+	return DWT->CYCCNT;
+#endif
+}
+
+/*
+ Records made before evt_init() (clock setup) stay in the ring, only
+ the header and the cycle counter are set up here. CYCCNT is not
+ cleared, PROFILE and BOOT_TRACE run on the same counter.
+*/
+void evt_init(void){
+#ifndef HOST_BUILD
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL  |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	evt_log.entries = EVT_RING_ENTRIES;
+	evt_log.hz      = SystemCoreClock;
+	evt_log.magic   = EVT_MAGIC;
+#if defined(RTE_Compiler_EventRecorder)
+	EventRecorderInitialize(EventRecordAll, 1U);
+#endif
+}
+
+// Interrupt handlers record too: claim the slot with PRIMASK set
+RAMFUNC void evt_record(uint32_t msg, uint32_t val1, uint32_t val2){
+	evt_record_t *r;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	r = &evt_log.ring[evt_log.head & (EVT_RING_ENTRIES - 1U)];
+	evt_log.head++;
+	r->ts   = evt_now();
+	r->id   = (uint16_t)((EVT_COMPONENT << 8) | msg);
+	r->val1 = (uint16_t)val1;
+	r->val2 = val2;
+	if(primask == 0) __enable_irq();
+#if defined(RTE_Compiler_EventRecorder)
+	EventRecord2(EventID(EventLevelOp, EVT_COMPONENT, msg), val1, val2);
+#endif
+}
+
+/////////////////////////////// ITM output ///////////////////////////////
+// Same small formatter as prof.c, no printf in the image
+
+static void evt_putc(char c){
+#ifdef HOST_BUILD
+	putchar(c);
+#else
+	ITM_SendChar((uint32_t)c);    // Stimulus port 0, same as printf retarget
+#endif
+}
+
+static void evt_puts(const char *s){
+	while(*s) evt_putc(*s++);
+}
+
+static void evt_puthex(uint32_t v, uint32_t digits){
+	while(digits-- > 0) evt_putc("0123456789abcdef"[(v >> (4U * digits)) & 0xFU]);
+}
+
+/*
+ "EVT HZ <hz>" once, then "EVT <seq> <ts> <id> <val1> <val2>" in hex for
+ every record since the previous dump. When more than a ring's worth
+ came in between, the oldest are gone and "EVT LOST <n>" says how many.
+*/
+void evt_dump(void){
+	uint32_t head = evt_log.head, lost;
+	const evt_record_t *r;
+
+	if(evt_dumped == 0 && head != 0){
+		evt_puts("EVT HZ ");  evt_puthex(evt_log.hz, 8);  evt_puts("\r\n");
+	}
+	if(head - evt_dumped > EVT_RING_ENTRIES){
+		lost = head - evt_dumped - EVT_RING_ENTRIES;
+		evt_puts("EVT LOST ");  evt_puthex(lost, 8);  evt_puts("\r\n");
+		evt_dumped += lost;
+	}
+	for(; evt_dumped != head; evt_dumped++){
+		r = &evt_log.ring[evt_dumped & (EVT_RING_ENTRIES - 1U)];
+		evt_puts("EVT ");
+		evt_puthex(evt_dumped, 8);  evt_putc(' ');
+		evt_puthex(r->ts, 8);       evt_putc(' ');
+		evt_puthex(r->id, 4);       evt_putc(' ');
+		evt_puthex(r->val1, 4);     evt_putc(' ');
+		evt_puthex(r->val2, 8);
+		evt_puts("\r\n");
+	}
+}
+
+#endif /* EVT_TRACE */
@@ -0,0 +1,92 @@
+#ifndef EVT_H
+#define EVT_H
+
+#include <stdint.h>
+
+/* Event trace for NUCLEO-F446RE
+
+ EVT_RECORD() stores a 12-byte record (cycle stamp, event id, two
+ values) in a RAM ring and returns; nothing is formatted on the target.
+ The ring keeps the last EVT_RING_ENTRIES events and lives in evt_log,
+ one block a debugger can dump as it is.
+
+ Stamps are DWT->CYCCNT core cycles (model cycles on the host).
+ EVT_CLOCK carries the new SystemCoreClock, so the decoder converts
+ every stretch with the clock it ran at.
+
+ Reading the trace:
+ - EVT_DUMP() prints the records since the previous dump as text over
+   ITM port 0 (stdout on the host), from thread mode
+ - a debugger dump of evt_log (binary, starts with EVT_MAGIC)
+ - Keil with the Event Recorder component: every record also goes to
+   EventRecord2() and common/keil/evt.scvd names the events in the
+   Event Recorder window
+
+ tools/evtscvd.py writes common/keil/evt.scvd from EVT_EVENTS below,
+ tools/evtdecode.py turns a dump into Chrome trace JSON
+ (chrome://tracing, ui.perfetto.dev) and prints ISR durations.
+
+ EVT_STEP coils: bit 0 A1, 1 B1, 2 A2, 3 B2 driven high.
+
+ The macros expand to nothing unless EVT_TRACE is defined.
+
+ Usage:
+	EVT_INIT();
+	EVT_RECORD(EVT_NOTE, note, freq_hz);
+	...
+	EVT_DUMP();
+*/
+
+// name, message number, SCVD property, SCVD value (val1, val2)
+#define EVT_EVENTS(X) \
+	X(EVT_STEP,      0x01, "Step",      "step=%d[val1] coils=%x[val2]") \
+	X(EVT_NOTE,      0x02, "Note",      "note=%d[val1] freq=%d[val2] Hz") \
+	X(EVT_BUTTON,    0x03, "Button",    "pin=%d[val1] level=%d[val2]") \
+	X(EVT_ISR_ENTER, 0x04, "IsrEnter",  "irq=%d[val1]") \
+	X(EVT_ISR_EXIT,  0x05, "IsrExit",   "irq=%d[val1]") \
+	X(EVT_CLOCK,     0x06, "Clock",     "profile=%d[val1] sysclk=%d[val2] Hz")
+
+#define EVT_ENUM(name, no, property, value)  name = no,
+enum { EVT_EVENTS(EVT_ENUM) };
+#undef EVT_ENUM
+
+#define EVT_COMPONENT     0x01U      // Event Recorder component number (user range 0x00-0x3F)
+#define EVT_RING_ENTRIES  256U       // power of two
+#define EVT_MAGIC         0x31545645UL   // "EVT1"
+
+typedef struct {
+	uint32_t ts;             // core cycles
+	uint16_t id;             // EVT_COMPONENT << 8 | message number
+	uint16_t val1;
+	uint32_t val2;
+} evt_record_t;
+
+typedef struct {
+	uint32_t magic;          // EVT_MAGIC
+	uint32_t entries;        // EVT_RING_ENTRIES
+	volatile uint32_t head;  // records since evt_init(), slot = head % entries
+	uint32_t hz;             // SystemCoreClock at evt_init()
+	evt_record_t ring[EVT_RING_ENTRIES];
+} evt_log_t;
+
+#ifdef EVT_TRACE
+
+extern evt_log_t evt_log;
+
+void evt_init(void);
+void evt_record(uint32_t msg, uint32_t val1, uint32_t val2);
+void evt_dump(void);
+
+#define EVT_INIT()                  evt_init()
+#define EVT_RECORD(msg, val1, val2) evt_record(msg, val1, val2)
+#define EVT_DUMP()                  evt_dump()
+
+#else
+
+#define EVT_INIT()                  ((void)0)
+#define EVT_RECORD(msg, val1, val2) ((void)0)
+#define EVT_DUMP()                  ((void)0)
+
+#endif
+
+#endif /* EVT_H */
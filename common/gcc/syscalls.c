@@ -0,0 +1,22 @@
+#include "stm32f446xx.h"
+#include "log.h"
+
+/* Newlib retarget for the GCC build
+
+ Keil links RTE_Compiler_IO_STDOUT_ITM for printf(), this does the same
+ for arm-none-eabi-gcc: stdout/stderr go to ITM stimulus port 0, or to
+ the buffered transport of common/log.h with LOG_UART / LOG_ITM.
+ Everything else comes from nosys.specs.
+*/
+
+int _write(int fd, const char *buf, int len){
+#if defined(LOG_UART) || defined(LOG_ITM)
+	(void)fd;
+	log_write(buf, (uint32_t)len);
+#else
+	int i;
+	(void)fd;
+	for(i=0; i<len; i++) ITM_SendChar((uint32_t)buf[i]);
+#endif
+	return len;
+}
@@ -0,0 +1,161 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "governor.h"
+#include "place.h"
+
+/* Load-driven clock governor, see governor.h */
+
+gov_policy_t gov_policy;
+gov_stats_t  gov_stats;
+
+static volatile uint32_t gov_ticks;            // ms since gov_init()
+static volatile uint32_t gov_next;             // profile chosen by the last window
+static volatile uint32_t gov_sleeping;         // inside the WFI of gov_idle()
+static volatile uint32_t gov_idle_from;        // cycle time the current idle stretch started
+static volatile uint32_t gov_idle_cycles;      // idle cycles in the current window
+static uint32_t          gov_window_start;
+static uint32_t          gov_window_ms, gov_window_left;
+
+void gov_policy_default(gov_policy_t *g, uint32_t profile){
+	g->profile       = profile;
+	g->min_profile   = CLOCK_16MHZ;
+	g->max_profile   = CLOCK_PROFILES - 1U;
+	g->up_permille   = 800;
+	g->down_permille = 300;
+	g->hold          = 3;
+	g->below         = 0;
+}
+
+// Lowest allowed profile that runs `demand` (load permille * MHz) under `target` permille
+static uint32_t gov_fit(const gov_policy_t *g, uint32_t demand, uint32_t target){
+	uint32_t p;
+	for(p = g->min_profile; p < g->max_profile; p++)
+		if(demand <= target * (clock_profiles[p].sysclk_hz / 1000000U)) break;
+	return p;
+}
+
+uint32_t gov_decide(gov_policy_t *g, uint32_t load){
+	uint32_t target = (g->up_permille + g->down_permille) / 2U;
+	uint32_t demand = load * (clock_profiles[g->profile].sysclk_hz / 1000000U);
+	uint32_t p = g->profile;
+
+	if(load >= 1000U){
+		// No idle at all, the real demand is unknown
+		g->below = 0;
+		p = g->max_profile;
+	} else if(load > g->up_permille){
+		g->below = 0;
+		p = gov_fit(g, demand, target);
+		if(p <= g->profile) p = g->profile < g->max_profile ? g->profile + 1U : g->max_profile;
+	} else if(load < g->down_permille){
+		if(++g->below >= g->hold){
+			g->below = 0;
+			p = gov_fit(g, demand, target);
+			if(p > g->profile) p = g->profile;
+		}
+	} else {
+		g->below = 0;
+	}
+	g->profile = p;
+	return p;
+}
+
+/*
+ Core cycles since gov_init(): ms count * SysTick period + SysTick progress.
+ A tick that is pending but not yet handled (interrupts masked) has
+ already reloaded VAL, PENDSTSET tells.
+*/
+static uint32_t gov_now(void){
+	uint32_t ms, val, load = SysTick->LOAD + 1U;
+	do {
+		ms  = gov_ticks;
+		val = SysTick->VAL;
+	} while(ms != gov_ticks);
+	if((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > load / 2U) ms++;
+	return ms * load + (load - 1U - val);
+}
+
+static void gov_window_restart(void){
+	gov_window_start = gov_now();
+	gov_idle_cycles  = 0;
+	gov_window_left  = gov_window_ms;
+}
+
+COLDFUNC void gov_init(uint32_t window_ms){
+	gov_policy_default(&gov_policy, clock_profile());
+	gov_next = clock_profile();
+	gov_window_ms = window_ms ? window_ms : 1U;
+	clock_systick_attach(1000);
+	gov_window_restart();
+}
+
+// Called from the SysTick_Handler below in GOVERNOR builds
+RAMFUNC void gov_tick(void){
+	uint32_t now, window, load;
+
+	gov_ticks++;
+	gov_stats.time_ms[clock_profile()]++;
+	if(gov_window_left == 0 || --gov_window_left != 0) return;
+
+	now = gov_now();
+	if(gov_sleeping){                            // woken by this tick, count the idle part up to now
+		gov_idle_cycles += now - gov_idle_from;
+		gov_idle_from = now;
+	}
+	window = now - gov_window_start;
+	load = window ? 1000U - (uint32_t)((uint64_t)gov_idle_cycles * 1000U / window) : 0U;
+	if(load > 1000U) load = 0;                   // idle rounding past the window end
+
+	gov_stats.windows++;
+	gov_stats.last_load = load;
+	gov_next = gov_decide(&gov_policy, load);
+
+	gov_window_start = now;
+	gov_idle_cycles = 0;
+	gov_window_left = gov_window_ms;
+}
+
+/*
+ Strong definition: the startup files already export a weak SysTick_Handler
+ aliased to Default_Handler, and ld neither replaces one weak definition by
+ another nor pulls governor.o out of fw_common for it. Only GOVERNOR builds
+ own SysTick, other ones keep it free for their own handler.
+*/
+#ifdef GOVERNOR
+RAMFUNC void SysTick_Handler(void){
+	gov_tick();
+}
+#endif
+
+/*
+ Sleep until the next interrupt, counting the cycles as idle. A profile
+ change decided by the last window is applied first, from thread mode:
+ clock_set_profile() busy-waits on the PLL and must not run in the ISR.
+*/
+void gov_idle(void){
+	uint32_t next = gov_next;
+	if(next != clock_profile()){
+		clock_set_profile(next);
+		gov_stats.changes++;
+		__disable_irq();
+		gov_window_restart();                    // cycle scale changed with SysTick->LOAD
+		__enable_irq();
+	}
+
+	gov_idle_from = gov_now();
+	gov_sleeping = 1;
+	__WFI();
+	__disable_irq();
+	gov_idle_cycles += gov_now() - gov_idle_from;
+	gov_sleeping = 0;
+	__enable_irq();
+}
+
+void gov_delay_ms(uint32_t ms){
+	uint32_t start = gov_ticks;
+	while(gov_ticks - start < ms) gov_idle();
+}
+
+uint32_t gov_ms(void){
+	return gov_ticks;
+}
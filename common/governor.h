@@ -0,0 +1,73 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdint.h>
+#include "clock.h"
+
+/* Load-driven clock governor for NUCLEO-F446RE
+
+ SysTick runs at 1 kHz (clock_systick_attach()) and stays running in
+ Sleep, so the core cycles spent in WFI are measured from SysTick->VAL.
+ Every window the load (busy cycles / window cycles, in permille) goes
+ to gov_decide(), which picks one of the clock.h profiles:
+
+ - load above up_permille: the lowest faster profile whose predicted
+   load (load * f_now / f_new) is below the midpoint of the two thresholds
+ - load below down_permille for hold windows: the lowest profile that
+   keeps the predicted load under that midpoint
+
+ The switch itself happens in gov_idle(), outside the interrupt.
+ clock_set_profile() moves flash latency and VOS with the clock and
+ rescales every attached timer prescaler, so tone and PWM frequencies
+ keep their value (clock.h). gov_decide() does not touch hardware and is
+ what host/gov_sim.c replays load traces through.
+
+ Firmware:  gov_init(20); ... gov_delay_ms(n) instead of busy loops,
+            gov_idle() instead of while(1);
+ The GOV_* macros do that when GOVERNOR is defined and fall back to the
+ fixed clock with clock_delay_ms() otherwise. GOVERNOR builds also get
+ SysTick_Handler from governor.c, so the project must not define its own.
+*/
+
+typedef struct {
+	uint32_t profile;          // current clock.h profile
+	uint32_t min_profile;
+	uint32_t max_profile;
+	uint32_t up_permille;      // step up above this load
+	uint32_t down_permille;    // step down below this load...
+	uint32_t hold;             // ...for this many consecutive windows
+	uint32_t below;            // windows below down_permille so far
+} gov_policy_t;
+
+typedef struct {
+	uint32_t windows;
+	uint32_t changes;
+	uint32_t last_load;        // permille
+	uint32_t time_ms[CLOCK_PROFILES];
+} gov_stats_t;
+
+extern gov_policy_t gov_policy;
+extern gov_stats_t  gov_stats;
+
+void     gov_policy_default(gov_policy_t *g, uint32_t profile);
+uint32_t gov_decide(gov_policy_t *g, uint32_t load_permille);
+
+void     gov_init(uint32_t window_ms);
+void     gov_tick(void);
+void     gov_idle(void);
+void     gov_delay_ms(uint32_t ms);
+uint32_t gov_ms(void);
+
+#ifdef GOVERNOR
+
+#define GOV_INIT(window_ms)  gov_init(window_ms)
+#define GOV_DELAY_MS(ms)     gov_delay_ms(ms)
+
+#else
+
+#define GOV_INIT(window_ms)  ((void)0)
+#define GOV_DELAY_MS(ms)     clock_delay_ms(ms)
+
+#endif
+
+#endif /* GOVERNOR_H */
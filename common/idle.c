@@ -0,0 +1,178 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "place.h"
+
+/* Low-power idle, see idle.h */
+
+#define IDLE_PREDIV_S  31999UL        // LSI / (0+1) / (31999+1) = 1 Hz calendar, SSR in 1/32000 s
+
+idle_stats_t idle_stats;
+
+static volatile uint32_t idle_holds;
+static uint32_t          idle_last;      // end of the previous idle period
+
+COLDFUNC void idle_init(void){
+	RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+	PWR->CR |= PWR_CR_DBP;                            // RTC registers writable
+	PWR->CR = (PWR->CR & ~PWR_CR_PDDS) | PWR_CR_LPDS; // deep sleep = Stop, low-power regulator
+
+	// RTC from LSI, the only clock left running in Stop
+	RCC->CSR |= RCC_CSR_LSION;
+	while ((RCC->CSR & RCC_CSR_LSIRDY) == 0);
+	if((RCC->BDCR & RCC_BDCR_RTCEN) == 0){
+		RCC->BDCR = (RCC->BDCR & ~RCC_BDCR_RTCSEL) | RCC_BDCR_RTCSEL_1;
+		RCC->BDCR |= RCC_BDCR_RTCEN;
+	}
+
+	RTC->WPR = 0xCA;                                  // unlock, kept open for the wakeup timer
+	RTC->WPR = 0x53;
+	RTC->ISR |= RTC_ISR_INIT;
+	while ((RTC->ISR & RTC_ISR_INITF) == 0);
+	RTC->PRER = IDLE_PREDIV_S;                        // synchronous first, then asynchronous (RM0390 26.3.5)
+	RTC->PRER = IDLE_PREDIV_S | (0UL << RTC_PRER_PREDIV_A_Pos);
+	RTC->TR = 0;
+	RTC->CR |= RTC_CR_BYPSHAD;                        // TR/SSR read directly, no RSF wait after Stop
+	RTC->ISR &= ~(RTC_ISR_INIT | RTC_ISR_RSF);
+	while ((RTC->ISR & RTC_ISR_RSF) == 0);            // calendar running again
+
+	// Wakeup timer -> EXTI line 22 (rising) -> RTC_WKUP_IRQn
+	EXTI->IMR  |= EXTI_IMR_MR22;
+	EXTI->RTSR |= EXTI_RTSR_TR22;
+	NVIC_EnableIRQ(RTC_WKUP_IRQn);
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	idle_last = idle_now_us();
+}
+
+// A peripheral needs its clock (timer output, DMA): Sleep only until released
+void idle_hold(void){
+	idle_holds++;
+}
+
+void idle_release(void){
+	if(idle_holds) idle_holds--;
+}
+
+// Microseconds since idle_init(), wraps once a day with the calendar
+uint32_t idle_now_us(void){
+	uint32_t tr, ssr, secs;
+	do {
+		tr  = RTC->TR;
+		ssr = RTC->SSR;
+	} while(tr != RTC->TR);
+	secs = (tr & 0xFU) + ((tr >> RTC_TR_ST_Pos) & 0x7U) * 10U
+	     + (((tr >> RTC_TR_MNU_Pos) & 0xFU) + ((tr >> RTC_TR_MNT_Pos) & 0x7U) * 10U) * 60U
+	     + (((tr >> RTC_TR_HU_Pos) & 0xFU) + ((tr >> RTC_TR_HT_Pos) & 0x3U) * 10U) * 3600U;
+	return secs * 1000000U + (IDLE_PREDIV_S - ssr) * 125U / 4U;
+}
+
+// Wake-up in `ticks` steps of IDLE_WUT_US
+static void idle_arm(uint32_t ticks){
+	RTC->CR &= ~RTC_CR_WUTE;
+	while ((RTC->ISR & RTC_ISR_WUTWF) == 0);          // up to 2 RTCCLK
+	RTC->WUTR = ticks - 1U;
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	EXTI->PR = EXTI_PR_PR22;
+	RTC->CR = (RTC->CR & ~RTC_CR_WUCKSEL) | RTC_CR_WUTIE | RTC_CR_WUTE;   // WUCKSEL 000: RTCCLK / 16
+}
+
+RAMFUNC void RTC_WKUP_IRQHandler(void){
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	EXTI->PR = EXTI_PR_PR22;
+}
+
+/*
+ Idle until an interrupt or `deadline_us` from now (IDLE_FOREVER: no
+ deadline). Returns the state used. Interrupts stay masked from before
+ WFI until the clock is back, so handlers never run on the wake-up HSI.
+ A deadline shorter than one wakeup step has no timer to end the sleep:
+ it is waited out running (IDLE_RUN).
+*/
+uint32_t idle_enter(uint32_t deadline_us){
+	uint32_t state, profile, ticks = 0, t0, t1, c0, late;
+
+	if(deadline_us < IDLE_WUT_US){
+		clock_delay_us(deadline_us);
+		return IDLE_RUN;
+	}
+	state = (idle_holds == 0 && deadline_us >= IDLE_STOP_MIN_US) ? IDLE_STOP : IDLE_SLEEP;
+	if(deadline_us != IDLE_FOREVER){
+		ticks = deadline_us / IDLE_WUT_US;
+		if(ticks > 0x10000U) ticks = 0x10000U;
+		if(ticks != 0) idle_arm(ticks);
+	}
+
+	t0 = idle_now_us();
+	idle_stats.entries[IDLE_RUN]++;
+	idle_stats.time_us[IDLE_RUN] += t0 - idle_last;
+
+	profile = clock_profile();
+	__disable_irq();
+	if(state == IDLE_STOP) SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+	__DSB();
+	__WFI();
+	SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+	if(state == IDLE_STOP && profile != CLOCK_16MHZ){
+		c0 = DWT->CYCCNT;
+		clock_set_profile(profile);                   // Stop wakes up on HSI, PLL off
+		idle_stats.restore_cycles = DWT->CYCCNT - c0;
+		if(idle_stats.restore_cycles > idle_stats.restore_max_cycles)
+			idle_stats.restore_max_cycles = idle_stats.restore_cycles;
+	}
+	t1 = idle_now_us();
+
+	if(RTC->ISR & RTC_ISR_WUTF){
+		idle_stats.wake_timer++;
+		late = t1 - t0 - ticks * IDLE_WUT_US;
+		idle_stats.latency_us = (late & 0x80000000U) ? 0U : late;   // early by RTC rounding -> 0
+		if(idle_stats.latency_us > idle_stats.latency_max_us) idle_stats.latency_max_us = idle_stats.latency_us;
+	} else if(EXTI->PR & ~EXTI_PR_PR22){
+		idle_stats.wake_exti++;
+	} else {
+		idle_stats.wake_other++;
+	}
+	if(ticks != 0) RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+
+	idle_stats.entries[state]++;
+	idle_stats.time_us[state] += t1 - t0;
+	idle_last = t1;
+	__enable_irq();                                   // the wake-up interrupt runs here
+	return state;
+}
+
+static void idle_puts(const char *s){
+	while(*s) ITM_SendChar((uint32_t)*s++);
+}
+
+static void idle_putu(uint32_t v){
+	char buf[10];
+	int n = 0;
+	do {
+		buf[n++] = (char)('0' + (v % 10));
+		v /= 10;
+	} while(v != 0);
+	while(n > 0) ITM_SendChar((uint32_t)buf[--n]);
+}
+
+void idle_dump(void){
+	static const char *const names[IDLE_STATES] = { "run", "sleep", "stop" };
+	uint32_t i;
+	for(i=0; i<IDLE_STATES; i++){
+		idle_puts(names[i]);
+		idle_puts(" n=");   idle_putu(idle_stats.entries[i]);
+		idle_puts(" us=");  idle_putu(idle_stats.time_us[i]);
+		idle_puts("\r\n");
+	}
+	idle_puts("wake timer=");  idle_putu(idle_stats.wake_timer);
+	idle_puts(" exti=");       idle_putu(idle_stats.wake_exti);
+	idle_puts(" other=");      idle_putu(idle_stats.wake_other);
+	idle_puts(" latency_us="); idle_putu(idle_stats.latency_us);
+	idle_puts("/");            idle_putu(idle_stats.latency_max_us);
+	idle_puts(" restore_cyc="); idle_putu(idle_stats.restore_cycles);
+	idle_puts("/");            idle_putu(idle_stats.restore_max_cycles);
+	idle_puts("\r\n");
+}
@@ -0,0 +1,71 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+/* Low-power idle for NUCLEO-F446RE
+
+ idle_enter(us) replaces the `while(1);` spin. It picks the deepest state
+ that fits the time until the caller's next deadline:
+
+ IDLE_SLEEP  WFI, peripherals keep running, any interrupt wakes.
+             Used while a peripheral that needs its clock is held
+             (idle_hold(), e.g. TIM2 toggling the LED) or when the
+             deadline is closer than IDLE_STOP_MIN_US.
+ IDLE_STOP   SLEEPDEEP + low-power regulator. All clocks stop except
+             LSI/RTC; EXTI lines wake the core, EXTI13 (B1 on PC13)
+             and the RTC wakeup timer (EXTI22) among them. Wake-up
+             runs from HSI, the clock profile in use before is restored
+             (clock_set_profile()) before interrupts are taken.
+
+ A finite deadline arms the RTC wakeup timer (LSI / 16, 500 us steps,
+ at most 32 s; longer deadlines wake early and the caller idles again).
+ One shorter than a step cannot be timed: idle_enter() busy-waits it
+ with clock_delay_us() and returns IDLE_RUN.
+
+ The RTC also keeps the time base for the statistics, since SysTick and
+ DWT stop in Stop: idle_now_us() has 31.25 us resolution and the
+ accuracy of LSI (nominal 32 kHz, not trimmed here).
+
+ idle_stats: entries and time per state (run time is measured between
+ two idle_enter() calls), wake sources, wake latency of timed wake-ups
+ (resume, clocks restored, minus the programmed deadline) and the DWT
+ cycles spent restoring the clock after Stop. idle_dump() prints them
+ over ITM, IDLE_DUMP() only in PROFILE builds.
+*/
+
+enum {
+	IDLE_RUN = 0,
+	IDLE_SLEEP,
+	IDLE_STOP,
+	IDLE_STATES
+};
+
+#define IDLE_FOREVER      0xFFFFFFFFUL
+#define IDLE_STOP_MIN_US  1000UL       // Stop entry/exit and PLL relock cost more below this
+#define IDLE_WUT_US       500UL        // RTC wakeup timer step
+
+typedef struct {
+	uint32_t entries[IDLE_STATES];
+	uint32_t time_us[IDLE_STATES];
+	uint32_t wake_timer, wake_exti, wake_other;
+	uint32_t latency_us, latency_max_us;
+	uint32_t restore_cycles, restore_max_cycles;
+} idle_stats_t;
+
+extern idle_stats_t idle_stats;
+
+void     idle_init(void);
+void     idle_hold(void);
+void     idle_release(void);
+uint32_t idle_enter(uint32_t deadline_us);
+uint32_t idle_now_us(void);
+void     idle_dump(void);
+
+#ifdef PROFILE
+#define IDLE_DUMP()  idle_dump()
+#else
+#define IDLE_DUMP()  ((void)0)
+#endif
+
+#endif /* IDLE_H */
@@ -0,0 +1,217 @@
+#include <string.h>
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "place.h"
+#include "log.h"
+#if defined(__ARMCC_VERSION)
+#include "RTE_Components.h"
+#endif
+
+/* Buffered log transport, see log.h */
+
+#define LOG_TX_PIN     2                 // PA2 = USART2_TX (AF7)
+#define LOG_DMA_FLAGS  (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6)
+
+log_stats_t log_stats;
+
+static uint8_t           log_buf[2][LOG_BUF_BYTES];
+static volatile uint32_t log_fill;       // half log_write() copies into
+static volatile uint32_t log_len;        // bytes waiting in it
+static volatile uint32_t log_busy;       // the other half is on the wire (UART)
+static volatile uint32_t log_on;         // log_init() done, bytes before it wait in the buffer
+static const uint8_t    *log_itm_p;      // rest of the half on its way to the ITM
+static uint32_t          log_itm_left;
+static uint32_t          log_transport;
+static uint32_t          log_baud;
+
+static uint32_t log_lock(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	return primask;
+}
+
+static void log_unlock(uint32_t primask){
+	if(primask == 0) __enable_irq();
+}
+
+// Oversampling by 16: BRR = PCLK1 / baud, re-derived on every clock change
+static void log_uart_baud(void){
+	USART2->BRR = (clock_pclk1_hz() + log_baud / 2U) / log_baud;
+}
+
+static void log_uart_init(void){
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_DMA1EN;
+	RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
+
+	GPIOA->MODER  &= ~(3UL << (2*LOG_TX_PIN));
+	GPIOA->MODER  |=   2UL << (2*LOG_TX_PIN);         // Alternate function
+	GPIOA->AFR[0] &= ~(0xFUL << (4*LOG_TX_PIN));
+	GPIOA->AFR[0] |=   7UL << (4*LOG_TX_PIN);         // AF7 = USART2_TX
+
+	log_uart_baud();
+	USART2->CR3 = USART_CR3_DMAT;
+	USART2->CR1 = USART_CR1_UE | USART_CR1_TE;
+
+	DMA1_Stream6->CR = 0;
+	while (DMA1_Stream6->CR & DMA_SxCR_EN);
+	DMA1->HIFCR = LOG_DMA_FLAGS;
+	DMA1_Stream6->PAR = (uintptr_t)&USART2->DR;
+	// Channel 4 (USART2_TX), memory -> peripheral, byte transfers, memory increment
+	DMA1_Stream6->CR = (4UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE;
+	NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+	NVIC_EnableIRQ(USART2_IRQn);
+	clock_listen(log_uart_baud);
+}
+
+// Hand the fill half to the DMA, called with interrupts masked
+static void log_uart_start(void){
+	uint32_t n = log_len;
+	const uint8_t *buf = log_buf[log_fill];
+	if(log_busy || n == 0 || !log_on) return;
+
+	log_fill ^= 1U;
+	log_len = 0;
+	log_busy = 1;
+	log_stats.sent += n;
+	log_stats.transfers++;
+	idle_hold();                                      // DMA and USART need their clocks, no Stop
+
+	__DSB();                                          // buffer in memory before the DMA reads it
+	USART2->SR &= ~USART_SR_TC;                       // sets again after the last stop bit of this half
+	DMA1->HIFCR = LOG_DMA_FLAGS;                      // EN does not set while a flag is pending
+	DMA1_Stream6->M0AR = (uintptr_t)buf;
+	DMA1_Stream6->NDTR = n;
+	DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+// The DMA is done, the last bytes are still in TDR and the shift register: wait for TC
+RAMFUNC void DMA1_Stream6_IRQHandler(void){
+	DMA1->HIFCR = LOG_DMA_FLAGS;
+	USART2->CR1 |= USART_CR1_TCIE;
+}
+
+// Last stop bit out: Stop may take the APB1 clock now
+RAMFUNC void USART2_IRQHandler(void){
+	if((USART2->SR & USART_SR_TC) == 0) return;
+	USART2->CR1 &= ~USART_CR1_TCIE;
+	log_busy = 0;
+	idle_release();
+	log_uart_start();                                 // what was written meanwhile
+}
+
+// Port 0 in words, bytes for the tail, as long as the stimulus FIFO takes them: the bytes taken.
+// Without a debugger (ITMENA/TER clear) everything is taken and dropped.
+static uint32_t log_itm_send(const uint8_t *p, uint32_t n){
+	uint32_t i = 0;
+#if defined(HOST_BUILD) || defined(QEMU_BUILD)
+	while(i < n && ITM->PORT[0].u32 != 0) ITM_SendChar(p[i++]);
+#else
+	if((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0 || (ITM->TER & 1UL) == 0) return n;
+	while(n - i >= 4U && ITM->PORT[0].u32 != 0){
+		ITM->PORT[0].u32 = (uint32_t)p[i] | ((uint32_t)p[i+1] << 8) | ((uint32_t)p[i+2] << 16) | ((uint32_t)p[i+3] << 24);
+		i += 4U;
+	}
+	while(n - i < 4U && i < n && ITM->PORT[0].u32 != 0) ITM->PORT[0].u8 = p[i++];
+#endif
+	return i;
+}
+
+void log_init(uint32_t transport, uint32_t baud){
+	uint32_t primask;
+	log_transport = transport;
+	log_baud = baud ? baud : LOG_BAUD;
+	if(transport == LOG_TO_UART) log_uart_init();
+
+	primask = log_lock();
+	log_on = 1;
+	if(transport == LOG_TO_UART) log_uart_start();    // printf() output from before init
+	log_unlock(primask);
+}
+
+void log_write(const char *s, uint32_t n){
+	uint32_t primask = log_lock();
+	uint32_t room = LOG_BUF_BYTES - log_len;
+	if(n > room){
+		log_stats.dropped += n - room;
+		n = room;
+	}
+	memcpy(&log_buf[log_fill][log_len], s, n);
+	log_len += n;
+	log_stats.written += n;
+	if(log_transport == LOG_TO_UART) log_uart_start();
+	log_unlock(primask);
+}
+
+// All n bytes or none (framed binary data): 1 when written
+uint32_t log_write_all(const char *s, uint32_t n){
+	uint32_t primask = log_lock();
+	if(n > LOG_BUF_BYTES - log_len){
+		log_unlock(primask);
+		return 0;
+	}
+	memcpy(&log_buf[log_fill][log_len], s, n);
+	log_len += n;
+	log_stats.written += n;
+	if(log_transport == LOG_TO_UART) log_uart_start();
+	log_unlock(primask);
+	return 1;
+}
+
+void log_puts(const char *s){
+	log_write(s, (uint32_t)strlen(s));
+}
+
+/*
+ ITM: ship what the stimulus FIFO takes, from thread mode only, and
+ return when it is full; the rest goes at the next call. A half is
+ swapped out only once the previous one is all sent, writers keep
+ filling the other half meanwhile. UART: nothing to do, the DMA
+ interrupt moves on by itself.
+*/
+void log_pump(void){
+	uint32_t primask, n;
+	if(log_transport != LOG_TO_ITM || !log_on) return;
+	for(;;){
+		if(log_itm_left != 0){
+			n = log_itm_send(log_itm_p, log_itm_left);
+			log_itm_p += n;
+			log_itm_left -= n;
+			if(log_itm_left != 0) return;                 // FIFO full
+		}
+		primask = log_lock();
+		n = log_len;
+		if(n != 0){
+			log_itm_p = log_buf[log_fill];
+			log_itm_left = n;
+			log_fill ^= 1U;
+			log_len = 0;
+			log_stats.sent += n;
+			log_stats.transfers++;
+		}
+		log_unlock(primask);
+		if(n == 0) return;
+	}
+}
+
+// Bytes not on the wire yet, the one in the USART shift register counts until TC
+uint32_t log_pending(void){
+	uint32_t n = log_len;
+	if(log_transport == LOG_TO_UART && log_busy) n += DMA1_Stream6->NDTR + 1U;
+	if(log_transport == LOG_TO_ITM) n += log_itm_left;
+	return n;
+}
+
+// Wait until everything is out (before a reset, benchmarks)
+void log_flush(void){
+	while(log_on && log_pending() != 0) log_pump();
+}
+
+#if defined(RTE_Compiler_IO_STDOUT_User) && (defined(LOG_UART) || defined(LOG_ITM))
+// Keil retarget with the RTE Compiler I/O STDOUT component set to "User"
+int stdout_putchar(int ch){
+	char c = (char)ch;
+	log_write(&c, 1);
+	return ch;
+}
+#endif
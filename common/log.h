@@ -0,0 +1,83 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+/* Buffered log transport for NUCLEO-F446RE
+
+ printf() through RTE_Compiler_IO_STDOUT_ITM pushes every character to
+ ITM port 0 and spins until the stimulus FIFO has room, so at SWO speed
+ the CPU waits for the wire. log_write() only copies into the fill half
+ of a double buffer and returns; the other half is on its way out:
+
+ LOG_TO_UART  USART2 TX (PA2, AF7, the ST-LINK virtual COM port) by
+              DMA1 Stream6 channel 4. The USART2 transmission-complete
+              interrupt, armed by the DMA one, hands the fill half to
+              the DMA and the CPU never touches the wire. idle_hold()
+              keeps idle_enter() out of Stop until the last stop bit is
+              out; BRR follows clock changes.
+ LOG_TO_ITM   ITM port 0 in 32-bit writes, a quarter of the FIFO checks
+              of ITM_SendChar(). Drained by log_pump() from the idle
+              loop instead of the code that logs; it sends while the
+              stimulus FIFO has room and returns when it is full, the
+              rest goes at the next call. Only log_flush() waits;
+              LOG_IDLE_US() keeps the idle loop coming back while
+              bytes are left.
+
+ A full fill half drops the new bytes (log_stats.dropped): logging never
+ blocks the caller, interrupt handlers included. log_write_all() takes
+ all of its bytes or none, for framed binary data (common/capture.h).
+
+ LOG_UART or LOG_ITM select the transport for LOG_INIT() / LOG_PUMP().
+ stdout follows: the GCC _write() (common/gcc/syscalls.c) and, with the
+ Keil RTE Compiler I/O STDOUT set to "User", stdout_putchar() end in
+ log_write(), so printf() callers stay as they are.
+
+ host/log_bench.c compares bytes/s and CPU load of both transports
+ with per-character ITM printf on the host model.
+*/
+
+enum {
+	LOG_TO_UART = 0,
+	LOG_TO_ITM
+};
+
+#define LOG_BUF_BYTES  256U          // per half
+#define LOG_ITM_POLL_US 500UL        // idle deadline while ITM bytes wait for FIFO room: one RTC wakeup step
+
+#ifndef LOG_BAUD
+#define LOG_BAUD       115200UL
+#endif
+
+typedef struct {
+	uint32_t written;        // bytes accepted by log_write()
+	uint32_t sent;           // bytes handed to the wire
+	uint32_t dropped;        // bytes lost to a full buffer
+	uint32_t transfers;      // DMA transfers / ITM bursts
+} log_stats_t;
+
+extern log_stats_t log_stats;
+
+void     log_init(uint32_t transport, uint32_t baud);
+void     log_write(const char *s, uint32_t n);
+uint32_t log_write_all(const char *s, uint32_t n);
+void     log_puts(const char *s);
+void     log_pump(void);
+uint32_t log_pending(void);
+void     log_flush(void);
+
+#if defined(LOG_UART)
+#define LOG_INIT()  log_init(LOG_TO_UART, LOG_BAUD)
+#define LOG_PUMP()  ((void)0)
+#define LOG_IDLE_US(us)  (us)
+#elif defined(LOG_ITM)
+#define LOG_INIT()  log_init(LOG_TO_ITM, 0)
+#define LOG_PUMP()  log_pump()
+#define LOG_IDLE_US(us)  (log_pending() != 0 ? LOG_ITM_POLL_US : (us))
+#else
+#define LOG_INIT()  ((void)0)
+#define LOG_PUMP()  ((void)0)
+#define LOG_IDLE_US(us)  (us)
+#endif
+
+#endif /* LOG_H */
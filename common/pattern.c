@@ -0,0 +1,248 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "place.h"
+#include "pattern.h"
+
+/* Blink patterns on TIM2 with a DMA burst, see pattern.h */
+
+#define PAT_PWM1       (TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_2)   // OC1M 0110: high while CNT < CCR1
+#define PAT_DBA        11U                                       // ARR, in words from CR1
+#define PAT_BURST      3U                                        // ARR, RCR, CCR1
+#define PAT_DMA_FLAGS  (DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7)
+#define PAT_LEAD       1U                                        // ARR of the two lead-in periods
+
+static const pattern_step_t *pat_steps;
+static uint32_t              pat_n, pat_loop;
+static volatile uint32_t     pat_on;
+static uint32_t              pat_listening;
+
+/*
+ Lead-in: UG loads a short low period into the shadows, a second one
+ goes to the preload registers. The update ending the first latches the
+ second and makes the first burst, which plays from the update after it:
+ from there on every step is written one update before it plays.
+*/
+static void pat_start(void){
+	uint32_t hz = clock_tim_hz(TIM2);
+
+	TIM2->CR1  = 0;
+	TIM2->DIER = 0;
+	DMA1_Stream7->CR = 0;
+	while (DMA1_Stream7->CR & DMA_SxCR_EN);
+	DMA1->HIFCR = PAT_DMA_FLAGS;
+
+	TIM2->PSC   = hz > PATTERN_TICK_HZ ? hz / PATTERN_TICK_HZ - 1U : 0U;
+	TIM2->ARR   = PAT_LEAD;
+	TIM2->CCR1  = 0;
+	TIM2->CCMR1 = PAT_PWM1 | TIM_CCMR1_OC1PE;
+	TIM2->CCER  = TIM_CCER_CC1E;                 // active high
+	TIM2->CR1   = TIM_CR1_ARPE | TIM_CR1_URS;    // load the shadows, no update request
+	TIM2->EGR   = TIM_EGR_UG;
+	TIM2->CR1   = TIM_CR1_ARPE;
+	TIM2->ARR   = PAT_LEAD;                      // preloaded: the second lead-in period
+	TIM2->CCR1  = 0;
+	TIM2->DCR   = ((PAT_BURST - 1U) << TIM_DCR_DBL_Pos) | (PAT_DBA << TIM_DCR_DBA_Pos);
+	TIM2->SR    = ~(uint32_t)TIM_SR_UIF;
+
+	DMA1_Stream7->PAR  = (uintptr_t)&TIM2->DMAR;
+	DMA1_Stream7->M0AR = (uintptr_t)pat_steps;
+	DMA1_Stream7->NDTR = PAT_BURST * (pat_n + (pat_loop ? 0U : 1U));
+	// Channel 3 (TIM2_UP), memory -> peripheral, words, memory increment; circular, or an interrupt at the end
+	DMA1_Stream7->CR = (3UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_0 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+	                   DMA_SxCR_MINC | DMA_SxCR_DIR_0 | (pat_loop ? DMA_SxCR_CIRC : DMA_SxCR_TCIE);
+	DMA1_Stream7->CR |= DMA_SxCR_EN;
+	TIM2->DIER  = TIM_DIER_UDE;
+	TIM2->CR1  |= TIM_CR1_CEN;
+}
+
+// PSC follows the APB1 timer clock; a pattern in flight starts over
+static void pat_clock(void){
+	if(pat_on) pat_start();
+}
+
+void pattern_init(void){
+	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+	NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+	NVIC_EnableIRQ(TIM2_IRQn);
+	if(!pat_listening){
+		pat_listening = 1;
+		clock_listen(pat_clock);
+	}
+}
+
+// Plays n steps, over and over with loop, else once (steps[n] is PATTERN_END)
+void pattern_play(const pattern_step_t *steps, uint32_t n, uint32_t loop){
+	if(n == 0) return;
+	pattern_stop();
+	pat_steps = steps;
+	pat_n     = n;
+	pat_loop  = loop;
+	pat_on    = 1;
+	idle_hold();                                 // TIM2 and the DMA need their clocks, no Stop
+	pat_start();
+}
+
+// Counter and stream off, the line low
+static RAMFUNC void pat_halt(void){
+	TIM2->DIER = 0;
+	DMA1_Stream7->CR = 0;
+	TIM2->CR1  = 0;
+	pat_on = 0;
+	idle_release();
+}
+
+void pattern_stop(void){
+	uint32_t cr1;
+	if(!pat_on) return;
+	TIM2->CCR1 = 0;
+	cr1 = TIM2->CR1;
+	TIM2->CR1  = cr1 | TIM_CR1_URS;              // CCR1 0 now: PWM 1 goes low
+	TIM2->EGR  = TIM_EGR_UG;
+	TIM2->CR1  = cr1;
+	pat_halt();
+}
+
+uint32_t pattern_busy(void){
+	return pat_on;
+}
+
+// PATTERN_END written, the last step is playing: stop at its end
+RAMFUNC void DMA1_Stream7_IRQHandler(void){
+	DMA1->HIFCR = PAT_DMA_FLAGS;
+	TIM2->SR    = ~(uint32_t)TIM_SR_UIF;
+	TIM2->DIER |= TIM_DIER_UIE;
+}
+
+// After the last step: PATTERN_END (CCR1 0) is in the shadows, the line is low
+RAMFUNC void TIM2_IRQHandler(void){
+	TIM2->SR = ~(uint32_t)TIM_SR_UIF;
+	if(pat_on) pat_halt();
+}
+
+/////////////////////////////// Compiler ///////////////////////////////
+
+// Morse code per character: a leading 1, then one bit per element, dash 1, first element highest
+static const uint8_t pat_morse_az[26] = {
+	0x05, 0x18, 0x1A, 0x0C, 0x02, 0x12, 0x0E, 0x10, 0x04, 0x17, 0x0D, 0x14, 0x07,
+	0x06, 0x0F, 0x16, 0x1D, 0x0A, 0x08, 0x03, 0x09, 0x11, 0x0B, 0x19, 0x1B, 0x1C,
+};
+static const uint8_t pat_morse_09[10] = {
+	0x3F, 0x2F, 0x27, 0x23, 0x21, 0x20, 0x30, 0x38, 0x3C, 0x3E,
+};
+
+typedef struct {
+	pattern_step_t *out;
+	uint32_t        max, n;
+	uint32_t        hi, lo;      // ticks of the step being built
+	uint32_t        unit;        // Morse unit, ticks
+	uint32_t        err;
+} pat_comp_t;
+
+static void pat_flush(pat_comp_t *c){
+	if(c->hi + c->lo == 0U) return;
+	if(c->n + 1U >= c->max){                     // room for PATTERN_END too
+		c->err = 1;
+		return;
+	}
+	c->out[c->n].arr  = c->hi + c->lo - 1U;
+	c->out[c->n].rcr  = 0;
+	c->out[c->n].ccr1 = c->hi;
+	c->n++;
+	c->hi = c->lo = 0;
+}
+
+static void pat_high(pat_comp_t *c, uint32_t ticks){
+	if(c->lo) pat_flush(c);
+	c->hi += ticks;
+}
+
+static void pat_low(pat_comp_t *c, uint32_t ticks){
+	c->lo += ticks;
+}
+
+static void pat_morse(pat_comp_t *c, char ch){
+	uint32_t code, bit;
+	if(ch >= 'a' && ch <= 'z') ch = (char)(ch - 'a' + 'A');
+	if(ch == ' '){
+		pat_low(c, 4U * c->unit);                // 3 after the letter, 7 in all
+		return;
+	}
+	if(ch >= 'A' && ch <= 'Z')      code = pat_morse_az[ch - 'A'];
+	else if(ch >= '0' && ch <= '9') code = pat_morse_09[ch - '0'];
+	else { c->err = 1; return; }
+	for(bit = 7U; (code >> bit) == 0U; bit--);   // the leading 1
+	while(bit--){
+		pat_high(c, (code >> bit) & 1U ? 3U * c->unit : c->unit);
+		pat_low(c, c->unit);
+	}
+	pat_low(c, 2U * c->unit);
+}
+
+static const char *pat_number(const char *p, uint32_t *v, pat_comp_t *c){
+	uint32_t n = 0;
+	if(*p < '0' || *p > '9') c->err = 1;
+	while(*p >= '0' && *p <= '9'){
+		if(n > 0xFFFFFFFFUL / 10U / PATTERN_TICKS(1)) c->err = 1;
+		n = n * 10U + (uint32_t)(*p++ - '0');
+	}
+	*v = n;
+	return p;
+}
+
+// Items up to the end or the ')' closing this depth; returns where it stopped
+static const char *pat_seq(pat_comp_t *c, const char *p, uint32_t depth){
+	const char *body, *end;
+	uint32_t v, k;
+	while(*p && !c->err){
+		switch(*p){
+			case ' ': case '\t': case '\n': case ',':
+				p++;
+				break;
+			case '+':
+				p = pat_number(p + 1, &v, c);
+				pat_high(c, PATTERN_TICKS(v));
+				break;
+			case '-':
+				p = pat_number(p + 1, &v, c);
+				pat_low(c, PATTERN_TICKS(v));
+				break;
+			case '@':
+				p = pat_number(p + 1, &v, c);
+				c->unit = PATTERN_TICKS(v);
+				break;
+			case '\'':
+				for(p++; *p && *p != '\''; p++) pat_morse(c, *p);
+				if(*p != '\'') c->err = 1;
+				else           p++;
+				break;
+			case '(':
+				if(depth >= PATTERN_DEPTH){ c->err = 1; break; }
+				body = p + 1;
+				end  = pat_seq(c, body, depth + 1U);     // first pass
+				if(c->err || *end != ')'){ c->err = 1; break; }
+				p = pat_number(end + 1, &v, c);
+				for(k=1; k<v && !c->err; k++) pat_seq(c, body, depth + 1U);
+				if(v == 0U) c->err = 1;
+				break;
+			case ')':
+				if(depth == 0U) c->err = 1;
+				return p;
+			default:
+				c->err = 1;
+				break;
+		}
+	}
+	return p;
+}
+
+uint32_t pattern_compile(const char *desc, pattern_step_t *steps, uint32_t max){
+	pat_comp_t c = { steps, max, 0, 0, 0, PATTERN_TICKS(PATTERN_UNIT_MS), 0 };
+	const char *end = pat_seq(&c, desc, 0);
+	if(*end) c.err = 1;
+	pat_flush(&c);
+	if(c.err || c.n == 0U || c.n >= max) return 0;
+	steps[c.n].arr = steps[c.n].rcr = steps[c.n].ccr1 = 0;
+	return c.n;
+}
@@ -0,0 +1,66 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdint.h>
+
+/* Blink patterns played by TIM2 channel 1 and a DMA burst, NUCLEO-F446RE
+
+ A pattern is a table of steps, each one PWM period of TIM2: high for
+ ccr1 ticks, then low until arr + 1 ticks (PWM mode 1, PATTERN_TICK_HZ
+ ticks). At every update event DMA1 Stream7 channel 3 (TIM2_UP) writes
+ the next step through DMAR as a burst of three words (DCR: DBA = ARR,
+ DBL = 3 transfers: ARR, RCR, CCR1; RCR is reserved on TIM2 and ignores
+ the write). ARR and CCR1 are preloaded, so a step written at an update
+ event plays from the next one. Looped tables run from a circular stream
+ with no interrupt at all; the core can sleep. A one-shot table ends
+ with PATTERN_END: its transfer complete interrupt arms the update
+ interrupt, which stops the counter after the last step, line low.
+
+ Steps are in ticks of 100 us, ARR is 32 bits (up to 119 hours per
+ step). A pattern starts after a 400 us low lead-in that fills the
+ preload pipeline. A clock change (clock_listen()) re-derives PSC and
+ restarts the pattern. The output pin (PA5, AF1) is set up by the
+ caller.
+
+ pattern_compile() turns a timing description into steps:
+
+   +N      high for N ms
+   -N      low for N ms
+   (...)K  the group K times, nested up to PATTERN_DEPTH deep
+   @N      Morse unit of N ms for what follows (default 100)
+   'TEXT'  TEXT in Morse code: dot 1 unit high, dash 3, 1 low between
+           elements, 3 after each letter, 7 for a space; A-Z, 0-9
+
+ Spaces between items are ignored. A high time after a low one starts a
+ new step; highs and lows in a row add up. "(+150-250)3 -1000" blinks
+ three times then pauses, "@80 'SOS' -400" is SOS. The table gets a
+ PATTERN_END after the steps; the count returned leaves it out, 0 is a
+ syntax error or a table too short.
+
+ host/pattern_bench.c checks the compiler against the level runs of
+ random descriptions and plays patterns on the host model, comparing
+ the TIM2 channel 1 edges in the dump with the table.
+*/
+
+#define PATTERN_TICK_HZ  10000UL
+#define PATTERN_DEPTH    4U
+#define PATTERN_UNIT_MS  100U
+
+// One step in burst order: ARR, RCR, CCR1
+typedef struct {
+	uint32_t arr;            // period, ticks - 1
+	uint32_t rcr;            // burst filler, 0
+	uint32_t ccr1;           // high ticks
+} pattern_step_t;
+
+#define PATTERN_TICKS(ms)         ((uint32_t)(ms) * (PATTERN_TICK_HZ / 1000U))
+#define PATTERN_STEP(on_ms, off_ms) { PATTERN_TICKS((on_ms) + (off_ms)) - 1U, 0U, PATTERN_TICKS(on_ms) }
+#define PATTERN_END                 { 0U, 0U, 0U }
+
+void     pattern_init(void);
+void     pattern_play(const pattern_step_t *steps, uint32_t n, uint32_t loop);
+void     pattern_stop(void);
+uint32_t pattern_busy(void);
+uint32_t pattern_compile(const char *desc, pattern_step_t *steps, uint32_t max);
+
+#endif /* PATTERN_H */
@@ -0,0 +1,164 @@
+#include "stm32f446xx.h"
+#include "place.h"
+#include "dds.h"
+#include "pcm.h"
+
+/* Sampled audio clips, see pcm.h */
+
+#define PCM_INDEX_MAX  88
+
+pcm_stats_t pcm_stats;
+
+static const uint16_t pcm_steps[PCM_INDEX_MAX + 1] = {
+	    7,     8,     9,    10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,    31,
+	   34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,   107,   118,   130,   143,
+	  157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,   544,   598,   658,
+	  724,   796,   876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,
+	 3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t pcm_adjust[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static union {
+	int16_t  s[PCM_CHUNK_MAX + 1U];
+	uint32_t w[(PCM_CHUNK_MAX + 1U) / 2U];   // halfword pairs, pcm_u8()
+} pcm_buf;
+
+static const pcm_clip_t *volatile pcm_clip;
+static uint32_t          pcm_off;              // next byte of the clip
+static uint32_t          pcm_len, pcm_pos;     // samples in pcm_buf, next one
+static uint32_t          pcm_step, pcm_frac;   // clip samples per output sample, Q16
+static int32_t           pcm_a, pcm_b;         // the two clip samples the output lies between
+static uint32_t          pcm_loop;
+static volatile uint32_t pcm_on;
+
+/*
+ One code: the difference is step * (code & 7) / 4 + step / 8 built from
+ shifts as the IMA reference does (bit-exact), its sign applied without a
+ branch, the predictor saturated by SSAT and the index by USAT (below 0)
+ and one compare (above 88, at most 96).
+*/
+#define PCM_IMA(c) do { \
+	int32_t step_ = pcm_steps[index], diff_ = step_ >> 3, sign_ = -(int32_t)((c) >> 3); \
+	diff_ += step_        & -(int32_t)(((c) >> 2) & 1U); \
+	diff_ += (step_ >> 1) & -(int32_t)(((c) >> 1) & 1U); \
+	diff_ += (step_ >> 2) & -(int32_t)((c) & 1U); \
+	pred   = __SSAT(pred + ((diff_ ^ sign_) - sign_), 16); \
+	index  = (int32_t)__USAT(index + pcm_adjust[c], 7); \
+	if(index > PCM_INDEX_MAX) index = PCM_INDEX_MAX; \
+} while(0)
+
+// One IMA ADPCM block of bytes (header included) to out, returns the samples
+RAMFUNC uint32_t pcm_ima_block(const uint8_t *in, uint32_t bytes, int16_t *out){
+	int32_t  pred  = (int16_t)(in[0] | (in[1] << 8));
+	int32_t  index = in[2] > PCM_INDEX_MAX ? PCM_INDEX_MAX : in[2];
+	uint32_t i, c, n = 1;
+	out[0] = (int16_t)pred;
+	for(i=4; i<bytes; i++){
+		c = in[i] & 0x0FU;
+		PCM_IMA(c);
+		out[n++] = (int16_t)pred;
+		c = in[i] >> 4;
+		PCM_IMA(c);
+		out[n++] = (int16_t)pred;
+	}
+	return n;
+}
+
+/*
+ n unsigned 8-bit samples to Q15 halfword pairs, four per word: the
+ offset is flipped in all four bytes at once, the bytes moved to the top
+ of their halfwords and packed two by two (PKHBT/PKHTB). A partial last
+ word is padded with silence. Returns n.
+*/
+RAMFUNC uint32_t pcm_u8(const uint8_t *in, uint32_t n, uint32_t *out){
+	uint32_t i, w, lo, hi;
+	for(i=0; i<n; i+=4U){
+		if(i + 4U <= n) w = in[i] | ((uint32_t)in[i + 1U] << 8) | ((uint32_t)in[i + 2U] << 16) | ((uint32_t)in[i + 3U] << 24);
+		else            w = in[i] | (i + 1U < n ? (uint32_t)in[i + 1U] << 8 : 0x8000UL) |
+		                    (i + 2U < n ? (uint32_t)in[i + 2U] << 16 : 0x800000UL) | 0x80000000UL;
+		w ^= 0x80808080UL;                       // offset binary to two's complement
+		lo = (w << 8) & 0xFF00FF00UL;            // samples 0 and 2
+		hi = w & 0xFF00FF00UL;                   // samples 1 and 3
+		*out++ = __PKHBT(lo, hi, 16);
+		*out++ = __PKHTB(hi, lo, 16);
+	}
+	return n;
+}
+
+// Next chunk of the clip into pcm_buf, 0 at its end (a partial IMA header is dropped)
+static uint32_t pcm_chunk(const pcm_clip_t *clip){
+	uint32_t rest = clip->bytes - pcm_off, k;
+	if(rest < (clip->format == PCM_IMA ? 4U : 1U)){
+		if(!pcm_loop) return 0;
+		pcm_off = 0;
+		rest    = clip->bytes;
+		pcm_stats.plays++;
+	}
+	if(clip->format == PCM_IMA){
+		k = rest < clip->block_bytes ? rest : clip->block_bytes;
+		pcm_len = pcm_ima_block(clip->data + pcm_off, k, pcm_buf.s);
+	} else {
+		k = rest < PCM_U8_CHUNK ? rest : PCM_U8_CHUNK;
+		pcm_len = pcm_u8(clip->data + pcm_off, k, pcm_buf.w);
+	}
+	pcm_off += k;
+	pcm_pos  = 0;
+	pcm_stats.chunks++;
+	return 1;
+}
+
+// dds.h source: the clip resampled to DDS_SAMPLE_HZ, linear between its samples, silence after the end
+static RAMFUNC void pcm_source(int32_t *out, uint32_t n){
+	const pcm_clip_t *clip = pcm_clip;
+	uint32_t i, frac = pcm_frac, step = pcm_step;
+	int32_t  a = pcm_a, b = pcm_b;
+	for(i=0; i<n; i++){
+		frac += step;
+		while(frac >= 0x10000UL){
+			frac -= 0x10000UL;
+			a = b;
+			if(pcm_pos == pcm_len && !pcm_chunk(clip)){
+				pcm_on = 0;
+				b = 0;
+			} else {
+				b = pcm_buf.s[pcm_pos++];
+			}
+		}
+		out[i] = a + (((b - a) * (int32_t)(frac >> 1)) >> 15);
+	}
+	pcm_frac = frac;
+	pcm_a    = a;
+	pcm_b    = b;
+}
+
+// Plays clip from the start through dds.h (dds_init() first), over again if loop
+void pcm_play(const pcm_clip_t *clip, uint32_t loop){
+	if(clip->bytes < (clip->format == PCM_IMA ? 4U : 1U) ||
+	   (clip->format == PCM_IMA && (clip->block_bytes < 4U || clip->block_bytes > PCM_BLOCK_MAX))) return;
+	NVIC_DisableIRQ(DMA1_Stream0_IRQn);          // the source runs in the DMA interrupt
+	pcm_clip = clip;
+	pcm_off  = 0;
+	pcm_len  = 0;
+	pcm_pos  = 0;
+	pcm_frac = 0;
+	pcm_a    = 0;
+	pcm_b    = 0;
+	pcm_loop = loop;
+	pcm_step = (uint32_t)(((uint64_t)clip->rate_hz << 16) / DDS_SAMPLE_HZ);
+	pcm_on   = 1;
+	pcm_stats.plays++;
+	dds_source(pcm_source);
+	NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+}
+
+// Back to the dds.h oscillator
+void pcm_stop(void){
+	dds_source(0);
+	pcm_on = 0;
+}
+
+uint32_t pcm_playing(void){
+	return pcm_on;
+}
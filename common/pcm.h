@@ -0,0 +1,60 @@
+#ifndef PCM_H
+#define PCM_H
+
+#include <stdint.h>
+
+/* Sampled audio clips through dds.h on TIM5 channel 1
+
+ Clips stay in flash as 8-bit unsigned PCM or IMA ADPCM (4 bits per
+ sample) at their own rate, 8 to 22.05 kHz. pcm_play() hands dds.h a
+ sample source: the DMA interrupt decodes the clip a chunk at a time
+ into a RAM buffer and resamples it linearly to DDS_SAMPLE_HZ, so the
+ PWM carrier stays at 31.25 kHz, out of the audio band, whatever the
+ clip rate. Amplitude and envelope of dds.h apply as for a tone.
+
+ IMA ADPCM uses the WAV block layout (mono, block_bytes per block):
+
+   int16 predictor (LE), uint8 step index, 0   the block's first sample
+   (block_bytes - 4) bytes of codes            low nibble first
+
+ so a block holds (block_bytes - 4) * 2 + 1 samples and decodes on its
+ own. The predictor saturates with SSAT and the step index with USAT,
+ no branches per sample; 8-bit PCM unpacks four samples per word into
+ halfword pairs with PKHBT/PKHTB. The host header supplies the same
+ intrinsics in C.
+
+ host/pcm_bench.c checks both decoders bit-exact against a plain
+ reference and prints their decode time per sample.
+*/
+
+#define PCM_BLOCK_MAX   512U                               // IMA ADPCM block_bytes limit
+#define PCM_CHUNK_MAX   ((PCM_BLOCK_MAX - 4U) * 2U + 1U)   // samples per decoded chunk
+#define PCM_U8_CHUNK    64U                                // 8-bit samples decoded at a time
+
+enum {
+	PCM_U8 = 0,
+	PCM_IMA
+};
+
+typedef struct {
+	const uint8_t *data;
+	uint32_t       bytes;
+	uint32_t       rate_hz;
+	uint16_t       block_bytes;   // PCM_IMA, 0 for PCM_U8
+	uint8_t        format;
+} pcm_clip_t;
+
+typedef struct {
+	uint32_t chunks;         // chunks decoded
+	uint32_t plays;          // pcm_play() calls and loops
+} pcm_stats_t;
+
+extern pcm_stats_t pcm_stats;
+
+void     pcm_play(const pcm_clip_t *clip, uint32_t loop);
+void     pcm_stop(void);
+uint32_t pcm_playing(void);
+uint32_t pcm_ima_block(const uint8_t *in, uint32_t bytes, int16_t *out);
+uint32_t pcm_u8(const uint8_t *in, uint32_t n, uint32_t *out);
+
+#endif /* PCM_H */
@@ -0,0 +1,40 @@
+#ifndef PLACE_H
+#define PLACE_H
+
+/* Code and data placement for NUCLEO-F446RE
+
+ Flash runs behind the ART accelerator: 64 instruction and 8 data lines
+ of 128 bits. A loop that stays inside the cached lines runs at zero
+ wait states, one that shares them with init code does not.
+
+ RAMFUNC       hot code, section .ramfunc, loaded to SRAM with .data
+               (RAM_ISR or MEM_PLACE)
+ COLDFUNC      run-once code (clock and pin setup), section .coldtext,
+               linked after all other code so the hot flash code stays
+               together (MEM_PLACE), never inlined into its caller
+ ART_ALIGNED   const table starting on a flash cache line
+
+ Both sections are known to common/gcc/stm32f446re.ld and to
+ common/keil/stm32f446re_ramfunc.sct. tools/memplace.py generates a
+ linker script or scatter file from tools/placement.json that pins
+ further functions by name (-ffunction-sections, .text.<name>) without
+ touching their source.
+*/
+
+#define ART_LINE_BYTES  16U
+
+#if (defined(RAM_ISR) || defined(MEM_PLACE)) && !defined(HOST_BUILD)
+#define RAMFUNC  __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+#if defined(MEM_PLACE) && !defined(HOST_BUILD)
+#define COLDFUNC  __attribute__((section(".coldtext"), cold, noinline))
+#else
+#define COLDFUNC
+#endif
+
+#define ART_ALIGNED  __attribute__((aligned(ART_LINE_BYTES)))
+
+#endif /* PLACE_H */
@@ -0,0 +1,189 @@
+#include "prof.h"
+
+/* Cycle-counter profiling, see prof.h
+
+ DWT->CYCCNT is a free running 32-bit counter, it wraps after
+ 2^32 / 84 MHz = 51 s, so a single region must stay shorter than that.
+ The subtraction below is done in uint32_t and survives one wrap.
+*/
+
+#ifdef PROFILE
+
+#ifdef HOST_BUILD
+#include <stdio.h>
+#include <time.h>
+#endif
+#include "stm32f446xx.h"
+
+static prof_region_t prof_arena[PROF_MAX_REGIONS];
+
+static const char *const prof_names[PROF_MAX_REGIONS] = {
+	"enable_HSI",
+	"configure_pin",
+	"step",
+	"note",
+	"isr",
+	"irq_warm",
+	"irq_cold",
+	"user0",
+	"user1",
+	"user2",
+};
+
+void prof_reset(void){
+	uint32_t i, b;
+	for(i=0; i<PROF_MAX_REGIONS; i++){
+		prof_arena[i].depth    = 0;
+		prof_arena[i].overflow = 0;
+		prof_arena[i].count = 0;
+		prof_arena[i].min   = 0xFFFFFFFFUL;
+		prof_arena[i].max   = 0;
+		prof_arena[i].total = 0;
+		for(b=0; b<PROF_HIST_BINS; b++) prof_arena[i].hist[b] = 0;
+	}
+}
+
+void prof_init(void){
+#ifndef HOST_BUILD
+	// Trace enable (TRCENA) powers the DWT and ITM blocks
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL  |= DWT_CTRL_CYCCNTENA_Msk;        // Start cycle counter
+#endif
+	prof_reset();
+}
+
+uint32_t prof_now(void){
+#ifdef HOST_BUILD
+#ifdef PROF_HOST_CLOCK
+	return (uint32_t)PROF_HOST_CLOCK();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+#endif
+#else
+	return DWT->CYCCNT;
+#endif
+}
+
+static uint32_t prof_bin(uint32_t cycles){
+	if(cycles == 0) return 0;
+#ifdef HOST_BUILD
+	return 32U - (uint32_t)__builtin_clz(cycles);
+#else
+	return 32U - __CLZ(cycles);
+#endif
+}
+
+// Interrupt handlers record too: the update runs with PRIMASK set
+void prof_record(uint32_t id, uint32_t cycles){
+	prof_region_t *r;
+	uint32_t bin, primask;
+	if(id >= PROF_MAX_REGIONS) return;
+	r = &prof_arena[id];
+	bin = prof_bin(cycles);
+	if(bin >= PROF_HIST_BINS) bin = PROF_HIST_BINS - 1;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	r->count++;
+	r->total += cycles;
+	if(cycles < r->min) r->min = cycles;
+	if(cycles > r->max) r->max = cycles;
+	r->hist[bin]++;
+	if(primask == 0) __enable_irq();
+}
+
+/*
+ The slot is claimed before the stamp is written. An interrupt between
+ the two enters and exits at depth + 1 and leaves depth as it found it;
+ one before the claim uses the same slot and is done with it before
+ this enter writes there.
+*/
+void prof_enter(uint32_t id){
+	prof_region_t *r;
+	uint32_t d;
+	if(id >= PROF_MAX_REGIONS) return;
+	r = &prof_arena[id];
+	d = r->depth++;
+	if(d >= PROF_NEST){
+		r->overflow++;
+		return;
+	}
+	r->start[d] = prof_now();
+}
+
+void prof_exit(uint32_t id){
+	prof_region_t *r;
+	uint32_t now = prof_now(), d;
+	if(id >= PROF_MAX_REGIONS) return;
+	r = &prof_arena[id];
+	if(r->depth == 0) return;                    // exit without an enter
+	d = r->depth - 1U;
+	if(d < PROF_NEST) prof_record(id, now - r->start[d]);
+	r->depth = d;
+}
+
+const prof_region_t *prof_region(uint32_t id){
+	if(id >= PROF_MAX_REGIONS) return 0;
+	return &prof_arena[id];
+}
+
+/////////////////////////////// ITM output ///////////////////////////////
+// Small formatter so the dump does not pull printf into the image
+
+static void prof_putc(char c){
+#ifdef HOST_BUILD
+	putchar(c);
+#else
+	ITM_SendChar((uint32_t)c);    // Stimulus port 0, same as printf retarget
+#endif
+}
+
+static void prof_puts(const char *s){
+	while(*s) prof_putc(*s++);
+}
+
+static void prof_putu(uint64_t v){
+	char buf[20];
+	int n = 0;
+	do {
+		buf[n++] = (char)('0' + (v % 10));
+		v /= 10;
+	} while(v != 0);
+	while(n > 0) prof_putc(buf[--n]);
+}
+
+void prof_dump(void){
+	uint32_t i, b;
+	const prof_region_t *r;
+
+	prof_puts("region count min avg max\r\n");
+	for(i=0; i<PROF_MAX_REGIONS; i++){
+		r = &prof_arena[i];
+		if(r->count == 0) continue;
+
+		prof_puts(prof_names[i]);
+		prof_putc(' ');  prof_putu(r->count);
+		prof_putc(' ');  prof_putu(r->min);
+		prof_putc(' ');  prof_putu(r->total / r->count);
+		prof_putc(' ');  prof_putu(r->max);
+		prof_puts("\r\n");
+		if(r->overflow){
+			prof_puts("  nested>");  prof_putu(PROF_NEST);
+			prof_putc(':');          prof_putu(r->overflow);
+			prof_puts("\r\n");
+		}
+
+		// Histogram: only the occupied bins, "<2^n:count"
+		for(b=0; b<PROF_HIST_BINS; b++){
+			if(r->hist[b] == 0) continue;
+			prof_puts("  <2^");  prof_putu(b);
+			prof_putc(':');      prof_putu(r->hist[b]);
+			prof_puts("\r\n");
+		}
+	}
+}
+
+#endif /* PROFILE */
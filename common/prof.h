@@ -0,0 +1,88 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+/* Cycle-counter profiling for NUCLEO-F446RE
+
+ Every region keeps count, min, max, total and a log2 histogram of the
+ cycles spent between PROF_ENTER() and PROF_EXIT(). All storage lives in
+ one static arena, nothing is allocated at run time.
+
+ Target: cycles come from DWT->CYCCNT (one tick per core clock).
+ Host  : cycles come from PROF_HOST_CLOCK() if defined, otherwise from
+         the monotonic clock in nanoseconds.
+
+ Regions nest: each keeps a stack of PROF_NEST open start stamps, so a
+ region entered again before its exit (recursion, or the same region
+ from an interrupt that preempts it) pairs every exit with its own
+ enter. Interrupts always return before the code they preempted, so
+ the stack stays in order without masking them. Entries beyond
+ PROF_NEST deep are not timed and count as overflow.
+
+ The macros expand to nothing unless PROFILE is defined, so the projects
+ keep their timing when profiling is off.
+
+ Usage:
+	PROF_ENTER(PROF_ENABLE_HSI);
+	enable_HSI();
+	PROF_EXIT(PROF_ENABLE_HSI);
+	...
+	prof_dump();   // min/avg/max + histogram over ITM port 0
+*/
+
+// Region ids, one slot each in the arena
+enum {
+	PROF_ENABLE_HSI = 0,     // clock setup (enable_HSI / sys_clk_config)
+	PROF_CONFIGURE_PIN,      // configure_*_pin / *_Pin_Init
+	PROF_STEP,               // one stepper step (coil update)
+	PROF_NOTE,               // one note change in the music loop
+	PROF_ISR,                // interrupt handler body
+	PROF_IRQ_WARM,           // pend -> first handler instruction, caches warm (ramvec_probe)
+	PROF_IRQ_COLD,           // same with the flash ART caches flushed before each pend
+	PROF_USER0,
+	PROF_USER1,
+	PROF_USER2,
+	PROF_MAX_REGIONS
+};
+
+#define PROF_HIST_BINS 32    // bin n counts samples with 2^(n-1) <= cycles < 2^n
+#define PROF_NEST      4     // open PROF_ENTERs per region
+
+typedef struct {
+	uint32_t start[PROF_NEST];   // stamps of the open PROF_ENTERs, innermost last
+	uint32_t depth;          // open PROF_ENTERs, overflowed ones included
+	uint32_t overflow;       // PROF_ENTERs deeper than PROF_NEST, not timed
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint32_t hist[PROF_HIST_BINS];
+} prof_region_t;
+
+#ifdef PROFILE
+
+void     prof_init(void);
+uint32_t prof_now(void);
+void     prof_enter(uint32_t id);
+void     prof_exit(uint32_t id);
+void     prof_record(uint32_t id, uint32_t cycles);
+void     prof_reset(void);
+void     prof_dump(void);
+const prof_region_t *prof_region(uint32_t id);
+
+#define PROF_INIT()     prof_init()
+#define PROF_ENTER(id)  prof_enter(id)
+#define PROF_EXIT(id)   prof_exit(id)
+#define PROF_DUMP()     prof_dump()
+
+#else
+
+#define PROF_INIT()     ((void)0)
+#define PROF_ENTER(id)  ((void)0)
+#define PROF_EXIT(id)   ((void)0)
+#define PROF_DUMP()     ((void)0)
+
+#endif
+
+#endif /* PROF_H */
@@ -0,0 +1,84 @@
+#include "stm32f446xx.h"
+#include "prof.h"
+#include "ramvec.h"
+
+/* SRAM vector table and interrupt latency probe, see ramvec.h */
+
+#if defined(RAM_VECTORS) && !defined(HOST_BUILD)
+// VTOR.TBLOFF: table aligned to its size rounded up to a power of two (113 words -> 512 B)
+static uint32_t ramvec_table[RAMVEC_ENTRIES] __attribute__((aligned(512)));
+#endif
+
+void ramvec_init(void){
+#if defined(RAM_VECTORS) && !defined(HOST_BUILD)
+	const uint32_t *src = (const uint32_t *)SCB->VTOR;   // flash table, RAMFUNC handlers already point to SRAM
+	uint32_t i;
+	for(i=0; i<RAMVEC_ENTRIES; i++) ramvec_table[i] = src[i];
+	__DSB();                                             // copy complete before the core fetches from it
+	SCB->VTOR = (uint32_t)ramvec_table;
+	__DSB();
+	__ISB();
+#endif
+}
+
+#ifdef PROFILE
+
+static volatile uint32_t ramvec_t0;
+static volatile uint32_t ramvec_cycles;     // pend -> ramvec_mark() of the last probe
+static volatile uint32_t ramvec_region;     // 0: no probe pending
+
+// Cycle stamp without a call: prof_now() and prof_record() stay in flash with RAM_ISR
+#ifdef HOST_BUILD
+#define RAMVEC_NOW()  prof_now()
+#else
+#define RAMVEC_NOW()  DWT->CYCCNT
+#endif
+
+// First statement of the probed handler; ramvec_pend() records the sample
+RAMFUNC void ramvec_mark(void){
+	uint32_t now = RAMVEC_NOW();
+	if(ramvec_region == 0) return;          // a real interrupt, not a probe
+	ramvec_cycles = now - ramvec_t0;
+	ramvec_region = 0;
+}
+
+// Drop every ART cache line so the next vector and handler fetches see the flash wait states
+static void ramvec_flush(void){
+	uint32_t acr = FLASH->ACR;
+	FLASH->ACR = acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);       // reset only works on a disabled cache
+	FLASH->ACR = (acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN)) | FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+	FLASH->ACR = acr & ~(FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+}
+
+static void ramvec_pend(int32_t irq, uint32_t region){
+	uint32_t timeout = 100000;
+	ramvec_region = region;
+	ramvec_t0 = RAMVEC_NOW();
+	NVIC_SetPendingIRQ((IRQn_Type)irq);
+	__DSB();
+	__ISB();
+	while(ramvec_region != 0 && --timeout != 0);   // masked or lower priority: give up, no sample
+	if(ramvec_region == 0) prof_record(region, ramvec_cycles);   // outside the measured window
+	ramvec_region = 0;
+}
+
+void ramvec_probe(int32_t irq, uint32_t n){
+	uint32_t i;
+	for(i=0; i<n; i++) ramvec_pend(irq, PROF_IRQ_WARM);
+	for(i=0; i<n; i++){
+		ramvec_flush();
+		ramvec_pend(irq, PROF_IRQ_COLD);
+	}
+}
+
+#else
+
+void ramvec_mark(void){
+}
+
+void ramvec_probe(int32_t irq, uint32_t n){
+	(void)irq;
+	(void)n;
+}
+
+#endif /* PROFILE */
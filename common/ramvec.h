@@ -0,0 +1,59 @@
+#ifndef RAMVEC_H
+#define RAMVEC_H
+
+#include <stdint.h>
+#include "place.h"
+
+/* SRAM vector table and RAM-resident interrupt handlers for NUCLEO-F446RE
+
+ Reset leaves VTOR on the flash table, so every exception entry fetches
+ its vector, and then the handler's first instructions, through the
+ flash wait states (2WS at 84 MHz, 5WS at 168 MHz). A hit in the ART
+ caches hides that; a miss adds the full wait states, which is the
+ jitter on interrupt latency.
+
+ RAM_VECTORS  ramvec_init() copies the active table into SRAM (aligned
+              to 512 bytes, 16 + 97 vectors rounded up to a power of
+              two, as VTOR requires) and points VTOR at the copy.
+ RAM_ISR      RAMFUNC (place.h) places a function in .ramfunc, which
+              both linkers load to SRAM together with .data:
+              common/gcc/stm32f446re.ld and, for Keil,
+              common/keil/stm32f446re_ramfunc.sct (Linker tab, scatter
+              file instead of the target dialog layout). Calls between
+              flash and SRAM go through linker veneers.
+
+ Used on the hot handlers: EXTI15_10 (B1), SysTick (governor tick) and
+ RTC wakeup (idle).
+
+ Latency measurement (PROFILE builds): RAMVEC_PROBE(irq, n) pends the
+ interrupt n times from thread mode, RAMVEC_MARK() as the first
+ statement of its handler records the cycles from the pend to the
+ handler in the PROF_IRQ_WARM region, then n more times with the flash
+ instruction and data caches flushed before each pend in PROF_IRQ_COLD.
+ PROF_DUMP() prints both; compare a plain build with
+ FW_DEFINES="PROFILE;RAM_VECTORS;RAM_ISR". Both ends of the window read
+ DWT->CYCCNT inline and the sample is recorded after the handler
+ returned, so with RAM_ISR no flash code runs inside it.
+*/
+
+#define RAMVEC_ENTRIES  (16U + 97U)      // system exceptions + STM32F446 IRQs (FMPI2C1_ER = 96)
+
+void ramvec_init(void);
+void ramvec_probe(int32_t irq, uint32_t n);
+void ramvec_mark(void);
+
+#ifdef RAM_VECTORS
+#define RAMVEC_INIT()  ramvec_init()
+#else
+#define RAMVEC_INIT()  ((void)0)
+#endif
+
+#ifdef PROFILE
+#define RAMVEC_PROBE(irq, n)  ramvec_probe(irq, n)
+#define RAMVEC_MARK()         ramvec_mark()
+#else
+#define RAMVEC_PROBE(irq, n)  ((void)0)
+#define RAMVEC_MARK()         ((void)0)
+#endif
+
+#endif /* RAMVEC_H */
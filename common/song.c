@@ -0,0 +1,25 @@
+#include "song.h"
+
+/* Song events, see song.h */
+
+// Octave 8 in Q16.16 Hz, equal temperament from A4 = 440 Hz; lower octaves shift right
+static const uint32_t song_oct8[12] = {
+	274334289UL, 290647054UL, 307929828UL, 326240288UL,   // C8  4186.009, C#, D, D#
+	345639545UL, 366192342UL, 387967272UL, 411037006UL,   // E8  5274.041, F, F#, G
+	435478539UL, 461373440UL, 488808132UL, 517874176UL    // G#8 6644.875, A 7040, A#, B
+};
+
+uint32_t song_hz_q16(song_event_t ev){
+	uint32_t midi = SONG_MIDI(ev), shift;
+	if(midi == 0U) return 0;
+	shift = SONG_OCT_MAX + 1U - midi / 12U;
+	return (song_oct8[midi % 12U] + ((1UL << shift) >> 1)) >> shift;
+}
+
+uint32_t song_hz(song_event_t ev){
+	return (song_hz_q16(ev) + 0x8000UL) >> 16;
+}
+
+uint32_t song_ms(song_event_t ev, uint32_t sixteenth_ms){
+	return SONG_SIXTEENTHS(ev) * sixteenth_ms;
+}
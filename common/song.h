@@ -0,0 +1,93 @@
+#ifndef SONG_H
+#define SONG_H
+
+#include <stdint.h>
+#include "adsr.h"
+
+/* Song scores as constant tables
+
+ A score is written as note macros that the compiler folds into one
+ 16-bit event each, in a const array (flash):
+
+   static const song_event_t song[] = {
+       NOTE(E,4,e), STAC(D,4,e), TIE(G,4,q), NOTE(G,4,q), REST(h), NOTE(Cs,5,qd)
+   };
+
+   NOTE(p,o,d)  pitch p in octave o, duration d, normal articulation
+   STAC(p,o,d)  staccato             (ADSR_STACCATO)
+   TIE(p,o,d)   legato into the next (ADSR_LEGATO)
+   REST(d)      silence
+
+ Pitches C Cs Db D Ds Eb E F Fs Gb G Gs Ab A As Bb B, octaves 0..8
+ (scientific: A4 = 440 Hz), durations w h q e s (whole to sixteenth),
+ dotted wd hd qd ed. A pitch or duration that is not in the list is an
+ undeclared identifier (SONG_PC_H, SONG_DUR_x), an octave out of range
+ a negative array size: a bad note does not compile. Nothing is parsed
+ at run time, and as the table is plain constant data it is the same
+ bytes in the host and the target build.
+
+   bits  0..6   MIDI note, 0 for a rest
+   bits  7..12  duration in sixteenths
+   bits 13..14  articulation, adsr.h ADSR_LEGATO / NORMAL / STACCATO
+
+ song_hz_q16() gives the equal-tempered frequency in Q16.16 Hz (dds.h),
+ song_hz() in whole Hz (tone.h), song_ms() the duration at a tempo.
+ host/song_check.c checks the encoding and the tuning.
+*/
+
+typedef uint16_t song_event_t;
+
+#define SONG_PC_C    0
+#define SONG_PC_Cs   1
+#define SONG_PC_Db   1
+#define SONG_PC_D    2
+#define SONG_PC_Ds   3
+#define SONG_PC_Eb   3
+#define SONG_PC_E    4
+#define SONG_PC_F    5
+#define SONG_PC_Fs   6
+#define SONG_PC_Gb   6
+#define SONG_PC_G    7
+#define SONG_PC_Gs   8
+#define SONG_PC_Ab   8
+#define SONG_PC_A    9
+#define SONG_PC_As   10
+#define SONG_PC_Bb   10
+#define SONG_PC_B    11
+
+#define SONG_DUR_w   16
+#define SONG_DUR_h   8
+#define SONG_DUR_q   4
+#define SONG_DUR_e   2
+#define SONG_DUR_s   1
+#define SONG_DUR_wd  24
+#define SONG_DUR_hd  12
+#define SONG_DUR_qd  6
+#define SONG_DUR_ed  3
+
+#define SONG_OCT_MAX 8
+
+// 0 if c holds, otherwise a compile error (negative array size)
+#define SONG_CHECK(c)            (0U * sizeof(char[(c) ? 1 : -1]))
+
+#define SONG_EVENT(midi, dur, artic) \
+	((song_event_t)((midi) | ((dur) << 7) | ((artic) << 13)))
+#define SONG_PITCH(p, o, d, artic) \
+	SONG_EVENT(SONG_PC_##p + 12 * ((o) + 1) + SONG_CHECK((o) >= 0 && (o) <= SONG_OCT_MAX), SONG_DUR_##d, artic)
+
+#define NOTE(p, o, d)  SONG_PITCH(p, o, d, ADSR_NORMAL)
+#define STAC(p, o, d)  SONG_PITCH(p, o, d, ADSR_STACCATO)
+#define TIE(p, o, d)   SONG_PITCH(p, o, d, ADSR_LEGATO)
+#define REST(d)        SONG_EVENT(0, SONG_DUR_##d, ADSR_NORMAL)
+
+#define SONG_LEN(song)       (sizeof(song) / sizeof((song)[0]))
+#define SONG_MIDI(ev)        ((ev) & 0x7FU)
+#define SONG_SIXTEENTHS(ev)  (((ev) >> 7) & 0x3FU)
+#define SONG_ARTIC(ev)       (((ev) >> 13) & 0x3U)
+#define SONG_IS_REST(ev)     (SONG_MIDI(ev) == 0U)
+
+uint32_t song_hz_q16(song_event_t ev);
+uint32_t song_hz(song_event_t ev);
+uint32_t song_ms(song_event_t ev, uint32_t sixteenth_ms);
+
+#endif /* SONG_H */
@@ -0,0 +1,124 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "place.h"
+#include "tone.h"
+
+/* Glitch-free tone output on TIM5, see tone.h */
+
+#define TONE_TOGGLE  (TIM_CCMR1_OC1M_0 | TIM_CCMR1_OC1M_1)   // OC1M 0011: toggle on match
+#define TONE_OFF     TIM_CCMR1_OC1M_2                        // OC1M 0100: forced inactive
+
+tone_stats_t tone_stats;
+
+static uint32_t          tone_tick_hz;
+static volatile uint32_t tone_next;          // ARR staged last, live after the next update
+static volatile uint32_t tone_silent = 1;
+static uint32_t          tone_from, tone_to; // glide, Hz
+static uint64_t          tone_len;           // glide length in ticks
+static uint64_t          tone_pos;           // ticks from the start of the glide to the staged period
+
+// Half a period of hz in ticks, less one: the pin toggles once per update
+uint32_t tone_arr(uint32_t hz){
+	uint32_t arr;
+	if(hz == 0) return 0xFFFFFFFFUL;
+	arr = (tone_tick_hz + hz) / (2U * hz);
+	return arr > 1U ? arr - 1U : 1U;
+}
+
+static void tone_mode(uint32_t oc1m){
+	TIM5->CCMR1 = (TIM5->CCMR1 & ~TIM_CCMR1_OC1M) | oc1m;
+}
+
+// Load the shadow registers now and restart the counter, without an update interrupt
+static void tone_reload(void){
+	uint32_t cr1 = TIM5->CR1;
+	TIM5->CR1 = cr1 | TIM_CR1_URS;
+	TIM5->EGR = TIM_EGR_UG;
+	TIM5->CR1 = cr1;
+}
+
+void tone_init(uint32_t tick_hz){
+	RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;
+	tone_tick_hz = tick_hz;
+	tone_silent = 1;
+	tone_next = tone_arr(1000U);
+
+	TIM5->CR1   = TIM_CR1_ARPE;                  // up-counting, ARR preloaded
+	TIM5->DIER  = 0;
+	TIM5->CCMR1 = TONE_OFF | TIM_CCMR1_OC1PE;    // CCR1 preloaded, silent until the first note
+	TIM5->CCR1  = 0;                             // match at the start of every period
+	TIM5->CCER  = TIM_CCER_CC1E;                 // active high
+	TIM5->ARR   = tone_next;
+	clock_tim_attach(TIM5, tick_hz);             // PSC, loads the shadows; redone on clock changes
+	TIM5->SR    = 0;
+	NVIC_EnableIRQ(TIM5_IRQn);
+	TIM5->CR1  |= TIM_CR1_CEN;
+}
+
+/*
+ The next note, from the next update event on. Out of silence nothing
+ plays that could be cut, so the counter restarts with it at once.
+*/
+void tone_set_hz(uint32_t hz){
+	uint32_t arr = tone_arr(hz);
+
+	TIM5->DIER &= ~TIM_DIER_UIE;                 // ends a glide
+	if(hz == 0){
+		tone_mode(TONE_OFF);
+		tone_silent = 1;
+		return;
+	}
+	if(arr != tone_next || tone_silent) tone_stats.notes++;
+	tone_next = arr;
+	TIM5->ARR = arr;
+	if(tone_silent){
+		tone_mode(TONE_TOGGLE);
+		tone_reload();
+		tone_silent = 0;
+	}
+}
+
+/*
+ Sweep from from_hz to to_hz in ms. from_hz starts like a tone_set_hz()
+ note, the update interrupt takes it from there.
+*/
+void tone_glide(uint32_t from_hz, uint32_t to_hz, uint32_t ms){
+	tone_set_hz(from_hz);
+	tone_len = (uint64_t)ms * tone_tick_hz / 1000U;
+	if(from_hz == 0 || to_hz == 0 || tone_len == 0){
+		tone_set_hz(to_hz);
+		return;
+	}
+	tone_from = from_hz;
+	tone_to   = to_hz;
+	tone_pos  = 0;
+	tone_stats.glides++;
+	TIM5->SR = ~(uint32_t)TIM_SR_UIF;
+	TIM5->DIER |= TIM_DIER_UIE;
+}
+
+uint32_t tone_gliding(void){
+	return (TIM5->DIER & TIM_DIER_UIE) != 0;
+}
+
+/*
+ Update event: the period staged last is live now. Stage the one after
+ it for the frequency at the tick it will start on; the last one is
+ to_hz, then the interrupt goes off.
+*/
+RAMFUNC void TIM5_IRQHandler(void){
+	uint32_t hz;
+	TIM5->SR = ~(uint32_t)TIM_SR_UIF;
+	if((TIM5->DIER & TIM_DIER_UIE) == 0) return;
+
+	tone_pos += (uint64_t)tone_next + 1U;
+	if(tone_pos >= tone_len){
+		hz = tone_to;
+		TIM5->DIER &= ~TIM_DIER_UIE;
+	} else {
+		hz = (uint32_t)((int64_t)tone_from + ((int64_t)tone_to - (int64_t)tone_from) * (int64_t)tone_pos / (int64_t)tone_len);
+	}
+	tone_next = tone_arr(hz);
+	TIM5->ARR = tone_next;
+	tone_stats.steps++;
+}
@@ -0,0 +1,47 @@
+#ifndef TONE_H
+#define TONE_H
+
+#include <stdint.h>
+
+/* Glitch-free tone output on TIM5 channel 1 for NUCLEO-F446RE
+
+ TIM5 counts at tick_hz (clock_tim_attach(), kept over clock changes)
+ and CH1 toggles at the start of every period (toggle on CCR1 = 0), so
+ the pin plays tick_hz / 2 / (ARR + 1). The speaker pin (PA0, AF2) is
+ set up by the caller.
+
+ Writing the running ARR without ARPE is not synchronised with the
+ counter: an ARR below the current CNT is missed and the 32-bit TIM5
+ counts on to 2^32 (36 minutes at 2 MHz) before the pin moves again.
+ Here ARR and CCR1 are preloaded (ARPE, OC1PE): tone_set_hz() only
+ writes the shadow registers, the update event commits them. The pin
+ completes the half-wave it is in and the new note starts at most one
+ period later, phase-continuous.
+
+ tone_glide() sweeps linearly from one frequency to another. The TIM5
+ update interrupt stages the next period at every update event, the
+ frequency taken from the ticks played since the start of the glide,
+ so the sweep keeps its length whatever the notes, and turns itself
+ off at the end. tone_set_hz(0) silences the pin (OC1M forced
+ inactive, at once) and any call ends a glide in progress.
+
+ host/tone_bench.c checks on the host model that no change of note
+ waits more than one period, against the raw ARR write it replaces,
+ and that a glide moves monotonically.
+*/
+
+typedef struct {
+	uint32_t notes;          // tone_set_hz() calls that changed the note
+	uint32_t glides;         // glides started
+	uint32_t steps;          // periods staged by the update interrupt
+} tone_stats_t;
+
+extern tone_stats_t tone_stats;
+
+void     tone_init(uint32_t tick_hz);
+void     tone_set_hz(uint32_t hz);
+void     tone_glide(uint32_t from_hz, uint32_t to_hz, uint32_t ms);
+uint32_t tone_gliding(void);
+uint32_t tone_arr(uint32_t hz);
+
+#endif /* TONE_H */
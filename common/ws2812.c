@@ -0,0 +1,178 @@
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "idle.h"
+#include "place.h"
+#include "ws2812.h"
+
+/* WS2812 LED strips on TIM2, see ws2812.h */
+
+#define WS_PWM1        (TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_2)   // OC1M 0110: high while CNT < CCR1
+#define WS_DMA_FLAGS   (DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 | DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1)
+#define WS_HALF        (WS2812_CHUNK * WS2812_BITS)              // words per DMA half
+#define WS_HALF_US     (WS_HALF * 1000000UL / WS2812_HZ)         // 240 us
+#define WS_LATCH       ((WS2812_LATCH_US + WS_HALF_US - 1U) / WS_HALF_US)   // zero halves after the data
+
+ws2812_stats_t ws2812_stats;
+
+static uint32_t          ws_buf[2U * WS_HALF];
+static ws2812_timing_t   ws_t;
+static const uint8_t    *ws_frame;
+static uint32_t          ws_leds, ws_next;     // LEDs in the frame, next one to encode
+static uint32_t          ws_data[2];           // half holds data (else 0 duty)
+static uint32_t          ws_quiet;             // zero halves played after the last data
+static uint32_t          ws_lead;              // zero halves to send before the data
+static volatile uint32_t ws_on_air;
+static uint32_t          ws_on;
+
+// Period and high times at tim_hz: 1.25 us, 0.4 us, 0.8 us, rounded
+void ws2812_timing(uint32_t tim_hz, ws2812_timing_t *t){
+	t->arr = (tim_hz + WS2812_HZ / 2U) / WS2812_HZ - 1U;
+	t->t0  = (tim_hz + 1250000UL) / 2500000UL;
+	t->t1  = (tim_hz * 2U + 1250000UL) / 2500000UL;
+}
+
+void ws2812_set(uint8_t *grb, uint32_t led, uint8_t r, uint8_t g, uint8_t b){
+	grb[3U * led]      = g;
+	grb[3U * led + 1U] = r;
+	grb[3U * led + 2U] = b;
+}
+
+// bytes of the frame to one duty word per bit, MSB first: t0 plus the bit times (t1 - t0), no branch
+RAMFUNC void ws2812_encode(const uint8_t *grb, uint32_t bytes, uint32_t *out, uint32_t t0, uint32_t t1){
+	uint32_t i, b, d = t1 - t0;
+	for(i=0; i<bytes; i++){
+		b = grb[i];
+		out[0] = t0 + (d & -((b >> 7) & 1U));
+		out[1] = t0 + (d & -((b >> 6) & 1U));
+		out[2] = t0 + (d & -((b >> 5) & 1U));
+		out[3] = t0 + (d & -((b >> 4) & 1U));
+		out[4] = t0 + (d & -((b >> 3) & 1U));
+		out[5] = t0 + (d & -((b >> 2) & 1U));
+		out[6] = t0 + (d & -((b >> 1) & 1U));
+		out[7] = t0 + (d & -(b & 1U));
+		out += 8;
+	}
+}
+
+// Half h: lead-in zeros, the next LEDs (a short last chunk padded with zeros), or zeros for the latch
+static RAMFUNC void ws_fill(uint32_t h){
+	uint32_t *out = ws_buf + h * WS_HALF, n, i;
+	if(ws_lead == 0U && ws_next < ws_leds){
+		n = ws_leds - ws_next < WS2812_CHUNK ? ws_leds - ws_next : WS2812_CHUNK;
+		ws2812_encode(ws_frame + 3U * ws_next, 3U * n, out, ws_t.t0, ws_t.t1);
+		for(i = n * WS2812_BITS; i < WS_HALF; i++) out[i] = 0;
+		ws_next  += n;
+		ws_data[h] = 1;
+		return;
+	}
+	if(ws_lead) ws_lead--;
+	for(i=0; i<WS_HALF; i++) out[i] = 0;
+	ws_data[h] = 0;
+}
+
+// Latch time over: stream and counter off, the line stays low (CCR1 0)
+static RAMFUNC void ws_stop(void){
+	TIM2->DIER &= ~TIM_DIER_UDE;
+	DMA1_Stream1->CR &= ~DMA_SxCR_EN;
+	TIM2->CR1  &= ~TIM_CR1_CEN;
+	ws_on_air = 0;
+	ws2812_stats.frames++;
+	idle_release();
+}
+
+// Timings kept over clock changes; a frame in flight starts over after a latch
+static void ws_clock(void){
+	ws2812_timing(clock_tim_hz(TIM2), &ws_t);
+	TIM2->PSC = 0;
+	TIM2->ARR = ws_t.arr;                        // preloaded, from the next update event
+	if(!ws_on_air) return;
+	NVIC_DisableIRQ(DMA1_Stream1_IRQn);
+	DMA1->LIFCR = WS_DMA_FLAGS;                  // halves played before the restart: nothing to refill
+	ws_next  = 0;
+	ws_quiet = 0;
+	ws_lead  = WS_LATCH + 2U;                    // both halves now, then the latch
+	ws_fill(0);
+	ws_fill(1);
+	ws2812_stats.restarts++;
+	NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+}
+
+void ws2812_init(void){
+	uint32_t cr1;
+	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+	ws_on_air = 0;
+
+	TIM2->CR1   = TIM_CR1_ARPE;                  // up-counting, ARR preloaded
+	TIM2->DIER  = 0;
+	ws_clock();
+	TIM2->CCMR1 = WS_PWM1 | TIM_CCMR1_OC1PE;     // CCR1 preloaded: the DMA writes the next bit
+	TIM2->CCR1  = 0;
+	TIM2->CCER  = TIM_CCER_CC1E;                 // active high, low between frames
+	cr1 = TIM2->CR1;
+	TIM2->CR1   = cr1 | TIM_CR1_URS;             // load the shadows, no update request
+	TIM2->EGR   = TIM_EGR_UG;
+	TIM2->CR1   = cr1;
+
+	DMA1_Stream1->CR = 0;
+	while (DMA1_Stream1->CR & DMA_SxCR_EN);
+	DMA1->LIFCR = WS_DMA_FLAGS;
+	NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+	if(!ws_on){
+		ws_on = 1;
+		clock_listen(ws_clock);
+	}
+}
+
+// Starts sending leds LEDs of grb (3 bytes each, GRB); 1 while the last frame is still going
+uint32_t ws2812_show(const uint8_t *grb, uint32_t leds){
+	if(ws_on_air) return 1;
+	ws_frame = grb;
+	ws_leds  = leds;
+	ws_next  = 0;
+	ws_quiet = 0;
+	ws_lead  = 0;
+	ws_fill(0);
+	ws_fill(1);
+	ws_on_air = 1;
+	idle_hold();                                 // TIM2 and the DMA need their clocks, no Stop
+
+	DMA1_Stream1->CR = 0;
+	while (DMA1_Stream1->CR & DMA_SxCR_EN);
+	DMA1->LIFCR = WS_DMA_FLAGS;
+	DMA1_Stream1->PAR  = (uintptr_t)&TIM2->CCR1;
+	DMA1_Stream1->M0AR = (uintptr_t)ws_buf;
+	DMA1_Stream1->NDTR = 2U * WS_HALF;
+	// Channel 3 (TIM2_UP), memory -> peripheral, words, memory increment, circular, very high priority
+	DMA1_Stream1->CR = (3UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_PL_0 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+	                   DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0 | DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+	DMA1_Stream1->CR |= DMA_SxCR_EN;
+	TIM2->CNT   = 0;
+	TIM2->DIER  = TIM_DIER_UDE;
+	TIM2->CR1  |= TIM_CR1_CEN;
+	return 0;
+}
+
+uint32_t ws2812_busy(void){
+	return ws_on_air;
+}
+
+/*
+ Half transfer: the first half has been played, refill it; transfer
+ complete: the second. Zero halves played after the data count towards
+ the latch. Both flags at once means a half went out again unchanged.
+*/
+RAMFUNC void DMA1_Stream1_IRQHandler(void){
+	uint32_t isr = DMA1->LISR, h;
+	DMA1->LIFCR = WS_DMA_FLAGS;
+	if((isr & (DMA_LISR_HTIF1 | DMA_LISR_TCIF1)) == (DMA_LISR_HTIF1 | DMA_LISR_TCIF1)) ws2812_stats.late++;
+	for(h=0; h<2U; h++){
+		if((isr & (h ? DMA_LISR_TCIF1 : DMA_LISR_HTIF1)) == 0 || !ws_on_air) continue;
+		if(!ws_data[h] && ws_lead == 0U && ws_next >= ws_leds && ++ws_quiet >= WS_LATCH){
+			ws_stop();
+			continue;
+		}
+		ws_fill(h);
+		ws2812_stats.halves++;
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef WS2812_H
+#define WS2812_H
+
+#include <stdint.h>
+
+/* WS2812 addressable RGB LED strips on TIM2 channel 1 for NUCLEO-F446RE
+
+ Every data bit is one 1.25 us PWM period of TIM2 (800 kHz): high for
+ 0.4 us for a 0, 0.8 us for a 1. An LED takes 24 bits, green, red, blue,
+ MSB first, and passes the rest on; after the last LED the line stays
+ low for WS2812_LATCH_US and the strip shows the frame.
+
+ PSC is 0 and ARR + 1 = timer clock / 800 kHz (105 at 84 MHz, 20 at
+ 16 MHz). The duty of each bit goes to CCR1 by DMA1 Stream1 channel 3
+ (TIM2_UP), one word per update event, circular over two halves of
+ WS2812_CHUNK LEDs. The half and full transfer interrupts encode the
+ next LEDs of the frame into the half the DMA has just left, then fill
+ halves with 0 (line low) until the latch time has passed, then stop
+ the stream and the counter. One interrupt per 8 LEDs (240 us); a frame
+ takes 30 us per LED plus the latch: 500 LEDs refresh at 65 fps.
+
+ The frame buffer is the caller's, 3 bytes per LED in wire order (GRB,
+ ws2812_set()). ws2812_show() starts a frame and returns; LEDs not yet
+ encoded show changes made while ws2812_busy(). A clock change
+ (clock_listen()) re-derives the timings and restarts a frame in flight
+ after a latch. CCR1 is preloaded: the word written at an update event
+ is the next period's duty. The data pin (PA5, AF1) is set up by the
+ caller.
+
+ host/ws2812_bench.c checks the bit encoding and the timings of every
+ clock.h profile against the WS2812 limits, measures the encode cost
+ per LED, and sends a frame through the DMA path of the host model.
+*/
+
+#define WS2812_HZ        800000UL
+#define WS2812_CHUNK     8U                   // LEDs per DMA half
+#define WS2812_LATCH_US  280U                 // WS2812B reset, older parts need 50 us
+#define WS2812_BITS      24U
+
+typedef struct {
+	uint32_t arr;            // period, ticks - 1
+	uint32_t t0;             // high ticks of a 0
+	uint32_t t1;             // high ticks of a 1
+} ws2812_timing_t;
+
+typedef struct {
+	uint32_t frames;         // frames completed
+	uint32_t halves;         // DMA halves refilled
+	uint32_t late;           // interrupts that found both halves played
+	uint32_t restarts;       // frames restarted by a clock change
+} ws2812_stats_t;
+
+extern ws2812_stats_t ws2812_stats;
+
+void     ws2812_init(void);
+uint32_t ws2812_show(const uint8_t *grb, uint32_t leds);
+uint32_t ws2812_busy(void);
+void     ws2812_set(uint8_t *grb, uint32_t led, uint8_t r, uint8_t g, uint8_t b);
+void     ws2812_timing(uint32_t tim_hz, ws2812_timing_t *t);
+void     ws2812_encode(const uint8_t *grb, uint32_t bytes, uint32_t *out, uint32_t t0, uint32_t t1);
+
+#endif /* WS2812_H */
@@ -1,4 +1,9 @@
 #include "stm32f446xx.h"
+#include "prof.h"
+#include "boot.h"
+#include "evt.h"
+#include "clock.h"
+#include "place.h"
 
 /* Board name: NUCLEO-F446RE
 
@@ -28,7 +33,8 @@
  SysTick Clock = AHB Clock / 8
 */
 
-static void enable_HSI(){
+#ifndef FAST_BOOT
+static COLDFUNC void enable_HSI(){
 	
 	/* Enable Power Control clock */
 	/* RCC->APB1ENR |= RCC_APB1LPENR_PWRLPEN; */
@@ -62,9 +68,9 @@ static void enable_HSI(){
  	
 	RCC->PLLCFGR = 0;
 	RCC->PLLCFGR &= ~(RCC_PLLCFGR_PLLSRC); 		// PLLSRC = 0 (HSI 16 Mhz clock selected as clock source)
-	RCC->PLLCFGR |= 16 << RCC_PLLCFGR_PLLN_Pos; 	// PLLM = 16, VCO input clock = 16 MHz / PLLM = 1 MHz
+	RCC->PLLCFGR |= 16 << RCC_PLLCFGR_PLLM_Pos; 	// PLLM = 16, VCO input clock = 16 MHz / PLLM = 1 MHz
 	RCC->PLLCFGR |= 336 << RCC_PLLCFGR_PLLN_Pos; 	// PLLN = 336, VCO output clock = 1 MHz * 336 = 336 MHz
-	RCC->PLLCFGR |= 4 << RCC_PLLCFGR_PLLP_Pos; 	// PLLP = 4, PLLCLK = 336 Mhz / PLLP = 84 MHz
+	RCC->PLLCFGR |= 1 << RCC_PLLCFGR_PLLP_Pos; 	// PLLP = 4 (01), PLLCLK = 336 Mhz / PLLP = 84 MHz
 	RCC->PLLCFGR |= 7 << RCC_PLLCFGR_PLLQ_Pos; 	// PLLQ = 7, USB Clock = 336 MHz / PLLQ = 48 MHz
 
 	// Enable Main PLL Clock
@@ -91,19 +97,21 @@ static void enable_HSI(){
 	// 10: PLL selected as system clock
 	RCC->CFGR &= ~RCC_CFGR_SW;
 	RCC->CFGR |= RCC_CFGR_SW_1;
-	// while ((RCC->CFGR & RCC_CFGR_SWS_PLL) != RCC_CFGR_SWS_PLL);
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
 
   	// Configure the Vector Table location add offset address 
 //	VECT_TAB_OFFSET  = 0x00UL; // Vector Table base offset field. 
                                    // This value must be a multiple of 0x200. 
   	SCB->VTOR = FLASH_BASE | VECT_TAB_OFFSET; // Vector Table Relocation in Internal FLASH 
 
+	clock_update(); // SystemCoreClock = 84 MHz
 }
+#endif
 
 
 
 
-static void configure_STEPPER_pin(){
+static COLDFUNC void configure_STEPPER_pin(){
   // Enable the clock to GPIO Port A	
   RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;   
 		
@@ -188,40 +196,71 @@ int main(void){
 	uint32_t delay;
 	delay = 100000;
 	
+	BOOT_STAMP(BOOT_MAIN);
+	PROF_INIT();
+	EVT_INIT();
+	PROF_ENTER(PROF_ENABLE_HSI);
+#ifdef FAST_BOOT
+	boot_clock_start();   // PLL locks while the pins are set up
+#else
 	enable_HSI();
+#endif
+	PROF_EXIT(PROF_ENABLE_HSI);
+	PROF_ENTER(PROF_CONFIGURE_PIN);
 	configure_STEPPER_pin();
+	PROF_EXIT(PROF_CONFIGURE_PIN);
+	BOOT_STAMP(BOOT_PINS);
 	turn_off_A1();
 	turn_off_B1();
 	turn_off_A2();
 	turn_off_B2();
+	BOOT_STAMP(BOOT_FIRST_OUTPUT);
+#ifdef FAST_BOOT
+	boot_clock_finish();
+#endif
+	BOOT_STAMP(BOOT_READY);
+	BOOT_DUMP();
 
 	
   // Dead loop & program hangs here
 	while(1){
 		  
-		  for(i=0; i<delay; i++); // simple delay
+			for(i=0; i<delay; i++); // simple delay
+			PROF_ENTER(PROF_STEP);
 			turn_on_A1();
 			turn_off_B1();
 			turn_off_A2();
 			turn_off_B2();
+			PROF_EXIT(PROF_STEP);
+			EVT_RECORD(EVT_STEP, 0, 0x1);
 		
-		  for(i=0; i<delay; i++); // simple delay
+			for(i=0; i<delay; i++); // simple delay
+			PROF_ENTER(PROF_STEP);
 			turn_off_A1();
 			turn_on_B1();
 			turn_off_A2();
 			turn_off_B2();
+			PROF_EXIT(PROF_STEP);
+			EVT_RECORD(EVT_STEP, 1, 0x2);
 		
-		  for(i=0; i<delay; i++); // simple delay
+			for(i=0; i<delay; i++); // simple delay
+			PROF_ENTER(PROF_STEP);
 			turn_off_A1();
 			turn_off_B1();
 			turn_on_A2();
 			turn_off_B2();
+			PROF_EXIT(PROF_STEP);
+			EVT_RECORD(EVT_STEP, 2, 0x4);
 		
-		  for(i=0; i<delay; i++); // simple delay
+			for(i=0; i<delay; i++); // simple delay
+			PROF_ENTER(PROF_STEP);
 			turn_off_A1();
 			turn_off_B1();
 			turn_off_A2();
 			turn_on_B2();
+			PROF_EXIT(PROF_STEP);
+			EVT_RECORD(EVT_STEP, 3, 0x8);
+			EVT_DUMP();              // EVT_TRACE: this cycle's steps over ITM
 		
 	}
 }
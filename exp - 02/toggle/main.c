@@ -1,4 +1,10 @@
 #include "stm32f446xx.h"
+#include "clock.h"
+#include "place.h"
+#include "log.h"
+#include "capture.h"
+#include "debounce.h"
+#include "idle.h"
 
 /* Board name: NUCLEO-F446RE
 
@@ -14,6 +20,8 @@
 
 #define BUTTON_PIN 13
 
+#define CAPTURE_HZ 1000000UL      // CAPTURE: LED and button sampled by TIM8/DMA2, frames on the log
+
 #define VECT_TAB_OFFSET  0x00 /*!< Vector Table base offset field. 
                                    This value must be a multiple of 0x200. */
 /*
@@ -26,7 +34,7 @@
  SysTick Clock = AHB Clock / 8
 */
 
-static void enable_HSI(){
+static COLDFUNC void enable_HSI(){
 	
 	/* Enable Power Control clock */
 	/* RCC->APB1ENR |= RCC_APB1LPENR_PWRLPEN; */
@@ -60,9 +68,9 @@ static void enable_HSI(){
  	
 	RCC->PLLCFGR = 0;
 	RCC->PLLCFGR &= ~(RCC_PLLCFGR_PLLSRC); 		// PLLSRC = 0 (HSI 16 Mhz clock selected as clock source)
-	RCC->PLLCFGR |= 16 << RCC_PLLCFGR_PLLN_Pos; 	// PLLM = 16, VCO input clock = 16 MHz / PLLM = 1 MHz
+	RCC->PLLCFGR |= 16 << RCC_PLLCFGR_PLLM_Pos; 	// PLLM = 16, VCO input clock = 16 MHz / PLLM = 1 MHz
 	RCC->PLLCFGR |= 336 << RCC_PLLCFGR_PLLN_Pos; 	// PLLN = 336, VCO output clock = 1 MHz * 336 = 336 MHz
-	RCC->PLLCFGR |= 4 << RCC_PLLCFGR_PLLP_Pos; 	// PLLP = 4, PLLCLK = 336 Mhz / PLLP = 84 MHz
+	RCC->PLLCFGR |= 1 << RCC_PLLCFGR_PLLP_Pos; 	// PLLP = 4 (01), PLLCLK = 336 Mhz / PLLP = 84 MHz
 	RCC->PLLCFGR |= 7 << RCC_PLLCFGR_PLLQ_Pos; 	// PLLQ = 7, USB Clock = 336 MHz / PLLQ = 48 MHz
 
 	// Enable Main PLL Clock
@@ -89,19 +97,20 @@ static void enable_HSI(){
 	// 10: PLL selected as system clock
 	RCC->CFGR &= ~RCC_CFGR_SW;
 	RCC->CFGR |= RCC_CFGR_SW_1;
-	// while ((RCC->CFGR & RCC_CFGR_SWS_PLL) != RCC_CFGR_SWS_PLL);
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
 
   	// Configure the Vector Table location add offset address 
 //	VECT_TAB_OFFSET  = 0x00UL; // Vector Table base offset field. 
                                    // This value must be a multiple of 0x200. 
   	SCB->VTOR = FLASH_BASE | VECT_TAB_OFFSET; // Vector Table Relocation in Internal FLASH 
 
+	clock_update(); // SystemCoreClock = 84 MHz
 }
 
 
 
 
-static void configure_LED_pin(){
+static COLDFUNC void configure_LED_pin(){
   // Enable the clock to GPIO Port A	
   RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;   
 		
@@ -123,7 +132,7 @@ static void configure_LED_pin(){
 	
 }
 
-static void configure_PUSH_pin(){
+static COLDFUNC void configure_PUSH_pin(){
   // Enable the clock to GPIO Port A	
   RCC->AHB1ENR |= RCC_AHB1ENR_GPIOCEN;   
 		
@@ -157,12 +166,35 @@ static void toggle_LED(){
 int main(void){
 	uint32_t i;
 	uint32_t delay;
+#ifdef DEBOUNCE
+	debounce_event_t e;
+#endif
 	delay = 100;
 	
 	enable_HSI();
 	configure_LED_pin();
 	configure_PUSH_pin();
 	turn_off_LED();
+
+#ifdef CAPTURE
+#if defined(LOG_UART) || defined(LOG_ITM)
+	LOG_INIT();
+#else
+	log_init(LOG_TO_UART, LOG_BAUD);   // the frames need a transport
+#endif
+	capture_start(CAPTURE_HZ, 1U << LED, 1U << BUTTON_PIN, capture_to_log);
+#endif
+
+#ifdef DEBOUNCE
+	// PC13 scanned by TIM7 and debounced, the core sleeps instead of polling
+	debounce_start(DEBOUNCE_HZ, 0, 0, 1U << BUTTON_PIN);
+	idle_init();
+	while(1){
+		while(debounce_get(&e)) if(e.level) toggle_LED();   // high, as the poll below
+		LOG_PUMP();
+		idle_enter(LOG_IDLE_US(IDLE_FOREVER));   // Sleep: debounce_start() holds off Stop
+	}
+#endif
 	
   // Dead loop & program hangs here
 	while(1){
@@ -173,6 +205,7 @@ int main(void){
          for(i=0; i<delay; i++);
 			}
 		}
+		LOG_PUMP();                        // LOG_ITM: ship the capture frames
 			
 	}
 }
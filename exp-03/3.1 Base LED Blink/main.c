@@ -1,4 +1,9 @@
 #include "stm32f446xx.h"
+#include "idle.h"
+#include "place.h"
+#include "clock.h"
+#include "ws2812.h"
+#include "pattern.h"
 
 /* Board name: NUCLEO-F446RE
 
@@ -21,6 +26,12 @@
 
 #define BUTTON_PIN 13
 
+#define STRIP_LEDS     60         // WS2812: strip on PA5 instead of LD2
+#define STRIP_FRAME_MS 16         // ~60 fps
+
+#define BLINK_CODE     "@120 'SOS' -840"   // PATTERN: played by TIM2 and a DMA burst, core asleep
+#define BLINK_STEPS    16
+
 #define VECT_TAB_OFFSET  0x00 /*!< Vector Table base offset field. 
                                    This value must be a multiple of 0x200. */
 /*
@@ -33,7 +44,7 @@
  SysTick Clock = AHB Clock / 8
 */
 	
-static void LED_Pin_Init(){
+static COLDFUNC void LED_Pin_Init(){
 	  RCC->AHB1ENR 		|= RCC_AHB1ENR_GPIOAEN;             // Enable GPIOA clock
 	
 	  // Set mode as Alternative Function 1
@@ -52,7 +63,7 @@ static void LED_Pin_Init(){
 	  //LED_PORT->OTYPER   &=  ~(1<<LED_PIN) ;           	// Push-Pull(0, reset), Open-Drain(1)
 }
 
-static void TIM2_CH1_Init(){
+static COLDFUNC void TIM2_CH1_Init(){
 		//tim uptade frequency = TIM_CLK/(TIM_PSC+1)/(TIM_ARR + 1)
 	  // 4000000 / 40 / 50000 = 2Hz
 		// Enable the timer clock
@@ -80,13 +91,49 @@ static void TIM2_CH1_Init(){
 		TIM2->CR1  |= TIM_CR1_CEN; // Enable counter
 }
 
+#ifdef WS2812
+// Colour wheel, pos 0..255: red -> green -> blue -> red, at 1/4 brightness
+static void strip_wheel(uint8_t *grb, uint32_t led, uint32_t pos){
+	uint32_t k = (pos % 85U) * 3U / 4U;          // 0..63 within the third
+	if(pos < 85U)       ws2812_set(grb, led, (uint8_t)(63U - k), (uint8_t)k, 0);
+	else if(pos < 170U) ws2812_set(grb, led, 0, (uint8_t)(63U - k), (uint8_t)k);
+	else                ws2812_set(grb, led, (uint8_t)k, 0, (uint8_t)(63U - k));
+}
+#endif
+
 int main(void){
+#ifdef WS2812
+	static uint8_t strip[3U * STRIP_LEDS];
+	uint32_t i, shift = 0;
+
+	LED_Pin_Init();       // PA5 AF1 = TIM2_CH1, the strip data line
+	ws2812_init();        // TIM2 PWM at 800 kHz, bits by DMA
+	while(1){
+		for(i=0; i<STRIP_LEDS; i++) strip_wheel(strip, i, (i * 256U / STRIP_LEDS + shift) & 0xFFU);
+		ws2812_show(strip, STRIP_LEDS);
+		while(ws2812_busy()) __WFI();
+		clock_delay_ms(STRIP_FRAME_MS);
+		shift += 2U;
+	}
+#endif
+
+#ifdef PATTERN
+	static pattern_step_t blink[BLINK_STEPS];
+
+	LED_Pin_Init();       // PA5 AF1 = TIM2_CH1
+	pattern_init();
+	pattern_play(blink, pattern_compile(BLINK_CODE, blink, BLINK_STEPS), 1);
+	idle_init();
+	while(1) idle_enter(IDLE_FOREVER);     // Sleep: pattern_play() holds off Stop
+#endif
 	
 // Default system clock 4 MHz
 		
 	TIM2_CH1_Init();
 	LED_Pin_Init();														 
-															 
-	while(1);
+	
+	idle_init();
+	idle_hold();      // TIM2 toggles the LED by itself and needs its clock: Sleep, never Stop
+	while(1) idle_enter(IDLE_FOREVER);
 }
 
@@ -94,12 +94,8 @@ static void TIM2_CH1_Init(){
 		TIM2->CR1  |= TIM_CR1_CEN; // Enable counter
 }
 
-static int brightness = 0;
-
 int main(void){
-		int i;
 		int n = 10;
-	int delay = 100;
 
 
 // Default system clock 4 MHz
@@ -1,4 +1,6 @@
 #include "stm32f446xx.h"
+#include "clock.h"
+#include "bam.h"
 
 /* Board name: NUCLEO-F446RE
 
@@ -21,6 +23,10 @@
 
 #define BUTTON_PIN 13
 
+#define BAM_MASK_A   0x07E0U      // BAM: PA5 (LD2) - PA10 and PC0 - PC9, 16 LEDs on any pins
+#define BAM_MASK_C   0x03FFU
+#define BAM_STEP_MS  8            // wave speed
+
 #define VECT_TAB_OFFSET  0x00 /*!< Vector Table base offset field. 
                                    This value must be a multiple of 0x200. */
 
@@ -74,10 +80,34 @@ static void TIM2_CH1_Init(){
 
 static int brightness = 0;
 
+#ifdef BAM
+// Triangle over pos 0..255, squared for the eye
+static uint8_t bam_wave(uint32_t pos){
+	uint32_t t = pos & 0x80U ? 255U - (pos & 0xFFU) : pos & 0xFFU;
+	t *= 2U;
+	return (uint8_t)(t * t / 255U);
+}
+#endif
+
 int main(void){
 		int i;
 		int n = 1;
 
+#ifdef BAM
+	uint32_t pin, k, phase = 0;
+
+	bam_init(BAM_MASK_A, BAM_MASK_C);    // TIM1 + DMA2 write the bit planes, no interrupts
+	while(1){
+		for(pin=0, k=0; pin<16U; pin++){
+			if(BAM_MASK_A & (1U << pin)) bam_set(GPIOA, pin, bam_wave(phase + 16U * k++));
+			if(BAM_MASK_C & (1U << pin)) bam_set(GPIOC, pin, bam_wave(phase + 16U * k++));
+		}
+		bam_show();
+		clock_delay_ms(BAM_STEP_MS);
+		phase += 2U;
+	}
+#endif
+
 
 // Default system clock 4 MHz
 	
@@ -1,4 +1,14 @@
 #include "stm32f446xx.h"
+#include "prof.h"
+#include "boot.h"
+#include "evt.h"
+#include "clock.h"
+#include "tone.h"
+#include "dds.h"
+#include "song.h"
+#include "governor.h"
+#include "ramvec.h"
+#include "place.h"
 
 /* Board name: NUCLEO-F446RE
 
@@ -21,6 +31,15 @@
 
 #define BUTTON_PIN 13
 
+#define TONE_TICK_HZ 2000000UL   // TIM5 counter rate, divides every clock.h timer clock
+#define SIXTEENTH_MS 125        // tempo: an eighth note is 250 ms
+#define VIBRATO_HZ   DDS_HZ(5.5)  // DDS: vibrato rate and depth
+#define VIBRATO_CENT 12
+#define VOICE_ATTACK_MS  10       // DDS: envelope of every note
+#define VOICE_DECAY_MS   80
+#define VOICE_SUSTAIN    (ADSR_ONE * 3 / 5)
+#define VOICE_RELEASE_MS 60
+
 #define VECT_TAB_OFFSET  0x00 /*!< Vector Table base offset field. 
                                    This value must be a multiple of 0x200. */
 /*
@@ -32,9 +51,9 @@
  Max Freq of APB1: 42 MHZ
  SysTick Clock = AHB Clock / 8
 */
-static uint16_t mask; 
 	
-static void enable_HSI(){
+#ifndef FAST_BOOT
+static COLDFUNC void enable_HSI(){
 	
 	/* Enable Power Control clock */
 	/* RCC->APB1ENR |= RCC_APB1LPENR_PWRLPEN; */
@@ -68,9 +87,9 @@ static void enable_HSI(){
  	
 	RCC->PLLCFGR = 0;
 	RCC->PLLCFGR &= ~(RCC_PLLCFGR_PLLSRC); 		// PLLSRC = 0 (HSI 16 Mhz clock selected as clock source)
-	RCC->PLLCFGR |= 16 << RCC_PLLCFGR_PLLN_Pos; 	// PLLM = 16, VCO input clock = 16 MHz / PLLM = 1 MHz
+	RCC->PLLCFGR |= 16 << RCC_PLLCFGR_PLLM_Pos; 	// PLLM = 16, VCO input clock = 16 MHz / PLLM = 1 MHz
 	RCC->PLLCFGR |= 336 << RCC_PLLCFGR_PLLN_Pos; 	// PLLN = 336, VCO output clock = 1 MHz * 336 = 336 MHz
-	RCC->PLLCFGR |= 4 << RCC_PLLCFGR_PLLP_Pos; 	// PLLP = 4, PLLCLK = 336 Mhz / PLLP = 84 MHz
+	RCC->PLLCFGR |= 1 << RCC_PLLCFGR_PLLP_Pos; 	// PLLP = 4 (01), PLLCLK = 336 Mhz / PLLP = 84 MHz
 	RCC->PLLCFGR |= 7 << RCC_PLLCFGR_PLLQ_Pos; 	// PLLQ = 7, USB Clock = 336 MHz / PLLQ = 48 MHz
 
 	// Enable Main PLL Clock
@@ -97,36 +116,19 @@ static void enable_HSI(){
 	// 10: PLL selected as system clock
 	RCC->CFGR &= ~RCC_CFGR_SW;
 	RCC->CFGR |= RCC_CFGR_SW_1;
-	// while ((RCC->CFGR & RCC_CFGR_SWS_PLL) != RCC_CFGR_SWS_PLL);
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
 
   	// Configure the Vector Table location add offset address 
 //	VECT_TAB_OFFSET  = 0x00UL; // Vector Table base offset field. 
                                    // This value must be a multiple of 0x200. 
   	SCB->VTOR = FLASH_BASE | VECT_TAB_OFFSET; // Vector Table Relocation in Internal FLASH 
 
+	clock_update(); // SystemCoreClock = 84 MHz, TIM5 prescaler and delays follow
 }
+#endif
 
 
-static void LED_Pin_Init(){
-	  RCC->AHB1ENR 		|= RCC_AHB1ENR_GPIOAEN;             // Enable GPIOA clock
-	
-	  // Set mode as Alternative Function 1
-		LED_PORT->MODER  	&= ~(0x03 << (2*LED_PIN));   			// Clear bits
-		LED_PORT->MODER  	|=   0x02 << (2*LED_PIN);      		// Input(00), Output(01), AlterFunc(10), Analog(11)
-	
-		LED_PORT->AFR[0] 	&= ~(0xF << (4*LED_PIN));         // 	AF 1 = TIM2_CH1
-		LED_PORT->AFR[0] 	|=   0x1 << (4*LED_PIN);          // 	AF 1 = TIM2_CH1
-	
-		//Set I/O output speed value as very high speed
-		LED_PORT->OSPEEDR  &= ~(0x03<<(2*LED_PIN)); 				// Speed mask
-		LED_PORT->OSPEEDR  |=   0x03<<(2*LED_PIN); 					// Very high speed
-		//Set I/O as no pull-up pull-down 
-		LED_PORT->PUPDR    &= ~(0x03<<(2*LED_PIN));    			// No PUPD(00, reset), Pullup(01), Pulldown(10), Reserved (11)
-		//Set I/O as push pull 
-	  //LED_PORT->OTYPER   &=  ~(1<<LED_PIN) ;           	// Push-Pull(0, reset), Open-Drain(1)
-}
-
-static void SPEAKER_Pin_Init(){
+static COLDFUNC void SPEAKER_Pin_Init(){
   // Enable the clock to GPIO Port B	
   RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;   
 
@@ -151,62 +153,89 @@ static void SPEAKER_Pin_Init(){
 	
 }
 
-static void TIM5_CH1_Init(){
-	//function for musical frequency in timer5
-	//tim uptade frequency = TIM_CLK/(TIM_PSC+1)/(TIM_ARR + 1)
-	// 16000000 / 2 / 2000 = 50Hz
-		// Enable the timer clock
-    RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;                  // Enable TIMER clock
-
-		// Counting direction: 0 = up-counting, 1 = down-counting
-		TIM5->CR1 &= ~TIM_CR1_DIR;  
-		
-    TIM5->PSC = 1;       // Prescaler = 23 
-    TIM5->ARR = 7999-1;   // Auto-reload: Upcouting (0..ARR), Downcouting (ARR..0)
-		TIM5->CCMR1 &= ~TIM_CCMR1_OC1M;  // Clear ouput compare mode bits for channel 1
- 
-	TIM5->CCMR1 |= TIM_CCMR1_OC1M_0 | TIM_CCMR1_OC1M_1; // OC1M = 0011 
-    TIM5->CCMR1 |= TIM_CCMR1_OC1PE;                     // Output 1 preload enable
-
-		// Select output polarity: 0 = active high, 1 = active low
-		TIM5->CCMR1 |= TIM_CCER_CC1NP; // select active high
-		
-    // Enable output for ch1
-		TIM5->CCER |= TIM_CCER_CC1E;                       
-    
-    // Main output enable (MOE): 0 = Disable, 1 = Enable
-		TIM5->BDTR |= TIM_BDTR_MOE;  
-
-		//TIM5->CCR1  = 1135;        // Output Compare Register for channel 1 
-		TIM5->CR1  |= TIM_CR1_CEN; // Enable counter
-}
-
-
 int main(void){
-		int i;
-		int n = 1;
 	  uint16_t current_note = 0;
 	
-    static uint32_t note_freq[8] = {261, 	294, 329, 349, 392, 440, 494, 522}; //Hz
-		static uint16_t song_notes[32] = {2, 2, 3, 2, 4, 4, 4, 4, 
-															 1, 1, 2, 1, 3, 3, 3, 3, 
-															 2, 2, 2, 2, 1, 1, 1, 1,
-															 0, 0, 0, 0, 0, 0, 0, 0};  // 0=C, 1=D ....
+		static const song_event_t song[] = {
+			STAC(E,4,e), STAC(E,4,e), NOTE(F,4,e), NOTE(E,4,e), TIE(G,4,e),  TIE(G,4,e),  TIE(G,4,e),  NOTE(G,4,e),
+			STAC(D,4,e), STAC(D,4,e), NOTE(E,4,e), NOTE(D,4,e), TIE(F,4,e),  TIE(F,4,e),  TIE(F,4,e),  NOTE(F,4,e),
+			NOTE(E,4,e), NOTE(E,4,e), NOTE(E,4,e), NOTE(E,4,e), NOTE(D,4,e), NOTE(D,4,e), NOTE(D,4,e), NOTE(D,4,e),
+			TIE(C,4,e),  TIE(C,4,e),  TIE(C,4,e),  TIE(C,4,e),  TIE(C,4,e),  TIE(C,4,e),  TIE(C,4,e),  NOTE(C,4,e)
+		};  // song.h: pitch, octave, duration; STAC/TIE articulate the DDS envelope
+		song_event_t ev;
+		uint32_t note_ms;
+#ifdef DDS
+		static const adsr_shape_t voice_shape = {VOICE_ATTACK_MS, VOICE_DECAY_MS, VOICE_SUSTAIN, VOICE_RELEASE_MS};
+		static adsr_t voice;
+		uint32_t gate, tied = 0;
+#endif
 		
 		
 // Default system clock 4 MHz
 	
-	enable_HSI(); //16 MHz
+	BOOT_STAMP(BOOT_MAIN);
+	PROF_INIT();
+	EVT_INIT();
+	PROF_ENTER(PROF_ENABLE_HSI);
+#ifdef FAST_BOOT
+	boot_clock_start();   // PLL locks while the pin and timer are set up
+#else
+	enable_HSI(); //84 MHz
+#endif
+	PROF_EXIT(PROF_ENABLE_HSI);
+	PROF_ENTER(PROF_CONFIGURE_PIN);
 	SPEAKER_Pin_Init();
-	
-	TIM5_CH1_Init(); // Timer to control Servo, signal period = 20ms
-	TIM5->ARR = (16000000 / 4 /  note_freq[current_note] ) - 1;
+	PROF_EXIT(PROF_CONFIGURE_PIN);
+	BOOT_STAMP(BOOT_PINS);
+	
+#ifdef DDS
+	dds_init();           // TIM5 CH1 PWM at 31.25 kHz, sine samples by DMA
+	dds_vibrato(VIBRATO_HZ, VIBRATO_CENT);
+	adsr_init(&voice, &voice_shape, DDS_CONTROL_US);
+	dds_envelope(&voice); // ticks once per block, silent until the first note on
+	dds_set_hz(song_hz_q16(song[current_note]));
+#else
+	tone_init(TONE_TICK_HZ); // TIM5 CH1 toggles, ARR/CCR1 preloaded: notes change on update events
+	tone_set_hz(song_hz(song[current_note]));
+#endif
+	BOOT_STAMP(BOOT_FIRST_OUTPUT);
+#ifdef FAST_BOOT
+	boot_clock_finish();
+#endif
+	BOOT_STAMP(BOOT_READY);
+	BOOT_DUMP();
+	RAMVEC_INIT();        // RAM_VECTORS: SysTick of the governor vectors from SRAM
+	GOV_INIT(20);         // GOVERNOR: clock follows the load, TIM5 keeps its tick rate
 
 	while(1){
-		  	TIM5->ARR = (16000000UL/2/ note_freq[song_notes[current_note]] ) - 1UL;
+				ev      = song[current_note];
+				note_ms = song_ms(ev, SIXTEENTH_MS);
+				PROF_ENTER(PROF_NOTE);
+#ifdef DDS
+				if(SONG_IS_REST(ev)){
+					tied = 0;
+				} else {
+					dds_set_hz(song_hz_q16(ev));                   // from the next block, phase-continuous
+					if(!tied) adsr_note_on(&voice);                // a legato note carries on from the last one
+					tied = SONG_ARTIC(ev) == ADSR_LEGATO;
+				}
+				gate = SONG_IS_REST(ev) ? 0 : adsr_gate_ms(SONG_ARTIC(ev), note_ms);
+#else
+		  	tone_set_hz(song_hz(ev));  // from the next update event, no skipped wrap; 0 for a rest
+#endif
+				PROF_EXIT(PROF_NOTE);
+				EVT_RECORD(EVT_NOTE, SONG_MIDI(ev), song_hz(ev));
+				EVT_DUMP();
 				current_note = current_note+1;
-				if (current_note > 32 ||  current_note < 0) current_note = 0;
-			  for(i=0;i<1000000;i++);  		// delay
+				if (current_note >= SONG_LEN(song)) current_note = 0;
+#ifdef DDS
+				GOV_DELAY_MS(gate);         // gate on, sleeps with GOVERNOR
+				if(!tied){
+					adsr_note_off(&voice);
+					GOV_DELAY_MS(note_ms - gate);  // release in the rest of the note
+				}
+#else
+			  GOV_DELAY_MS(note_ms);  		// delay, sleeps with GOVERNOR
+#endif
 	}
 }
-
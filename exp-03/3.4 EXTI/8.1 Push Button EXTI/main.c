@@ -1,4 +1,13 @@
+#include <stdio.h>
 #include "stm32f446xx.h"
+#include "prof.h"
+#include "boot.h"
+#include "evt.h"
+#include "idle.h"
+#include "ramvec.h"
+#include "log.h"
+#include "debounce.h"
+#include "place.h"
 
 /* Board name: NUCLEO-F446RE
 
@@ -20,7 +29,8 @@
 
 ////////////////// ENABLE 16MHz CLOCK BY SADMAN SAKIB AHBAB//////////////////////////
 
-static void sys_clk_config(){
+#ifndef FAST_BOOT
+static COLDFUNC void sys_clk_config(){
 	RCC->CR |= RCC_CR_HSION;
 	while ((RCC->CR & RCC_CR_HSIRDY) == 0); // Wait until HSI ready
 	
@@ -55,6 +65,7 @@ static void sys_clk_config(){
                                    // This value must be a multiple of 0x200. 
   	SCB->VTOR = FLASH_BASE | VECT_TAB_OFFSET; // Vector Table Relocation in Internal FLASH 
 }
+#endif
 ///////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -71,7 +82,7 @@ static void sys_clk_config(){
 
 
 
-static void configure_LED_pin(){
+static COLDFUNC void configure_LED_pin(){
   // Enable the clock to GPIO Port A	
   RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;   
 		
@@ -95,17 +106,13 @@ static void turn_on_LED(){
 	GPIOA->ODR |= 1U << LED_PIN;
 }
 
-static void turn_off_LED(){
-	GPIOA->ODR &= ~(1U << LED_PIN);
-}
-
 static void toggle_LED(){
 	GPIOA->ODR ^= (1 << LED_PIN);
 }
 
 
 
-void config_EXTI(void) {
+COLDFUNC void config_EXTI(void) {
 		// GPIO Configuration
 	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOCEN;
 	
@@ -132,27 +139,74 @@ void config_EXTI(void) {
 	printf("nice\r\n");
 }
 
-void EXTI15_10_IRQHandler(void) {  
+RAMFUNC void EXTI15_10_IRQHandler(void) {  
 //	NVIC_ClearPendingIRQ(EXTI15_10_IRQn);
 	uint32_t j;
+	RAMVEC_MARK();   // PROFILE: latency of RAMVEC_PROBE() pends
+	EVT_RECORD(EVT_ISR_ENTER, EXTI15_10_IRQn, 0);
 	// PR: Pending register
 	if (EXTI->PR & EXTI_PR_PR13) {
 		// cleared by writing a 1 to this bit
 		EXTI->PR |= EXTI_PR_PR13;
+		EVT_RECORD(EVT_BUTTON, EXTI_PIN, (GPIOC->IDR >> EXTI_PIN) & 1UL);
+		PROF_ENTER(PROF_ISR);
 		toggle_LED();
 		printf("Hi\r\n");
 		for(j=0;j<3000;j++);
+		PROF_EXIT(PROF_ISR);
+		PROF_DUMP();
+		IDLE_DUMP();
 	}
+	EVT_RECORD(EVT_ISR_EXIT, EXTI15_10_IRQn, 0);
 }
 
 int main(void){
-	
+#ifdef DEBOUNCE
+	debounce_event_t e;
+#endif
+	
+	BOOT_STAMP(BOOT_MAIN);
+	PROF_INIT();
+	EVT_INIT();
+	PROF_ENTER(PROF_ENABLE_HSI);
+#ifdef FAST_BOOT
+	// Reset already runs from HSI 16 MHz with /1 prescalers, only the caches are missing.
+	// 0WS is enough up to 30 MHz, the 2WS of sys_clk_config() slows every flash fetch.
+	FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_PRFTEN | FLASH_ACR_LATENCY_0WS;
+#else
 	sys_clk_config(); // clk = 16MHz
+#endif
+	PROF_EXIT(PROF_ENABLE_HSI);
+	LOG_INIT();       // LOG_UART / LOG_ITM: printf() goes through the buffered transport
+	PROF_ENTER(PROF_CONFIGURE_PIN);
 	configure_LED_pin();
+	PROF_EXIT(PROF_CONFIGURE_PIN);
+	BOOT_STAMP(BOOT_PINS);
 	turn_on_LED();	
-	config_EXTI();
+	BOOT_STAMP(BOOT_FIRST_OUTPUT);
+#ifdef DEBOUNCE
+	debounce_start(DEBOUNCE_HZ, 0, 0, 1U << EXTI_PIN);   // B1 scanned by TIM7 instead of EXTI13
+#else
+	config_EXTI();    // printf / ITM start after the LED is already on
+#endif
+	RAMVEC_INIT();    // RAM_VECTORS: VTOR -> SRAM copy of the table
+	RAMVEC_PROBE(EXTI15_10_IRQn, 64);   // PROFILE: irq_warm / irq_cold in the dump
 	printf("hello\r\n");
-	while(1);
+	BOOT_STAMP(BOOT_READY);
+	BOOT_DUMP();
+	idle_init();
+	while(1){
+		EVT_DUMP();                      // EVT_TRACE: the presses since the last wake-up
+#ifdef DEBOUNCE
+		while(debounce_get(&e)){
+			EVT_RECORD(EVT_BUTTON, EXTI_PIN, e.level);
+			if(e.level) toggle_LED();        // released, as the rising edge of EXTI13
+			printf("B1 %u at scan %lu\r\n", (unsigned)e.level, (unsigned long)e.tick);
+		}
+#endif
+		LOG_PUMP();                      // LOG_ITM: ship what the handler printed
+		idle_enter(LOG_IDLE_US(IDLE_FOREVER));   // Stop until B1 (EXTI13) wakes the core; DEBOUNCE: Sleep, TIM7
+	}
 
 }
 
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adsr.h"
+#include "dds.h"
+
+/* ADSR envelope curves on the host
+
+ adsr_sim [-v]
+
+ Runs adsr_tick() at the DDS control tick (DDS_CONTROL_US) through
+ note patterns and checks the curves against their definition:
+   attack   linear, full level after attack_ms
+   decay    s + (1 - s) r^n with r^(decay_ms) = 1/1024, ends on sustain
+   release  l0 r^n, idle once under 1/1024 of full scale
+   retrigger, early release: no step larger than the steepest segment
+ -v prints every curve as "name tick level stage" lines on stdout.
+ Exit code 1 on the first curve that is off.
+*/
+
+#define SIM_TICKS    2000U
+#define SIM_TOL      40.0            // Q15, 1/1024 of full scale plus rounding
+
+typedef struct {
+	const char  *name;
+	adsr_shape_t shape;
+	uint32_t     on_tick;         // note on
+	uint32_t     off_tick;        // note off, 0: never
+	uint32_t     on2_tick;        // second note on, 0: none
+} sim_case_t;
+
+static const sim_case_t sim_cases[] = {
+	{ "pluck",     {  10, 100, ADSR_ONE / 2, 200 }, 0, 300, 0 },
+	{ "pad",       { 300, 500, ADSR_ONE * 3 / 4, 800 }, 0, 1000, 0 },
+	{ "organ",     {   0,   0, ADSR_ONE, 0 }, 0, 50, 0 },
+	{ "retrigger", {  20,  50, ADSR_ONE / 2, 400 }, 0, 200, 300 },
+	{ "early-off", { 100,  50, ADSR_ONE / 2, 100 }, 0, 40, 0 },
+};
+
+static int sim_verbose;
+
+static uint32_t sim_ticks(uint32_t ms){
+	uint32_t n = (ms * 1000U + DDS_CONTROL_US / 2U) / DDS_CONTROL_US;
+	return n ? n : 1U;
+}
+
+// Ideal per-tick ratio: a full-range fall reaches 1/1024 after ms
+static double sim_ratio(uint32_t ms){
+	return ms ? pow(2.0, -10.0 / sim_ticks(ms)) : 0.0;
+}
+
+static unsigned sim_run(const sim_case_t *c){
+	static const char *const stages = "IADSR";
+	adsr_t env;
+	uint32_t t, level, prev = 0, stage, prev_stage = ADSR_IDLE, attack_end = 0, decay_end = 0, release_end = 0;
+	uint32_t t_stage = 0, n0 = 0;
+	double ideal, l0 = 0.0, s = c->shape.sustain / (double)ADSR_ONE, max_step = 0.0, bound, err, worst = 0.0;
+	unsigned bad = 0;
+
+	adsr_init(&env, &c->shape, DDS_CONTROL_US);
+	bound = ADSR_ONE / (double)sim_ticks(c->shape.attack_ms) + 1.0;
+	if(c->shape.decay_ms)   bound = fmax(bound, ADSR_ONE * (1.0 - sim_ratio(c->shape.decay_ms)) + 1.0);
+	if(c->shape.release_ms) bound = fmax(bound, ADSR_ONE * (1.0 - sim_ratio(c->shape.release_ms)) + 1.0);
+	if(c->shape.attack_ms == 0 || c->shape.decay_ms == 0 || c->shape.release_ms == 0) bound = ADSR_ONE;
+
+	for(t = 0; t < SIM_TICKS; t++){
+		if(t == c->on_tick || (c->on2_tick && t == c->on2_tick)) adsr_note_on(&env);
+		if(c->off_tick && t == c->off_tick)                      adsr_note_off(&env);
+		level = adsr_tick(&env);
+		stage = env.stage;
+		if(sim_verbose) printf("%s %u %u %c\n", c->name, t, level, stages[stage]);
+
+		if(fabs((double)level - (double)prev) > max_step) max_step = fabs((double)level - (double)prev);
+		if(stage != prev_stage){
+			if(prev_stage == ADSR_ATTACK && !attack_end) attack_end = t;
+			if(prev_stage == ADSR_DECAY && !decay_end)   decay_end = t;
+			if(stage == ADSR_IDLE && !release_end)       release_end = t;
+			if(stage == ADSR_DECAY){                // from the full level the attack ended on
+				t_stage = t;
+				n0 = 0;
+				l0 = level / (double)ADSR_ONE;
+			}
+			if(stage == ADSR_RELEASE){              // one step already taken from where the note was
+				t_stage = t;
+				n0 = 1;
+				l0 = prev / (double)ADSR_ONE;
+			}
+			prev_stage = stage;
+		}
+
+		// Closed form of the exponential segments, from the tick they started on
+		ideal = -1.0;
+		if(stage == ADSR_DECAY)   ideal = s + (l0 - s) * pow(sim_ratio(c->shape.decay_ms), t - t_stage + n0);
+		if(stage == ADSR_RELEASE) ideal = l0 * pow(sim_ratio(c->shape.release_ms), t - t_stage + n0);
+		if(ideal >= 0.0){
+			err = fabs(level - ideal * ADSR_ONE);
+			if(err > worst) worst = err;
+		}
+		prev = level;
+	}
+
+	// Attack from 0 reaches full level after attack_ms, to the tick
+	if(c->on_tick == 0 && c->off_tick > sim_ticks(c->shape.attack_ms) &&
+	   attack_end != sim_ticks(c->shape.attack_ms) - 1U) bad++;
+	if(worst > SIM_TOL) bad++;
+	if(max_step > bound) bad++;
+	if(c->off_tick && c->on2_tick <= c->off_tick && release_end == 0) bad++;
+
+	fprintf(stderr, "%-10s attack %4u decay %4u release %4u ticks, curve off by %5.1f, largest step %6.0f (bound %6.0f)  %s\n",
+	        c->name, attack_end, decay_end, release_end, worst, max_step, bound, bad ? "FAIL" : "ok");
+	return bad;
+}
+
+int main(int argc, char **argv){
+	unsigned i, fail = 0;
+	sim_verbose = argc > 1 && !strcmp(argv[1], "-v");
+	fprintf(stderr, "control tick %lu us\n", (unsigned long)DDS_CONTROL_US);
+	for(i = 0; i < sizeof sim_cases / sizeof sim_cases[0]; i++) fail += sim_run(&sim_cases[i]);
+
+	if(adsr_gate_ms(ADSR_LEGATO, 240) != 240 || adsr_gate_ms(ADSR_NORMAL, 240) != 210 ||
+	   adsr_gate_ms(ADSR_STACCATO, 240) != 120){
+		fprintf(stderr, "gate times  FAIL\n");
+		fail++;
+	}
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
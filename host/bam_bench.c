@@ -0,0 +1,206 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "bam.h"
+
+/* Bit-angle modulation planes and DMA tables on the host
+
+ bam_bench
+
+ Planes: bam_planes() against a per-pin, per-bit reference for random
+ levels and masks: set bits for the pins of the plane, reset bits for
+ the rest of the mask, nothing outside it.
+
+ Speed: ns per bam_planes() call (16 pins, 8 words), vectorised and
+ reference, host figures.
+
+ Replay: the model has no TIM1 or DMA2, so after bam_init() the three
+ streams are read back (PAR, M0AR, NDTR, CHSEL, CIRC) and played the
+ way TIM1 runs them: at each update event ARR goes to the shadow and
+ Stream5 writes the next one, then the CC1/CC2 requests at CNT 0 write
+ the BSRR words. Every pin must be on for level * BAM_LSB_TICKS ticks
+ of each frame, and pins outside the masks never change.
+
+ Clocks: PSC after bam_init() and a switch of every clock.h profile
+ must give BAM_TICK_HZ exactly.
+
+ Exit code 1 when a word, a duty, a stream or a prescaler is off.
+*/
+
+#define BENCH_ROUNDS    20000U
+#define BENCH_FRAMES    4U
+#define BENCH_PASS_NS   300000000ULL
+
+static uint64_t bench_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_ref(const uint8_t level[16], uint16_t mask, uint32_t bsrr[BAM_PLANES]){
+	uint32_t b, pin;
+	for(b=0; b<BAM_PLANES; b++){
+		bsrr[b] = 0;
+		for(pin=0; pin<16U; pin++){
+			if((mask & (1U << pin)) == 0) continue;
+			bsrr[b] |= (level[pin] >> b) & 1U ? 1UL << pin : 1UL << (pin + 16U);
+		}
+	}
+}
+
+static void bench_random(uint8_t level[16]){
+	uint32_t i;
+	for(i=0; i<16U; i++) level[i] = (uint8_t)rand();
+}
+
+static unsigned bench_planes(void){
+	uint8_t  level[16];
+	uint32_t got[BAM_PLANES], want[BAM_PLANES], r, b, bad = 0;
+	uint16_t mask;
+
+	srand(11);
+	for(r=0; r<BENCH_ROUNDS; r++){
+		bench_random(level);
+		mask = r < 2U ? (uint16_t)(r ? 0xFFFFU : 0U) : (uint16_t)rand();
+		bam_planes(level, mask, got);
+		bench_ref(level, mask, want);
+		for(b=0; b<BAM_PLANES; b++) bad += got[b] != want[b];
+	}
+	fprintf(stderr, "planes: %u level sets, %lu words off  %s\n", BENCH_ROUNDS, (unsigned long)bad, bad ? "FAIL" : "ok");
+	return bad != 0;
+}
+
+static void bench_speed(void){
+	static void (*const fn[2])(const uint8_t *, uint16_t, uint32_t *) = { bam_planes, bench_ref };
+	static const char *const name[2] = { "bam_planes", "reference" };
+	uint8_t  level[16];
+	uint32_t out[BAM_PLANES], i;
+	uint64_t t0, el, n;
+	volatile uint32_t sink = 0;
+
+	bench_random(level);
+	for(i=0; i<2U; i++){
+		t0 = bench_ns();
+		n  = 0;
+		do {
+			level[n & 15U] = (uint8_t)n;
+			fn[i](level, 0xFFFFU, out);
+			sink += out[n & 7U];
+			n++;
+			el = bench_ns() - t0;
+		} while(el < BENCH_PASS_NS);
+		fprintf(stderr, "speed: %-10s %7.2f ns per port (16 pins), %.2f ns per pin\n", name[i],
+		        (double)el / (double)n, (double)el / (double)n / 16.0);
+	}
+	(void)sink;
+}
+
+typedef struct {
+	DMA_Stream_TypeDef *s;
+	uint32_t            i;
+} bench_stream_t;
+
+// One DMA transfer: the next word of the stream to its PAR
+static uint32_t bench_take(bench_stream_t *t){
+	const uint32_t *m = (const uint32_t *)t->s->M0AR;
+	uint32_t w = m[t->i];
+	t->i = (t->i + 1U) % t->s->NDTR;
+	return w;
+}
+
+static unsigned bench_stream_ok(DMA_Stream_TypeDef *s, volatile uint32_t *par){
+	uint32_t cr = s->CR;
+	return (cr & DMA_SxCR_EN) && (cr & DMA_SxCR_CIRC) && (cr & DMA_SxCR_MINC) && (cr & DMA_SxCR_DIR_0) &&
+	       ((cr & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) == 6U && s->NDTR == BAM_PLANES && s->PAR == (uintptr_t)par;
+}
+
+// Frames of TIM1 played from the streams: on ticks per pin, ODR bits outside the masks kept
+static unsigned bench_replay(const uint8_t la[16], const uint8_t lc[16], uint16_t ma, uint16_t mc){
+	bench_stream_t arr = { DMA2_Stream5, 0 }, ga = { DMA2_Stream1, 0 }, gc = { DMA2_Stream2, 0 };
+	uint32_t on[2][16], odr[2], shadow, preload, period, pin, p, w, bad = 0;
+	uint32_t keep[2] = { 0xA5A5U & ~(uint32_t)ma, 0x5A5AU & ~(uint32_t)mc };
+
+	if(!bench_stream_ok(DMA2_Stream5, &TIM1->ARR) || !bench_stream_ok(DMA2_Stream1, &GPIOA->BSRR) ||
+	   !bench_stream_ok(DMA2_Stream2, &GPIOC->BSRR) || TIM1->CCR1 != 0 || TIM1->CCR2 != 0 ||
+	   (TIM1->DIER & (TIM_DIER_UDE | TIM_DIER_CC1DE | TIM_DIER_CC2DE)) != (TIM_DIER_UDE | TIM_DIER_CC1DE | TIM_DIER_CC2DE) ||
+	   (TIM1->CR1 & (TIM_CR1_CEN | TIM_CR1_ARPE)) != (TIM_CR1_CEN | TIM_CR1_ARPE))
+		return 1000;
+	memset(on, 0, sizeof on);
+	odr[0] = keep[0];
+	odr[1] = keep[1];
+	preload = TIM1->ARR;                         // the counter sits on the last tick of the lead-in
+	for(period=0; period < BENCH_FRAMES * BAM_PLANES; period++){
+		shadow  = preload;                       // update event
+		preload = bench_take(&arr);
+		for(p=0; p<2U; p++){                     // CC1, CC2 at CNT 0
+			w = bench_take(p ? &gc : &ga);
+			odr[p] = (odr[p] | (w & 0xFFFFU)) & ~(w >> 16);
+		}
+		for(p=0; p<2U; p++)
+			for(pin=0; pin<16U; pin++)
+				if(odr[p] & (1U << pin)) on[p][pin] += shadow + 1U;
+	}
+	for(pin=0; pin<16U; pin++){
+		bad += on[0][pin] != ((ma >> pin) & 1U ? la[pin] * BAM_LSB_TICKS * BENCH_FRAMES : ((keep[0] >> pin) & 1U) * BAM_FRAME_TICKS * BENCH_FRAMES);
+		bad += on[1][pin] != ((mc >> pin) & 1U ? lc[pin] * BAM_LSB_TICKS * BENCH_FRAMES : ((keep[1] >> pin) & 1U) * BAM_FRAME_TICKS * BENCH_FRAMES);
+	}
+	return bad;
+}
+
+static unsigned bench_dma(void){
+	uint8_t  la[16], lc[16];
+	uint32_t r, pin, bad = 0, hz;
+	uint16_t ma, mc;
+	unsigned i;
+
+	setenv("MODEL_RUN_MS", "0", 1);
+	model_reset();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+	srand(5);
+	for(r=0; r<200U; r++){
+		ma = r ? (uint16_t)rand() : 0xFFFFU;
+		mc = r ? (uint16_t)rand() : 0xFFFFU;
+		bam_init(ma, mc);
+		bench_random(la);
+		bench_random(lc);
+		for(pin=0; pin<16U; pin++){
+			bam_set(GPIOA, pin, la[pin]);
+			bam_set(GPIOC, pin, lc[pin]);
+		}
+		bam_show();
+		bad += bench_replay(la, lc, ma, mc);
+	}
+	fprintf(stderr, "replay: 200 mask/level sets, %u frames each, %lu pins off  %s\n", BENCH_FRAMES, (unsigned long)bad,
+	        bad ? "FAIL" : "ok");
+
+	for(i=0; i<CLOCK_PROFILES; i++){
+		unsigned b;
+		clock_set_profile(i);
+		hz = clock_tim_hz(TIM1);
+		b  = hz / (TIM1->PSC + 1U) != BAM_TICK_HZ || hz % (TIM1->PSC + 1U) != 0U || bench_replay(la, lc, ma, mc) != 0U;
+		fprintf(stderr, "clock: TIM1 at %3lu MHz, PSC %3lu, frame %lu us  %s\n", (unsigned long)(hz / 1000000UL),
+		        (unsigned long)TIM1->PSC, (unsigned long)(BAM_FRAME_TICKS * 1000000UL / BAM_TICK_HZ), b ? "FAIL" : "ok");
+		bad += b;
+	}
+	bam_stop();
+	bad += (DMA2_Stream1->CR & DMA_SxCR_EN) != 0 || (TIM1->CR1 & TIM_CR1_CEN) != 0;
+	model_finish();
+	return bad != 0;
+}
+
+int main(void){
+	unsigned fail = 0;
+
+	fail += bench_planes();
+	bench_speed();
+	fail += bench_dma();
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
@@ -0,0 +1,354 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "capture.h"
+
+/* Logic analyzer codec and interrupt path on the host
+
+ capture_bench [budget_pct] [-o capture.bin]
+
+ Codec: traces in the style of the wiring we debug, 1 MHz samples of
+ PA6-PA9 (stepper coils) and PC13 (B1) with other pins of both ports
+ toggling outside the masks: idle lines, half steps every 2 ms, button
+ presses with 3 ms of contact bounce, a 125 kHz square wave on PA6 and
+ random levels on every channel (the worst case). Each goes through
+ capture_block(), the frames are decoded and every sample compared
+ with the trace. Printed: bytes out, the ratio against the 4 bytes per
+ sample the DMA writes, the wire rate at 1 MHz, ns per sample and the
+ sample rate the compressor sustains in budget_pct of this CPU
+ (default 25 %). One trace runs again into a sink that refuses every
+ third frame: the lost samples must show as a gap, the rest exact.
+
+ Interrupt path: the model has no TIM8 or DMA2, so after
+ capture_start() the two streams are checked (PAR, CHSEL, CIRC, sizes,
+ NDTR) and played the way TIM8 runs them: a half-word per stream and
+ sample, HTIF4/TCIF4 at the half and the end, and the Stream4 handler.
+ One interrupt comes after the DMA has lapped the compressor: one
+ overrun, and exactly the overwritten samples missing. A switch to
+ 16 MHz mid-buffer must compress the partial half, re-derive ARR and
+ send a new header. The decoded capture must be the trace, sample for
+ sample, but for that gap. -o writes it, after a line of text as in a
+ serial log, for tools/capvcd.py.
+
+ Exit code 1 when a sample, a stream or a header is off.
+*/
+
+#define BENCH_MA        0x03C0U                  // PA6-PA9
+#define BENCH_MC        0x2000U                  // PC13
+#define BENCH_SAMPLES   (1U << 20)
+#define BENCH_OUT       (8U << 20)
+#define BENCH_PASS_NS   200000000ULL
+#define BENCH_HZ        1000000UL
+#define BENCH_SWITCH    300123U                  // sample of the clock switch
+#define BENCH_LATE      700000U                  // sample of the late interrupt
+
+void DMA2_Stream4_IRQHandler(void);                // common/capture.c
+
+static uint16_t bench_a[BENCH_SAMPLES], bench_c[BENCH_SAMPLES];
+static uint8_t  bench_out[BENCH_OUT];
+static uint32_t bench_len, bench_keep, bench_refuse, bench_offered;
+static uint32_t bench_dec[BENCH_SAMPLES];
+static uint8_t  bench_have[BENCH_SAMPLES];
+
+typedef struct {
+	uint32_t frames, bad, headers, samples, overlap;
+	uint32_t tim_hz[4], ticks[4], first[4];
+} bench_dec_t;
+
+static uint64_t bench_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Frames into bench_out (bench_keep), every bench_refuse-th refused
+static uint32_t bench_sink(const uint8_t *frame, uint32_t n){
+	bench_offered++;
+	if(bench_refuse && bench_offered % bench_refuse == 0U) return 0;
+	if(bench_keep){
+		if(bench_len + n > BENCH_OUT) return 0;
+		memcpy(bench_out + bench_len, frame, n);
+	}
+	bench_len += n;
+	return 1;
+}
+
+static uint32_t bench_rand(void){
+	return (uint32_t)rand() ^ ((uint32_t)rand() << 15);
+}
+
+// Packed channels of one sample, pin by pin
+static uint32_t bench_pack(uint16_t a, uint16_t c){
+	uint32_t v = a | ((uint32_t)c << 16), m = BENCH_MA | ((uint32_t)BENCH_MC << 16), out = 0, ch = 0, b;
+	for(b=0; b<32U; b++){
+		if((m & (1UL << b)) == 0) continue;
+		out |= ((v >> b) & 1U) << ch;
+		ch++;
+	}
+	return out;
+}
+
+static const char *const bench_traces[] = { "idle", "stepper", "button", "square", "random" };
+
+static void bench_trace(uint32_t kind, uint32_t n){
+	static const uint16_t half[8] = { 0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9 };
+	uint32_t i, step = 0, next = 0, level = 1;
+	uint16_t noise_a = 0, noise_c = 0;
+	srand(kind + 1U);
+	for(i=0; i<n; i++){
+		if(kind && (i & 63U) == 0U){                 // LED, UART and the rest, outside the masks
+			noise_a = (uint16_t)(bench_rand() & ~BENCH_MA);
+			noise_c = (uint16_t)(bench_rand() & ~BENCH_MC);
+		}
+		bench_a[i] = noise_a;
+		bench_c[i] = noise_c | (uint16_t)(level << 13);
+		switch(kind){
+			case 1:
+				if(i % 2000U == 0U) step++;
+				bench_a[i] |= (uint16_t)(half[step & 7U] << 6);
+				break;
+			case 2:
+				if(i % 100000U < 3000U && i >= next){    // bounce at the press and the release
+					level ^= 1U;
+					next = i + 1U + bench_rand() % 200U;
+				}
+				if(i % 100000U == 3000U) level = (i / 100000U) & 1U;
+				bench_c[i] = noise_c | (uint16_t)(level << 13);
+				break;
+			case 3:
+				bench_a[i] |= (uint16_t)(((i >> 2) & 1U) << 6);
+				break;
+			case 4:
+				bench_a[i] = (uint16_t)((bench_a[i] & ~BENCH_MA) | (bench_rand() & BENCH_MA));
+				bench_c[i] = (uint16_t)((bench_c[i] & ~BENCH_MC) | (bench_rand() & BENCH_MC));
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+// Frames of bench_out into bench_dec/bench_have; data frames before a header use the bench masks
+static void bench_decode(bench_dec_t *d){
+	const uint8_t *p = bench_out, *q;
+	uint32_t i = 0, len, sum, k, first, count, v, run, shift, at, vbytes = 1;
+	memset(d, 0, sizeof *d);
+	memset(bench_have, 0, sizeof bench_have);
+	while(i + 6U <= bench_len){
+		if(p[i] != CAPTURE_SYNC){ i++; continue; }
+		len = p[i + 2] | ((uint32_t)p[i + 3] << 8);
+		if(len + 6U > CAPTURE_FRAME_MAX || i + len + 6U > bench_len){ i++; continue; }
+		for(sum=0, k=1; k<4U+len; k++) sum += p[i + k];
+		if((sum & 0xFFFFU) != (p[i + 4 + len] | ((uint32_t)p[i + 5 + len] << 8))){ d->bad++; i++; continue; }
+		q = p + i + 4;
+		d->frames++;
+		if(p[i + 1] == CAPTURE_HEADER && len == 16U && d->headers < 4U){
+			d->first[d->headers]  = q[0] | (q[1] << 8) | ((uint32_t)q[2] << 16) | ((uint32_t)q[3] << 24);
+			d->tim_hz[d->headers] = q[4] | (q[5] << 8) | ((uint32_t)q[6] << 16) | ((uint32_t)q[7] << 24);
+			d->ticks[d->headers]  = q[8] | (q[9] << 8) | ((uint32_t)q[10] << 16) | ((uint32_t)q[11] << 24);
+			d->headers++;
+		} else if(p[i + 1] == CAPTURE_DATA){
+			first = q[0] | (q[1] << 8) | ((uint32_t)q[2] << 16) | ((uint32_t)q[3] << 24);
+			count = q[4] | ((uint32_t)q[5] << 8);
+			d->samples += count;
+			for(at=6; at<len; ){
+				for(v=0, k=0; k<vbytes; k++) v |= (uint32_t)q[at++] << (8U * k);
+				for(run=0, shift=0; ; shift += 7U){
+					run |= (uint32_t)(q[at] & 0x7FU) << shift;
+					if(q[at++] < 0x80U) break;
+				}
+				for(k=0; k<run && first < BENCH_SAMPLES; k++, first++){
+					d->overlap += bench_have[first];
+					bench_dec[first]  = v;
+					bench_have[first] = 1;
+				}
+			}
+		}
+		i += len + 6U;
+	}
+}
+
+// Samples of the trace the capture got wrong or lost
+static uint32_t bench_check(uint32_t n, uint32_t *lost){
+	uint32_t i, bad = 0;
+	*lost = 0;
+	for(i=0; i<n; i++){
+		if(!bench_have[i]) (*lost)++;
+		else bad += bench_dec[i] != bench_pack(bench_a[i], bench_c[i]);
+	}
+	return bad;
+}
+
+static unsigned bench_codec(double budget){
+	bench_dec_t d;
+	uint32_t kind, bad, lost, n, bytes;
+	uint64_t t0, el;
+	double ns;
+	unsigned fail = 0;
+
+	fprintf(stderr, "%-8s %9s %9s %8s %11s %8s %12s\n", "trace", "samples", "bytes", "ratio", "kB/s@1MHz", "ns/smp", "rate@budget");
+	for(kind=0; kind<sizeof bench_traces / sizeof bench_traces[0]; kind++){
+		bench_trace(kind, BENCH_SAMPLES);
+		bench_len = 0;
+		bench_keep = 1;
+		bench_refuse = 0;
+		capture_start(BENCH_HZ, BENCH_MA, BENCH_MC, bench_sink);
+		bench_len = 0;                               // the header of capture_start(), not needed here
+		capture_block(bench_a, bench_c, BENCH_SAMPLES);
+		bench_decode(&d);
+		bad = bench_check(BENCH_SAMPLES, &lost);
+		bytes = bench_len;
+
+		bench_keep = 0;
+		t0 = bench_ns();
+		n  = 0;
+		do {
+			capture_block(bench_a, bench_c, BENCH_SAMPLES);
+			n += BENCH_SAMPLES;
+			el = bench_ns() - t0;
+		} while(el < BENCH_PASS_NS);
+		capture_stop();
+		ns = (double)el / (double)n;
+		fprintf(stderr, "%-8s %9lu %9lu %7.1f:1 %11.2f %8.3f %9.1f MHz  %s\n", bench_traces[kind], (unsigned long)BENCH_SAMPLES,
+		        (unsigned long)bytes, 4.0 * BENCH_SAMPLES / (double)bytes,
+		        (double)bytes * BENCH_HZ / BENCH_SAMPLES / 1000.0, ns, budget / 100.0 * 1e3 / ns,
+		        bad || lost || d.bad || d.overlap ? "FAIL" : "ok");
+		fail += bad || lost || d.bad || d.overlap;
+	}
+
+	bench_trace(2, BENCH_SAMPLES);                   // a sink that refuses frames
+	bench_len = bench_offered = 0;
+	bench_keep = 1;
+	bench_refuse = 3;
+	memset(&capture_stats, 0, sizeof capture_stats);
+	capture_start(BENCH_HZ, BENCH_MA, BENCH_MC, bench_sink);
+	capture_block(bench_a, bench_c, BENCH_SAMPLES);
+	capture_stop();
+	bench_decode(&d);
+	bad = bench_check(BENCH_SAMPLES, &lost);
+	bench_refuse = 0;
+	fprintf(stderr, "refused: %lu frames dropped, %lu samples lost, %lu decoded, %lu off  %s\n",
+	        (unsigned long)capture_stats.dropped, (unsigned long)lost, (unsigned long)d.samples, (unsigned long)bad,
+	        bad || capture_stats.dropped == 0U || lost == 0U || lost + d.samples != BENCH_SAMPLES ? "FAIL" : "ok");
+	return fail + (bad || capture_stats.dropped == 0U || lost == 0U || lost + d.samples != BENCH_SAMPLES);
+}
+
+static unsigned bench_stream_ok(DMA_Stream_TypeDef *s, volatile uint32_t *par, uint32_t ie){
+	uint32_t cr = s->CR;
+	return (cr & DMA_SxCR_EN) && (cr & DMA_SxCR_CIRC) && (cr & DMA_SxCR_MINC) && (cr & (DMA_SxCR_DIR_0 | DMA_SxCR_DIR_1)) == 0U &&
+	       (cr & (DMA_SxCR_PSIZE_0 | DMA_SxCR_PSIZE_1 | DMA_SxCR_MSIZE_0 | DMA_SxCR_MSIZE_1)) == (DMA_SxCR_PSIZE_0 | DMA_SxCR_MSIZE_0) &&
+	       (cr & (DMA_SxCR_HTIE | DMA_SxCR_TCIE)) == ie && ((cr & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) == 7U &&
+	       s->NDTR == 2U * CAPTURE_BLOCK && s->PAR == (uintptr_t)par;
+}
+
+static unsigned bench_setup_ok(uint32_t tim_hz){
+	return bench_stream_ok(DMA2_Stream3, &GPIOA->IDR, 0) &&
+	       bench_stream_ok(DMA2_Stream4, &GPIOC->IDR, DMA_SxCR_HTIE | DMA_SxCR_TCIE) &&
+	       TIM8->CCR2 == 0 && TIM8->CCR3 == 0 && (TIM8->CR1 & TIM_CR1_CEN) &&
+	       (TIM8->DIER & (TIM_DIER_CC2DE | TIM_DIER_CC3DE)) == (TIM_DIER_CC2DE | TIM_DIER_CC3DE) &&
+	       tim_hz / (TIM8->PSC + 1U) / (TIM8->ARR + 1U) == BENCH_HZ;
+}
+
+// LIFCR/HIFCR of DMA2 are not modelled: the handler's clears, applied here
+static void bench_clear(void){
+	DMA2->HISR &= ~DMA2->HIFCR;
+	DMA2->HIFCR = 0;
+	DMA2->LIFCR = 0;
+}
+
+// One sample as TIM8 and the two streams take it: Stream3, then Stream4 with its flags
+static void bench_take(uint16_t a, uint16_t c){
+	DMA_Stream_TypeDef *s[2] = { DMA2_Stream3, DMA2_Stream4 };
+	uint16_t v[2] = { a, c };
+	uint32_t i, at;
+	for(i=0; i<2U; i++){
+		at = 2U * CAPTURE_BLOCK - s[i]->NDTR;
+		((uint16_t *)s[i]->M0AR)[at] = v[i];
+		if(--s[i]->NDTR == 0U) s[i]->NDTR = 2U * CAPTURE_BLOCK;
+	}
+	if(s[1]->NDTR == CAPTURE_BLOCK)       DMA2->HISR |= DMA_HISR_HTIF4;
+	if(s[1]->NDTR == 2U * CAPTURE_BLOCK)  DMA2->HISR |= DMA_HISR_TCIF4;
+}
+
+static unsigned bench_isr(const char *out){
+	bench_dec_t d;
+	uint32_t i, n = BENCH_SAMPLES, bad, lost, rate, held = 0, setup[2];
+	unsigned fail;
+	FILE *f;
+
+	bench_trace(1, n);
+	for(i=0; i<n; i++) bench_c[i] = (uint16_t)((bench_c[i] & ~BENCH_MC) | (((i / 150000U) & 1U) << 13));
+	setenv("MODEL_RUN_MS", "0", 1);
+	model_reset();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+	memset(&capture_stats, 0, sizeof capture_stats);
+	bench_len = bench_offered = 0;
+	bench_keep = 1;
+	rate = capture_start(BENCH_HZ, BENCH_MA, BENCH_MC, bench_sink);
+	setup[0] = bench_setup_ok(clock_tim_hz(TIM8));
+	setup[1] = 0;
+	for(i=0; i<n; i++){
+		if(i == BENCH_SWITCH){
+			clock_set_profile(CLOCK_16MHZ);
+			setup[1] = bench_setup_ok(clock_tim_hz(TIM8));
+		}
+		bench_take(bench_a[i], bench_c[i]);
+		if(i >= BENCH_LATE && i < BENCH_LATE + 2U * CAPTURE_BLOCK + 100U){
+			held = 1;                                // the handler waits, the flags pile up
+			continue;
+		}
+		if(DMA2->HISR & (DMA_HISR_HTIF4 | DMA_HISR_TCIF4)){
+			DMA2_Stream4_IRQHandler();
+			bench_clear();
+		}
+	}
+	capture_stop();
+	bench_clear();
+	model_finish();
+
+	bench_decode(&d);
+	bad  = bench_check(n, &lost);
+	fail = !setup[0] || !setup[1] || rate != BENCH_HZ || !held || bad || lost != capture_stats.lost || lost == 0U ||
+	       lost > CAPTURE_BLOCK || d.bad || d.overlap || capture_stats.overruns != 1U || d.headers != 2U || d.first[0] != 0U || d.first[1] != BENCH_SWITCH ||
+	       d.tim_hz[0] != 84000000UL || d.ticks[0] != 84U || d.tim_hz[1] != 16000000UL || d.ticks[1] != 16U ||
+	       (DMA2_Stream4->CR & DMA_SxCR_EN) || (TIM8->CR1 & TIM_CR1_CEN);
+	fprintf(stderr, "isr: %lu samples at %lu Hz, streams %s/%s, %lu frames, %lu bytes, %lu headers (ticks %lu, %lu), "
+	        "%lu overruns, %lu lost, %lu off  %s\n", (unsigned long)n, (unsigned long)rate, setup[0] ? "ok" : "bad",
+	        setup[1] ? "ok" : "bad", (unsigned long)d.frames, (unsigned long)bench_len, (unsigned long)d.headers,
+	        (unsigned long)d.ticks[0], (unsigned long)d.ticks[1], (unsigned long)capture_stats.overruns,
+	        (unsigned long)lost, (unsigned long)bad, fail ? "FAIL" : "ok");
+
+	if(out){
+		f = fopen(out, "wb");
+		if(f == 0 || fprintf(f, "capture_bench: PA6-PA9 half steps, PC13 every 150 ms\r\n") < 0 ||
+		   fwrite(bench_out, 1, bench_len, f) != bench_len){
+			fprintf(stderr, "%s: cannot write\n", out);
+			fail = 1;
+		}
+		if(f) fclose(f);
+	}
+	return fail;
+}
+
+int main(int argc, char **argv){
+	const char *out = 0;
+	double budget = 25.0;
+	unsigned fail = 0;
+	int i;
+
+	for(i=1; i<argc; i++){
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) out = argv[++i];
+		else budget = strtod(argv[i], 0);
+	}
+	fail += bench_codec(budget);
+	fail += bench_isr(out);
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
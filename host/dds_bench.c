@@ -0,0 +1,203 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "dds.h"
+
+/* DDS render throughput and tuning on the host
+
+ dds_bench [budget_pct] [seconds]
+
+ Throughput: dds_render() in blocks of DDS_BLOCK, as the DMA interrupt
+ calls it, for sine (interpolated table), square (phase MSB), vibrato
+ and a bent sine. ns/sample and samples/s are host figures; "rate" is
+ the sample rate that fits in budget_pct of this CPU (default 10 %) and
+ "load" the share DDS_SAMPLE_HZ takes.
+
+ Tuning: seconds of output (default 10) per frequency, measured from the
+ interpolated rising crossings of the duty values through mid-scale,
+ against the integer-ARR square of tone.h at its 2 MHz tick. Bends of
+ one octave and one semitone must scale the frequency exactly, and a
+ vibrato must swing by its depth.
+
+ DMA: dds_init() on the host model, 84 MHz. The TIM5 update DMA must
+ play the blocks at DDS_SAMPLE_HZ / DDS_BLOCK, with ARR following a
+ switch to 16 MHz.
+
+ Exit code 1 when an output is off by more than BENCH_TUNE_HZ or the DMA
+ path misses its rate.
+*/
+
+#define BENCH_BLOCKS     2000U         // per timed pass
+#define BENCH_PASS_NS    300000000ULL  // timed passes for at least this long
+#define BENCH_TONE_HZ    2000000UL     // tone.h tick of the music experiment
+#define BENCH_TUNE_HZ    (0.001)       // tuning tolerance
+#define BENCH_SWING      (0.5)         // vibrato extremes, Hz
+#define BENCH_RUN_MS     200U
+
+static const int16_t *const bench_square = 0;
+
+static uint64_t bench_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_voice(const int16_t *wave, uint32_t hz_q16, int32_t cents, uint32_t vib_cents){
+	dds_set_wave(wave);
+	dds_set_amp(DDS_AMP_MAX);
+	dds_set_hz(hz_q16);
+	dds_bend(cents);
+	dds_vibrato(DDS_HZ(6.0), vib_cents);
+}
+
+static void bench_speed(const char *name, double budget){
+	static uint32_t out[DDS_BLOCK];
+	uint64_t t0 = bench_ns(), t, samples = 0;
+	volatile uint32_t sink = 0;
+	uint32_t i;
+	double ns;
+
+	do {
+		for(i=0; i<BENCH_BLOCKS; i++){
+			dds_render(out, DDS_BLOCK);
+			sink += out[i % DDS_BLOCK];
+		}
+		samples += (uint64_t)BENCH_BLOCKS * DDS_BLOCK;
+		t = bench_ns() - t0;
+	} while(t < BENCH_PASS_NS);
+	ns = (double)t / (double)samples;
+	fprintf(stderr, "%-8s %9.2f %11.2f %12.0f %9.3f\n", name, ns, 1e3 / ns,
+	        budget / 100.0 * 1e9 / ns, 100.0 * DDS_SAMPLE_HZ * ns / 1e9);
+	(void)sink;
+}
+
+/*
+ Frequency of `seconds` of output from its rising mid-scale crossings,
+ with the lowest and highest single-cycle frequency.
+*/
+static double bench_measure(double seconds, double *lo, double *hi){
+	static uint32_t out[DDS_BLOCK];
+	uint64_t n = (uint64_t)(seconds * DDS_SAMPLE_HZ), k = 0;
+	double mid = dds_levels() / 2.0 - 0.5, prev = mid, x, at, first = -1.0, last = -1.0, f;
+	uint64_t cycles = 0;
+	uint32_t i;
+
+	*lo = 1e9;
+	*hi = 0.0;
+	while(k < n){
+		dds_render(out, DDS_BLOCK);
+		for(i=0; i<DDS_BLOCK; i++, k++){
+			x = (double)out[i];
+			if(prev < mid && x >= mid){
+				at = ((double)k - 1.0 + (mid - prev) / (x - prev)) / DDS_SAMPLE_HZ;
+				if(last >= 0.0){
+					f = 1.0 / (at - last);
+					if(f < *lo) *lo = f;
+					if(f > *hi) *hi = f;
+					cycles++;
+				} else {
+					first = at;
+				}
+				last = at;
+			}
+			prev = x;
+		}
+	}
+	return cycles ? (double)cycles / (last - first) : 0.0;
+}
+
+// tone.h on its 2 MHz tick: the note rounded to Hz, half a period in whole ticks
+static double bench_tone_hz(double hz){
+	uint32_t f = (uint32_t)(hz + 0.5);
+	uint32_t arr = (BENCH_TONE_HZ + f) / (2U * f) - 1U;
+	return BENCH_TONE_HZ / 2.0 / (arr + 1.0);
+}
+
+static unsigned bench_tune(double hz, int32_t cents, double seconds){
+	double want = hz * pow(2.0, cents / 1200.0), got, lo, hi;
+	unsigned bad;
+	bench_voice(dds_sine, DDS_HZ(hz), cents, 0);
+	got = bench_measure(seconds, &lo, &hi);
+	bad = fabs(got - want) > BENCH_TUNE_HZ;
+	fprintf(stderr, "%10.4f %+6ld %12.6f %12.6f %+10.3f %12.4f %+10.3f  %s\n", hz, (long)cents, want, got,
+	        (got - want) * 1e3, bench_tone_hz(want), (bench_tone_hz(want) - want) * 1e3, bad ? "FAIL" : "ok");
+	return bad;
+}
+
+static unsigned bench_vibrato(double hz, uint32_t depth, double seconds){
+	double lo, hi, want_lo = hz * pow(2.0, -(double)depth / 1200.0), want_hi = hz * pow(2.0, depth / 1200.0);
+	unsigned bad;
+	bench_voice(dds_sine, DDS_HZ(hz), 0, depth);
+	bench_measure(seconds, &lo, &hi);
+	bad = fabs(lo - want_lo) > BENCH_SWING || fabs(hi - want_hi) > BENCH_SWING;
+	fprintf(stderr, "vibrato %.1f Hz +-%lu cents: %.2f .. %.2f Hz (want %.2f .. %.2f)  %s\n", hz,
+	        (unsigned long)depth, lo, hi, want_lo, want_hi, bad ? "FAIL" : "ok");
+	return bad;
+}
+
+// The interrupt-driven path on the model: blocks played per second, ARR over a clock switch
+static unsigned bench_dma(void){
+	uint32_t blocks, late, arr84, arr16, want = BENCH_RUN_MS * DDS_SAMPLE_HZ / DDS_BLOCK / 1000U;
+	uint64_t end;
+	unsigned bad;
+
+	setenv("MODEL_RUN_MS", "0", 1);              // no wall-clock budget
+	model_reset();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+	dds_init();
+	bench_voice(dds_sine, DDS_HZ(440.0), 0, 0);
+	blocks = dds_stats.blocks;
+	late = dds_stats.late;
+	end = model_cycles() + (uint64_t)SystemCoreClock * BENCH_RUN_MS / 1000U;
+	while(model_cycles() < end) __WFI();
+	blocks = dds_stats.blocks - blocks;
+	late = dds_stats.late - late;
+	arr84 = TIM5->ARR;
+	clock_set_profile(CLOCK_16MHZ);
+	arr16 = TIM5->ARR;
+	model_finish();
+
+	bad = blocks < want * 9U / 10U || blocks > want * 11U / 10U || arr84 != 2687U || arr16 != 511U;
+	fprintf(stderr, "dma: %lu blocks in %u ms (want %lu), %lu late, ARR %lu at 84 MHz, %lu at 16 MHz  %s\n",
+	        (unsigned long)blocks, BENCH_RUN_MS, (unsigned long)want, (unsigned long)late,
+	        (unsigned long)arr84, (unsigned long)arr16, bad ? "FAIL" : "ok");
+	return bad;
+}
+
+int main(int argc, char **argv){
+	double budget  = argc > 1 ? strtod(argv[1], 0) : 10.0;
+	double seconds = argc > 2 ? strtod(argv[2], 0) : 10.0;
+	unsigned fail = 0;
+
+	fprintf(stderr, "DDS at %lu Hz, blocks of %u, %u levels\n", (unsigned long)DDS_SAMPLE_HZ, DDS_BLOCK, dds_levels());
+	fprintf(stderr, "%-8s %9s %11s %12s %9s\n", "wave", "ns/smp", "Msamples/s", "rate@budget", "load %");
+	bench_voice(dds_sine, DDS_HZ(440.0), 0, 0);
+	bench_speed("sine", budget);
+	bench_voice(bench_square, DDS_HZ(440.0), 0, 0);
+	bench_speed("square", budget);
+	bench_voice(dds_sine, DDS_HZ(440.0), 0, 20);
+	bench_speed("vibrato", budget);
+	bench_voice(dds_sine, DDS_HZ(440.0), 150, 0);
+	bench_speed("bend", budget);
+
+	fprintf(stderr, "\n%10s %6s %12s %12s %10s %12s %10s\n", "Hz", "cents", "want", "dds", "err mHz", "tone.h", "err mHz");
+	fail += bench_tune(440.0, 0, seconds);
+	fail += bench_tune(261.6256, 0, seconds);
+	fail += bench_tune(1000.123, 0, seconds);
+	fail += bench_tune(27.5, 0, seconds);
+	fail += bench_tune(440.0, 1200, seconds);
+	fail += bench_tune(440.0, 100, seconds);
+	fail += bench_tune(440.0, -1200, seconds);
+	fail += bench_vibrato(440.0, 20, seconds / 5.0);
+
+	fail += bench_dma();
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
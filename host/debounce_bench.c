@@ -0,0 +1,375 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "debounce.h"
+
+/* Vertical-counter debouncing and its event queue on the host
+
+ debounce_bench
+
+ Bounce: all 48 pins of GPIOA/B/C are buttons pressed and released at
+ random (held 80-400 ms, 100-600 ms apart) for a minute, each edge
+ followed by contact bounce in the shape of measured switches: a tactile
+ dome like B1, a panel push button, a toggle and a worn contact, from
+ 0.1 to 6 ms of level flips 10 us and up apart; and a quiet line with
+ 40 us spikes. The levels go through the IDRs and debounce_tick() at
+ 250 Hz to 2 kHz. Printed per rate: edges pressed, events, events off
+ (extra, missing or the wrong level) and the latency from the first
+ contact. At DEBOUNCE_HZ every edge must come out exactly once, at most
+ DEBOUNCE_SCANS scans after the bounce; spikes never.
+
+ Cost: ns per scan of the 48 pins against a counter per pin.
+
+ Queue: all 48 pins changing in one scan overfill the ring, the rest
+ must be counted as dropped with the levels still right. Then the scan
+ runs on its own thread, as the interrupt would, with the main thread
+ taking events: every event must be whole, in order and none dropped.
+
+ Timer: debounce_start() on the model, TIM7 at the scan rate and still
+ there after a switch to 16 MHz.
+
+ Exit code 1 when an event, a count or the timer is off.
+*/
+
+#define BENCH_PINS      48U
+#define BENCH_US        60000000UL               // a minute of presses
+#define BENCH_TR        8192U                    // transitions per pin
+#define BENCH_EDGES     512U                     // edges per pin
+#define BENCH_SCANS     (1U << 22)
+#define BENCH_THREAD    (1U << 21)               // scans of the threaded run
+
+typedef struct {
+	const char *name;
+	uint32_t    press_us, release_us;            // bounce after the edge
+	uint32_t    spike_ms;                        // 0: presses, else spikes this far apart
+} bench_profile_t;
+
+typedef struct {
+	uint32_t us, level;
+} bench_tr_t;
+
+typedef struct {
+	uint32_t start, settle, level;
+} bench_edge_t;
+
+static const bench_profile_t bench_profiles[] = {
+	{ "tact",   300U,  100U,  0U },
+	{ "push",   1500U, 2500U, 0U },
+	{ "toggle", 3000U, 5000U, 0U },
+	{ "worn",   6000U, 6000U, 0U },
+	{ "spikes", 0U,    0U,    30U },
+};
+
+static const uint32_t bench_rates[] = { 250U, DEBOUNCE_HZ, 1000U, 2000U };
+
+static bench_tr_t   bench_tr[BENCH_PINS][BENCH_TR];
+static uint32_t     bench_ntr[BENCH_PINS];
+static bench_edge_t bench_edge[BENCH_PINS][BENCH_EDGES];
+static uint32_t     bench_nedge[BENCH_PINS];
+
+static uint64_t bench_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t bench_rand(void){
+	return (uint32_t)rand() ^ ((uint32_t)rand() << 15);
+}
+
+static void bench_add(uint32_t pin, uint32_t us, uint32_t level){
+	if(bench_ntr[pin] < BENCH_TR){
+		bench_tr[pin][bench_ntr[pin]].us    = us;
+		bench_tr[pin][bench_ntr[pin]].level = level;
+		bench_ntr[pin]++;
+	}
+}
+
+// An edge to level at t, flipping for w us after it; settles on level at t + w at the latest
+static void bench_bounce(uint32_t pin, uint32_t t, uint32_t w, uint32_t level){
+	uint32_t iv = w / 4U > 10U ? w / 4U : 10U, at, l;
+	bench_add(pin, t, level);
+	for(at = t + 10U + bench_rand() % iv, l = level ^ 1U; at < t + w; at += 10U + bench_rand() % iv, l ^= 1U)
+		bench_add(pin, at, l);
+	if(l == level) bench_add(pin, t + w, level);
+	if(bench_nedge[pin] < BENCH_EDGES){
+		bench_edge[pin][bench_nedge[pin]].start  = t;
+		bench_edge[pin][bench_nedge[pin]].settle = t + w;
+		bench_edge[pin][bench_nedge[pin]].level  = level;
+		bench_nedge[pin]++;
+	}
+}
+
+// Every pin idles high (pull-up), a press pulls it low
+static void bench_trace(const bench_profile_t *p, uint32_t seed){
+	uint32_t pin, t;
+	srand(seed);
+	memset(bench_ntr, 0, sizeof bench_ntr);
+	memset(bench_nedge, 0, sizeof bench_nedge);
+	for(pin=0; pin<BENCH_PINS; pin++){
+		t = 50000U + bench_rand() % 250000U;
+		if(p->spike_ms){
+			for(; t < BENCH_US - 200000UL; t += p->spike_ms * 500U + bench_rand() % (p->spike_ms * 1000U)){
+				bench_add(pin, t, 0);
+				bench_add(pin, t + 40U, 1);
+			}
+			continue;
+		}
+		while(t < BENCH_US - 1200000UL){
+			bench_bounce(pin, t, p->press_us, 0);
+			t += p->press_us + 80000U + bench_rand() % 320000U;
+			bench_bounce(pin, t, p->release_us, 1);
+			t += p->release_us + 100000U + bench_rand() % 500000U;
+		}
+	}
+}
+
+typedef struct {
+	uint32_t edges, events, off, late;
+	uint64_t lat_sum;
+	uint32_t lat_max;
+} bench_result_t;
+
+// The trace scanned at hz, events taken after every scan and matched with the edges pin by pin
+static void bench_run(uint32_t hz, bench_result_t *r){
+	static uint32_t at[BENCH_PINS], level[BENCH_PINS], got[BENCH_PINS];
+	uint32_t period = 1000000UL / hz, phase = bench_rand() % period, now, t, pin, lat, ab, c;
+	debounce_event_t e;
+	bench_edge_t *x;
+
+	memset(r, 0, sizeof *r);
+	memset(at, 0, sizeof at);
+	memset(got, 0, sizeof got);
+	for(pin=0; pin<BENCH_PINS; pin++) level[pin] = 1;
+	debounce_start(0, 0xFFFFU, 0xFFFFU, 0xFFFFU);
+	for(now = phase; now < BENCH_US; now += period){
+		for(ab=0, c=0, pin=0; pin<BENCH_PINS; pin++){
+			while(at[pin] < bench_ntr[pin] && bench_tr[pin][at[pin]].us <= now) level[pin] = bench_tr[pin][at[pin]++].level;
+			if(pin < 32U) ab |= level[pin] << pin;
+			else          c  |= level[pin] << (pin - 32U);
+		}
+		GPIOA->IDR = ab & 0xFFFFU;
+		GPIOB->IDR = ab >> 16;
+		GPIOC->IDR = c;
+		debounce_tick();
+		while(debounce_get(&e)){
+			r->events++;
+			t = phase + (e.tick - 1U) * period;      // the scan that took it
+			if(e.pin >= BENCH_PINS || got[e.pin] >= bench_nedge[e.pin]){
+				r->off++;
+				continue;
+			}
+			x = &bench_edge[e.pin][got[e.pin]];
+			if(e.level != x->level || t < x->start){   // bounce taken for a level: the edge is still to come
+				r->off++;
+				continue;
+			}
+			got[e.pin]++;
+			if(t > x->settle + DEBOUNCE_SCANS * period) r->late++;
+			lat = t - x->start;
+			r->lat_sum += lat;
+			if(lat > r->lat_max) r->lat_max = lat;
+		}
+	}
+	for(pin=0; pin<BENCH_PINS; pin++){
+		r->edges += bench_nedge[pin];
+		if(got[pin] < bench_nedge[pin]) r->off += bench_nedge[pin] - got[pin];
+	}
+}
+
+static unsigned bench_bounces(void){
+	bench_result_t r;
+	uint32_t i, k, bad;
+	unsigned fail = 0;
+
+	fprintf(stderr, "%-8s %9s %6s %7s %7s %5s %5s %8s %8s\n", "trace", "bounce us", "Hz", "edges", "events", "off", "late",
+	        "lat ms", "max ms");
+	for(i=0; i<sizeof bench_profiles / sizeof bench_profiles[0]; i++){
+		bench_trace(&bench_profiles[i], i + 1U);
+		for(k=0; k<sizeof bench_rates / sizeof bench_rates[0]; k++){
+			bench_run(bench_rates[k], &r);
+			bad = r.off || r.late || (bench_profiles[i].spike_ms && r.events);
+			fprintf(stderr, "%-8s %4lu/%-4lu %6lu %7lu %7lu %5lu %5lu %8.2f %8.2f  %s\n", bench_profiles[i].name,
+			        (unsigned long)bench_profiles[i].press_us, (unsigned long)bench_profiles[i].release_us,
+			        (unsigned long)bench_rates[k], (unsigned long)r.edges, (unsigned long)r.events, (unsigned long)r.off,
+			        (unsigned long)r.late, r.events ? (double)r.lat_sum / r.events / 1000.0 : 0.0, r.lat_max / 1000.0,
+			        bad ? (bench_rates[k] == DEBOUNCE_HZ || bench_profiles[i].spike_ms ? "FAIL" : "bounced") : "ok");
+			if(bad && (bench_rates[k] == DEBOUNCE_HZ || bench_profiles[i].spike_ms)) fail++;
+		}
+	}
+	return fail;
+}
+
+// The same 4-scan rule with a counter per pin, for the cost comparison
+static uint8_t  bench_cnt[BENCH_PINS];
+static uint64_t bench_level;
+
+static void bench_naive(void){
+	uint64_t v = (GPIOA->IDR & 0xFFFFU) | ((uint64_t)(GPIOB->IDR & 0xFFFFU) << 16) | ((uint64_t)(GPIOC->IDR & 0xFFFFU) << 32);
+	uint32_t i;
+	for(i=0; i<BENCH_PINS; i++){
+		if(((v ^ bench_level) >> i & 1U) == 0U){
+			bench_cnt[i] = 0;
+		} else if(++bench_cnt[i] >= DEBOUNCE_SCANS){
+			bench_cnt[i] = 0;
+			bench_level ^= 1ULL << i;
+		}
+	}
+}
+
+static unsigned bench_cost(void){
+	debounce_event_t e;
+	uint64_t t0, vc, pp;
+	uint32_t i;
+
+	debounce_start(0, 0xFFFFU, 0xFFFFU, 0xFFFFU);
+	t0 = bench_ns();
+	for(i=0; i<BENCH_SCANS; i++){
+		GPIOA->IDR = (i >> 6) & 0x0101U;             // a few pins moving, as buttons do
+		debounce_tick();
+		while(debounce_get(&e));
+	}
+	vc = bench_ns() - t0;
+	t0 = bench_ns();
+	for(i=0; i<BENCH_SCANS; i++){
+		GPIOA->IDR = (i >> 6) & 0x0101U;
+		bench_naive();
+	}
+	pp = bench_ns() - t0;
+	fprintf(stderr, "cost: %.2f ns per scan of 48 pins, %.2f ns with a counter per pin (%.1fx)\n",
+	        (double)vc / BENCH_SCANS, (double)pp / BENCH_SCANS, vc ? (double)pp / (double)vc : 0.0);
+	return 0;
+}
+
+// All 48 pins in one scan: DEBOUNCE_QUEUE events, the rest dropped, lowest pin first
+static unsigned bench_burst(void){
+	debounce_event_t e;
+	uint32_t i, n = 0, order = 0, levels = 0;
+	unsigned bad;
+
+	memset(&debounce_stats, 0, sizeof debounce_stats);
+	debounce_start(0, 0xFFFFU, 0xFFFFU, 0xFFFFU);
+	GPIOA->IDR = GPIOB->IDR = GPIOC->IDR = 0xFFFFU;
+	debounce_tick();
+	GPIOA->IDR = GPIOB->IDR = GPIOC->IDR = 0;
+	for(i=0; i<DEBOUNCE_SCANS; i++) debounce_tick();
+	for(i=0; i<BENCH_PINS; i++) levels += debounce_level(i);
+	while(debounce_get(&e)){
+		order += e.pin != n || e.level != 0U || e.tick != DEBOUNCE_SCANS + 1U;
+		n++;
+	}
+	bad = n != DEBOUNCE_QUEUE || order || levels || debounce_stats.dropped != BENCH_PINS - DEBOUNCE_QUEUE;
+	fprintf(stderr, "burst: 48 edges in one scan, %lu queued, %lu dropped, %lu out of order, %lu levels off  %s\n",
+	        (unsigned long)n, (unsigned long)debounce_stats.dropped, (unsigned long)order, (unsigned long)levels,
+	        bad ? "FAIL" : "ok");
+	return bad;
+}
+
+/*
+ Threaded run: from scan 8 on, every 8th scan s flips pin k % 48,
+ k = s / 8 - 1, so every event is known from its tick alone: taken at
+ s + 3, the level the parity of the pin's flips so far. The scan waits
+ while the ring could fill, as a slower interrupt rate would: nothing
+ may be dropped.
+*/
+static volatile uint32_t bench_done, bench_taken;
+
+static void *bench_producer(void *arg){
+	uint32_t s, pin, a = 0, b = 0, c = 0;
+	(void)arg;
+	GPIOA->IDR = GPIOB->IDR = GPIOC->IDR = 0;
+	debounce_tick();                             // scan 1 takes the levels
+	for(s=2; s<BENCH_THREAD; s++){
+		if(s % 8U == 0U){
+			pin = (s / 8U - 1U) % BENCH_PINS;
+			if(pin < 16U)      a ^= 1U << pin;
+			else if(pin < 32U) b ^= 1U << (pin - 16U);
+			else               c ^= 1U << (pin - 32U);
+			GPIOA->IDR = a;
+			GPIOB->IDR = b;
+			GPIOC->IDR = c;
+		}
+		while(debounce_stats.events - bench_taken >= DEBOUNCE_QUEUE - 1U) sched_yield();
+		debounce_tick();
+	}
+	__DMB();
+	bench_done = 1;
+	return 0;
+}
+
+static unsigned bench_thread(void){
+	pthread_t th;
+	debounce_event_t e;
+	uint32_t n = 0, bad = 0, last = 0, k, expect;
+	unsigned fail;
+
+	memset(&debounce_stats, 0, sizeof debounce_stats);
+	debounce_start(0, 0xFFFFU, 0xFFFFU, 0xFFFFU);
+	bench_done = bench_taken = 0;
+	pthread_create(&th, 0, bench_producer, 0);
+	for(;;){
+		if(!debounce_get(&e)){
+			if(!bench_done){
+				sched_yield();
+				continue;
+			}
+			if(!debounce_get(&e)) break;             // the last events, published before bench_done
+		}
+		bench_taken = ++n;
+		k = (e.tick - (DEBOUNCE_SCANS - 1U)) / 8U - 1U;
+		bad += e.tick <= last || (e.tick - (DEBOUNCE_SCANS - 1U)) % 8U != 0U || e.pin != k % BENCH_PINS ||
+		       e.level != ((k / BENCH_PINS + 1U) & 1U);
+		last = e.tick;
+	}
+	pthread_join(th, 0);
+	expect = BENCH_THREAD / 8U - 1U;
+	fail = bad || n != expect || debounce_stats.dropped;
+	fprintf(stderr, "thread: %lu events taken, %lu dropped, %lu expected, %lu off  %s\n", (unsigned long)n,
+	        (unsigned long)debounce_stats.dropped, (unsigned long)expect, (unsigned long)bad, fail ? "FAIL" : "ok");
+	return fail;
+}
+
+static unsigned bench_timer_ok(void){
+	return (TIM7->CR1 & TIM_CR1_CEN) && (TIM7->DIER & TIM_DIER_UIE) && NVIC_GetEnableIRQ(TIM7_IRQn) &&
+	       clock_tim_hz(TIM7) / (TIM7->PSC + 1U) / (TIM7->ARR + 1U) == DEBOUNCE_HZ;
+}
+
+static unsigned bench_timer(void){
+	uint32_t ok[2];
+	unsigned fail;
+
+	setenv("MODEL_RUN_MS", "0", 1);
+	model_reset();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+	debounce_start(DEBOUNCE_HZ, 0, 0, 1U << 13);
+	ok[0] = bench_timer_ok();
+	clock_set_profile(CLOCK_16MHZ);
+	ok[1] = bench_timer_ok();
+	debounce_stop();
+	fail = !ok[0] || !ok[1] || (TIM7->CR1 & TIM_CR1_CEN) || NVIC_GetEnableIRQ(TIM7_IRQn);
+	model_finish();
+	fprintf(stderr, "timer: TIM7 at %u Hz, 84 MHz %s, 16 MHz %s, stopped %s  %s\n", DEBOUNCE_HZ, ok[0] ? "ok" : "bad",
+	        ok[1] ? "ok" : "bad", (TIM7->CR1 & TIM_CR1_CEN) ? "no" : "yes", fail ? "FAIL" : "ok");
+	return fail;
+}
+
+int main(void){
+	unsigned fail = 0;
+
+	fail += bench_bounces();
+	fail += bench_cost();
+	fail += bench_burst();
+	fail += bench_thread();
+	fail += bench_timer();
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
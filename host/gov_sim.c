@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f446xx.h"
+#include "clock.h"
+#include "governor.h"
+
+/* Governor replay on synthetic load traces
+
+ gov_sim [trace] [windows] [-v]
+
+ trace: step | ramp | burst | saw | <file>, a file has one demand per
+ line in MHz of work (cycles per second the firmware needs).
+ Every window the load the governor sees is demand / f_profile, capped
+ at 100 %; work above the capacity of the profile is counted as missed.
+
+ Energy uses a proportional model, P_run ~ f * Vcore^2 and Sleep at a
+ quarter of that, good for comparing policies against a fixed clock,
+ not for absolute numbers.
+*/
+
+#define SIM_WINDOW_MS 20U
+
+static const double sim_vcore[CLOCK_PROFILES] = { 1.20, 1.20, 1.20, 1.32 };   // VOS scale 3 / scale 1
+
+static double sim_demand(const char *trace, unsigned w, unsigned n, FILE *file){
+	static unsigned seed = 1;
+	char line[64];
+	if(file){
+		if(!fgets(line, sizeof line, file)) return -1.0;
+		return atof(line);
+	}
+	if(w >= n) return -1.0;
+	seed = seed * 1103515245U + 12345U;
+	if(!strcmp(trace, "step"))  return w < n / 3 ? 5.0 : (w < 2 * n / 3 ? 70.0 : 10.0);
+	if(!strcmp(trace, "ramp"))  return 150.0 * w / n;
+	if(!strcmp(trace, "burst")) return (w % 50) < 5 ? 120.0 : 3.0 + (seed >> 16) % 4;
+	if(!strcmp(trace, "saw"))   return 10.0 + 8.0 * (w % 25);
+	return -1.0;
+}
+
+static double sim_power(uint32_t p, double busy){
+	double f = clock_profiles[p].sysclk_hz / 1e6, v = sim_vcore[p];
+	return f * v * v * (busy + 0.25 * (1.0 - busy));
+}
+
+int main(int argc, char **argv){
+	const char *trace = argc > 1 ? argv[1] : "step";
+	unsigned n = argc > 2 ? (unsigned)strtoul(argv[2], 0, 10) : 300U, w;
+	int verbose = argc > 3 && !strcmp(argv[3], "-v");
+	FILE *file = 0;
+	gov_policy_t g;
+	uint32_t p, load, time_ms[CLOCK_PROFILES] = {0}, changes = 0, fixed = CLOCK_PROFILES - 1U;
+	double demand, f, missed = 0, total = 0, energy = 0, energy_fixed = 0;
+
+	if(strcmp(trace, "step") && strcmp(trace, "ramp") && strcmp(trace, "burst") && strcmp(trace, "saw")){
+		file = fopen(trace, "r");
+		if(!file){ perror(trace); return 2; }
+	}
+
+	gov_policy_default(&g, CLOCK_16MHZ);
+	p = g.profile;
+	for(w = 0; (demand = sim_demand(trace, w, n, file)) >= 0.0; w++){
+		f = clock_profiles[p].sysclk_hz / 1e6;
+		load = demand >= f ? 1000U : (uint32_t)(demand * 1000.0 / f);
+		if(demand > f) missed += demand - f;
+		total += demand;
+		time_ms[p] += SIM_WINDOW_MS;
+		energy += sim_power(p, load / 1000.0);
+		energy_fixed += sim_power(fixed, demand >= 168.0 ? 1.0 : demand / 168.0);
+
+		if(verbose) printf("%5u %7.1f MHz  %3u MHz  load %4u\n", w, demand, (unsigned)f, load);
+		if(gov_decide(&g, load) != p){
+			p = g.profile;
+			changes++;
+		}
+	}
+	if(file) fclose(file);
+
+	printf("trace %s, %u windows of %u ms, %u changes\n", trace, w, SIM_WINDOW_MS, changes);
+	for(p = 0; p < CLOCK_PROFILES; p++)
+		printf("  %3lu MHz %7u ms\n", (unsigned long)(clock_profiles[p].sysclk_hz / 1000000U), time_ms[p]);
+	printf("missed work %.1f%%, energy %.1f%% of fixed %lu MHz\n",
+	       total > 0 ? 100.0 * missed / total : 0.0,
+	       energy_fixed > 0 ? 100.0 * energy / energy_fixed : 0.0,
+	       (unsigned long)(clock_profiles[fixed].sysclk_hz / 1000000U));
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "log.h"
+
+/* Log transport benchmark on the host model
+
+ log_bench [lines] [period_us] [baud] [swo_hz] >/dev/null
+
+ One log line every period_us, three ways:
+   printf  per-character ITM_SendChar(), the RTE_Compiler_IO_STDOUT_ITM path
+   itm     log_write(), log_pump() polled while idle between lines
+   uart    log_write(), USART2 TX DMA at baud (ST-LINK VCP)
+ ITM is limited to swo_hz (10 bit times per character, MODEL_SWO_HZ).
+
+ CPU is the time spent in the logging calls and in the log_pump() calls
+ made while the stimulus FIFO has room (waiting for room is idle time
+ the core could sleep or work through), bytes/s
+ is what reached the wire from the first line until the buffer drained.
+ The table goes to stderr, the log itself to stdout (ITM) and
+ MODEL_UART (/dev/null unless set).
+*/
+
+enum { BENCH_PRINTF = 0, BENCH_ITM, BENCH_UART, BENCH_MODES };
+
+static const char *const bench_names[BENCH_MODES] = { "printf", "itm", "uart" };
+
+static void bench_itm_puts(const char *s){
+	while(*s) ITM_SendChar((uint32_t)*s++);
+}
+
+static void bench_run(uint32_t mode, unsigned lines, unsigned period_us, uint32_t baud){
+	char line[64];
+	unsigned i;
+	int n;
+	uint64_t hz = SystemCoreClock, t0, t, next, cpu = 0, bytes = 0, elapsed;
+	uint32_t sent0 = log_stats.sent, dropped0 = log_stats.dropped;
+
+	if(mode == BENCH_ITM)  log_init(LOG_TO_ITM, 0);
+	if(mode == BENCH_UART) log_init(LOG_TO_UART, baud);
+
+	t0 = next = model_cycles();
+	for(i = 0; i < lines; i++){
+		while((t = model_cycles()) < next){      // idle until the next line is due
+			if(mode == BENCH_ITM && log_pending() != 0 && ITM->PORT[0].u32 != 0){
+				log_pump();                      // the idle loop ships what the FIFO takes
+				cpu += model_cycles() - t;
+			}
+		}
+		next += hz * period_us / 1000000U;
+		t = model_cycles();
+		n = snprintf(line, sizeof line, "t=%lu adc=%4u state=%s\r\n",
+		             (unsigned long)((t - t0) * 1000000U / hz), (i * 37U) % 4096U, (i & 1U) ? "run" : "idle");
+		if(mode == BENCH_PRINTF) bench_itm_puts(line);
+		else                     log_write(line, (uint32_t)n);
+		cpu += model_cycles() - t;
+		bytes += (uint64_t)n;
+	}
+	log_flush();
+	elapsed = model_cycles() - t0;
+
+	if(mode != BENCH_PRINTF) bytes = log_stats.sent - sent0;
+	fprintf(stderr, "%-7s %8llu %8lu %10.0f %6.1f%%\n", bench_names[mode], (unsigned long long)bytes,
+	        (unsigned long)(log_stats.dropped - dropped0),
+	        elapsed ? (double)bytes * (double)hz / (double)elapsed : 0.0,
+	        elapsed ? 100.0 * (double)cpu / (double)elapsed : 0.0);
+}
+
+int main(int argc, char **argv){
+	unsigned lines     = argc > 1 ? (unsigned)strtoul(argv[1], 0, 10) : 200U;
+	unsigned period_us = argc > 2 ? (unsigned)strtoul(argv[2], 0, 10) : 500U;
+	uint32_t baud      = argc > 3 ? (uint32_t)strtoul(argv[3], 0, 10) : 921600U;
+	const char *swo    = argc > 4 ? argv[4] : "2000000";
+	uint32_t mode;
+
+	setenv("MODEL_RUN_MS", "0", 1);                  // no wall-clock budget
+	setenv("MODEL_SWO_HZ", swo, 1);
+	setenv("MODEL_UART", "/dev/null", 0);
+	model_reset();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+
+	fprintf(stderr, "%u lines every %u us, %lu baud, SWO %s Hz, core %lu Hz\n",
+	        lines, period_us, (unsigned long)baud, swo, (unsigned long)SystemCoreClock);
+	fprintf(stderr, "%-7s %8s %8s %10s %7s\n", "mode", "bytes", "dropped", "bytes/s", "cpu");
+	for(mode = 0; mode < BENCH_MODES; mode++) bench_run(mode, lines, period_us, baud);
+	model_finish();
+	return 0;
+}
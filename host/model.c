@@ -0,0 +1,1127 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stm32f446xx.h"
+#include "vcd.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include <string.h>
+#include <time.h>
+
+/* Host peripheral model, see model.h */
+
+GPIO_TypeDef       model_GPIOA, model_GPIOB, model_GPIOC;
+RCC_TypeDef        model_RCC;
+TIM_TypeDef        model_TIM1, model_TIM2, model_TIM3, model_TIM4, model_TIM5;
+TIM_TypeDef        model_TIM6, model_TIM7, model_TIM8;
+EXTI_TypeDef       model_EXTI;
+SYSCFG_TypeDef     model_SYSCFG;
+FLASH_TypeDef      model_FLASH;
+PWR_TypeDef        model_PWR;
+USART_TypeDef      model_USART2;
+RTC_TypeDef        model_RTC;
+DMA_TypeDef        model_DMA1, model_DMA2;
+DMA_Stream_TypeDef model_DMA1_Stream[8], model_DMA2_Stream[8];
+SCB_Type           model_SCB;
+SysTick_Type       model_SysTick;
+DWT_Type           model_DWT;
+CoreDebug_Type     model_CoreDebug;
+ITM_Type           model_ITM;
+
+uint32_t SystemCoreClock = 16000000;
+
+// Handlers the firmware may define, unresolved ones stay NULL
+void SysTick_Handler(void)       __attribute__((weak));
+void EXTI0_IRQHandler(void)      __attribute__((weak));
+void EXTI9_5_IRQHandler(void)    __attribute__((weak));
+void EXTI15_10_IRQHandler(void)  __attribute__((weak));
+void RTC_WKUP_IRQHandler(void)   __attribute__((weak));
+void DMA1_Stream0_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream1_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream6_IRQHandler(void) __attribute__((weak));
+void DMA1_Stream7_IRQHandler(void) __attribute__((weak));
+void USART2_IRQHandler(void)     __attribute__((weak));
+void TIM2_IRQHandler(void)       __attribute__((weak));
+void TIM5_IRQHandler(void)       __attribute__((weak));
+
+// Profiling report from common/prof.c when the run is built with PROFILE
+void prof_dump(void)             __attribute__((weak));
+
+#define MODEL_HSI_HZ     16000000UL
+#define MODEL_LSI_HZ     32000ULL
+#define MODEL_MAX_INPUTS 64
+#define MODEL_STEP_NS    20000ULL      // model step: GPIO sampling, interrupts, inputs
+#define MODEL_VT_BLOCK_CYCLES 4U       // core cycles per firmware basic block on virtual time
+
+typedef struct {
+	uint64_t at_ns;
+	char     port;
+	uint8_t  pin;
+	uint8_t  level;
+} model_input_t;
+
+static pthread_t       model_thread;
+static pthread_mutex_t model_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int    model_running;
+static int             model_virtual;          // virtual time (model_run()), else the wall clock
+static uint64_t        model_vt_ps;            // virtual time since model_start()
+static uint64_t        model_vt_block_ps;      // one basic block at the core clock of the last step
+static uint64_t        model_vt_step_ps;       // next model step
+static uint32_t        model_vt_busy;          // in a model step or a handler, steps wait
+static uint64_t        model_t0_ns, model_last_ns, model_budget_ns;
+static uint64_t        model_cyc;              // core cycles up to model_last_ns
+static uint64_t        model_cyc_rem;          // and the cycle fraction, in Hz * ns
+static uint64_t        model_systick_due;
+static uint8_t         model_nvic_enabled[MODEL_IRQ_COUNT];
+static uint8_t         model_nvic_prio[MODEL_IRQ_COUNT];
+static volatile uint32_t model_primask;
+static void (*volatile model_pending[MODEL_IRQ_COUNT])(void);   // raised while PRIMASK was set
+static void (*volatile model_nvic_pending[MODEL_IRQ_COUNT])(void);   // raised while the line was disabled
+static volatile uint32_t model_wakeups;        // counts interrupt requests, ends a WFI
+static volatile int    model_stopped;          // Stop mode: core clock off
+static uint64_t        model_rtc_t0_ns, model_wut_due_ns;
+static uint32_t        model_cyccnt_base;
+static FILE           *model_uart_out;         // USART2 TX, MODEL_UART or stdout
+static uint64_t        model_uart_due_ns;      // end of the byte on the wire, 0: idle
+static int             model_uart_tdr, model_uart_shift;   // bytes in TDR / the shift register, -1: empty
+static uint64_t        model_uart_last_ns;
+static uint32_t        model_swo_hz;           // MODEL_SWO_HZ, 0: ITM without a rate limit
+static uint64_t        model_swo_free_ns;
+static model_input_t   model_inputs[MODEL_MAX_INPUTS];
+static int             model_ninputs, model_next_input;
+
+static void model_call(IRQn_Type irq, void (*handler)(void));
+static void model_isr(int irq, void (*handler)(void));
+static void model_vt_step(void);
+
+static uint64_t model_now_ns(void){
+	struct timespec ts;
+	if(model_virtual) return model_vt_ps / 1000U;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/////////////////////////////// Clock tree ///////////////////////////////
+
+uint32_t model_core_hz(void){
+	uint32_t pllm, plln, pllp;
+	if((model_RCC.CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL) return MODEL_HSI_HZ;
+	pllm = (model_RCC.PLLCFGR & RCC_PLLCFGR_PLLM) >> RCC_PLLCFGR_PLLM_Pos;
+	plln = (model_RCC.PLLCFGR & RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos;
+	pllp = ((((model_RCC.PLLCFGR & RCC_PLLCFGR_PLLP) >> RCC_PLLCFGR_PLLP_Pos) + 1U) * 2U);
+	if(pllm == 0) pllm = 1;                      // invalid on silicon, keep the model alive
+	return (uint32_t)((uint64_t)MODEL_HSI_HZ / pllm * plln / pllp);
+}
+
+static uint32_t model_ahb_hz(void){
+	static const uint8_t presc[16] = {0,0,0,0,0,0,0,0,1,2,3,4,6,7,8,9};
+	return model_core_hz() >> presc[(model_RCC.CFGR & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+}
+
+// APBx timer clock: PCLK, doubled when the APB prescaler is not 1
+static uint32_t model_timer_hz(uint32_t ppre){
+	static const uint8_t presc[8] = {0,0,0,0,1,2,3,4};
+	uint32_t shift = presc[ppre & 7U];
+	uint32_t pclk  = model_ahb_hz() >> shift;
+	return shift ? pclk * 2U : pclk;
+}
+
+uint32_t model_apb1_timer_hz(void){ return model_timer_hz((model_RCC.CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos); }
+uint32_t model_apb2_timer_hz(void){ return model_timer_hz((model_RCC.CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos); }
+
+void SystemInit(void){
+}
+
+void SystemCoreClockUpdate(void){
+	SystemCoreClock = model_ahb_hz();
+}
+
+// Core cycles now, no count while stopped; model_lock held
+static uint64_t model_cycles_locked(void){
+	uint64_t now = model_now_ns();
+	if(model_stopped || now < model_last_ns) return model_cyc;
+	return model_cyc + ((now - model_last_ns) * model_core_hz() + model_cyc_rem) / 1000000000ULL;
+}
+
+uint64_t model_cycles(void){
+	uint64_t c;
+	pthread_mutex_lock(&model_lock);
+	c = model_cycles_locked();
+	pthread_mutex_unlock(&model_lock);
+	return c;
+}
+
+// CYCCNT counts while CYCCNTENA is set and keeps its value otherwise; caller holds model_lock
+static void model_dwt_sync(uint64_t cyc){
+	if((model_CoreDebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (model_DWT.CTRL & DWT_CTRL_CYCCNTENA_Msk))
+		model_DWT.CYCCNT = (uint32_t)cyc - model_cyccnt_base;
+	else
+		model_cyccnt_base = (uint32_t)cyc - model_DWT.CYCCNT;
+}
+
+// Firmware DWT access (host/stm32f446xx.h): CYCCNT to the cycle, not to the last model step
+void model_dwt_access(void){
+	if(!model_running) return;
+	if(model_virtual){                           // one thread, nothing to lock out
+		model_dwt_sync(model_cycles_locked());
+		return;
+	}
+	pthread_mutex_lock(&model_lock);
+	model_dwt_sync(model_cycles_locked());
+	pthread_mutex_unlock(&model_lock);
+}
+
+/////////////////////////////// NVIC / core ///////////////////////////////
+
+// A request raised while its line was disabled stays pending and is taken when it is enabled, as on the NVIC
+void NVIC_EnableIRQ(IRQn_Type irq){
+	void (*handler)(void);
+	if(irq < 0) return;
+	model_nvic_enabled[irq] = 1;
+	handler = __atomic_exchange_n(&model_nvic_pending[irq], 0, __ATOMIC_SEQ_CST);
+	if(handler) model_call(irq, handler);
+}
+void NVIC_DisableIRQ(IRQn_Type irq){ if(irq >= 0) model_nvic_enabled[irq] = 0; }
+uint32_t NVIC_GetEnableIRQ(IRQn_Type irq){ return irq >= 0 ? model_nvic_enabled[irq] : 0; }
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority){ if(irq >= 0) model_nvic_prio[irq] = (uint8_t)priority; }
+uint32_t NVIC_GetPriority(IRQn_Type irq){ return irq >= 0 ? model_nvic_prio[irq] : 0; }
+
+// Software pend: the handlers the model knows are taken as if raised by their peripheral
+void NVIC_SetPendingIRQ(IRQn_Type irq){
+	switch((int)irq){
+		case RTC_WKUP_IRQn:  model_call(irq, RTC_WKUP_IRQHandler);  break;
+		case EXTI0_IRQn:     model_call(irq, EXTI0_IRQHandler);     break;
+		case 23:             model_call(irq, EXTI9_5_IRQHandler);   break;
+		case EXTI15_10_IRQn: model_call(irq, EXTI15_10_IRQHandler); break;
+		default:             break;
+	}
+}
+void NVIC_ClearPendingIRQ(IRQn_Type irq){ if(irq >= 0) model_nvic_pending[irq] = 0; }
+
+uint32_t SysTick_Config(uint32_t ticks){
+	if((ticks - 1UL) > SysTick_LOAD_RELOAD_Msk) return 1;
+	SysTick->LOAD = ticks - 1UL;
+	SysTick->VAL  = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+	return 0;
+}
+
+// Stimulus port 0 reads 1 (FIFO has room) once the last character is on the SWO wire
+void model_itm_access(void){
+	model_ITM.PORT[0].u32 = model_now_ns() >= model_swo_free_ns;
+}
+
+// With MODEL_SWO_HZ the core waits like ITM_SendChar() on a full stimulus FIFO: 10 bit times per character
+uint32_t ITM_SendChar(uint32_t ch){
+	uint64_t now;
+	if(model_swo_hz){
+		if(model_virtual && model_vt_ps < model_swo_free_ns * 1000U) model_vt_ps = model_swo_free_ns * 1000U;
+		while((now = model_now_ns()) < model_swo_free_ns);
+		model_swo_free_ns = now + 10ULL * 1000000000ULL / model_swo_hz;
+	}
+	putchar((int)ch);
+	return ch;
+}
+
+void __disable_irq(void){ model_primask = 1; }
+
+// Interrupts raised while masked are taken here, on the firmware thread, as on the core
+void __enable_irq(void){
+	uint32_t i;
+	void (*handler)(void);
+	model_primask = 0;
+	for(i=0; i<MODEL_IRQ_COUNT; i++){
+		handler = __atomic_exchange_n(&model_pending[i], 0, __ATOMIC_SEQ_CST);
+		if(handler) model_isr((int)i, handler);
+	}
+}
+uint32_t __get_PRIMASK(void){ return model_primask; }
+void __set_PRIMASK(uint32_t primask){ model_primask = primask; }
+
+/*
+ Sleep until the next interrupt request; a request already pending
+ behind PRIMASK returns at once. With SLEEPDEEP this is Stop mode: the
+ PLL goes off, HSI is selected on wake-up and the core cycle count
+ (DWT, SysTick) does not advance while stopped. On virtual time the
+ model steps on from here until a request comes.
+*/
+void __WFI(void){
+	struct timespec ts = {0, 10000};             // a model tick
+	uint32_t seen = model_wakeups, i;
+	for(i=0; i<MODEL_IRQ_COUNT; i++) if(model_pending[i]) return;
+	if(SCB->SCR & SCB_SCR_SLEEPDEEP_Msk){
+		pthread_mutex_lock(&model_lock);               // count up to here at the old clock
+		model_cyc = model_cycles_locked();
+		model_cyc_rem = 0;
+		model_last_ns = model_now_ns();
+		model_stopped = 1;
+		pthread_mutex_unlock(&model_lock);
+		__atomic_fetch_and((uint32_t *)&model_RCC.CR, ~RCC_CR_PLLON, __ATOMIC_SEQ_CST);
+		__atomic_fetch_and((uint32_t *)&model_RCC.CFGR, ~RCC_CFGR_SW, __ATOMIC_SEQ_CST);
+	}
+	while(model_running && model_wakeups == seen){
+		if(!model_virtual){
+			nanosleep(&ts, 0);
+			continue;
+		}
+		if(model_vt_ps < model_vt_step_ps) model_vt_ps = model_vt_step_ps;
+		model_vt_step();
+	}
+	model_stopped = 0;
+}
+void __WFE(void){ __WFI(); }
+void __SEV(void){ }
+
+/////////////////////////////// GPIO / EXTI ///////////////////////////////
+
+static GPIO_TypeDef *model_port(char port){
+	switch(port){
+		case 'A': return &model_GPIOA;
+		case 'B': return &model_GPIOB;
+		case 'C': return &model_GPIOC;
+		default:  return 0;
+	}
+}
+
+// A wake-up interrupt restarts the core clock before its handler runs
+static void model_wake(void){
+	pthread_mutex_lock(&model_lock);
+	if(model_stopped){
+		model_last_ns = model_now_ns();
+		model_stopped = 0;
+	}
+	pthread_mutex_unlock(&model_lock);
+}
+
+static void model_call(IRQn_Type irq, void (*handler)(void)){
+	if(handler == 0) return;
+	if(!model_nvic_enabled[irq]){
+		model_nvic_pending[irq] = handler;
+		return;
+	}
+	model_wakeups++;
+	model_wake();
+	if(model_primask) model_pending[irq] = handler;
+	else              model_isr(irq, handler);
+}
+
+static void model_exti_dispatch(uint32_t line){
+	if(line == 0)       model_call(EXTI0_IRQn, EXTI0_IRQHandler);
+	else if(line <= 9)  model_call((IRQn_Type)23, EXTI9_5_IRQHandler);
+	else                model_call(EXTI15_10_IRQn, EXTI15_10_IRQHandler);
+}
+
+void model_set_input(char port, uint32_t pin, int level){
+	GPIO_TypeDef *gpio = model_port(port);
+	uint32_t old, line_port, bit = 1UL << pin;
+	if(gpio == 0 || pin > 15) return;
+
+	old = gpio->IDR & bit;
+	if(level) gpio->IDR |= bit;
+	else      gpio->IDR &= ~bit;
+	if(old == (gpio->IDR & bit)) return;
+
+	// EXTI line follows the port selected in SYSCFG_EXTICR
+	line_port = (SYSCFG->EXTICR[pin / 4] >> (4 * (pin % 4))) & 0xFU;
+	if(line_port != (uint32_t)(port - 'A')) return;
+	if(( level && (EXTI->RTSR & bit)) || (!level && (EXTI->FTSR & bit))){
+		EXTI->PR |= bit;
+		if(EXTI->IMR & bit) model_exti_dispatch(pin);
+	}
+}
+
+/////////////////////////////// Input script ///////////////////////////////
+
+static void model_parse_inputs(const char *s){
+	char port;
+	unsigned pin, ms, level;
+	int used;
+	model_ninputs = 0;
+	while(s && *s && model_ninputs < MODEL_MAX_INPUTS){
+		if(sscanf(s, "P%c%u@%u=%u%n", &port, &pin, &ms, &level, &used) != 4) break;
+		model_inputs[model_ninputs].at_ns = (uint64_t)ms * 1000000ULL;
+		model_inputs[model_ninputs].port  = port;
+		model_inputs[model_ninputs].pin   = (uint8_t)pin;
+		model_inputs[model_ninputs].level = (uint8_t)(level != 0);
+		model_ninputs++;
+		s += used;
+		if(*s == ',') s++;
+	}
+}
+
+/////////////////////////////// Timers and waveform trace ///////////////////////////////
+
+/*
+ TIM2 and TIM5 count from the wall clock, edge by edge on the exact
+ timer tick. PSC and OC1M are latched at every update event; ARR and
+ CCR1 too when ARPE / OC1PE preload them, else a write applies at once
+ as on silicon: an ARR below the running CNT lets the counter run on to
+ 2^32 before it wraps. Each overflow sets UIF and, with UIE, raises
+ TIMx_IRQHandler at the next model step; EGR UG does not, the firmware
+ only issues it with URS set. Timers do not count in Stop.
+
+ With UDE each overflow also makes one transfer on the DMA1 stream of
+ the update request (TIM2_UP: stream 1 or 7 channel 3, TIM5_UP: stream
+ 0 or 6 channel 6), memory to a register of the timer, after the
+ preload registers are latched: a CCR1 written by the DMA is the duty
+ of the next period, as on silicon. A stream on DMAR is a DMA burst
+ into the registers DCR selects. Circular streams reload NDTR;
+ HTIF/TCIF are set at half and end and raise the stream interrupt at
+ the next model step. LIFCR/HIFCR clear LISR/HISR.
+
+ MODEL_VCD=<file> dumps GPIOA 0/5/6-9, PC13, the channel 1 outputs of
+ TIM2 and TIM5 with their PSC/ARR/CCR1 values, and one wire per
+ interrupt handler (host/vcd.h). GPIO levels are sampled every model
+ step (20-80 us); a pin in alternate function follows its timer
+ channel edge by edge. Times are ns since model_start().
+*/
+
+enum { MODEL_TR_TIM2 = 0, MODEL_TR_TIM5, MODEL_TR_TIMERS };
+
+typedef struct {
+	TIM_TypeDef *tim;
+	uint32_t     sig;
+	uint32_t     sig_psc, sig_arr, sig_ccr;   // PSC, ARR, CCR1 in use
+	int          running;
+	int          irq;             // update interrupt raised, not yet taken
+	int          uif;             // update event not yet shown in SR
+	uint32_t     arr, ccr;        // ARR, CCR1 in use
+	uint64_t     start_ps;        // update event that opened the period
+	uint64_t     tick_ps, period_ps;
+	uint64_t     edge_ps[2];      // edges of this period, in time order
+	int8_t       edge_to[2];      // level after the edge, -1: toggle
+	uint32_t     nedges, next;
+	uint32_t     level;           // OC1REF
+} model_tim_trace_t;
+
+typedef struct {
+	GPIO_TypeDef *gpio;
+	uint8_t       pin;
+	const char   *name;
+	uint32_t      sig;
+} model_pin_trace_t;
+
+static pthread_mutex_t   model_tr_lock = PTHREAD_MUTEX_INITIALIZER;
+static model_tim_trace_t model_tr_tim[MODEL_TR_TIMERS];
+
+typedef struct {
+	uint32_t ndtr0;           // NDTR as programmed, reloaded in circular mode
+	int      on;              // EN seen set
+	int      irq;             // HTIF/TCIF raised under HTIE/TCIE, not yet taken
+} model_dma_t;
+
+static model_dma_t model_dma1[8];
+
+// Streams and channel of the update DMA request, per traced timer (RM0390 table 28)
+static const struct { uint8_t stream[2], chsel; } model_tim_up_dma[MODEL_TR_TIMERS] = {
+	{ { 1, 7 }, 3 },          // TIM2_UP
+	{ { 0, 6 }, 6 },          // TIM5_UP
+};
+static model_pin_trace_t model_tr_pin[] = {
+	{ &model_GPIOA,  0, "PA0",  0 },
+	{ &model_GPIOA,  5, "PA5",  0 },
+	{ &model_GPIOA,  6, "PA6",  0 },
+	{ &model_GPIOA,  7, "PA7",  0 },
+	{ &model_GPIOA,  8, "PA8",  0 },
+	{ &model_GPIOA,  9, "PA9",  0 },
+	{ &model_GPIOC, 13, "PC13", 0 },
+};
+#define MODEL_TR_PINS (sizeof model_tr_pin / sizeof model_tr_pin[0])
+static uint32_t          model_tr_irq[MODEL_IRQ_COUNT];   // wire + 1, 0: not traced
+static uint32_t          model_tr_systick;
+static uint64_t          model_tr_last_ps;
+
+// Timer whose channel 1 drives the pin in its current mode, -1 if none (AF1 TIM2_CH1, AF2 TIM5_CH1)
+static int model_tr_pin_timer(const model_pin_trace_t *p){
+	uint32_t af;
+	if(((p->gpio->MODER >> (2U * p->pin)) & 3U) != 2U) return -1;
+	af = (p->gpio->AFR[p->pin / 8U] >> (4U * (p->pin % 8U))) & 0xFU;
+	if(p->gpio != &model_GPIOA) return -1;
+	if(af == 1U && (p->pin == 0 || p->pin == 5)) return MODEL_TR_TIM2;
+	if(af == 2U && p->pin == 0) return MODEL_TR_TIM5;
+	return -1;
+}
+
+// Channel 1 output: OC1REF through CC1P, low while CC1E is off
+static uint32_t model_tr_tim_out(const model_tim_trace_t *t){
+	if((t->tim->CCER & TIM_CCER_CC1E) == 0) return 0;
+	return t->level ^ ((t->tim->CCER & TIM_CCER_CC1P) ? 1U : 0U);
+}
+
+static void model_tr_tim_emit(model_tim_trace_t *t, uint64_t at_ps){
+	uint32_t i, out = model_tr_tim_out(t);
+	vcd_change(at_ps / 1000U, t->sig, out);
+	for(i=0; i<MODEL_TR_PINS; i++)
+		if(model_tr_pin_timer(&model_tr_pin[i]) == (int)(t - model_tr_tim))
+			vcd_change(at_ps / 1000U, model_tr_pin[i].sig, out);
+}
+
+// Edges of the current period for the CCR1 in use and the OC1M mode
+static void model_tr_tim_edges(model_tim_trace_t *t){
+	uint32_t mode = (t->tim->CCMR1 & TIM_CCMR1_OC1M) >> 4;
+	uint64_t match = t->start_ps + (uint64_t)t->ccr * t->tick_ps;
+
+	t->nedges = t->next = 0;
+	switch(mode){
+		case 1: case 2: case 3:                     // active / inactive / toggle on match
+			if(t->ccr > t->arr) break;
+			t->edge_ps[0] = match;
+			t->edge_to[0] = mode == 3 ? -1 : (int8_t)(mode == 1);
+			t->nedges = 1;
+			break;
+		case 4: case 5:                             // forced inactive / active
+			t->edge_ps[0] = t->start_ps;
+			t->edge_to[0] = (int8_t)(mode == 5);
+			t->nedges = 1;
+			break;
+		case 6: case 7:                             // PWM 1 / 2: active / inactive while CNT < CCR1
+			t->edge_ps[0] = t->start_ps;
+			t->edge_to[0] = (int8_t)((t->ccr > 0) == (mode == 6));
+			t->nedges = 1;
+			if(t->ccr > 0 && t->ccr <= t->arr){
+				t->edge_ps[1] = match;
+				t->edge_to[1] = (int8_t)(mode == 7);
+				t->nedges = 2;
+			}
+			break;
+		default:                                    // frozen
+			break;
+	}
+}
+
+// Update event: latch the registers and lay out the edges of the period
+static void model_tr_tim_period(model_tim_trace_t *t, uint64_t at_ps){
+	uint32_t hz = model_apb1_timer_hz();
+
+	t->start_ps  = at_ps;
+	t->tick_ps   = ((uint64_t)(t->tim->PSC & 0xFFFFU) + 1U) * 1000000000000ULL / (hz ? hz : 1U);
+	if(t->tick_ps == 0) t->tick_ps = 1;
+	t->arr       = t->tim->ARR;
+	t->ccr       = t->tim->CCR1;
+	t->period_ps = ((uint64_t)t->arr + 1U) * t->tick_ps;
+	vcd_change(at_ps / 1000U, t->sig_psc, t->tim->PSC & 0xFFFFU);
+	vcd_change(at_ps / 1000U, t->sig_arr, t->arr);
+	vcd_change(at_ps / 1000U, t->sig_ccr, t->ccr);
+	model_tr_tim_edges(t);
+}
+
+// Flags of stream n in LISR/HISR, as given for stream 0
+static void model_dma_flag(uint32_t n, uint32_t bits){
+	static const uint8_t shift[4] = { 0, 6, 16, 22 };
+	__atomic_fetch_or((uint32_t *)(n < 4U ? &DMA1->LISR : &DMA1->HISR), bits << shift[n & 3U], __ATOMIC_SEQ_CST);
+}
+
+// Clear requests, and the NDTR each enabled stream started with
+static void model_dma_sync(void){
+	uint32_t n, clr;
+	if((clr = __atomic_exchange_n((uint32_t *)&DMA1->LIFCR, 0, __ATOMIC_SEQ_CST)) != 0)
+		__atomic_fetch_and((uint32_t *)&DMA1->LISR, ~clr, __ATOMIC_SEQ_CST);
+	for(n=0; n<8; n++){
+		if((model_DMA1_Stream[n].CR & DMA_SxCR_EN) == 0){
+			model_dma1[n].on = 0;
+		} else if(!model_dma1[n].on){
+			model_dma1[n].on = 1;
+			model_dma1[n].ndtr0 = model_DMA1_Stream[n].NDTR;
+		}
+	}
+}
+
+/*
+ One update DMA request of timer t: the transfer on the first enabled
+ stream mapped to it. A stream pointed at DMAR makes a DMA burst, DBL + 1
+ transfers to the registers from DBA on (DCR), as the timer issues them.
+*/
+static void model_tr_tim_dma(model_tim_trace_t *t){
+	uint32_t i, n, k, size, at, burst = 1, chsel = model_tim_up_dma[t - model_tr_tim].chsel;
+	uintptr_t dst;
+	DMA_Stream_TypeDef *s;
+	model_dma_t *d;
+
+	for(i=0; i<2; i++){
+		n = model_tim_up_dma[t - model_tr_tim].stream[i];
+		s = &model_DMA1_Stream[n];
+		d = &model_dma1[n];
+		if((s->CR & DMA_SxCR_EN) == 0 || ((s->CR & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) != chsel) continue;
+		if(!d->on){
+			d->on = 1;
+			d->ndtr0 = s->NDTR;
+		}
+		if(s->PAR == (uintptr_t)&t->tim->DMAR) burst = ((t->tim->DCR & TIM_DCR_DBL) >> TIM_DCR_DBL_Pos) + 1U;
+		for(k=0; k<burst; k++){
+			if(s->NDTR == 0) return;
+			size = 1U << ((s->CR >> DMA_SxCR_PSIZE_Pos) & 3U);
+			at   = (s->CR & DMA_SxCR_MINC) ? (d->ndtr0 - s->NDTR) * size : 0U;
+			dst  = s->PAR;
+			if(s->PAR == (uintptr_t)&t->tim->DMAR)
+				dst = (uintptr_t)((volatile uint32_t *)t->tim + ((t->tim->DCR & TIM_DCR_DBA) >> TIM_DCR_DBA_Pos) + k);
+			if(dst >= (uintptr_t)t->tim && dst + size <= (uintptr_t)(t->tim + 1))
+				memcpy((void *)dst, (const void *)(s->M0AR + at), size);
+			s->NDTR--;
+			if(s->NDTR == d->ndtr0 / 2U){
+				model_dma_flag(n, DMA_LISR_HTIF0);
+				if(s->CR & DMA_SxCR_HTIE) d->irq = 1;
+			}
+			if(s->NDTR == 0){
+				model_dma_flag(n, DMA_LISR_TCIF0);
+				if(s->CR & DMA_SxCR_TCIE) d->irq = 1;
+				if(s->CR & DMA_SxCR_CIRC){
+					s->NDTR = d->ndtr0;
+				} else {
+					__atomic_fetch_and((uint32_t *)&s->CR, ~DMA_SxCR_EN, __ATOMIC_SEQ_CST);
+					d->on = 0;
+					return;
+				}
+			}
+		}
+		return;
+	}
+}
+
+// UIF for the next firmware access, the update interrupt when UIE enables it, the DMA request with UDE
+static void model_tr_tim_update(model_tim_trace_t *t){
+	t->uif = 1;
+	if(t->tim->DIER & TIM_DIER_UIE) t->irq = 1;
+	if(t->tim->DIER & TIM_DIER_UDE) model_tr_tim_dma(t);
+}
+
+/*
+ ARR without ARPE and CCR1 without OC1PE apply mid-period. The counter
+ only meets an ARR below it after the wrap at 2^32; a compare match
+ already passed does not happen again, except that PWM levels follow
+ CNT < CCR1 at once.
+*/
+static void model_tr_tim_direct(model_tim_trace_t *t, uint64_t now_ps){
+	uint64_t cnt = (now_ps - t->start_ps) / t->tick_ps;
+	uint32_t mode, i;
+
+	if((t->tim->CR1 & TIM_CR1_ARPE) == 0 && t->tim->ARR != t->arr){
+		t->arr = t->tim->ARR;
+		t->period_ps = (t->arr >= cnt ? (uint64_t)t->arr + 1U : 1ULL << 32) * t->tick_ps;
+		vcd_change(now_ps / 1000U, t->sig_arr, t->arr);
+	}
+	if((t->tim->CCMR1 & TIM_CCMR1_OC1PE) == 0 && t->tim->CCR1 != t->ccr){
+		t->ccr = t->tim->CCR1;
+		vcd_change(now_ps / 1000U, t->sig_ccr, t->ccr);
+		mode = (t->tim->CCMR1 & TIM_CCMR1_OC1M) >> 4;
+		model_tr_tim_edges(t);
+		for(i=0; i<t->nedges; i++){
+			if(t->edge_ps[i] >= now_ps) break;
+			if(mode >= 6) t->edge_ps[i] = now_ps;
+			else          t->next = i + 1U;
+		}
+	}
+}
+
+static uint64_t model_tr_tim_due(const model_tim_trace_t *t){
+	if(!t->running) return UINT64_MAX;
+	return t->next < t->nedges ? t->edge_ps[t->next] : t->start_ps + t->period_ps;
+}
+
+/*
+ Every timer edge up to now_ps, the timers merged in time order so
+ the dump stays monotonic. Caller holds model_tr_lock.
+*/
+static void model_tr_advance(uint64_t now_ps){
+	model_tim_trace_t *t, *first;
+	uint64_t due, best, shift;
+	uint32_t i;
+
+	model_dma_sync();
+	for(i=0; i<MODEL_TR_TIMERS; i++){
+		t = &model_tr_tim[i];
+		if(model_stopped && t->running && now_ps > model_tr_last_ps){
+			shift = now_ps - model_tr_last_ps;          // no timer clock in Stop
+			t->start_ps += shift;
+			t->edge_ps[0] += shift;
+			t->edge_ps[1] += shift;
+		}
+		if(t->tim->EGR & TIM_EGR_UG){                  // re-initialise: counter back to 0, no UIF (URS)
+			t->tim->EGR = 0;
+			if(t->running) model_tr_tim_period(t, now_ps);
+		}
+		if(!t->running && (t->tim->CR1 & TIM_CR1_CEN)){
+			t->running = 1;
+			model_tr_tim_period(t, now_ps);
+		}
+		if(t->running && (t->tim->CR1 & TIM_CR1_CEN) == 0) t->running = 0;
+	}
+	model_tr_last_ps = now_ps;
+
+	for(;;){
+		first = 0;
+		best = UINT64_MAX;
+		for(i=0; i<MODEL_TR_TIMERS; i++){
+			due = model_tr_tim_due(&model_tr_tim[i]);
+			if(due < best){ best = due; first = &model_tr_tim[i]; }
+		}
+		if(first == 0 || best > now_ps) break;
+		if(first->next < first->nedges){
+			first->level = first->edge_to[first->next] < 0 ? first->level ^ 1U : (uint32_t)first->edge_to[first->next];
+			first->next++;
+			model_tr_tim_emit(first, best);
+		} else {
+			model_tr_tim_period(first, best);
+			model_tr_tim_update(first);
+		}
+	}
+	for(i=0; i<MODEL_TR_TIMERS; i++){
+		t = &model_tr_tim[i];
+		if(!t->running) continue;
+		model_tr_tim_direct(t, now_ps);
+		t->tim->CNT = (uint32_t)((now_ps - t->start_ps) / t->tick_ps);
+	}
+}
+
+static uint64_t model_tr_now_ps(void){
+	return (model_now_ns() - model_t0_ns) * 1000ULL;
+}
+
+// Model step: timer edges, then the sampled pin levels
+static void model_trace_pins(void){
+	uint32_t i;
+	uint64_t now_ps = model_tr_now_ps();
+	int tim;
+	model_tr_advance(now_ps);
+	for(i=0; i<MODEL_TR_PINS; i++){
+		model_pin_trace_t *p = &model_tr_pin[i];
+		uint32_t mode = (p->gpio->MODER >> (2U * p->pin)) & 3U;
+		tim = model_tr_pin_timer(p);
+		if(tim >= 0)        vcd_change(now_ps / 1000U, p->sig, model_tr_tim_out(&model_tr_tim[tim]));
+		else if(mode == 1U) vcd_change(now_ps / 1000U, p->sig, (p->gpio->ODR >> p->pin) & 1U);
+		else                vcd_change(now_ps / 1000U, p->sig, (p->gpio->IDR >> p->pin) & 1U);
+	}
+}
+
+static void model_trace_step(void){
+	pthread_mutex_lock(&model_tr_lock);
+	if(vcd_active()) model_trace_pins();
+	else             model_tr_advance(model_tr_now_ps());
+	pthread_mutex_unlock(&model_tr_lock);
+}
+
+// Update and update-DMA interrupts raised since the last step, taken outside model_tr_lock
+static void model_tim_irqs(void){
+	if(__atomic_exchange_n(&model_tr_tim[MODEL_TR_TIM2].irq, 0, __ATOMIC_SEQ_CST)) model_call(TIM2_IRQn, TIM2_IRQHandler);
+	if(__atomic_exchange_n(&model_tr_tim[MODEL_TR_TIM5].irq, 0, __ATOMIC_SEQ_CST)) model_call(TIM5_IRQn, TIM5_IRQHandler);
+	if(__atomic_exchange_n(&model_dma1[0].irq, 0, __ATOMIC_SEQ_CST)) model_call(DMA1_Stream0_IRQn, DMA1_Stream0_IRQHandler);
+	if(__atomic_exchange_n(&model_dma1[1].irq, 0, __ATOMIC_SEQ_CST)) model_call(DMA1_Stream1_IRQn, DMA1_Stream1_IRQHandler);
+	if(__atomic_exchange_n(&model_dma1[6].irq, 0, __ATOMIC_SEQ_CST)) model_call(DMA1_Stream6_IRQn, DMA1_Stream6_IRQHandler);
+	if(__atomic_exchange_n(&model_dma1[7].irq, 0, __ATOMIC_SEQ_CST)) model_call(DMA1_Stream7_IRQn, DMA1_Stream7_IRQHandler);
+}
+
+/*
+ Every firmware GPIO access (host/stm32f446xx.h) records the levels the
+ previous one left. A busy loop can switch pins many times between two
+ model steps; this way the dump holds every level in the order the
+ firmware wrote it, whatever the timing of the run.
+*/
+void model_gpio_access(void){
+	if(model_running && vcd_active()) model_trace_step();
+}
+
+/*
+ Every firmware TIM2/TIM5 access sees CNT and UIF as of now. UIF only
+ reaches SR here, in the thread about to access it: an update the model
+ thread finds between this and a "SR = ~TIM_SR_UIF" is shown by the next
+ access instead of being cleared with the old one. SR is rc_w0, the
+ model raises no flag but UIF, the other bits of that write are dropped.
+*/
+void model_tim_access(void){
+	uint32_t i;
+	if(!model_running) return;
+	model_trace_step();
+	for(i=0; i<MODEL_TR_TIMERS; i++){
+		model_tim_trace_t *t = &model_tr_tim[i];
+		uint32_t uif = __atomic_exchange_n(&t->uif, 0, __ATOMIC_SEQ_CST) ? TIM_SR_UIF : 0U;
+		__atomic_fetch_and((uint32_t *)&t->tim->SR, TIM_SR_UIF, __ATOMIC_SEQ_CST);
+		__atomic_fetch_or((uint32_t *)&t->tim->SR, uif, __ATOMIC_SEQ_CST);
+	}
+}
+
+// Handler entry / exit on its wire
+static void model_trace_irq(int irq, uint32_t active){
+	uint32_t sig;
+	uint64_t now_ps;
+	if(!vcd_active()) return;
+	sig = irq < 0 ? model_tr_systick : model_tr_irq[irq];
+	if(sig == 0) return;
+	pthread_mutex_lock(&model_tr_lock);
+	now_ps = model_tr_now_ps();
+	model_tr_advance(now_ps);
+	vcd_change(now_ps / 1000U, sig - 1U, active);
+	pthread_mutex_unlock(&model_tr_lock);
+}
+
+static void model_trace_open(const char *path){
+	static const struct { int irq; const char *name; } irqs[] = {
+		{ EXTI0_IRQn,        "EXTI0" },
+		{ 23,                "EXTI9_5" },
+		{ EXTI15_10_IRQn,    "EXTI15_10" },
+		{ RTC_WKUP_IRQn,     "RTC_WKUP" },
+		{ DMA1_Stream0_IRQn, "DMA1_Stream0" },
+		{ DMA1_Stream1_IRQn, "DMA1_Stream1" },
+		{ DMA1_Stream6_IRQn, "DMA1_Stream6" },
+		{ DMA1_Stream7_IRQn, "DMA1_Stream7" },
+		{ USART2_IRQn,       "USART2" },
+		{ TIM2_IRQn,         "TIM2" },
+		{ TIM5_IRQn,         "TIM5" },
+	};
+	uint32_t i;
+	memset(model_tr_tim, 0, sizeof model_tr_tim);
+	memset(model_dma1, 0, sizeof model_dma1);
+	model_tr_tim[MODEL_TR_TIM2].tim = &model_TIM2;
+	model_tr_tim[MODEL_TR_TIM5].tim = &model_TIM5;
+	model_tr_last_ps = 0;
+	if(path == 0 || *path == 0 || vcd_open(path) != 0) return;
+
+	for(i=0; i<MODEL_TR_PINS; i++) model_tr_pin[i].sig = vcd_wire("gpio", model_tr_pin[i].name, 1);
+	model_tr_tim[MODEL_TR_TIM2].sig = vcd_wire("tim", "TIM2_CH1", 1);
+	model_tr_tim[MODEL_TR_TIM5].sig = vcd_wire("tim", "TIM5_CH1", 1);
+	model_tr_tim[MODEL_TR_TIM2].sig_psc = vcd_wire("tim", "TIM2_PSC", 16);
+	model_tr_tim[MODEL_TR_TIM2].sig_arr = vcd_wire("tim", "TIM2_ARR", 32);
+	model_tr_tim[MODEL_TR_TIM2].sig_ccr = vcd_wire("tim", "TIM2_CCR1", 32);
+	model_tr_tim[MODEL_TR_TIM5].sig_psc = vcd_wire("tim", "TIM5_PSC", 16);
+	model_tr_tim[MODEL_TR_TIM5].sig_arr = vcd_wire("tim", "TIM5_ARR", 32);
+	model_tr_tim[MODEL_TR_TIM5].sig_ccr = vcd_wire("tim", "TIM5_CCR1", 32);
+	memset(model_tr_irq, 0, sizeof model_tr_irq);
+	model_tr_systick = vcd_wire("irq", "SysTick", 1) + 1U;
+	for(i=0; i<sizeof irqs / sizeof irqs[0]; i++)
+		model_tr_irq[irqs[i].irq] = vcd_wire("irq", irqs[i].name, 1) + 1U;
+	vcd_begin();
+	vcd_change(0, model_tr_systick - 1U, 0);
+	for(i=0; i<sizeof irqs / sizeof irqs[0]; i++) vcd_change(0, model_tr_irq[irqs[i].irq] - 1U, 0);
+}
+
+static void model_isr(int irq, void (*handler)(void)){
+	model_vt_busy++;
+	model_trace_irq(irq, 1);
+	handler();
+	model_trace_irq(irq, 0);
+	model_vt_busy--;
+}
+
+static void model_trace_close(void){
+	if(!vcd_active()) return;
+	pthread_mutex_lock(&model_tr_lock);
+	model_tr_advance(model_tr_now_ps());
+	vcd_close();
+	pthread_mutex_unlock(&model_tr_lock);
+}
+
+/////////////////////////////// Hardware thread ///////////////////////////////
+
+static uint32_t model_bcd(uint32_t v){ return ((v / 10U) << 4) | (v % 10U); }
+
+static void model_status(__IO uint32_t *reg, uint32_t bits, uint32_t set){
+	if(set) __atomic_fetch_or((uint32_t *)reg, bits, __ATOMIC_SEQ_CST);
+	else    __atomic_fetch_and((uint32_t *)reg, ~bits, __ATOMIC_SEQ_CST);
+}
+
+/*
+ RTC on LSI (32 kHz nominal): calendar time and sub-seconds from the wall
+ clock since INIT was left, the wakeup timer raises WUTF / EXTI line 22.
+*/
+static void model_rtc(uint64_t now){
+	uint64_t prediv_a, prediv_s, apre, secs, period;
+	uint32_t sel;
+	if((model_RCC.BDCR & RCC_BDCR_RTCEN) == 0 || (RTC->ISR & RTC_ISR_INIT)){
+		model_rtc_t0_ns = now;
+		model_wut_due_ns = 0;
+		RTC->SSR = RTC->PRER & RTC_PRER_PREDIV_S;   // counts down from PREDIV_S once INIT is left
+		return;
+	}
+	prediv_a = ((RTC->PRER >> RTC_PRER_PREDIV_A_Pos) & 0x7FU) + 1U;
+	prediv_s = (RTC->PRER & RTC_PRER_PREDIV_S) + 1U;
+	apre = (now - model_rtc_t0_ns) * MODEL_LSI_HZ / prediv_a / 1000000000ULL;
+	secs = apre / prediv_s;
+	RTC->SSR = (uint32_t)(prediv_s - 1U - apre % prediv_s);
+	RTC->TR  = model_bcd((uint32_t)(secs % 60U)) | (model_bcd((uint32_t)(secs / 60U % 60U)) << RTC_TR_MNU_Pos) |
+	           (model_bcd((uint32_t)(secs / 3600U % 24U)) << RTC_TR_HU_Pos);
+	model_status(&RTC->ISR, RTC_ISR_RSF, 1);
+
+	if((RTC->CR & RTC_CR_WUTE) == 0){
+		model_wut_due_ns = 0;
+		return;
+	}
+	sel = RTC->CR & RTC_CR_WUCKSEL;
+	period = sel < 4U ? ((RTC->WUTR & 0xFFFFU) + 1ULL) * (16U >> sel) * 1000000000ULL / MODEL_LSI_HZ
+	                  : ((RTC->WUTR & 0xFFFFU) + 1ULL) * 1000000000ULL;
+	if(model_wut_due_ns == 0) model_wut_due_ns = now + period;
+	while(now >= model_wut_due_ns){
+		__atomic_fetch_or((uint32_t *)&RTC->ISR, RTC_ISR_WUTF, __ATOMIC_SEQ_CST);
+		if(EXTI->RTSR & EXTI_RTSR_TR22){
+			EXTI->PR |= EXTI_PR_PR22;
+			if(EXTI->IMR & EXTI_IMR_MR22) model_call(RTC_WKUP_IRQn, RTC_WKUP_IRQHandler);
+		}
+		model_wut_due_ns += period;
+	}
+}
+
+static uint32_t model_pclk1_hz(void){
+	static const uint8_t presc[8] = {0,0,0,0,1,2,3,4};
+	return model_ahb_hz() >> presc[((model_RCC.CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos) & 7U];
+}
+
+// DMA1 Stream6 refills an empty TDR; the last item clears EN, sets TCIF6 and raises its interrupt on TCIE
+static void model_uart_dma_fill(void){
+	DMA_Stream_TypeDef *s = DMA1_Stream6;
+	if(model_uart_tdr >= 0 || (s->CR & DMA_SxCR_EN) == 0 || s->PAR != (uintptr_t)&USART2->DR ||
+	   (USART2->CR3 & USART_CR3_DMAT) == 0 || s->NDTR == 0) return;
+	if(!model_dma1[6].on){
+		model_dma1[6].on = 1;
+		model_dma1[6].ndtr0 = s->NDTR;
+	}
+	model_uart_tdr = *(const uint8_t *)(s->M0AR + ((s->CR & DMA_SxCR_MINC) ? model_dma1[6].ndtr0 - s->NDTR : 0U));
+	model_status(&USART2->SR, USART_SR_TXE, 0);
+	if(--s->NDTR != 0) return;
+	model_dma1[6].on = 0;
+	model_status(&s->CR, DMA_SxCR_EN, 0);
+	model_status(&DMA1->HISR, DMA_HISR_TCIF6, 1);
+	if(s->CR & DMA_SxCR_TCIE) model_call(DMA1_Stream6_IRQn, DMA1_Stream6_IRQHandler);
+}
+
+/*
+ USART2 TX fed by DMA1 Stream6: the DMA keeps TDR full, TDR moves to
+ the shift register when the previous byte is out and each byte takes
+ 10 bit times at PCLK1 / BRR on its way to MODEL_UART (stdout by
+ default). The DMA is done (TCIF6) with up to two bytes still in the
+ USART; TC sets after the last stop bit and raises USART2_IRQHandler
+ while TCIE is on. TC only clears by a firmware write of 0 (rc_w0), as
+ on silicon before a DMA transfer. Stop takes the APB1 clock: a byte
+ on the wire holds until the wake-up. HIFCR acts as write-1-to-clear on
+ HISR.
+*/
+static void model_uart_dma(uint64_t now){
+	uint32_t brr = USART2->BRR & 0xFFFFU, hz = model_pclk1_hz();
+	uint64_t byte_ns;
+
+	if(DMA1->HIFCR){
+		__atomic_fetch_and((uint32_t *)&DMA1->HISR, ~DMA1->HIFCR, __ATOMIC_SEQ_CST);
+		DMA1->HIFCR = 0;
+	}
+	if((DMA1_Stream6->CR & DMA_SxCR_EN) == 0) model_dma1[6].on = 0;
+	if(model_stopped && model_uart_due_ns) model_uart_due_ns += now - model_uart_last_ns;
+	model_uart_last_ns = now;
+	if(model_stopped) return;
+	if(brr == 0 || (USART2->CR1 & (USART_CR1_UE | USART_CR1_TE)) != (USART_CR1_UE | USART_CR1_TE)){
+		model_uart_due_ns = 0;
+		model_uart_tdr = model_uart_shift = -1;
+		return;
+	}
+	byte_ns = 10ULL * brr * 1000000000ULL / hz;
+	for(;;){
+		model_uart_dma_fill();
+		if(model_uart_shift < 0 && model_uart_tdr >= 0){
+			model_uart_due_ns = (model_uart_due_ns ? model_uart_due_ns : now) + byte_ns;   // back to back, or from idle
+			model_uart_shift = model_uart_tdr;
+			model_uart_tdr = -1;
+			model_status(&USART2->SR, USART_SR_TXE, 1);
+			continue;
+		}
+		if(model_uart_shift < 0 || now < model_uart_due_ns) break;
+		fputc(model_uart_shift, model_uart_out);
+		USART2->DR = (uint32_t)model_uart_shift;
+		model_uart_shift = -1;
+		if(model_uart_tdr < 0) model_uart_dma_fill();
+		if(model_uart_tdr < 0){                          // line idle after this stop bit
+			fflush(model_uart_out);
+			model_uart_due_ns = 0;
+			model_status(&USART2->SR, USART_SR_TC, 1);
+		}
+	}
+	if((USART2->SR & USART_SR_TC) && (USART2->CR1 & USART_CR1_TCIE)) model_call(USART2_IRQn, USART2_IRQHandler);
+}
+
+/*
+ Oscillators and switches are ready as soon as they are requested, also
+ for the firmware RCC access that polls them (host/stm32f446xx.h): a
+ ready loop never waits for the next model step, which on a single host
+ CPU can be a whole time slice away. Only the status bits are touched,
+ atomically, so a firmware RMW of the enable bits in the same register
+ is never lost.
+*/
+void model_rcc_access(void){
+	uint32_t cfgr = model_RCC.CFGR;
+	model_status(&model_RCC.CR, RCC_CR_HSIRDY, model_RCC.CR & RCC_CR_HSION);
+	model_status(&model_RCC.CR, RCC_CR_HSERDY, model_RCC.CR & RCC_CR_HSEON);
+	model_status(&model_RCC.CR, RCC_CR_PLLRDY, model_RCC.CR & RCC_CR_PLLON);
+	// SWS follows SW in one step: the clock tree never sees HSI in between
+	while(!__atomic_compare_exchange_n((uint32_t *)&model_RCC.CFGR, &cfgr,
+	                                   (cfgr & ~RCC_CFGR_SWS) | ((cfgr & RCC_CFGR_SW) << 2), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+	model_status(&PWR->CSR, PWR_CSR_VOSRDY, 1);
+	model_status(&model_RCC.CSR, RCC_CSR_LSIRDY, model_RCC.CSR & RCC_CSR_LSION);
+}
+
+static void model_step(void){
+	uint64_t now = model_now_ns(), cyc, frac;
+	uint32_t load;
+
+	model_rcc_access();
+	model_status(&RTC->ISR, RTC_ISR_INITF, RTC->ISR & RTC_ISR_INIT);
+	model_status(&RTC->ISR, RTC_ISR_WUTWF, (RTC->CR & RTC_CR_WUTE) == 0);
+	model_rtc(now);
+	model_uart_dma(now);
+
+	pthread_mutex_lock(&model_lock);
+	if(!model_stopped && now > model_last_ns){
+		// The fraction carries over: model_cycles() between two steps never goes back
+		frac = (now - model_last_ns) * model_core_hz() + model_cyc_rem;
+		model_cyc += frac / 1000000000ULL;
+		model_cyc_rem = frac % 1000000000ULL;
+		model_last_ns = now;
+	}
+	cyc = model_cyc;
+	model_dwt_sync(cyc);
+	pthread_mutex_unlock(&model_lock);
+
+	if(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk){
+		load = (SysTick->LOAD & SysTick_LOAD_RELOAD_Msk) + 1U;
+		if(model_systick_due == 0) model_systick_due = cyc + load;
+		while(cyc >= model_systick_due){
+			if(model_primask){                   // stays pending until PRIMASK clears
+				model_wakeups++;
+				break;
+			}
+			SysTick->CTRL |= SysTick_CTRL_COUNTFLAG_Msk;
+			if((SysTick->CTRL & SysTick_CTRL_TICKINT_Msk) && SysTick_Handler) model_isr(-1, SysTick_Handler);
+			model_systick_due += load;
+		}
+		// Down-counter position, LOAD..0
+		SysTick->VAL = cyc < model_systick_due ? (uint32_t)(model_systick_due - cyc - 1U) % load : 0U;
+	} else {
+		model_systick_due = 0;
+	}
+
+	while(model_next_input < model_ninputs &&
+	      now - model_t0_ns >= model_inputs[model_next_input].at_ns){
+		model_set_input(model_inputs[model_next_input].port,
+		                model_inputs[model_next_input].pin,
+		                model_inputs[model_next_input].level);
+		model_next_input++;
+	}
+	model_trace_step();
+	model_tim_irqs();
+}
+
+static void *model_hw(void *arg){
+	struct timespec ts = {0, MODEL_STEP_NS};
+	(void)arg;
+#ifdef __linux__
+	prctl(PR_SET_TIMERSLACK, 1UL);       // 20 us steps, not the default 50 us slack on top
+#endif
+	while(model_running){
+		model_step();
+		if(model_budget_ns && model_now_ns() - model_t0_ns >= model_budget_ns){
+			model_finish();
+			exit(0);
+		}
+		nanosleep(&ts, 0);
+	}
+	return 0;
+}
+
+/*
+ Virtual time, for model_run(): no model thread, the firmware thread
+ runs the steps. The experiments are built with
+ -fsanitize-coverage=trace-pc, so every basic block they execute calls
+ __sanitizer_cov_trace_pc(), which charges MODEL_VT_BLOCK_CYCLES core
+ cycles at the current clock and runs the model step once a step
+ period (MODEL_STEP_NS) has passed. __WFI() steps on until a request
+ comes. Interrupts are taken between two basic blocks of the firmware
+ and never nest. A run depends only on the firmware and the input
+ script, not on the host: the same dump every time.
+*/
+static void model_vt_step(void){
+	model_vt_busy++;
+	model_step();
+	model_vt_block_ps = (uint64_t)MODEL_VT_BLOCK_CYCLES * 1000000000000ULL / model_core_hz();
+	model_vt_step_ps = (model_vt_ps / (MODEL_STEP_NS * 1000U) + 1U) * MODEL_STEP_NS * 1000U;
+	model_vt_busy--;
+	if(model_budget_ns && model_vt_ps >= model_budget_ns * 1000U){
+		model_finish();
+		exit(0);
+	}
+}
+
+void __sanitizer_cov_trace_pc(void){
+	if(!model_virtual || !model_running) return;
+	model_vt_ps += model_vt_block_ps;
+	if(model_vt_ps >= model_vt_step_ps && model_vt_busy == 0) model_vt_step();
+}
+
+void model_reset(void){
+	memset((void *)&model_GPIOA, 0, sizeof(model_GPIOA));
+	memset((void *)&model_GPIOB, 0, sizeof(model_GPIOB));
+	memset((void *)&model_GPIOC, 0, sizeof(model_GPIOC));
+	memset((void *)&model_RCC, 0, sizeof(model_RCC));
+	memset((void *)&model_RTC, 0, sizeof(model_RTC));
+	memset((void *)&model_USART2, 0, sizeof(model_USART2));
+	memset((void *)&model_DMA1, 0, sizeof(model_DMA1));
+	memset((void *)model_DMA1_Stream, 0, sizeof(model_DMA1_Stream));
+	memset((void *)model_nvic_pending, 0, sizeof(model_nvic_pending));
+
+	// Reset values (RM0390)
+	model_GPIOA.MODER = 0xA8000000UL;              // PA13/14/15 debug pins
+	model_GPIOB.MODER = 0x00000280UL;
+	model_GPIOC.IDR   = 1UL << 13;                 // B1 released, external pull-up
+	RCC->CR        = RCC_CR_HSION | RCC_CR_HSIRDY | 0x80UL;
+	RCC->PLLCFGR   = 0x24003010UL;
+	PWR->CR        = PWR_CR_VOS;                   // Scale 1
+	RTC->PRER      = 0x007F00FFUL;
+	RTC->ISR       = 0x00000007UL;
+	SCB->VTOR      = 0;
+	SystemCoreClock = MODEL_HSI_HZ;
+
+	USART2->SR     = USART_SR_TXE | USART_SR_TC;
+
+	model_cyc = 0;
+	model_cyc_rem = 0;
+	model_cyccnt_base = 0;
+	model_uart_due_ns = 0;
+	model_uart_tdr = model_uart_shift = -1;
+	model_systick_due = 0;
+	model_next_input = 0;
+}
+
+void model_start(void){
+	const char *ms = getenv("MODEL_RUN_MS"), *uart = getenv("MODEL_UART"), *swo = getenv("MODEL_SWO_HZ");
+	model_budget_ns = (uint64_t)(ms ? strtoul(ms, 0, 10) : 200UL) * 1000000ULL;
+	model_parse_inputs(getenv("MODEL_INPUT"));
+	model_uart_out = uart ? fopen(uart, "w") : 0;
+	if(model_uart_out == 0) model_uart_out = stdout;
+	model_swo_hz = swo ? (uint32_t)strtoul(swo, 0, 10) : 0U;
+
+	model_vt_ps = 0;
+	model_vt_step_ps = MODEL_STEP_NS * 1000U;
+	model_vt_block_ps = (uint64_t)MODEL_VT_BLOCK_CYCLES * 1000000000000ULL / model_core_hz();
+	model_vt_busy = 0;
+	model_t0_ns = model_last_ns = model_now_ns();
+	model_trace_open(getenv("MODEL_VCD"));
+	model_running = 1;
+	if(!model_virtual) pthread_create(&model_thread, 0, model_hw, 0);
+}
+
+// End of run: report the visible pin state and the cycles spent
+void model_finish(void){
+	model_running = 0;
+	if(prof_dump) prof_dump();
+	if(model_uart_out) fflush(model_uart_out);
+	model_trace_close();
+	fflush(stdout);
+	fprintf(stderr, "model: %llu cycles, core %lu Hz, GPIOA ODR %04lx, GPIOC ODR %04lx\n",
+	        (unsigned long long)model_cycles(), (unsigned long)model_core_hz(),
+	        (unsigned long)(model_GPIOA.ODR & 0xFFFFU), (unsigned long)(model_GPIOC.ODR & 0xFFFFU));
+}
+
+int model_run(int (*fw_entry)(void)){
+	int rc;
+	model_virtual = 1;
+	model_reset();
+	model_start();
+	SystemInit();
+	rc = fw_entry();
+	model_finish();
+	return rc;
+}
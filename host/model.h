@@ -0,0 +1,59 @@
+#ifndef HOST_MODEL_H
+#define HOST_MODEL_H
+
+#include <stdint.h>
+
+/* Host peripheral model for NUCLEO-F446RE
+
+ The experiments run unchanged on the host: their main() is renamed to
+ fw_main() (-Dmain=fw_main) and started by host/model_main.c. The model
+ stands in for the hardware while fw_main() runs:
+
+ - RCC ready flags follow their enable bits (HSIRDY, PLLRDY, SWS), also
+   within a firmware polling loop
+ - DWT->CYCCNT counts core cycles at the clock RCC is configured for
+ - EXTI edges on GPIO inputs raise EXTIx_IRQHandler when unmasked
+ - SysTick fires SysTick_Handler at LOAD+1 core cycles
+ - interrupts raised under __disable_irq() are held until __enable_irq(),
+   those of a disabled NVIC line until NVIC_EnableIRQ()
+ - __WFI() blocks until the next interrupt; with SLEEPDEEP it is Stop:
+   PLL off, SYSCLK back on HSI, no core cycles until the wake-up
+ - RTC on LSI: calendar, sub-seconds and the wakeup timer (EXTI line 22)
+ - USART2 TX by DMA1 Stream6 at the BRR baud rate through TDR and the
+   shift register: TCIF6 and its interrupt, then USART TC and TCIE
+ - ITM port 0 goes to stdout; PORT[0] reads 0 while the previous
+   character is still on the SWO wire (MODEL_SWO_HZ)
+ - TIM2/TIM5 count at PSC/ARR with or without ARR/CCR1 preload (CNT,
+   EGR UG), set UIF at update events and raise TIMx_IRQHandler on UIE
+ - TIM2/TIM5 update DMA requests (UDE) move one item per update event
+   on their DMA1 stream, circular or not, with HTIF/TCIF and interrupts;
+   a DMA burst (DCR/DMAR) moves DBL + 1
+
+ model_run() runs fw_main() on virtual time: the experiments are built
+ with -fsanitize-coverage=trace-pc, every basic block of theirs costs
+ four core cycles (MODEL_VT_BLOCK_CYCLES) and the model steps between
+ blocks, so a run is the same on every host. The benches call
+ model_start() themselves and get a model thread on wall-clock time.
+
+ Environment:
+ MODEL_RUN_MS   budget of one run, virtual time under model_run(),
+                wall-clock otherwise; default 200
+ MODEL_INPUT    input script, "PC13@50=0,PC13@70=1" drives PC13 low at
+                50 ms and high again at 70 ms (B1 idles high)
+ MODEL_UART     file for the USART2 TX bytes, default stdout
+ MODEL_SWO_HZ   SWO bit rate ITM_SendChar() waits for, default no limit
+ MODEL_VCD      value change dump of GPIOA 0/5/6-9, PC13, TIM2/TIM5
+                channel 1 and its PSC/ARR/CCR1, the interrupt handlers (GTKWave)
+*/
+
+void     model_reset(void);
+void     model_start(void);
+void     model_finish(void);
+uint64_t model_cycles(void);
+uint32_t model_core_hz(void);
+uint32_t model_apb1_timer_hz(void);
+uint32_t model_apb2_timer_hz(void);
+void     model_set_input(char port, uint32_t pin, int level);
+int      model_run(int (*fw_entry)(void));
+
+#endif /* HOST_MODEL_H */
@@ -0,0 +1,9 @@
+#include "stm32f446xx.h"
+
+/* Host entry point: runs one experiment's main() (built as fw_main) on the model */
+
+int fw_main(void);
+
+int main(void){
+	return model_run(fw_main);
+}
@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "pattern.h"
+
+/* Blink pattern compiler and the TIM2 DMA-burst player on the host
+
+ pattern_bench
+
+ Compiler: fixed descriptions against hand-made tables (blink codes,
+ Morse), malformed ones must give 0, and random descriptions of +N, -N
+ and nested groups against their level runs: the table expanded back to
+ runs of high and low must give the same runs as the description.
+
+ Player: patterns on the host model with MODEL_VCD set, the TIM2_CH1
+ edges read back from the dump. A one-shot pattern must give the runs
+ of its table after the lead-in, end low and clear pattern_busy(); a
+ looped one must repeat them, and restart with the new PSC after a
+ switch to 16 MHz.
+
+ Exit code 1 when a table, a run or an edge is off.
+*/
+
+#define BENCH_STEPS     1024U
+#define BENCH_RUNS      4096U
+#define BENCH_RANDOM    2000U
+#define BENCH_EDGES     4096U
+
+typedef struct {
+	uint32_t level, ticks;
+} bench_run_t;
+
+typedef struct {
+	bench_run_t r[BENCH_RUNS];
+	uint32_t    n;
+} bench_runs_t;
+
+static pattern_step_t bench_table[BENCH_STEPS];
+
+// A run of level, merged with the last one of the same level, nothing for 0 ticks
+static void bench_add(bench_runs_t *rs, uint32_t level, uint32_t ticks){
+	if(ticks == 0U) return;
+	if(rs->n && rs->r[rs->n - 1U].level == level){
+		rs->r[rs->n - 1U].ticks += ticks;
+		return;
+	}
+	if(rs->n < BENCH_RUNS){
+		rs->r[rs->n].level = level;
+		rs->r[rs->n].ticks = ticks;
+		rs->n++;
+	}
+}
+
+static void bench_expand(const pattern_step_t *s, uint32_t n, bench_runs_t *rs){
+	uint32_t i;
+	for(i=0; i<n; i++){
+		bench_add(rs, 1, s[i].ccr1 > s[i].arr ? s[i].arr + 1U : s[i].ccr1);
+		bench_add(rs, 0, s[i].ccr1 > s[i].arr ? 0U : s[i].arr + 1U - s[i].ccr1);
+	}
+}
+
+static unsigned bench_same(const bench_runs_t *a, const bench_runs_t *b){
+	uint32_t i;
+	if(a->n != b->n) return 0;
+	for(i=0; i<a->n; i++)
+		if(a->r[i].level != b->r[i].level || a->r[i].ticks != b->r[i].ticks) return 0;
+	return 1;
+}
+
+// Random description, groups nested at most d deep; its runs appended to rs
+static int bench_gen(char *out, int len, uint32_t d, bench_runs_t *rs){
+	int at = 0, items = 1 + rand() % 5, i, k;
+	bench_runs_t body;
+	uint32_t ms, level, j;
+	for(i=0; i<items && at < len - 40; i++){
+		if(d && rand() % 4 == 0){
+			body.n = 0;
+			out[at++] = '(';
+			at += bench_gen(out + at, len - at - 8, d - 1U, &body);
+			k = 1 + rand() % 2;
+			at += snprintf(out + at, (size_t)(len - at), ")%d ", k);
+			while(k--)
+				for(j=0; j<body.n; j++) bench_add(rs, body.r[j].level, body.r[j].ticks);
+			continue;
+		}
+		ms    = (uint32_t)(rand() % 40);
+		level = (uint32_t)rand() & 1U;
+		at += snprintf(out + at, (size_t)(len - at), level ? "+%lu" : "-%lu", (unsigned long)ms);
+		bench_add(rs, level, PATTERN_TICKS(ms));
+	}
+	return at;
+}
+
+static unsigned bench_compiler(void){
+	static const struct {
+		const char    *desc;
+		pattern_step_t want[9];
+		uint32_t       n;
+	} fixed[] = {
+		{ "(+150-250)3 -1000", { PATTERN_STEP(150, 250), PATTERN_STEP(150, 250), PATTERN_STEP(150, 1250) }, 3 },
+		{ "@80 'SOS' -400",    { PATTERN_STEP(80, 80), PATTERN_STEP(80, 80), PATTERN_STEP(80, 240),
+		                         PATTERN_STEP(240, 80), PATTERN_STEP(240, 80), PATTERN_STEP(240, 240),
+		                         PATTERN_STEP(80, 80), PATTERN_STEP(80, 80), PATTERN_STEP(80, 640) }, 9 },
+		{ "+100 +100 -50 -50", { PATTERN_STEP(200, 100) }, 1 },
+		{ "-500 +500",         { PATTERN_STEP(0, 500), PATTERN_STEP(500, 0) }, 2 },
+		{ "'e t'",             { PATTERN_STEP(100, 700), PATTERN_STEP(300, 300) }, 2 },
+	};
+	static const char *const bad[] = { "", "+", "+1)", "(+1-1", "(+1-1)0", "'S", "'#'", "x", "((((( +1 )1 )1 )1 )1 )1" };
+	char desc[512];
+	bench_runs_t want, got;
+	uint32_t i, n, off = 0, fail = 0;
+
+	for(i=0; i<sizeof fixed / sizeof fixed[0]; i++){
+		n = pattern_compile(fixed[i].desc, bench_table, BENCH_STEPS);
+		if(n != fixed[i].n || memcmp(bench_table, fixed[i].want, n * sizeof bench_table[0]) != 0 ||
+		   bench_table[n].arr != 0U || bench_table[n].ccr1 != 0U){
+			fprintf(stderr, "compiler: \"%s\" gives %lu steps  FAIL\n", fixed[i].desc, (unsigned long)n);
+			fail++;
+		}
+	}
+	for(i=0; i<sizeof bad / sizeof bad[0]; i++){
+		if(pattern_compile(bad[i], bench_table, BENCH_STEPS) != 0U){
+			fprintf(stderr, "compiler: \"%s\" accepted  FAIL\n", bad[i]);
+			fail++;
+		}
+	}
+	if(pattern_compile("(+1-1)9", bench_table, 9) != 0U || pattern_compile("(+1-1)9", bench_table, 10) != 9U) fail++;
+
+	srand(3);
+	for(i=0; i<BENCH_RANDOM; i++){
+		want.n = got.n = 0;
+		bench_gen(desc, sizeof desc, 2, &want);
+		n = pattern_compile(desc, bench_table, BENCH_STEPS);
+		bench_expand(bench_table, n, &got);
+		if(want.n == 0U ? n != 0U : !bench_same(&want, &got)){
+			if(off++ == 0) fprintf(stderr, "compiler: \"%s\" runs differ\n", desc);
+		}
+	}
+	fprintf(stderr, "compiler: %u fixed, %u malformed, %u random descriptions, %lu off  %s\n",
+	        (unsigned)(sizeof fixed / sizeof fixed[0]), (unsigned)(sizeof bad / sizeof bad[0]), BENCH_RANDOM,
+	        (unsigned long)(off + fail), off + fail ? "FAIL" : "ok");
+	return off + fail != 0U;
+}
+
+/////////////////////////////// Player ///////////////////////////////
+
+typedef struct {
+	uint64_t t_ns;
+	uint32_t level;
+} bench_edge_t;
+
+static bench_edge_t bench_edges[BENCH_EDGES];
+
+// TIM2_CH1 changes in a model dump
+static uint32_t bench_vcd(const char *path){
+	char line[256], id[16] = "";
+	uint64_t t = 0;
+	uint32_t n = 0, w;
+	FILE *f = fopen(path, "r");
+	if(f == 0) return 0;
+	while(fgets(line, sizeof line, f)){
+		char name[64], sid[16];
+		if(sscanf(line, "$var wire %u %15s %63s", &w, sid, name) == 3 && strcmp(name, "TIM2_CH1") == 0) strcpy(id, sid);
+		else if(line[0] == '#') t = strtoull(line + 1, 0, 10);
+		else if((line[0] == '0' || line[0] == '1') && id[0] && strncmp(line + 1, id, strlen(id)) == 0 &&
+		        (line[1 + strlen(id)] == '\n' || line[1 + strlen(id)] == 0) && n < BENCH_EDGES){
+			bench_edges[n].t_ns  = t;
+			bench_edges[n].level = (uint32_t)(line[0] - '0');
+			n++;
+		}
+	}
+	fclose(f);
+	return n;
+}
+
+// Runs between the edges from the first rising one at or after from_ns up to to_ns, in pattern ticks
+static void bench_edge_runs(uint32_t n, uint64_t from_ns, uint64_t to_ns, bench_runs_t *rs){
+	uint32_t i = 0;
+	rs->n = 0;
+	while(i < n && (bench_edges[i].t_ns < from_ns || bench_edges[i].level != 1U)) i++;
+	for(; i + 1U < n && bench_edges[i + 1U].t_ns <= to_ns; i++)
+		bench_add(rs, bench_edges[i].level, (uint32_t)((bench_edges[i + 1U].t_ns - bench_edges[i].t_ns) * PATTERN_TICK_HZ / 1000000000ULL));
+}
+
+static uint64_t bench_t0_ns;
+
+// Wall time since model_start(), the time base of the dump
+static uint64_t bench_now_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec - bench_t0_ns;
+}
+
+// Busy: a looped pattern raises no interrupt to wake __WFI()
+static void bench_wait_ms(uint32_t ms){
+	uint64_t end = bench_now_ns() + (uint64_t)ms * 1000000ULL;
+	while(bench_now_ns() < end);
+}
+
+static unsigned bench_player(void){
+	static pattern_step_t once[64], loop[64];
+	char path[] = "/tmp/pattern_bench_XXXXXX";
+	bench_runs_t want, got, one;
+	uint64_t t_once, t_loop, t_switch, t_restart, t_end;
+	uint32_t n_once, n_loop, edges, i, end_low, psc, busy, bad = 0;
+	int fd = mkstemp(path);
+
+	if(fd < 0) return 1;
+	close(fd);
+	n_once = pattern_compile("+3-2 (+1-1)3 @2 'K' -5", once, 64);
+	n_loop = pattern_compile("+4-1 +2-3", loop, 64);
+
+	setenv("MODEL_RUN_MS", "0", 1);
+	setenv("MODEL_VCD", path, 1);
+	model_reset();
+	bench_t0_ns = 0;
+	bench_t0_ns = bench_now_ns();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+	pattern_init();
+
+	t_once = bench_now_ns();
+	pattern_play(once, n_once, 0);
+	for(i=0; i<200U && pattern_busy(); i++) bench_wait_ms(1);
+	busy = pattern_busy();
+	bench_wait_ms(5);
+
+	t_loop = bench_now_ns();
+	pattern_play(loop, n_loop, 1);
+	bench_wait_ms(35);
+	t_switch = bench_now_ns();
+	clock_set_profile(CLOCK_16MHZ);
+	t_restart = bench_now_ns();                  // the pattern starts over, after the lead-in
+	psc = TIM2->PSC;
+	bench_wait_ms(35);
+	t_end = bench_now_ns();
+	pattern_stop();
+	bench_wait_ms(2);
+	end_low = (TIM2->CR1 & TIM_CR1_CEN) == 0U;
+	model_finish();
+	unsetenv("MODEL_VCD");
+
+	edges = bench_vcd(path);
+	unlink(path);
+
+	want.n = 0;
+	bench_expand(once, n_once, &want);
+	bench_edge_runs(edges, t_once, t_loop, &got);
+	if(got.n && got.r[got.n - 1U].level == 0U) got.n--;            // the line stays low after the end
+	if(want.n && want.r[want.n - 1U].level == 0U) want.n--;
+	i = !bench_same(&want, &got) || busy;
+	fprintf(stderr, "player: one-shot %lu steps, %lu runs on the wire%s  %s\n", (unsigned long)n_once,
+	        (unsigned long)got.n, busy ? ", still busy" : "", i ? "FAIL" : "ok");
+	bad += i;
+
+	one.n = 0;
+	bench_expand(loop, n_loop, &one);
+	for(i=0; i<2U; i++){
+		uint32_t r, k, cycles;
+		bench_edge_runs(edges, i ? t_restart : t_loop, i ? t_end : t_switch, &got);
+		want.n = 0;
+		cycles = got.n / one.n;
+		for(k=0; k<cycles; k++)
+			for(r=0; r<one.n; r++) bench_add(&want, one.r[r].level, one.r[r].ticks);
+		got.n = want.n;
+		r = cycles < 3U || !bench_same(&want, &got) || (i && psc != 1599U);
+		fprintf(stderr, "player: looped %lu steps%s, %lu cycles on the wire  %s\n", (unsigned long)n_loop,
+		        i ? " after a switch to 16 MHz" : "", (unsigned long)cycles, r ? "FAIL" : "ok");
+		bad += r;
+	}
+	bad += !end_low;
+	return bad != 0;
+}
+
+int main(void){
+	unsigned fail = 0;
+
+	fail += bench_compiler();
+	fail += bench_player();
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
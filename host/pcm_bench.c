@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_TSC()  __rdtsc()
+#else
+#define BENCH_TSC()  0ULL
+#endif
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "dds.h"
+#include "pcm.h"
+
+/* PCM and IMA ADPCM decoding on the host
+
+ pcm_bench [seconds]
+
+ A test clip (default 4 s at 22.05 kHz: a sweep, a chord, noise bursts
+ and full-scale steps that drive the predictor into saturation) is
+ encoded with a reference IMA ADPCM encoder into 256-byte WAV blocks.
+
+ Exactness: pcm_ima_block() against the plain IMA reference decoder on
+ the encoded clip and on random blocks (any header, any index), and
+ pcm_u8() against (b ^ 0x80) << 8 at every length mod 4. Any sample
+ that differs fails.
+
+ Speed: ns and host TSC cycles per decoded sample for both decoders and
+ the reference, and the share 22.05 kHz takes of this CPU. The Cortex-M4
+ figure comes from PROF on the board.
+
+ Playback: pcm_play() of an 8 kHz clip on the host model at 84 MHz. The
+ DMA interrupt must decode every block of the clip, end it on time and
+ put its samples on the duty.
+
+ Exit code 1 on the first mismatch or a playback that is off.
+*/
+
+#define BENCH_RATE      22050U
+#define BENCH_BLOCK     256U                       // block_bytes
+#define BENCH_SPB       ((BENCH_BLOCK - 4U) * 2U + 1U)   // samples per block
+#define BENCH_RANDOM    20000U                     // random blocks
+#define BENCH_PASS_NS   300000000ULL
+#define BENCH_PLAY_HZ   8000U
+#define BENCH_PLAY_MS   100U
+#define BENCH_PI        3.14159265358979323846
+
+static const int8_t bench_adjust[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+static const int16_t bench_steps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+	107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+	4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+	22385, 24623, 27086, 29794, 32767
+};
+
+static uint64_t bench_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Reference decoder of one code, as in the IMA recommendation
+static int16_t bench_ref_code(unsigned code, int *pred, int *index){
+	int step = bench_steps[*index], diff = step >> 3;
+	if(code & 4) diff += step;
+	if(code & 2) diff += step >> 1;
+	if(code & 1) diff += step >> 2;
+	if(code & 8) *pred -= diff;
+	else         *pred += diff;
+	if(*pred >  32767) *pred =  32767;
+	if(*pred < -32768) *pred = -32768;
+	*index += bench_adjust[code & 7];
+	if(*index < 0)  *index = 0;
+	if(*index > 88) *index = 88;
+	return (int16_t)*pred;
+}
+
+static uint32_t bench_ref_block(const uint8_t *in, uint32_t bytes, int16_t *out){
+	int pred = (int16_t)(in[0] | (in[1] << 8)), index = in[2] > 88 ? 88 : in[2];
+	uint32_t i, n = 1;
+	out[0] = (int16_t)pred;
+	for(i=4; i<bytes; i++){
+		out[n++] = bench_ref_code(in[i] & 15U, &pred, &index);
+		out[n++] = bench_ref_code(in[i] >> 4, &pred, &index);
+	}
+	return n;
+}
+
+// Reference encoder: the code whose decode comes closest, tracked with the decoder's own state
+static uint32_t bench_encode(const int16_t *pcm, uint32_t n, uint8_t *out){
+	uint32_t i, k, bytes = 0, left;
+	int pred, index = 0, step, diff, code, mask;
+	for(i=0; i<n; i+=BENCH_SPB){
+		uint8_t *blk = out + bytes;
+		left = n - i < BENCH_SPB ? n - i : BENCH_SPB;
+		pred = pcm[i];
+		blk[0] = (uint8_t)pred;
+		blk[1] = (uint8_t)((unsigned)pred >> 8);
+		blk[2] = (uint8_t)index;
+		blk[3] = 0;
+		memset(blk + 4, 0, BENCH_BLOCK - 4U);
+		for(k=1; k<BENCH_SPB; k++){
+			step = bench_steps[index];
+			diff = (k < left ? pcm[i + k] : pred) - pred;
+			code = 0;
+			if(diff < 0){ code = 8; diff = -diff; }
+			for(mask = 4; mask; mask >>= 1){
+				if(diff >= step){ code |= mask; diff -= step; }
+				step >>= 1;
+			}
+			bench_ref_code((unsigned)code, &pred, &index);
+			blk[4 + (k - 1) / 2] |= (uint8_t)(code << (((k - 1) & 1U) * 4U));
+		}
+		bytes += BENCH_BLOCK;
+	}
+	return bytes;
+}
+
+static void bench_clip(int16_t *pcm, uint32_t n){
+	uint32_t i;
+	double t, ph = 0.0, s;
+	srand(1);
+	for(i=0; i<n; i++){
+		t = (double)i / BENCH_RATE;
+		ph += 2.0 * BENCH_PI * (50.0 + 5000.0 * (double)(i % (n / 4U)) / (n / 4U)) / BENCH_RATE;
+		switch(i * 4U / n){
+			case 0:  s = 0.8 * sin(ph); break;
+			case 1:  s = 0.3 * (sin(2 * BENCH_PI * 261.63 * t) + sin(2 * BENCH_PI * 329.63 * t) + sin(2 * BENCH_PI * 392.0 * t)); break;
+			case 2:  s = (i / 2000U) & 1U ? (rand() / (double)RAND_MAX - 0.5) * 1.6 : 0.0; break;
+			default: s = (i / 300U) & 1U ? 1.0 : -1.0; break;
+		}
+		s *= 32767.0;
+		pcm[i] = (int16_t)(s > 32767.0 ? 32767 : s < -32768.0 ? -32768 : s);
+	}
+}
+
+static unsigned bench_exact(const uint8_t *adpcm, uint32_t bytes, const int16_t *pcm, uint32_t n){
+	static int16_t a[PCM_CHUNK_MAX + 1U], b[PCM_CHUNK_MAX + 1U];
+	static uint8_t blk[PCM_BLOCK_MAX], u8[67];
+	static uint32_t w[40];
+	uint32_t i, k, na, nb, len, diff = 0, blocks = 0;
+	double err = 0.0, sig = 0.0;
+	unsigned bad = 0;
+
+	for(i=0; i<bytes; i+=BENCH_BLOCK){
+		na = pcm_ima_block(adpcm + i, BENCH_BLOCK, a);
+		nb = bench_ref_block(adpcm + i, BENCH_BLOCK, b);
+		if(na != nb || memcmp(a, b, na * sizeof a[0])) diff++;
+		for(k=0; k<na && i / BENCH_BLOCK * BENCH_SPB + k < n; k++){
+			double d = (double)a[k] - pcm[i / BENCH_BLOCK * BENCH_SPB + k];
+			err += d * d;
+			sig += (double)pcm[i / BENCH_BLOCK * BENCH_SPB + k] * pcm[i / BENCH_BLOCK * BENCH_SPB + k];
+		}
+		blocks++;
+	}
+	for(i=0; i<BENCH_RANDOM; i++){
+		len = 4U + (uint32_t)rand() % (PCM_BLOCK_MAX - 3U);
+		for(k=0; k<len; k++) blk[k] = (uint8_t)rand();
+		na = pcm_ima_block(blk, len, a);
+		nb = bench_ref_block(blk, len, b);
+		if(na != nb || memcmp(a, b, na * sizeof a[0])) diff++;
+		blocks++;
+	}
+	fprintf(stderr, "ima:  %lu blocks, %lu differ from the reference, clip SNR %.1f dB  %s\n",
+	        (unsigned long)blocks, (unsigned long)diff, 10.0 * log10(sig / (err > 0.0 ? err : 1.0)), diff ? "FAIL" : "ok");
+	bad += diff != 0;
+
+	diff = 0;
+	for(len=1; len<=sizeof u8; len++){
+		for(k=0; k<len; k++) u8[k] = (uint8_t)rand();
+		memset(w, 0xA5, sizeof w);
+		pcm_u8(u8, len, w);
+		for(k=0; k<(len + 3U) / 4U * 4U; k++){
+			int16_t got  = (int16_t)(w[k / 2U] >> ((k & 1U) * 16U));
+			int16_t want = k < len ? (int16_t)((u8[k] ^ 0x80) << 8) : 0;
+			if(got != want) diff++;
+		}
+	}
+	fprintf(stderr, "u8:   lengths 1..%u, %lu samples differ  %s\n", (unsigned)sizeof u8, (unsigned long)diff, diff ? "FAIL" : "ok");
+	return bad + (diff != 0);
+}
+
+static void bench_speed(const char *name, int which, const uint8_t *adpcm, uint32_t bytes){
+	static int16_t out[PCM_CHUNK_MAX + 1U];
+	static uint32_t w[BENCH_BLOCK / 2U];
+	uint64_t t0 = bench_ns(), c0 = BENCH_TSC(), t, samples = 0;
+	volatile int32_t sink = 0;
+	uint32_t i;
+	double ns;
+
+	do {
+		for(i=0; i<bytes; i+=BENCH_BLOCK){
+			if(which == 0)      samples += pcm_ima_block(adpcm + i, BENCH_BLOCK, out);
+			else if(which == 1) samples += bench_ref_block(adpcm + i, BENCH_BLOCK, out);
+			else                samples += pcm_u8(adpcm + i, BENCH_BLOCK, w);
+			sink += out[i & 255U] + (int32_t)w[i & 127U];
+		}
+		t = bench_ns() - t0;
+	} while(t < BENCH_PASS_NS);
+	ns = (double)t / (double)samples;
+	fprintf(stderr, "%-10s %8.2f %10.1f %8.3f\n", name, ns,
+	        BENCH_TSC() ? (double)(BENCH_TSC() - c0) / (double)samples : 0.0, 100.0 * BENCH_RATE * ns / 1e9);
+	(void)sink;
+}
+
+// pcm_play() through the DDS DMA path on the model
+static unsigned bench_play(const int16_t *pcm){
+	static uint8_t adpcm[((BENCH_PLAY_HZ * BENCH_PLAY_MS / 1000U) / BENCH_SPB + 1U) * BENCH_BLOCK];
+	static int16_t sub[BENCH_PLAY_HZ * BENCH_PLAY_MS / 1000U];
+	pcm_clip_t clip;
+	uint32_t i, n = sizeof sub / sizeof sub[0], chunks, want, ms, lo = 0xFFFFFFFFUL, hi = 0;
+	uint64_t end, stop = 0;
+	unsigned bad;
+
+	for(i=0; i<n; i++) sub[i] = pcm[i * (BENCH_RATE / BENCH_PLAY_HZ)];
+	clip.data        = adpcm;
+	clip.bytes       = bench_encode(sub, n, adpcm);
+	clip.rate_hz     = BENCH_PLAY_HZ;
+	clip.block_bytes = BENCH_BLOCK;
+	clip.format      = PCM_IMA;
+	want = clip.bytes / BENCH_BLOCK;
+	ms   = want * BENCH_SPB * 1000U / BENCH_PLAY_HZ;    // the last block is padded
+
+	setenv("MODEL_RUN_MS", "0", 1);
+	model_reset();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+	dds_init();
+	dds_set_amp(DDS_AMP_MAX);
+	chunks = pcm_stats.chunks;
+	pcm_play(&clip, 0);
+	end = model_cycles() + (uint64_t)SystemCoreClock * (ms * 3U / 2U) / 1000U;
+	while(model_cycles() < end){
+		__WFI();
+		if(pcm_playing()){
+			if(TIM5->CCR1 < lo) lo = TIM5->CCR1;
+			if(TIM5->CCR1 > hi) hi = TIM5->CCR1;
+		} else if(!stop) {
+			stop = model_cycles();
+		}
+	}
+	chunks = pcm_stats.chunks - chunks;
+	pcm_stop();
+	model_finish();
+
+	stop = stop ? (stop - (end - (uint64_t)SystemCoreClock * (ms * 3U / 2U) / 1000U)) * 1000U / SystemCoreClock : 0;
+	bad = chunks != want || stop + 2U < ms || stop > ms + 3U || hi - lo < dds_levels() / 4U;
+	fprintf(stderr, "play: %lu of %lu blocks at %u Hz, ended after %lu ms (clip %lu ms), duty %lu..%lu of %lu  %s\n",
+	        (unsigned long)chunks, (unsigned long)want, BENCH_PLAY_HZ, (unsigned long)stop, (unsigned long)ms,
+	        (unsigned long)lo, (unsigned long)hi, (unsigned long)dds_levels(), bad ? "FAIL" : "ok");
+	return bad;
+}
+
+int main(int argc, char **argv){
+	double seconds = argc > 1 ? strtod(argv[1], 0) : 4.0;
+	uint32_t n = (uint32_t)(seconds * BENCH_RATE), bytes;
+	int16_t *pcm;
+	uint8_t *adpcm;
+	unsigned fail = 0;
+
+	if(n < 4U * BENCH_RATE / 10U) n = 4U * BENCH_RATE / 10U;
+	pcm   = malloc(n * sizeof pcm[0]);
+	adpcm = malloc((n / BENCH_SPB + 1U) * BENCH_BLOCK);
+	if(!pcm || !adpcm) return 1;
+	bench_clip(pcm, n);
+	bytes = bench_encode(pcm, n, adpcm);
+	fprintf(stderr, "clip %lu samples at %u Hz, %lu bytes IMA ADPCM in %u-byte blocks\n",
+	        (unsigned long)n, BENCH_RATE, (unsigned long)bytes, BENCH_BLOCK);
+
+	fail += bench_exact(adpcm, bytes, pcm, n);
+
+	fprintf(stderr, "\n%-10s %8s %10s %8s\n", "decoder", "ns/smp", "cyc/smp", "load %");
+	bench_speed("ima", 0, adpcm, bytes);
+	bench_speed("ima ref", 1, adpcm, bytes);
+	bench_speed("u8", 2, adpcm, bytes);
+	fprintf(stderr, "\n");
+
+	fail += bench_play(pcm);
+	free(pcm);
+	free(adpcm);
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "song.h"
+
+/* Song score tables on the host
+
+ song_check [-v]
+
+ Folds a score with every pitch, duration and articulation through the
+ song.h macros and checks the packed events against their definition:
+ MIDI note, sixteenths, articulation, the equal-tempered frequency
+ (Q16.16 within rounding, whole Hz) and the tempo. -v prints the table
+ as hex bytes in memory order, the same bytes the target build puts in
+ flash (compare with a dump of the firmware's table).
+ Exit code 1 if any event is off.
+*/
+
+#define CHECK_TOL_Q16  1.0            // rounding of the octave shift, Q16.16 Hz
+
+typedef struct {
+	song_event_t ev;
+	uint32_t     midi;
+	uint32_t     sixteenths;
+	uint32_t     artic;
+} check_case_t;
+
+static const song_event_t check_score[] = {
+	NOTE(C,0,s), NOTE(A,4,q), STAC(Cs,5,e), TIE(Db,5,h), NOTE(B,8,w), REST(qd),
+	NOTE(Eb,3,wd), NOTE(Fs,2,hd), NOTE(Gb,6,ed), STAC(As,1,q), TIE(Bb,7,e), NOTE(Gs,4,s)
+};
+
+static const check_case_t check_cases[] = {
+	{ NOTE(C,0,s),    12,  1, ADSR_NORMAL },
+	{ NOTE(A,4,q),    69,  4, ADSR_NORMAL },
+	{ STAC(Cs,5,e),   73,  2, ADSR_STACCATO },
+	{ TIE(Db,5,h),    73,  8, ADSR_LEGATO },
+	{ NOTE(B,8,w),   119, 16, ADSR_NORMAL },
+	{ REST(qd),        0,  6, ADSR_NORMAL },
+	{ NOTE(Eb,3,wd),  51, 24, ADSR_NORMAL },
+	{ NOTE(Fs,2,hd),  42, 12, ADSR_NORMAL },
+	{ NOTE(Gb,6,ed),  90,  3, ADSR_NORMAL },
+	{ STAC(As,1,q),   34,  4, ADSR_STACCATO },
+	{ TIE(Bb,7,e),   106,  2, ADSR_LEGATO },
+	{ NOTE(Gs,4,s),   68,  1, ADSR_NORMAL },
+};
+
+int main(int argc, char **argv){
+	unsigned i, fail = 0;
+	double ideal, err, worst = 0.0;
+	const check_case_t *c;
+
+	if(argc > 1 && !strcmp(argv[1], "-v")){
+		for(i = 0; i < sizeof check_score; i++) printf("%02x%c", ((const uint8_t *)check_score)[i], i % 16U == 15U ? '\n' : ' ');
+		printf("\n");
+	}
+
+	for(i = 0; i < sizeof check_cases / sizeof check_cases[0]; i++){
+		c = &check_cases[i];
+		if(c->ev != check_score[i] || SONG_MIDI(c->ev) != c->midi || SONG_SIXTEENTHS(c->ev) != c->sixteenths ||
+		   SONG_ARTIC(c->ev) != c->artic || SONG_IS_REST(c->ev) != (c->midi == 0U)){
+			fprintf(stderr, "event %u: %04x midi %u sixteenths %u artic %u  FAIL\n", i, c->ev,
+			        SONG_MIDI(c->ev), SONG_SIXTEENTHS(c->ev), SONG_ARTIC(c->ev));
+			fail++;
+		}
+		ideal = c->midi ? 440.0 * pow(2.0, ((double)c->midi - 69.0) / 12.0) : 0.0;
+		err = fabs(song_hz_q16(c->ev) - ideal * 65536.0);
+		if(err > worst) worst = err;
+		if(song_hz(c->ev) != (uint32_t)(ideal + 0.5)){
+			fprintf(stderr, "event %u: %u Hz for %.3f Hz  FAIL\n", i, song_hz(c->ev), ideal);
+			fail++;
+		}
+		if(song_ms(c->ev, 125U) != c->sixteenths * 125U) fail++;
+	}
+	fprintf(stderr, "%u events, %u bytes, tuning off by %.2f/65536 Hz\n",
+	        (unsigned)SONG_LEN(check_score), (unsigned)sizeof check_score, worst);
+	if(worst > CHECK_TOL_Q16) fail++;
+	if(song_hz(NOTE(A,4,q)) != 440U || song_hz_q16(REST(q)) != 0U) fail++;
+
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
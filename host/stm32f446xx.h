@@ -0,0 +1,554 @@
+#ifndef HOST_STM32F446XX_H
+#define HOST_STM32F446XX_H
+
+/* Host stand-in for the CMSIS device header (NUCLEO-F446RE)
+
+ Lets the experiments and common/ compile natively (HOST_BUILD). Every
+ peripheral is a plain struct in host RAM owned by host/model.c; the
+ model thread plays the part of the hardware (ready flags, cycle counter,
+ interrupts). Only the registers and bit names used in this repository
+ are provided, values match stm32f446xx.h / core_cm4.h.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef HOST_BUILD
+#define HOST_BUILD
+#endif
+
+#define __IO  volatile
+#define __I   volatile const
+#define __O   volatile
+
+/////////////////////////////// IRQ numbers ///////////////////////////////
+
+typedef enum {
+	NonMaskableInt_IRQn   = -14,
+	MemoryManagement_IRQn = -12,
+	BusFault_IRQn         = -11,
+	UsageFault_IRQn       = -10,
+	SVCall_IRQn           = -5,
+	DebugMonitor_IRQn     = -4,
+	PendSV_IRQn           = -2,
+	SysTick_IRQn          = -1,
+	RTC_WKUP_IRQn         = 3,
+	EXTI0_IRQn            = 6,
+	DMA1_Stream0_IRQn     = 11,
+	DMA1_Stream1_IRQn     = 12,
+	DMA1_Stream2_IRQn     = 13,
+	DMA1_Stream3_IRQn     = 14,
+	DMA1_Stream4_IRQn     = 15,
+	DMA1_Stream5_IRQn     = 16,
+	DMA1_Stream6_IRQn     = 17,
+	TIM2_IRQn             = 28,
+	TIM3_IRQn             = 29,
+	TIM4_IRQn             = 30,
+	USART2_IRQn           = 38,
+	EXTI15_10_IRQn        = 40,
+	DMA1_Stream7_IRQn     = 47,
+	TIM5_IRQn             = 50,
+	TIM6_DAC_IRQn         = 54,
+	TIM7_IRQn             = 55,
+	DMA2_Stream0_IRQn     = 56,
+	DMA2_Stream1_IRQn     = 57,
+	DMA2_Stream2_IRQn     = 58,
+	DMA2_Stream3_IRQn     = 59,
+	DMA2_Stream4_IRQn     = 60,
+	DMA2_Stream5_IRQn     = 68,
+	DMA2_Stream6_IRQn     = 69,
+	DMA2_Stream7_IRQn     = 70,
+	MODEL_IRQ_COUNT       = 97
+} IRQn_Type;
+
+/////////////////////////////// Register blocks ///////////////////////////////
+
+typedef struct {
+	__IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR;
+	__IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR, PLLCFGR, CFGR, CIR, AHB1RSTR, AHB2RSTR, AHB3RSTR, RESERVED0;
+	__IO uint32_t APB1RSTR, APB2RSTR, RESERVED1[2];
+	__IO uint32_t AHB1ENR, AHB2ENR, AHB3ENR, RESERVED2;
+	__IO uint32_t APB1ENR, APB2ENR, RESERVED3[2];
+	__IO uint32_t AHB1LPENR, AHB2LPENR, AHB3LPENR, RESERVED4;
+	__IO uint32_t APB1LPENR, APB2LPENR, RESERVED5[2];
+	__IO uint32_t BDCR, CSR, RESERVED6[2];
+	__IO uint32_t SSCGR, PLLI2SCFGR, PLLSAICFGR, DCKCFGR, CKGATENR, DCKCFGR2;
+} RCC_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR;
+	__IO uint32_t CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR, OR;
+} TIM_TypeDef;
+
+typedef struct {
+	__IO uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+
+typedef struct {
+	__IO uint32_t MEMRMP, PMC;
+	__IO uint32_t EXTICR[4];
+	uint32_t      RESERVED[2];
+	__IO uint32_t CMPCR;
+} SYSCFG_TypeDef;
+
+typedef struct {
+	__IO uint32_t ACR, KEYR, OPTKEYR, SR, CR, OPTCR;
+} FLASH_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR, CSR;
+} PWR_TypeDef;
+
+typedef struct {
+	__IO uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+typedef struct {
+	__IO uint32_t TR, DR, CR, ISR, PRER, WUTR, CALIBR, ALRMAR, ALRMBR, WPR, SSR;
+} RTC_TypeDef;
+
+/* DMA addresses are pointer sized on the host so the model can follow them */
+typedef struct {
+	__IO uint32_t  CR;
+	__IO uint32_t  NDTR;
+	__IO uintptr_t PAR;
+	__IO uintptr_t M0AR;
+	__IO uintptr_t M1AR;
+	__IO uint32_t  FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+	__IO uint32_t LISR, HISR, LIFCR, HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+	__I  uint32_t CPUID;
+	__IO uint32_t ICSR, VTOR, AIRCR, SCR, CCR;
+	__IO uint8_t  SHP[12];
+	__IO uint32_t SHCSR, CFSR, HFSR, DFSR, MMFAR, BFAR, AFSR;
+	__IO uint32_t CPACR;
+} SCB_Type;
+
+typedef struct {
+	__IO uint32_t CTRL, LOAD, VAL;
+	__I  uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+	__IO uint32_t CTRL, CYCCNT, CPICNT, EXCCNT, SLEEPCNT, LSUCNT, FOLDCNT;
+	__I  uint32_t PCSR;
+} DWT_Type;
+
+typedef struct {
+	__IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+	__IO union {
+		__O uint8_t  u8;
+		__O uint16_t u16;
+		__O uint32_t u32;           // read: 1 when the stimulus FIFO has room
+	} PORT[32];
+	__IO uint32_t TER, TPR, TCR;
+} ITM_Type;
+
+/////////////////////////////// Instances (host/model.c) ///////////////////////////////
+
+extern GPIO_TypeDef       model_GPIOA, model_GPIOB, model_GPIOC;
+extern RCC_TypeDef        model_RCC;
+extern TIM_TypeDef        model_TIM1, model_TIM2, model_TIM3, model_TIM4, model_TIM5;
+extern TIM_TypeDef        model_TIM6, model_TIM7, model_TIM8;
+extern EXTI_TypeDef       model_EXTI;
+extern SYSCFG_TypeDef     model_SYSCFG;
+extern FLASH_TypeDef      model_FLASH;
+extern PWR_TypeDef        model_PWR;
+extern USART_TypeDef      model_USART2;
+extern RTC_TypeDef        model_RTC;
+extern DMA_TypeDef        model_DMA1, model_DMA2;
+extern DMA_Stream_TypeDef model_DMA1_Stream[8], model_DMA2_Stream[8];
+extern SCB_Type           model_SCB;
+extern SysTick_Type       model_SysTick;
+extern DWT_Type           model_DWT;
+extern CoreDebug_Type     model_CoreDebug;
+extern ITM_Type           model_ITM;
+
+void model_gpio_access(void);
+void model_dwt_access(void);
+void model_tim_access(void);
+void model_rcc_access(void);
+void model_itm_access(void);
+
+#define GPIOA        (model_gpio_access(), &model_GPIOA)   // MODEL_VCD sees every write
+#define GPIOB        (model_gpio_access(), &model_GPIOB)
+#define GPIOC        (model_gpio_access(), &model_GPIOC)
+#define RCC          (model_rcc_access(), &model_RCC)        // ready flags follow the enables at once
+#define TIM1         (&model_TIM1)
+#define TIM2         (model_tim_access(), &model_TIM2)    // CNT and UIF as of now
+#define TIM3         (&model_TIM3)
+#define TIM4         (&model_TIM4)
+#define TIM5         (model_tim_access(), &model_TIM5)
+#define TIM6         (&model_TIM6)
+#define TIM7         (&model_TIM7)
+#define TIM8         (&model_TIM8)
+#define EXTI         (&model_EXTI)
+#define SYSCFG       (&model_SYSCFG)
+#define FLASH        (&model_FLASH)
+#define PWR          (&model_PWR)
+#define USART2       (&model_USART2)
+#define RTC          (&model_RTC)
+#define DMA1         (&model_DMA1)
+#define DMA2         (&model_DMA2)
+#define DMA1_Stream0 (&model_DMA1_Stream[0])
+#define DMA1_Stream1 (&model_DMA1_Stream[1])
+#define DMA1_Stream2 (&model_DMA1_Stream[2])
+#define DMA1_Stream3 (&model_DMA1_Stream[3])
+#define DMA1_Stream4 (&model_DMA1_Stream[4])
+#define DMA1_Stream5 (&model_DMA1_Stream[5])
+#define DMA1_Stream6 (&model_DMA1_Stream[6])
+#define DMA1_Stream7 (&model_DMA1_Stream[7])
+#define DMA2_Stream0 (&model_DMA2_Stream[0])
+#define DMA2_Stream1 (&model_DMA2_Stream[1])
+#define DMA2_Stream2 (&model_DMA2_Stream[2])
+#define DMA2_Stream3 (&model_DMA2_Stream[3])
+#define DMA2_Stream4 (&model_DMA2_Stream[4])
+#define DMA2_Stream5 (&model_DMA2_Stream[5])
+#define DMA2_Stream6 (&model_DMA2_Stream[6])
+#define DMA2_Stream7 (&model_DMA2_Stream[7])
+#define SCB          (&model_SCB)
+#define SysTick      (&model_SysTick)
+#define DWT          (model_dwt_access(), &model_DWT)    // CYCCNT exact on every read
+#define CoreDebug    (&model_CoreDebug)
+#define ITM          (model_itm_access(), &model_ITM)    // PORT[0] reads 0 while the SWO wire is busy
+
+#define FLASH_BASE   0x08000000UL
+#define SRAM1_BASE   0x20000000UL
+#define SRAM_BASE    SRAM1_BASE
+
+/////////////////////////////// RCC ///////////////////////////////
+
+#define RCC_CR_HSION              (1UL << 0)
+#define RCC_CR_HSIRDY             (1UL << 1)
+#define RCC_CR_HSEON              (1UL << 16)
+#define RCC_CR_HSERDY             (1UL << 17)
+#define RCC_CR_CSSON              (1UL << 19)
+#define RCC_CR_PLLON              (1UL << 24)
+#define RCC_CR_PLLRDY             (1UL << 25)
+
+#define RCC_PLLCFGR_PLLM_Pos      0
+#define RCC_PLLCFGR_PLLM          (0x3FUL << 0)
+#define RCC_PLLCFGR_PLLN_Pos      6
+#define RCC_PLLCFGR_PLLN          (0x1FFUL << 6)
+#define RCC_PLLCFGR_PLLP_Pos      16
+#define RCC_PLLCFGR_PLLP          (0x3UL << 16)
+#define RCC_PLLCFGR_PLLSRC_Pos    22
+#define RCC_PLLCFGR_PLLSRC        (1UL << 22)
+#define RCC_PLLCFGR_PLLQ_Pos      24
+#define RCC_PLLCFGR_PLLQ          (0xFUL << 24)
+
+#define RCC_CFGR_SW               (0x3UL << 0)
+#define RCC_CFGR_SW_0             (0x1UL << 0)
+#define RCC_CFGR_SW_1             (0x2UL << 0)
+#define RCC_CFGR_SW_HSI           0x0UL
+#define RCC_CFGR_SW_PLL           0x2UL
+#define RCC_CFGR_SWS              (0x3UL << 2)
+#define RCC_CFGR_SWS_HSI          0x0UL
+#define RCC_CFGR_SWS_PLL          0x8UL
+#define RCC_CFGR_HPRE             (0xFUL << 4)
+#define RCC_CFGR_HPRE_Pos         4
+#define RCC_CFGR_PPRE1            (0x7UL << 10)
+#define RCC_CFGR_PPRE1_Pos        10
+#define RCC_CFGR_PPRE1_DIV2       0x00001000UL
+#define RCC_CFGR_PPRE1_DIV4       0x00001400UL
+#define RCC_CFGR_PPRE2            (0x7UL << 13)
+#define RCC_CFGR_PPRE2_Pos        13
+#define RCC_CFGR_PPRE2_DIV2       0x00008000UL
+
+#define RCC_AHB1ENR_GPIOAEN       (1UL << 0)
+#define RCC_AHB1ENR_GPIOBEN       (1UL << 1)
+#define RCC_AHB1ENR_GPIOCEN       (1UL << 2)
+#define RCC_AHB1ENR_DMA1EN        (1UL << 21)
+#define RCC_AHB1ENR_DMA2EN        (1UL << 22)
+
+#define RCC_APB1ENR_TIM2EN        (1UL << 0)
+#define RCC_APB1ENR_TIM3EN        (1UL << 1)
+#define RCC_APB1ENR_TIM4EN        (1UL << 2)
+#define RCC_APB1ENR_TIM5EN        (1UL << 3)
+#define RCC_APB1ENR_TIM6EN        (1UL << 4)
+#define RCC_APB1ENR_TIM7EN        (1UL << 5)
+#define RCC_APB1ENR_USART2EN      (1UL << 17)
+#define RCC_APB1ENR_PWREN         (1UL << 28)
+#define RCC_APB1LPENR_PWRLPEN     (1UL << 28)
+
+#define RCC_APB2ENR_TIM1EN        (1UL << 0)
+#define RCC_APB2ENR_TIM8EN        (1UL << 1)
+#define RCC_APB2ENR_SYSCFGEN      (1UL << 14)
+
+/////////////////////////////// FLASH / PWR ///////////////////////////////
+
+#define FLASH_ACR_LATENCY         (0xFUL << 0)
+#define FLASH_ACR_LATENCY_0WS     0x0UL
+#define FLASH_ACR_LATENCY_1WS     0x1UL
+#define FLASH_ACR_LATENCY_2WS     0x2UL
+#define FLASH_ACR_LATENCY_3WS     0x3UL
+#define FLASH_ACR_LATENCY_4WS     0x4UL
+#define FLASH_ACR_LATENCY_5WS     0x5UL
+#define FLASH_ACR_PRFTEN          (1UL << 8)
+#define FLASH_ACR_ICEN            (1UL << 9)
+#define FLASH_ACR_DCEN            (1UL << 10)
+#define FLASH_ACR_ICRST           (1UL << 11)
+#define FLASH_ACR_DCRST           (1UL << 12)
+
+#define PWR_CR_LPDS               (1UL << 0)
+#define PWR_CR_PDDS               (1UL << 1)
+#define PWR_CR_CWUF               (1UL << 2)
+#define PWR_CR_DBP                (1UL << 8)
+#define PWR_CR_FPDS               (1UL << 9)
+#define PWR_CR_VOS_Pos            14
+#define PWR_CR_VOS                (0x3UL << 14)
+#define PWR_CR_VOS_0              (0x1UL << 14)
+#define PWR_CR_VOS_1              (0x2UL << 14)
+#define PWR_CSR_VOSRDY            (1UL << 14)
+
+#define RCC_BDCR_RTCSEL           (0x3UL << 8)
+#define RCC_BDCR_RTCSEL_1         (0x2UL << 8)
+#define RCC_BDCR_RTCEN            (1UL << 15)
+#define RCC_CSR_LSION             (1UL << 0)
+#define RCC_CSR_LSIRDY            (1UL << 1)
+
+#define RTC_CR_WUCKSEL            (0x7UL << 0)
+#define RTC_CR_BYPSHAD            (1UL << 5)
+#define RTC_CR_WUTE               (1UL << 10)
+#define RTC_CR_WUTIE              (1UL << 14)
+#define RTC_ISR_WUTWF             (1UL << 2)
+#define RTC_ISR_RSF               (1UL << 5)
+#define RTC_ISR_INITF             (1UL << 6)
+#define RTC_ISR_INIT              (1UL << 7)
+#define RTC_ISR_WUTF              (1UL << 10)
+#define RTC_PRER_PREDIV_S         (0x7FFFUL << 0)
+#define RTC_PRER_PREDIV_A_Pos     16
+#define RTC_TR_SU                 (0xFUL << 0)
+#define RTC_TR_ST_Pos             4
+#define RTC_TR_MNU_Pos            8
+#define RTC_TR_MNT_Pos            12
+#define RTC_TR_HU_Pos             16
+#define RTC_TR_HT_Pos             20
+
+/////////////////////////////// TIM ///////////////////////////////
+
+#define TIM_CR1_CEN               (1UL << 0)
+#define TIM_CR1_UDIS              (1UL << 1)
+#define TIM_CR1_URS               (1UL << 2)
+#define TIM_CR1_OPM               (1UL << 3)
+#define TIM_CR1_DIR               (1UL << 4)
+#define TIM_CR1_ARPE              (1UL << 7)
+#define TIM_CR2_CCDS              (1UL << 3)
+#define TIM_DIER_UIE              (1UL << 0)
+#define TIM_DIER_CC1IE            (1UL << 1)
+#define TIM_DIER_UDE              (1UL << 8)
+#define TIM_DIER_CC1DE            (1UL << 9)
+#define TIM_DIER_CC2DE            (1UL << 10)
+#define TIM_DIER_CC3DE            (1UL << 11)
+#define TIM_SR_UIF                (1UL << 0)
+#define TIM_SR_CC1IF              (1UL << 1)
+#define TIM_EGR_UG                (1UL << 0)
+#define TIM_CCMR1_OC1FE           (1UL << 2)
+#define TIM_CCMR1_OC1PE           (1UL << 3)
+#define TIM_CCMR1_OC1M            (0x7UL << 4)
+#define TIM_CCMR1_OC1M_0          (0x1UL << 4)
+#define TIM_CCMR1_OC1M_1          (0x2UL << 4)
+#define TIM_CCMR1_OC1M_2          (0x4UL << 4)
+#define TIM_CCMR1_OC2PE           (1UL << 11)
+#define TIM_CCMR1_OC2M            (0x7UL << 12)
+#define TIM_CCMR1_OC2M_1          (0x2UL << 12)
+#define TIM_CCMR1_OC2M_2          (0x4UL << 12)
+#define TIM_CCER_CC1E             (1UL << 0)
+#define TIM_CCER_CC1P             (1UL << 1)
+#define TIM_CCER_CC1NE            (1UL << 2)
+#define TIM_CCER_CC1NP            (1UL << 3)
+#define TIM_CCER_CC2E             (1UL << 4)
+#define TIM_BDTR_MOE              (1UL << 15)
+#define TIM_DCR_DBA_Pos           0
+#define TIM_DCR_DBA               (0x1FUL << 0)
+#define TIM_DCR_DBL_Pos           8
+#define TIM_DCR_DBL               (0x1FUL << 8)
+
+/////////////////////////////// EXTI / SYSCFG ///////////////////////////////
+
+#define SYSCFG_EXTICR4_EXTI13     (0xFUL << 4)
+#define SYSCFG_EXTICR4_EXTI13_PC  (0x2UL << 4)
+#define EXTI_IMR_MR13             (1UL << 13)
+#define EXTI_IMR_IM13             EXTI_IMR_MR13
+#define EXTI_EMR_MR13             (1UL << 13)
+#define EXTI_RTSR_TR13            (1UL << 13)
+#define EXTI_FTSR_TR13            (1UL << 13)
+#define EXTI_PR_PR13              (1UL << 13)
+#define EXTI_IMR_MR22             (1UL << 22)
+#define EXTI_RTSR_TR22            (1UL << 22)
+#define EXTI_PR_PR22              (1UL << 22)
+
+/////////////////////////////// DMA / USART ///////////////////////////////
+
+#define DMA_SxCR_EN               (1UL << 0)
+#define DMA_SxCR_TCIE             (1UL << 4)
+#define DMA_SxCR_HTIE             (1UL << 3)
+#define DMA_SxCR_TEIE             (1UL << 2)
+#define DMA_SxCR_DIR_Pos          6
+#define DMA_SxCR_DIR_0            (1UL << 6)
+#define DMA_SxCR_DIR_1            (1UL << 7)
+#define DMA_SxCR_CIRC             (1UL << 8)
+#define DMA_SxCR_PINC             (1UL << 9)
+#define DMA_SxCR_MINC             (1UL << 10)
+#define DMA_SxCR_PSIZE_Pos        11
+#define DMA_SxCR_PSIZE_0          (1UL << 11)
+#define DMA_SxCR_PSIZE_1          (1UL << 12)
+#define DMA_SxCR_MSIZE_Pos        13
+#define DMA_SxCR_MSIZE_0          (1UL << 13)
+#define DMA_SxCR_MSIZE_1          (1UL << 14)
+#define DMA_SxCR_PL_0             (1UL << 16)
+#define DMA_SxCR_PL_1             (1UL << 17)
+#define DMA_SxCR_DBM              (1UL << 18)
+#define DMA_SxCR_CT               (1UL << 19)
+#define DMA_SxCR_CHSEL_Pos        25
+#define DMA_SxCR_CHSEL            (0x7UL << 25)
+#define DMA_SxFCR_DMDIS           (1UL << 2)
+#define DMA_SxFCR_FTH             (0x3UL << 0)
+
+#define DMA_LISR_FEIF0            (1UL << 0)
+#define DMA_LISR_DMEIF0           (1UL << 2)
+#define DMA_LISR_TEIF0            (1UL << 3)
+#define DMA_LISR_HTIF0            (1UL << 4)
+#define DMA_LISR_TCIF0            (1UL << 5)
+#define DMA_LIFCR_CFEIF0          (1UL << 0)
+#define DMA_LIFCR_CDMEIF0         (1UL << 2)
+#define DMA_LIFCR_CTEIF0          (1UL << 3)
+#define DMA_LIFCR_CHTIF0          (1UL << 4)
+#define DMA_LIFCR_CTCIF0          (1UL << 5)
+#define DMA_LISR_HTIF1            (1UL << 10)
+#define DMA_LISR_TCIF1            (1UL << 11)
+#define DMA_LIFCR_CFEIF1          (1UL << 6)
+#define DMA_LIFCR_CDMEIF1         (1UL << 8)
+#define DMA_LIFCR_CTEIF1          (1UL << 9)
+#define DMA_LIFCR_CHTIF1          (1UL << 10)
+#define DMA_LIFCR_CTCIF1          (1UL << 11)
+#define DMA_LIFCR_CFEIF2          (1UL << 16)
+#define DMA_LIFCR_CDMEIF2         (1UL << 18)
+#define DMA_LIFCR_CTEIF2          (1UL << 19)
+#define DMA_LIFCR_CHTIF2          (1UL << 20)
+#define DMA_LIFCR_CTCIF2          (1UL << 21)
+#define DMA_LIFCR_CFEIF3          (1UL << 22)
+#define DMA_LIFCR_CDMEIF3         (1UL << 24)
+#define DMA_LIFCR_CTEIF3          (1UL << 25)
+#define DMA_LIFCR_CHTIF3          (1UL << 26)
+#define DMA_LIFCR_CTCIF3          (1UL << 27)
+#define DMA_HISR_HTIF4            (1UL << 4)
+#define DMA_HISR_TCIF4            (1UL << 5)
+#define DMA_HIFCR_CFEIF4          (1UL << 0)
+#define DMA_HIFCR_CDMEIF4         (1UL << 2)
+#define DMA_HIFCR_CTEIF4          (1UL << 3)
+#define DMA_HIFCR_CHTIF4          (1UL << 4)
+#define DMA_HIFCR_CTCIF4          (1UL << 5)
+#define DMA_HIFCR_CFEIF5          (1UL << 6)
+#define DMA_HIFCR_CDMEIF5         (1UL << 8)
+#define DMA_HIFCR_CTEIF5          (1UL << 9)
+#define DMA_HIFCR_CHTIF5          (1UL << 10)
+#define DMA_HIFCR_CTCIF5          (1UL << 11)
+#define DMA_HISR_TCIF6            (1UL << 21)
+#define DMA_HIFCR_CFEIF6          (1UL << 16)
+#define DMA_HIFCR_CDMEIF6         (1UL << 18)
+#define DMA_HIFCR_CTEIF6          (1UL << 19)
+#define DMA_HIFCR_CHTIF6          (1UL << 20)
+#define DMA_HIFCR_CTCIF6          (1UL << 21)
+#define DMA_HISR_TCIF7            (1UL << 27)
+#define DMA_HIFCR_CFEIF7          (1UL << 22)
+#define DMA_HIFCR_CDMEIF7         (1UL << 24)
+#define DMA_HIFCR_CTEIF7          (1UL << 25)
+#define DMA_HIFCR_CHTIF7          (1UL << 26)
+#define DMA_HIFCR_CTCIF7          (1UL << 27)
+
+#define USART_SR_TXE              (1UL << 7)
+#define USART_SR_TC               (1UL << 6)
+#define USART_CR1_UE              (1UL << 13)
+#define USART_CR1_TCIE            (1UL << 6)
+#define USART_CR1_TE              (1UL << 3)
+#define USART_CR3_DMAT            (1UL << 7)
+
+/////////////////////////////// Core ///////////////////////////////
+
+#define SCB_ICSR_PENDSTSET_Msk         (1UL << 26)
+#define SCB_SCR_SLEEPONEXIT_Msk        (1UL << 1)
+#define SCB_SCR_SLEEPDEEP_Msk          (1UL << 2)
+#define SysTick_CTRL_ENABLE_Msk        (1UL << 0)
+#define SysTick_CTRL_TICKINT_Msk       (1UL << 1)
+#define SysTick_CTRL_CLKSOURCE_Msk     (1UL << 2)
+#define SysTick_CTRL_COUNTFLAG_Msk     (1UL << 16)
+#define SysTick_LOAD_RELOAD_Msk        0xFFFFFFUL
+#define DWT_CTRL_CYCCNTENA_Msk         (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk     (1UL << 24)
+#define ITM_TCR_ITMENA_Msk             (1UL << 0)
+
+#define __NVIC_PRIO_BITS               4
+#define __FPU_PRESENT                  1
+#define __FPU_USED                     0
+
+extern uint32_t SystemCoreClock;
+void SystemInit(void);
+void SystemCoreClockUpdate(void);
+
+// Core intrinsics and NVIC, implemented by the model
+void     NVIC_EnableIRQ(IRQn_Type irq);
+void     NVIC_DisableIRQ(IRQn_Type irq);
+uint32_t NVIC_GetEnableIRQ(IRQn_Type irq);
+void     NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type irq);
+void     NVIC_SetPendingIRQ(IRQn_Type irq);
+void     NVIC_ClearPendingIRQ(IRQn_Type irq);
+uint32_t SysTick_Config(uint32_t ticks);
+uint32_t ITM_SendChar(uint32_t ch);
+void     __WFI(void);
+void     __WFE(void);
+void     __SEV(void);
+void     __disable_irq(void);
+void     __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void     __set_PRIMASK(uint32_t primask);
+
+#define __DSB()        __sync_synchronize()
+#define __ISB()        __sync_synchronize()
+#define __DMB()        __sync_synchronize()
+#define __NOP()        ((void)0)
+#define __CLZ(x)       ((x) == 0 ? 32U : (uint32_t)__builtin_clz(x))
+#define __RBIT(x)      model_rbit(x)
+#define __REV(x)       __builtin_bswap32(x)
+#define __ROR(x, n)    (((uint32_t)(x) >> ((n) & 31U)) | ((uint32_t)(x) << ((32U - (n)) & 31U)))
+#define __SSAT(x, n)   model_ssat((int32_t)(x), n)
+#define __USAT(x, n)   model_usat((int32_t)(x), n)
+#define __PKHBT(a, b, n) (((uint32_t)(a) & 0x0000FFFFUL) | (((uint32_t)(b) << (n)) & 0xFFFF0000UL))
+#define __PKHTB(a, b, n) (((uint32_t)(a) & 0xFFFF0000UL) | (((uint32_t)(b) >> (n)) & 0x0000FFFFUL))
+#define __STATIC_INLINE static inline
+#define __WEAK          __attribute__((weak))
+#define __ALIGNED(x)    __attribute__((aligned(x)))
+
+static inline uint32_t model_rbit(uint32_t v){
+	uint32_t r = 0, i;
+	for(i=0; i<32; i++){ r = (r << 1) | (v & 1U); v >>= 1; }
+	return r;
+}
+
+// SSAT/USAT: saturate to n-bit signed, n-bit unsigned
+static inline int32_t model_ssat(int32_t v, uint32_t n){
+	int32_t max = (int32_t)((1UL << (n - 1U)) - 1U);
+	return v > max ? max : v < -max - 1 ? -max - 1 : v;
+}
+
+static inline uint32_t model_usat(int32_t v, uint32_t n){
+	uint32_t max = (uint32_t)((1ULL << n) - 1U);
+	return v < 0 ? 0U : (uint32_t)v > max ? max : (uint32_t)v;
+}
+
+#include "model.h"
+
+#endif /* HOST_STM32F446XX_H */
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "tone.h"
+
+/* Note-change latency of the TIM5 tone output on the host model
+
+ tone_bench [notes] [seed]
+
+ The notes of the music experiment, one at a random point of the
+ running period, two ways:
+   raw   TIM5->ARR written while the counter runs, no ARPE (the old
+         music loop): an ARR below CNT is only met after the counter
+         wraps at 2^32
+   tone  tone_set_hz(), ARR preloaded and committed at the update event
+ Latency is the time from the write to the update event that starts the
+ new note, against the period in flight when it was written; a stall is
+ no update within four periods (the bench restarts the counter then).
+ For tone the first period of the new note must also have its length.
+ Samples the host disturbed (this thread preempted) count under "host"
+ and are left out.
+
+ A glide from C4 to C6 and back checks that the staged periods move
+ monotonically, end on the target and take the requested time.
+
+ Exit code 1 when tone_set_hz() ever waits longer than the period in
+ flight, misses the period of a note or a glide goes wrong.
+*/
+
+#define BENCH_TICK_HZ  2000000UL      // TIM5 counter rate, as in the music experiment
+#define BENCH_TOL      (0.02)         // host timing slack on a period
+#define BENCH_TOL_US   (20.0)
+#define BENCH_GAP_US   (100.0)        // longer between two polls: preempted, sample dropped
+#define BENCH_NONE     (-1e9)         // no update event
+
+static const uint32_t bench_freq[8] = { 261, 294, 329, 349, 392, 440, 494, 522 };
+static const uint8_t  bench_song[32] = { 2, 2, 3, 2, 4, 4, 4, 4, 1, 1, 2, 1, 3, 3, 3, 3,
+                                         2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+static unsigned bench_seed;
+static int      bench_disturbed;
+
+static unsigned bench_rand(unsigned n){
+	bench_seed = bench_seed * 1103515245U + 12345U;
+	return (bench_seed >> 16) % n;
+}
+
+static double bench_us(uint64_t cycles){
+	return (double)cycles * 1e6 / (double)SystemCoreClock;
+}
+
+static void bench_wait_us(double us){
+	uint64_t end = model_cycles() + (uint64_t)(us * (double)SystemCoreClock / 1e6);
+	while(model_cycles() < end);
+}
+
+/*
+ Time in us from t0 to the next update event, BENCH_NONE when none
+ comes within limit_us. CNT after the poll that sees UIF takes out the polling
+ delay. The host may preempt this thread for more than a period; a gap
+ of BENCH_GAP_US between two polls, or of half the slack around the
+ CNT read, sets bench_disturbed and the sample is not counted.
+*/
+static double bench_update_us(uint64_t t0, double limit_us){
+	uint64_t t, last = model_cycles();
+	uint32_t cnt, uif;
+	for(;;){
+		uif = TIM5->SR & TIM_SR_UIF;
+		t = model_cycles();
+		if(bench_us(t - last) > BENCH_GAP_US) bench_disturbed = 1;
+		last = t;
+		if(uif) break;
+		if(bench_us(t - t0) > limit_us) return BENCH_NONE;
+	}
+	t   = model_cycles();
+	cnt = TIM5->CNT;
+	if(bench_us(model_cycles() - t) > BENCH_TOL_US / 2.0) bench_disturbed = 1;
+	TIM5->SR = ~(uint32_t)TIM_SR_UIF;
+	if(bench_us(model_cycles() - t) > BENCH_GAP_US) bench_disturbed = 1;   // may have cleared the next update too
+	return bench_us(t - t0) - (double)cnt * 1e6 / BENCH_TICK_HZ;
+}
+
+// Half a period in ticks less one, as tone_arr() and the music loop
+static uint32_t bench_arr(uint32_t hz){
+	return (BENCH_TICK_HZ + hz) / (2U * hz) - 1U;
+}
+
+static double bench_period_us(uint32_t arr){
+	return ((double)arr + 1.0) * 1e6 / BENCH_TICK_HZ;
+}
+
+// The old TIM5_CH1_Init(): toggle on match, CCR1 preloaded, ARR not
+static void bench_raw_init(uint32_t arr){
+	RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;
+	TIM5->CR1   = 0;
+	TIM5->DIER  = 0;
+	TIM5->ARR   = arr;
+	clock_tim_attach(TIM5, BENCH_TICK_HZ);
+	TIM5->CCMR1 = TIM_CCMR1_OC1M_0 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1PE;
+	TIM5->CCER  = TIM_CCER_CC1E;
+	TIM5->CR1  |= TIM_CR1_CEN;
+}
+
+/*
+ One pass over the song, returns the number of notes that waited longer
+ than the period in flight or (tone) whose first period was off.
+*/
+static unsigned bench_run(int use_tone, unsigned notes){
+	unsigned i, late = 0, stalls = 0, bad = 0, skipped = 0, measured = 0;
+	uint32_t arr, old_arr, prev;
+	double lat, worst = 0.0, sum = 0.0, first, limit;
+	uint64_t t0;
+
+	old_arr = bench_arr(bench_freq[bench_song[0]]);
+	if(use_tone){
+		tone_init(BENCH_TICK_HZ);
+		tone_set_hz(bench_freq[bench_song[0]]);
+	} else {
+		bench_raw_init(old_arr);
+	}
+	bench_update_us(model_cycles(), 4.0 * bench_period_us(old_arr));
+	TIM5->SR = ~(uint32_t)TIM_SR_UIF;
+
+	for(i = 0; i < notes; i++){
+		uint32_t hz = bench_freq[bench_song[(i + 1U) % 32U]];
+		bench_wait_us(bench_rand(1000U) * bench_period_us(old_arr) / 1000.0);
+		arr = bench_arr(hz);
+		limit = 4.0 * (bench_period_us(old_arr) + bench_period_us(arr));
+		TIM5->SR = ~(uint32_t)TIM_SR_UIF;
+		bench_disturbed = 0;
+		t0 = model_cycles();
+		if(use_tone) tone_set_hz(hz);
+		else         TIM5->ARR = arr;
+		if(bench_us(model_cycles() - t0) > BENCH_GAP_US) bench_disturbed = 1;
+		if(TIM5->SR & TIM_SR_UIF) bench_disturbed = 1;           // an update before the write was done
+		lat = bench_update_us(t0, limit);
+		if(lat == BENCH_NONE){                       // counting on to 2^32
+			stalls++;
+			TIM5->EGR = TIM_EGR_UG;
+			TIM5->SR = ~(uint32_t)TIM_SR_UIF;
+			old_arr = arr;
+			continue;
+		}
+		first = use_tone ? bench_update_us(t0, limit) - lat : bench_period_us(arr);
+		prev = old_arr;
+		old_arr = arr;
+		if(bench_disturbed || lat < 0.0){
+			skipped++;
+			continue;
+		}
+		sum += lat;
+		measured++;
+		if(lat > worst) worst = lat;
+		if(lat > bench_period_us(prev) * (1.0 + BENCH_TOL) + BENCH_TOL_US) late++;
+		if(first < bench_period_us(arr) * (1.0 - BENCH_TOL) - BENCH_TOL_US ||
+		   first > bench_period_us(arr) * (1.0 + BENCH_TOL) + BENCH_TOL_US) bad++;
+	}
+	fprintf(stderr, "%-5s %6u %8.0f %8.0f %7u %6u %6u %6u\n", use_tone ? "tone" : "raw", notes,
+	        measured ? sum / measured : 0.0, worst, late, stalls, bad, skipped);
+	return use_tone ? late + stalls + bad : 0U;
+}
+
+/*
+ Glide from_hz -> to_hz over ms: every ARR the update interrupt stages,
+ in order. They must move one way, end on tone_arr(to_hz) and the glide
+ must end after ms (plus the period in flight and the host slack).
+*/
+static unsigned bench_glide(uint32_t from_hz, uint32_t to_hz, uint32_t ms){
+	uint32_t arr, last, n = 0, wrong = 0, steps0 = tone_stats.steps;
+	uint64_t t0;
+	double took;
+
+	tone_set_hz(from_hz);
+	bench_wait_us(2.0 * bench_period_us(tone_arr(from_hz)));
+	t0 = model_cycles();
+	tone_glide(from_hz, to_hz, ms);
+	last = tone_arr(from_hz);
+	while(tone_gliding()){
+		__WFI();                                     // the update interrupt runs, as on the target
+		arr = TIM5->ARR;
+		if(arr != last){
+			if((to_hz > from_hz) != (arr < last)) wrong++;
+			last = arr;
+			n++;
+		}
+		if(bench_us(model_cycles() - t0) > 4000.0 * ms) break;
+	}
+	took = bench_us(model_cycles() - t0) / 1000.0;
+	arr = TIM5->ARR;
+	if(arr != tone_arr(to_hz)) wrong++;
+	if(took < ms * (1.0 - BENCH_TOL) || took > ms * (1.0 + BENCH_TOL) + 2.0 * bench_period_us(tone_arr(from_hz)) / 1000.0 + 2.0)
+		wrong++;
+	fprintf(stderr, "glide %4lu -> %4lu Hz in %3lu ms: %5.1f ms, %4lu steps, %3lu periods, %s\n",
+	        (unsigned long)from_hz, (unsigned long)to_hz, (unsigned long)ms, took,
+	        (unsigned long)(tone_stats.steps - steps0), (unsigned long)n, wrong ? "FAIL" : "ok");
+	return wrong;
+}
+
+int main(int argc, char **argv){
+	unsigned notes = argc > 1 ? (unsigned)strtoul(argv[1], 0, 10) : 256U;
+	unsigned fail;
+
+	bench_seed = argc > 2 ? (unsigned)strtoul(argv[2], 0, 10) : 1U;
+	setenv("MODEL_RUN_MS", "0", 1);                  // no wall-clock budget
+	model_reset();
+	model_start();
+	clock_set_profile(CLOCK_84MHZ);
+
+	fprintf(stderr, "%u note changes, TIM5 at %lu Hz, core %lu Hz\n",
+	        notes, (unsigned long)BENCH_TICK_HZ, (unsigned long)SystemCoreClock);
+	fprintf(stderr, "%-5s %6s %8s %8s %7s %6s %6s %6s\n", "mode", "notes", "avg us", "max us", "late", "stall", "pitch", "host");
+	fail  = bench_run(0, notes);
+	fail += bench_run(1, notes);
+	fail += bench_glide(262, 1047, 200);
+	fail += bench_glide(1047, 262, 200);
+	tone_set_hz(0);
+	model_finish();
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
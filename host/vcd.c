@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vcd.h"
+
+/* Value change dump writer, see vcd.h */
+
+#define VCD_MAX_WIRES   32
+#define VCD_BUF_BYTES   (1U << 20)
+#define VCD_LINE_BYTES  64U              // longest record: "#<t>\n" or "b<32 bits> <id>\n"
+
+typedef struct {
+	const char *scope;
+	const char *name;
+	uint32_t    width;
+	uint32_t    value;
+	int         known;                   // 0 until the first vcd_change()
+} vcd_wire_t;
+
+static FILE      *vcd_file;
+static char      *vcd_buf;
+static size_t     vcd_len;
+static vcd_wire_t vcd_wires[VCD_MAX_WIRES];
+static uint32_t   vcd_nwires;
+static uint64_t   vcd_time;
+static int        vcd_timed;             // a "#<t>" line is out
+
+static void vcd_flush(void){
+	if(vcd_len) fwrite(vcd_buf, 1, vcd_len, vcd_file);
+	vcd_len = 0;
+}
+
+static void vcd_putc(char c){
+	vcd_buf[vcd_len++] = c;
+}
+
+static void vcd_puts(const char *s){
+	while(*s) vcd_putc(*s++);
+}
+
+static void vcd_putu(uint64_t v){
+	char tmp[20];
+	int n = 0;
+	do {
+		tmp[n++] = (char)('0' + (v % 10U));
+		v /= 10U;
+	} while(v != 0);
+	while(n > 0) vcd_putc(tmp[--n]);
+}
+
+// Identifier: wire index in base 94, printable '!'..'~'
+static void vcd_putid(uint32_t sig){
+	do {
+		vcd_putc((char)('!' + sig % 94U));
+		sig /= 94U;
+	} while(sig != 0);
+}
+
+int vcd_open(const char *path){
+	vcd_file = fopen(path, "wb");
+	if(vcd_file == 0) return 1;
+	vcd_buf = malloc(VCD_BUF_BYTES);
+	if(vcd_buf == 0){
+		fclose(vcd_file);
+		vcd_file = 0;
+		return 1;
+	}
+	vcd_len = 0;
+	vcd_nwires = 0;
+	vcd_timed = 0;
+	return 0;
+}
+
+int vcd_active(void){
+	return vcd_file != 0;
+}
+
+uint32_t vcd_wire(const char *scope, const char *name, uint32_t width){
+	vcd_wire_t *w;
+	if(vcd_nwires >= VCD_MAX_WIRES) return VCD_MAX_WIRES - 1U;
+	w = &vcd_wires[vcd_nwires];
+	w->scope = scope;
+	w->name  = name;
+	w->width = width ? width : 1U;
+	w->known = 0;
+	return vcd_nwires++;
+}
+
+// Header, wires grouped by scope in declaration order, all values x at time 0
+void vcd_begin(void){
+	uint32_t i, j;
+	const char *scope = 0;
+	if(vcd_file == 0) return;
+
+	vcd_puts("$timescale 1ns $end\n$scope module model $end\n");
+	for(i=0; i<vcd_nwires; i++){
+		if(scope == 0 || strcmp(scope, vcd_wires[i].scope) != 0){
+			if(scope) vcd_puts("$upscope $end\n");
+			scope = vcd_wires[i].scope;
+			vcd_puts("$scope module ");  vcd_puts(scope);  vcd_puts(" $end\n");
+		}
+		vcd_puts("$var wire ");  vcd_putu(vcd_wires[i].width);  vcd_putc(' ');
+		vcd_putid(i);            vcd_putc(' ');
+		vcd_puts(vcd_wires[i].name);
+		vcd_puts(" $end\n");
+	}
+	if(scope) vcd_puts("$upscope $end\n");
+	vcd_puts("$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+	for(i=0; i<vcd_nwires; i++){
+		if(vcd_wires[i].width == 1) vcd_putc('x');
+		else {
+			vcd_putc('b');
+			for(j=0; j<vcd_wires[i].width; j++) vcd_putc('x');
+			vcd_putc(' ');
+		}
+		vcd_putid(i);
+		vcd_putc('\n');
+	}
+	vcd_puts("$end\n");
+	vcd_time = 0;
+	vcd_timed = 1;
+}
+
+void vcd_change(uint64_t t_ns, uint32_t sig, uint32_t value){
+	vcd_wire_t *w;
+	uint32_t bit;
+	if(vcd_file == 0 || sig >= vcd_nwires) return;
+	w = &vcd_wires[sig];
+	if(w->width < 32U) value &= (1UL << w->width) - 1U;
+	if(w->known && w->value == value) return;
+	w->known = 1;
+	w->value = value;
+
+	if(vcd_len > VCD_BUF_BYTES - VCD_LINE_BYTES) vcd_flush();
+	if(!vcd_timed || t_ns > vcd_time){
+		vcd_putc('#');
+		vcd_putu(t_ns);
+		vcd_putc('\n');
+		vcd_time = t_ns;
+		vcd_timed = 1;
+	}
+	if(w->width == 1){
+		vcd_putc((char)('0' + value));
+	} else {
+		vcd_putc('b');
+		for(bit = w->width; bit-- > 0; ) vcd_putc((char)('0' + ((value >> bit) & 1U)));
+		vcd_putc(' ');
+	}
+	vcd_putid(sig);
+	vcd_putc('\n');
+}
+
+void vcd_close(void){
+	if(vcd_file == 0) return;
+	vcd_flush();
+	fclose(vcd_file);
+	free(vcd_buf);
+	vcd_file = 0;
+	vcd_buf = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef HOST_VCD_H
+#define HOST_VCD_H
+
+#include <stdint.h>
+
+/* Value change dump writer for the host model
+
+ One dump per process. Signals are declared with vcd_wire() before
+ vcd_begin(), then vcd_change() appends a value at a time in ns; times
+ must not go backwards and unchanged values are skipped. Output goes
+ through a 1 MiB buffer and leaves in large fwrite() batches, so
+ millions of changes cost little more than the formatting.
+
+	vcd_open("run.vcd");
+	pa5 = vcd_wire("gpio", "PA5", 1);
+	vcd_begin();
+	vcd_change(t_ns, pa5, 1);
+	...
+	vcd_close();
+*/
+
+int      vcd_open(const char *path);
+uint32_t vcd_wire(const char *scope, const char *name, uint32_t width);
+void     vcd_begin(void);
+void     vcd_change(uint64_t t_ns, uint32_t sig, uint32_t value);
+int      vcd_active(void);
+void     vcd_close(void);
+
+#endif /* HOST_VCD_H */
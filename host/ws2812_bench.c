@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f446xx.h"
+#include "model.h"
+#include "clock.h"
+#include "ws2812.h"
+
+/* WS2812 bit encoding, timings and DMA path on the host
+
+ ws2812_bench [leds]
+
+ Encoding: random frames through ws2812_encode(), every duty word read
+ back as a bit (above or below the midpoint of t0 and t1) and compared
+ with the frame, MSB first, and ws2812_set() in GRB order.
+
+ Timings: ws2812_timing() at the APB1 timer clock of every clock.h
+ profile against the WS2812B limits (T0H 0.4 us, T1H 0.8 us +-150 ns,
+ period 1.25 us +-600 ns).
+
+ Speed: ns per LED of ws2812_encode(), host figures, and the share of
+ the wire time (30 us per LED) it takes.
+
+ DMA: a frame of leds (default 64) on the host model at 84 MHz. It must
+ end after 30 us per LED plus the latch with every half refilled on
+ time; a switch to 16 MHz in the middle of a frame must restart it with
+ the new ARR and still end. A frame the host disturbed (late halves,
+ length off) runs again, at most BENCH_TRIES times.
+
+ Exit code 1 when a bit, a timing or the DMA path is off.
+*/
+
+#define BENCH_FRAMES    2000U
+#define BENCH_PASS_NS   300000000ULL
+#define BENCH_MAX_LEDS  1024U
+#define BENCH_TRIES     3U        // frames the host disturbed run again
+
+static uint8_t  bench_frame[3U * BENCH_MAX_LEDS];
+static uint32_t bench_words[WS2812_BITS * BENCH_MAX_LEDS];
+
+static uint64_t bench_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned bench_bits(void){
+	ws2812_timing_t t;
+	uint32_t f, i, k, leds, bad = 0, mid;
+	uint8_t  grb[3];
+
+	ws2812_timing(84000000UL, &t);
+	mid = (t.t0 + t.t1) / 2U;
+	srand(7);
+	for(f=0; f<BENCH_FRAMES; f++){
+		leds = 1U + (uint32_t)rand() % 64U;
+		for(i=0; i<3U * leds; i++) bench_frame[i] = (uint8_t)rand();
+		ws2812_encode(bench_frame, 3U * leds, bench_words, t.t0, t.t1);
+		for(i=0; i<3U * leds; i++)
+			for(k=0; k<8U; k++){
+				uint32_t w = bench_words[8U * i + k];
+				if((w != t.t0 && w != t.t1) || (w > mid) != ((bench_frame[i] >> (7U - k)) & 1U)) bad++;
+			}
+	}
+	ws2812_set(grb, 0, 0x11, 0x22, 0x33);
+	if(grb[0] != 0x22 || grb[1] != 0x11 || grb[2] != 0x33) bad++;
+	fprintf(stderr, "bits: %u frames, %lu words off  %s\n", BENCH_FRAMES, (unsigned long)bad, bad ? "FAIL" : "ok");
+	return bad != 0;
+}
+
+static unsigned bench_timing(void){
+	static const uint32_t hz[] = { 16000000UL, 42000000UL, 84000000UL };
+	ws2812_timing_t t;
+	double ns, period, h0, h1;
+	unsigned i, bad = 0, b;
+
+	for(i=0; i<sizeof hz / sizeof hz[0]; i++){
+		ws2812_timing(hz[i], &t);
+		ns     = 1e9 / hz[i];
+		period = (t.arr + 1U) * ns;
+		h0     = t.t0 * ns;
+		h1     = t.t1 * ns;
+		b = period < 650.0 || period > 1850.0 || h0 < 250.0 || h0 > 550.0 || h1 < 650.0 || h1 > 950.0;
+		fprintf(stderr, "timer %2lu MHz: ARR %3lu t0 %2lu t1 %2lu, period %6.1f ns, T0H %5.1f ns, T1H %5.1f ns  %s\n",
+		        (unsigned long)(hz[i] / 1000000UL), (unsigned long)t.arr, (unsigned long)t.t0, (unsigned long)t.t1,
+		        period, h0, h1, b ? "FAIL" : "ok");
+		bad += b;
+	}
+	return bad;
+}
+
+static void bench_speed(uint32_t leds){
+	ws2812_timing_t t;
+	uint64_t t0 = bench_ns(), el, n = 0;
+	volatile uint32_t sink = 0;
+	double ns;
+
+	ws2812_timing(84000000UL, &t);
+	do {
+		ws2812_encode(bench_frame, 3U * leds, bench_words, t.t0, t.t1);
+		sink += bench_words[n % (WS2812_BITS * leds)];
+		n += leds;
+		el = bench_ns() - t0;
+	} while(el < BENCH_PASS_NS);
+	ns = (double)el / (double)n;
+	fprintf(stderr, "encode: %.2f ns/LED, %.3f %% of the 30 us wire time\n", ns, 100.0 * ns / 30000.0);
+	(void)sink;
+}
+
+// Sleeps while a frame is on air, up to model cycle end. The check runs
+// with PRIMASK set as in idle_enter(): the last interrupt of the frame
+// cannot slip in between it and __WFI() and leave nothing to wake up.
+static void bench_wait(uint64_t end){
+	for(;;){
+		__disable_irq();
+		if(!ws2812_busy() || model_cycles() >= end) break;
+		__WFI();
+		__enable_irq();
+	}
+	__enable_irq();
+}
+
+/*
+ One frame on the model; switch_us > 0 switches to 16 MHz that far into
+ it. Late halves or a frame length off the wire time mean the model
+ thread or this one was preempted (one host CPU): such a frame runs
+ again, up to BENCH_TRIES times. Frame count, restarts and ARR never do.
+*/
+static unsigned bench_dma(uint32_t leds, uint32_t switch_us){
+	uint32_t i, halves, restarts, frames, arr, late, want_us, took_us, tries = 0;
+	uint64_t start, end, limit;
+	unsigned bad, host;
+
+	for(i=0; i<leds; i++) ws2812_set(bench_frame, i, (uint8_t)i, (uint8_t)(255U - i), 0x5A);
+	want_us = leds * 30U + WS2812_LATCH_US;
+	do {
+		tries++;
+		setenv("MODEL_RUN_MS", "0", 1);
+		model_reset();
+		model_start();
+		clock_set_profile(CLOCK_84MHZ);
+		ws2812_init();
+		halves   = ws2812_stats.halves;
+		restarts = ws2812_stats.restarts;
+		frames   = ws2812_stats.frames;
+		late     = ws2812_stats.late;
+		start    = model_cycles();
+		limit    = start + (uint64_t)SystemCoreClock / 10U;  // 100 ms at most
+		ws2812_show(bench_frame, leds);
+		if(switch_us){
+			end = start + (uint64_t)SystemCoreClock / 1000000U * switch_us;
+			bench_wait(end);
+			clock_set_profile(CLOCK_16MHZ);
+			start = model_cycles();                          // the frame starts over here
+		}
+		bench_wait(limit);
+		took_us  = (uint32_t)((model_cycles() - start) * 1000000U / SystemCoreClock);
+		arr      = TIM2->ARR;
+		halves   = ws2812_stats.halves - halves;
+		restarts = ws2812_stats.restarts - restarts;
+		frames   = ws2812_stats.frames - frames;
+		late     = ws2812_stats.late - late;
+		model_finish();
+
+		host = late != 0U || took_us < want_us || took_us > want_us + 3U * 240U + (switch_us ? 3U * 240U : 0U);
+		bad  = frames != 1U || restarts != (switch_us ? 1U : 0U) || arr != (switch_us ? 19U : 104U);
+	} while(host && !bad && tries < BENCH_TRIES);
+	bad |= host;
+	fprintf(stderr, "dma: %lu LEDs%s in %lu us (wire %lu us), %lu halves, %lu late, %lu restarts, ARR %lu, try %lu  %s\n",
+	        (unsigned long)leds, switch_us ? ", 16 MHz mid-frame," : "", (unsigned long)took_us, (unsigned long)want_us,
+	        (unsigned long)halves, (unsigned long)late, (unsigned long)restarts, (unsigned long)arr, (unsigned long)tries,
+	        bad ? "FAIL" : "ok");
+	return bad;
+}
+
+int main(int argc, char **argv){
+	uint32_t leds = argc > 1 ? (uint32_t)strtoul(argv[1], 0, 0) : 64U;
+	unsigned fail = 0;
+
+	if(leds == 0U || leds > BENCH_MAX_LEDS) leds = 64U;
+	fail += bench_bits();
+	fail += bench_timing();
+	bench_speed(leds);
+	fail += bench_dma(leds, 0);
+	fail += bench_dma(leds, leds * 15U);
+	fprintf(stderr, "%s\n", fail ? "FAIL" : "ok");
+	return fail ? 1 : 0;
+}
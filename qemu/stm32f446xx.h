@@ -0,0 +1,89 @@
+#ifndef QEMU_STM32F446XX_H
+#define QEMU_STM32F446XX_H
+
+/* STM32F446 device header for the QEMU build (FW_QEMU)
+
+ qemu-system-arm -M netduinoplus2 runs the Cortex-M4 core, NVIC,
+ SysTick and semihosting of the firmware as they are, but has no model
+ of the RCC, GPIO, EXTI or of most STM32F446 blocks: their registers
+ read as zero and every ready-flag poll hangs. This header includes the
+ CMSIS one and points those peripherals at stub register blocks in
+ SRAM (qemu/stub.c). Every access goes through stub_sync() first, so
+ the stub updates ready flags, pins and timer outputs before the
+ firmware looks, even with interrupts masked.
+
+ Stubbed: RCC, PWR, FLASH, GPIOA-C, SYSCFG, EXTI, TIM2, TIM5, RTC,
+ USART2, DMA1 Stream0, Stream1 and Stream6, DWT, CoreDebug, ITM.
+ ITM_SendChar() goes to the semihosting console.
+
+ The QEMU TIM2 (time base) and TIM4 (stub tick) are used by the stub
+ itself at their real addresses.
+*/
+
+#include_next <stm32f446xx.h>
+
+#ifdef QEMU_BUILD
+
+extern GPIO_TypeDef       stub_GPIOA, stub_GPIOB, stub_GPIOC;
+extern RCC_TypeDef        stub_RCC;
+extern PWR_TypeDef        stub_PWR;
+extern FLASH_TypeDef      stub_FLASH;
+extern SYSCFG_TypeDef     stub_SYSCFG;
+extern EXTI_TypeDef       stub_EXTI;
+extern TIM_TypeDef        stub_TIM2, stub_TIM5;
+extern RTC_TypeDef        stub_RTC;
+extern USART_TypeDef      stub_USART2;
+extern DMA_TypeDef        stub_DMA1;
+extern DMA_Stream_TypeDef stub_DMA1_Stream0, stub_DMA1_Stream1, stub_DMA1_Stream6;
+extern DWT_Type           stub_DWT;
+extern CoreDebug_Type     stub_CoreDebug;
+extern ITM_Type           stub_ITM;
+
+void     stub_sync(void);
+uint32_t stub_itm_putc(uint32_t ch);
+
+#undef  GPIOA
+#undef  GPIOB
+#undef  GPIOC
+#undef  RCC
+#undef  PWR
+#undef  FLASH
+#undef  SYSCFG
+#undef  EXTI
+#undef  TIM2
+#undef  TIM5
+#undef  RTC
+#undef  USART2
+#undef  DMA1
+#undef  DMA1_Stream0
+#undef  DMA1_Stream1
+#undef  DMA1_Stream6
+#undef  DWT
+#undef  CoreDebug
+#undef  ITM
+
+#define GPIOA         (stub_sync(), &stub_GPIOA)
+#define GPIOB         (stub_sync(), &stub_GPIOB)
+#define GPIOC         (stub_sync(), &stub_GPIOC)
+#define RCC           (stub_sync(), &stub_RCC)
+#define PWR           (stub_sync(), &stub_PWR)
+#define FLASH         (stub_sync(), &stub_FLASH)
+#define SYSCFG        (stub_sync(), &stub_SYSCFG)
+#define EXTI          (stub_sync(), &stub_EXTI)
+#define TIM2          (stub_sync(), &stub_TIM2)
+#define TIM5          (stub_sync(), &stub_TIM5)
+#define RTC           (stub_sync(), &stub_RTC)
+#define USART2        (stub_sync(), &stub_USART2)
+#define DMA1          (stub_sync(), &stub_DMA1)
+#define DMA1_Stream0  (stub_sync(), &stub_DMA1_Stream0)
+#define DMA1_Stream1  (stub_sync(), &stub_DMA1_Stream1)
+#define DMA1_Stream6  (stub_sync(), &stub_DMA1_Stream6)
+#define DWT           (stub_sync(), &stub_DWT)
+#define CoreDebug     (stub_sync(), &stub_CoreDebug)
+#define ITM           (&stub_ITM)
+
+#define ITM_SendChar(ch)  stub_itm_putc(ch)
+
+#endif /* QEMU_BUILD */
+
+#endif /* QEMU_STM32F446XX_H */
@@ -0,0 +1,10 @@
+#ifndef QEMU_STM32F4XX_H
+#define QEMU_STM32F4XX_H
+
+/* CMSIS family header for the QEMU build: system_stm32f4xx.c includes
+   this one, the stub peripherals of qemu/stm32f446xx.h apply there too */
+
+#include_next <stm32f4xx.h>
+#include "stm32f446xx.h"
+
+#endif /* QEMU_STM32F4XX_H */
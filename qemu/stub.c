@@ -0,0 +1,599 @@
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f446xx.h"
+
+/* Stub peripherals for the QEMU build, see qemu/stm32f446xx.h
+
+ Time is QEMU virtual time, read from the netduinoplus2 TIM2 counting
+ at QEMU_TIM_HZ. Run under -icount shift=0 one instruction takes one
+ virtual ns, runs are deterministic and DWT->CYCCNT (the virtual ns
+ while enabled) counts instructions, so PROF_DUMP() regions are
+ instruction counts.
+
+ Output over the semihosting console, one line each:
+   QEMU PIN <t_ns> <pin> <0|1>     PA0, PA5-PA9, PC13 changes
+   QEMU END <t_ns> <core_hz> <odr_a> <odr_c>
+ ITM and USART2 text go out as they are. Arguments (semihosting
+ command line, tools/qemu_run.py): run_ms=<n> input=PC13@50=0,...
+
+ Same behaviour as the host model (host/model.c) where it matters
+ here, with these simplifications:
+ - ready flags follow their enable bits at once, no Stop mode
+ - EXTI PR bits clear once their handler has run (the stub cannot tell
+   a write-1-to-clear from the value it holds)
+ - USART2 DMA transfers complete at once, TC with them
+ - the update DMA requests are served on DMA1 Stream0 (TIM5) and
+   Stream1 (TIM2) only
+ - SysTick is QEMU's and counts at the netduinoplus2 core clock
+*/
+
+#ifndef QEMU_TIM_HZ
+#define QEMU_TIM_HZ      1000000000ULL   // stm32f2xx_timer clock of the netduinoplus2 SoC
+#endif
+#define STUB_TICK_NS     50000ULL        // TIM4 tick: inputs, sampling, end of run
+#define STUB_MAX_INPUTS  64
+#define STUB_LINE_BYTES  128
+
+#define STUB_CLOCK       ((TIM_TypeDef *)TIM2_BASE)   // QEMU timers, not the stubs
+#define STUB_TICK        ((TIM_TypeDef *)TIM4_BASE)
+
+GPIO_TypeDef       stub_GPIOA, stub_GPIOB, stub_GPIOC;
+RCC_TypeDef        stub_RCC;
+PWR_TypeDef        stub_PWR;
+FLASH_TypeDef      stub_FLASH;
+SYSCFG_TypeDef     stub_SYSCFG;
+EXTI_TypeDef       stub_EXTI;
+TIM_TypeDef        stub_TIM2, stub_TIM5;
+RTC_TypeDef        stub_RTC;
+USART_TypeDef      stub_USART2;
+DMA_TypeDef        stub_DMA1;
+DMA_Stream_TypeDef stub_DMA1_Stream0, stub_DMA1_Stream1, stub_DMA1_Stream6;
+DWT_Type           stub_DWT;
+CoreDebug_Type     stub_CoreDebug;
+ITM_Type           stub_ITM;
+
+// Profiling report from common/prof.c when the run is built with PROFILE
+void prof_dump(void) __attribute__((weak));
+
+typedef struct {
+	uint64_t at_ns;
+	char     port;
+	uint8_t  pin;
+	uint8_t  level;
+} stub_input_t;
+
+typedef struct {
+	TIM_TypeDef *tim;
+	IRQn_Type    irq;             // update interrupt
+	int          running;
+	uint64_t     start_ns;        // update event that opened the period
+	uint64_t     tick_ps, period_ps;
+	uint64_t     match_ps;        // CCR1 match in this period, 0: none
+	uint32_t     matched;
+	uint32_t     level;           // OC1REF
+	DMA_Stream_TypeDef *dma;      // stream of the update DMA request
+	uint32_t     chsel;
+	IRQn_Type    dma_irq;
+	uint32_t     dma_shift;       // its flags in LISR, as for stream 0
+	uint32_t     dma_ndtr;        // NDTR as programmed, 0: not enabled
+} stub_timer_t;
+
+typedef struct {
+	GPIO_TypeDef *gpio;
+	uint8_t       pin;
+	char          name[5];
+	uint8_t       level;          // 2: not reported yet
+} stub_pin_t;
+
+static stub_input_t stub_inputs[STUB_MAX_INPUTS];
+static uint32_t     stub_ninputs, stub_next_input;
+static uint64_t     stub_end_ns;
+static uint64_t     stub_now_ns;
+static uint32_t     stub_clock_last;
+static uint64_t     stub_clock_high;
+static uint32_t     stub_cyccnt_base;
+static uint32_t     stub_exti_raised;        // lines the stub set in PR
+static uint32_t     stub_exti_seen;          // ... whose handler has been active since
+static stub_timer_t stub_timers[2] = {
+	{ &stub_TIM2, TIM2_IRQn, .dma = &stub_DMA1_Stream1, .chsel = 3, .dma_irq = DMA1_Stream1_IRQn, .dma_shift = 6 },
+	{ &stub_TIM5, TIM5_IRQn, .dma = &stub_DMA1_Stream0, .chsel = 6, .dma_irq = DMA1_Stream0_IRQn, .dma_shift = 0 }
+};
+static stub_pin_t   stub_pins[] = {
+	{ &stub_GPIOA,  0, "PA0",  2 },
+	{ &stub_GPIOA,  5, "PA5",  2 },
+	{ &stub_GPIOA,  6, "PA6",  2 },
+	{ &stub_GPIOA,  7, "PA7",  2 },
+	{ &stub_GPIOA,  8, "PA8",  2 },
+	{ &stub_GPIOA,  9, "PA9",  2 },
+	{ &stub_GPIOC, 13, "PC13", 2 },
+};
+#define STUB_PINS (sizeof stub_pins / sizeof stub_pins[0])
+static char         stub_itm_line[STUB_LINE_BYTES];
+static uint32_t     stub_itm_len;
+static int          stub_started;
+
+/////////////////////////////// Semihosting ///////////////////////////////
+
+#define SYS_WRITE0       0x04
+#define SYS_GET_CMDLINE  0x15
+#define SYS_EXIT         0x18
+#define ADP_STOPPED_APPLICATION_EXIT  0x20026
+
+static int stub_semihost(int op, void *arg){
+	register int   r0 __asm__("r0") = op;
+	register void *r1 __asm__("r1") = arg;
+	__asm__ volatile("bkpt 0xAB" : "+r"(r0) : "r"(r1) : "memory");
+	return r0;
+}
+
+static void stub_puts(const char *s){
+	stub_semihost(SYS_WRITE0, (void *)s);
+}
+
+static char *stub_putu(char *p, uint64_t v){
+	char tmp[20];
+	int n = 0;
+	do {
+		tmp[n++] = (char)('0' + (v % 10U));
+		v /= 10U;
+	} while(v != 0);
+	while(n > 0) *p++ = tmp[--n];
+	return p;
+}
+
+static char *stub_puthex(char *p, uint32_t v, uint32_t digits){
+	while(digits-- > 0) *p++ = "0123456789abcdef"[(v >> (4U * digits)) & 0xFU];
+	return p;
+}
+
+/////////////////////////////// Clock tree ///////////////////////////////
+
+static uint32_t stub_core_hz(void){
+	uint32_t pllm, plln, pllp;
+	if((stub_RCC.CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL) return 16000000UL;
+	pllm = (stub_RCC.PLLCFGR & RCC_PLLCFGR_PLLM) >> RCC_PLLCFGR_PLLM_Pos;
+	plln = (stub_RCC.PLLCFGR & RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos;
+	pllp = ((((stub_RCC.PLLCFGR & RCC_PLLCFGR_PLLP) >> RCC_PLLCFGR_PLLP_Pos) + 1U) * 2U);
+	if(pllm == 0) pllm = 1;
+	return (uint32_t)(16000000ULL / pllm * plln / pllp);
+}
+
+// APB1 timer clock: PCLK1, doubled when the prescaler is not 1
+static uint32_t stub_apb1_timer_hz(void){
+	static const uint8_t ahb[16] = {0,0,0,0,0,0,0,0,1,2,3,4,6,7,8,9};
+	static const uint8_t apb[8]  = {0,0,0,0,1,2,3,4};
+	uint32_t hclk  = stub_core_hz() >> ahb[(stub_RCC.CFGR & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+	uint32_t shift = apb[((stub_RCC.CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos) & 7U];
+	return shift ? (hclk >> shift) * 2U : hclk;
+}
+
+static void stub_status(__IO uint32_t *reg, uint32_t bits, uint32_t set){
+	if(set) *reg |= bits;
+	else    *reg &= ~bits;
+}
+
+/////////////////////////////// Pins and timers ///////////////////////////////
+
+// 0 TIM2 / 1 TIM5 for a pin in alternate function on its channel 1, -1 otherwise
+static int stub_pin_timer(const stub_pin_t *p){
+	uint32_t af;
+	if(((p->gpio->MODER >> (2U * p->pin)) & 3U) != 2U || p->gpio != &stub_GPIOA) return -1;
+	af = (p->gpio->AFR[p->pin / 8U] >> (4U * (p->pin % 8U))) & 0xFU;
+	if(af == 1U && (p->pin == 0 || p->pin == 5)) return 0;
+	if(af == 2U && p->pin == 0) return 1;
+	return -1;
+}
+
+static uint32_t stub_timer_out(const stub_timer_t *t){
+	if((t->tim->CCER & TIM_CCER_CC1E) == 0) return 0;
+	return t->level ^ ((t->tim->CCER & TIM_CCER_CC1P) ? 1U : 0U);
+}
+
+static void stub_pin_report(stub_pin_t *p, uint32_t level, uint64_t at_ns){
+	char line[48], *s = line;
+	if(p->level == level) return;
+	p->level = (uint8_t)level;
+	memcpy(s, "QEMU PIN ", 9);        s += 9;
+	s = stub_putu(s, at_ns);          *s++ = ' ';
+	memcpy(s, p->name, strlen(p->name));  s += strlen(p->name);
+	*s++ = ' ';
+	*s++ = (char)('0' + level);
+	*s++ = '\n';
+	*s = 0;
+	stub_puts(line);
+}
+
+static void stub_timer_emit(stub_timer_t *t, uint64_t at_ns){
+	uint32_t i;
+	for(i=0; i<STUB_PINS; i++)
+		if(stub_pin_timer(&stub_pins[i]) == (int)(t - stub_timers))
+			stub_pin_report(&stub_pins[i], stub_timer_out(t), at_ns);
+}
+
+// Latch PSC/ARR/CCR1/OC1M at an update event; PWM modes start the period active
+static void stub_timer_period(stub_timer_t *t, uint64_t at_ps){
+	uint32_t hz = stub_apb1_timer_hz(), ccr = t->tim->CCR1, arr = t->tim->ARR;
+	uint32_t mode = (t->tim->CCMR1 & TIM_CCMR1_OC1M) >> TIM_CCMR1_OC1M_Pos;
+	t->start_ns  = at_ps / 1000U;
+	t->tick_ps   = ((uint64_t)(t->tim->PSC & 0xFFFFU) + 1U) * 1000000000000ULL / (hz ? hz : 1U);
+	if(t->tick_ps == 0) t->tick_ps = 1;
+	t->period_ps = ((uint64_t)arr + 1U) * t->tick_ps;
+	t->match_ps  = ccr <= arr ? at_ps + (uint64_t)ccr * t->tick_ps : 0;
+	t->matched   = 0;
+	if(mode == 6U || mode == 7U) t->level = (ccr > 0) == (mode == 6U);
+	else if(mode == 4U)          t->level = 0;
+	else if(mode == 5U)          t->level = 1;
+	stub_timer_emit(t, at_ps / 1000U);
+}
+
+/*
+ TIM2_UP (DMA1 Stream1 channel 3) and TIM5_UP (Stream0 channel 6), UDE:
+ one item per update event into a register of the timer, after the
+ period has latched its preload registers. Circular streams reload
+ NDTR; HTIF/TCIF pend the stream interrupt.
+*/
+static void stub_timer_dma(stub_timer_t *t){
+	DMA_Stream_TypeDef *s = t->dma;
+	uint32_t size, at;
+	if((t->tim->DIER & TIM_DIER_UDE) == 0) return;
+	if((s->CR & DMA_SxCR_EN) == 0 || ((s->CR & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) != t->chsel || s->NDTR == 0) return;
+	if(t->dma_ndtr == 0) t->dma_ndtr = s->NDTR;
+	size = 1U << ((s->CR >> DMA_SxCR_PSIZE_Pos) & 3U);
+	at   = (s->CR & DMA_SxCR_MINC) ? (t->dma_ndtr - s->NDTR) * size : 0U;
+	if(s->PAR >= (uint32_t)t->tim && s->PAR + size <= (uint32_t)(t->tim + 1))
+		memcpy((void *)s->PAR, (const void *)(s->M0AR + at), size);
+	s->NDTR--;
+	if(s->NDTR == t->dma_ndtr / 2U){
+		stub_DMA1.LISR |= DMA_LISR_HTIF0 << t->dma_shift;
+		if(s->CR & DMA_SxCR_HTIE) NVIC_SetPendingIRQ(t->dma_irq);
+	}
+	if(s->NDTR == 0){
+		stub_DMA1.LISR |= DMA_LISR_TCIF0 << t->dma_shift;
+		if(s->CR & DMA_SxCR_TCIE) NVIC_SetPendingIRQ(t->dma_irq);
+		if(s->CR & DMA_SxCR_CIRC){
+			s->NDTR = t->dma_ndtr;
+		} else {
+			s->CR &= ~DMA_SxCR_EN;
+			t->dma_ndtr = 0;
+		}
+	}
+}
+
+/*
+ Timer outputs up to now: one CCR1 match per period (toggle, active,
+ inactive, end of the PWM active phase) and the update event, which
+ sets UIF and pends the update interrupt under UIE. Runs of whole
+ periods are walked one by one, the stub tick keeps them short. SR is
+ rc_w0 and UIF the only flag kept.
+*/
+static void stub_timers_advance(uint64_t now_ns){
+	stub_timer_t *t;
+	uint64_t now_ps = now_ns * 1000U, end_ps;
+	uint32_t i, mode;
+	for(i=0; i<2; i++){
+		t = &stub_timers[i];
+		t->tim->SR &= TIM_SR_UIF;
+		if(t->tim->EGR & TIM_EGR_UG){
+			t->tim->EGR = 0;
+			if(t->running) stub_timer_period(t, now_ps);
+		}
+		if(!t->running && (t->tim->CR1 & TIM_CR1_CEN)){
+			t->running = 1;
+			stub_timer_period(t, now_ps);
+		}
+		if(t->running && (t->tim->CR1 & TIM_CR1_CEN) == 0) t->running = 0;
+		if(!t->running) continue;
+
+		for(;;){
+			end_ps = t->start_ns * 1000U + t->period_ps;
+			if(t->match_ps && !t->matched && t->match_ps <= now_ps && t->match_ps < end_ps){
+				mode = (t->tim->CCMR1 & TIM_CCMR1_OC1M) >> TIM_CCMR1_OC1M_Pos;
+				if(mode == 1U)                    t->level = 1;
+				else if(mode == 2U)               t->level = 0;
+				else if(mode == 3U)               t->level ^= 1U;
+				else if(mode == 6U || mode == 7U) t->level = mode == 7U;
+				t->matched = 1;
+				stub_timer_emit(t, t->match_ps / 1000U);
+				continue;
+			}
+			if(end_ps > now_ps) break;
+			stub_timer_period(t, end_ps);
+			t->tim->SR |= TIM_SR_UIF;
+			if(t->tim->DIER & TIM_DIER_UIE) NVIC_SetPendingIRQ(t->irq);
+			stub_timer_dma(t);
+		}
+		t->tim->CNT = (uint32_t)((now_ps - t->start_ns * 1000U) / t->tick_ps);
+	}
+}
+
+static void stub_pins_sample(uint64_t now_ns){
+	uint32_t i, mode;
+	int tim;
+	stub_pin_t *p;
+	for(i=0; i<STUB_PINS; i++){
+		p = &stub_pins[i];
+		mode = (p->gpio->MODER >> (2U * p->pin)) & 3U;
+		tim = stub_pin_timer(p);
+		if(tim >= 0)        stub_pin_report(p, stub_timer_out(&stub_timers[tim]), now_ns);
+		else if(mode == 1U) stub_pin_report(p, (p->gpio->ODR >> p->pin) & 1U, now_ns);
+		else                stub_pin_report(p, (p->gpio->IDR >> p->pin) & 1U, now_ns);
+	}
+}
+
+/////////////////////////////// EXTI ///////////////////////////////
+
+static IRQn_Type stub_exti_irq(uint32_t line){
+	if(line == 0)  return EXTI0_IRQn;
+	if(line <= 4)  return (IRQn_Type)(EXTI1_IRQn + (int)line - 1);
+	if(line <= 9)  return EXTI9_5_IRQn;
+	if(line <= 15) return EXTI15_10_IRQn;
+	return RTC_WKUP_IRQn;                        // line 22, the only other one raised here
+}
+
+static void stub_exti_raise(uint32_t line){
+	uint32_t bit = 1UL << line;
+	if((stub_EXTI.IMR & bit) == 0) return;
+	stub_EXTI.PR |= bit;
+	stub_exti_raised |= bit;
+	stub_exti_seen &= ~bit;
+	NVIC_SetPendingIRQ(stub_exti_irq(line));
+}
+
+// A raised PR bit stays until its handler has been active and returned
+static void stub_exti_retire(void){
+	uint32_t line, bit;
+	IRQn_Type irq;
+	for(line=0; line<23; line++){
+		bit = 1UL << line;
+		if((stub_exti_raised & bit) == 0) continue;
+		irq = stub_exti_irq(line);
+		if(NVIC_GetActive(irq)){
+			stub_exti_seen |= bit;
+		} else if((stub_exti_seen & bit) && !NVIC_GetPendingIRQ(irq)){
+			stub_EXTI.PR &= ~bit;
+			stub_exti_raised &= ~bit;
+		}
+	}
+}
+
+static void stub_set_input(char port, uint32_t pin, uint32_t level){
+	GPIO_TypeDef *gpio = port == 'A' ? &stub_GPIOA : port == 'B' ? &stub_GPIOB : port == 'C' ? &stub_GPIOC : 0;
+	uint32_t bit = 1UL << pin, old;
+	if(gpio == 0 || pin > 15) return;
+	old = gpio->IDR & bit;
+	if(level) gpio->IDR |= bit;
+	else      gpio->IDR &= ~bit;
+	if(old == (gpio->IDR & bit)) return;
+	if(((stub_SYSCFG.EXTICR[pin / 4] >> (4 * (pin % 4))) & 0xFU) != (uint32_t)(port - 'A')) return;
+	if(( level && (stub_EXTI.RTSR & bit)) || (!level && (stub_EXTI.FTSR & bit))) stub_exti_raise(pin);
+}
+
+/////////////////////////////// RTC, USART2 DMA ///////////////////////////////
+
+static uint64_t stub_rtc_t0_ns, stub_wut_due_ns;
+
+// Wakeup timer on LSI 32 kHz: WUTF and EXTI line 22
+static void stub_rtc(uint64_t now){
+	uint64_t prediv_a, prediv_s, apre, period;
+	uint32_t sel;
+	if((stub_RCC.BDCR & RCC_BDCR_RTCEN) == 0 || (stub_RTC.ISR & RTC_ISR_INIT)){
+		stub_rtc_t0_ns = now;
+		stub_wut_due_ns = 0;
+		stub_RTC.SSR = stub_RTC.PRER & RTC_PRER_PREDIV_S;
+		return;
+	}
+	prediv_a = ((stub_RTC.PRER >> RTC_PRER_PREDIV_A_Pos) & 0x7FU) + 1U;
+	prediv_s = (stub_RTC.PRER & RTC_PRER_PREDIV_S) + 1U;
+	apre = (now - stub_rtc_t0_ns) * 32000U / prediv_a / 1000000000ULL;
+	stub_RTC.SSR = (uint32_t)(prediv_s - 1U - apre % prediv_s);
+	stub_RTC.ISR |= RTC_ISR_RSF;
+
+	if((stub_RTC.CR & RTC_CR_WUTE) == 0){
+		stub_wut_due_ns = 0;
+		return;
+	}
+	sel = stub_RTC.CR & RTC_CR_WUCKSEL;
+	period = sel < 4U ? ((stub_RTC.WUTR & 0xFFFFU) + 1ULL) * (16U >> sel) * 1000000000ULL / 32000U
+	                  : ((stub_RTC.WUTR & 0xFFFFU) + 1ULL) * 1000000000ULL;
+	if(stub_wut_due_ns == 0) stub_wut_due_ns = now + period;
+	while(now >= stub_wut_due_ns){
+		stub_RTC.ISR |= RTC_ISR_WUTF;
+		if(stub_EXTI.RTSR & EXTI_RTSR_TR22) stub_exti_raise(22);
+		stub_wut_due_ns += period;
+	}
+}
+
+static void stub_uart_dma(void){
+	DMA_Stream_TypeDef *s = &stub_DMA1_Stream6;
+	char chunk[STUB_LINE_BYTES];
+	const uint8_t *src;
+	uint32_t n, k;
+
+	if(stub_DMA1.HIFCR){
+		stub_DMA1.HISR &= ~stub_DMA1.HIFCR;
+		stub_DMA1.HIFCR = 0;
+	}
+	if(stub_DMA1.LIFCR){
+		stub_DMA1.LISR &= ~stub_DMA1.LIFCR;
+		stub_DMA1.LIFCR = 0;
+	}
+	for(k=0; k<2; k++)
+		if((stub_timers[k].dma->CR & DMA_SxCR_EN) == 0) stub_timers[k].dma_ndtr = 0;
+	if((stub_USART2.SR & USART_SR_TC) && (stub_USART2.CR1 & USART_CR1_TCIE)) NVIC_SetPendingIRQ(USART2_IRQn);
+	if((s->CR & DMA_SxCR_EN) == 0 || s->PAR != (uintptr_t)&stub_USART2.DR) return;
+	src = (const uint8_t *)s->M0AR;
+	for(n = s->NDTR; n > 0; n -= k){
+		k = n < sizeof chunk - 1U ? n : sizeof chunk - 1U;
+		memcpy(chunk, src, k);
+		chunk[k] = 0;
+		stub_puts(chunk);
+		if(s->CR & DMA_SxCR_MINC) src += k;
+	}
+	s->NDTR = 0;
+	s->CR &= ~DMA_SxCR_EN;
+	stub_USART2.SR |= USART_SR_TC;
+	stub_DMA1.HISR |= DMA_HISR_TCIF6;
+	if(s->CR & DMA_SxCR_TCIE) NVIC_SetPendingIRQ(DMA1_Stream6_IRQn);
+}
+
+/////////////////////////////// Sync ///////////////////////////////
+
+// Virtual ns from the free-running QEMU TIM2, 32-bit counter extended
+static uint64_t stub_time_ns(void){
+	uint32_t cnt = STUB_CLOCK->CNT;
+	if(cnt < stub_clock_last) stub_clock_high += 1ULL << 32;
+	stub_clock_last = cnt;
+	return (stub_clock_high | cnt) * 1000000000ULL / QEMU_TIM_HZ;
+}
+
+static void stub_finish(void);
+
+/*
+ Called before every firmware access to a stub peripheral and from the
+ stub tick. Interrupts the stub raises are pended in the NVIC and taken
+ when the firmware allows.
+*/
+void stub_sync(void){
+	uint32_t primask = __get_PRIMASK();
+	uint64_t now;
+	if(!stub_started) return;
+	__disable_irq();
+	now = stub_now_ns = stub_time_ns();
+
+	// Oscillators, switches and regulators are ready as soon as requested
+	stub_status(&stub_RCC.CR, RCC_CR_HSIRDY, stub_RCC.CR & RCC_CR_HSION);
+	stub_status(&stub_RCC.CR, RCC_CR_HSERDY, stub_RCC.CR & RCC_CR_HSEON);
+	stub_status(&stub_RCC.CR, RCC_CR_PLLRDY, stub_RCC.CR & RCC_CR_PLLON);
+	stub_RCC.CFGR = (stub_RCC.CFGR & ~RCC_CFGR_SWS) | ((stub_RCC.CFGR & RCC_CFGR_SW) << 2);
+	stub_status(&stub_RCC.CSR, RCC_CSR_LSIRDY, stub_RCC.CSR & RCC_CSR_LSION);
+	stub_PWR.CSR |= PWR_CSR_VOSRDY;
+	stub_status(&stub_RTC.ISR, RTC_ISR_INITF, stub_RTC.ISR & RTC_ISR_INIT);
+	stub_status(&stub_RTC.ISR, RTC_ISR_WUTWF, (stub_RTC.CR & RTC_CR_WUTE) == 0);
+
+	// BSRR: set/reset ODR bits, reads as zero
+	if(stub_GPIOA.BSRR){ stub_GPIOA.ODR = (stub_GPIOA.ODR | (stub_GPIOA.BSRR & 0xFFFFU)) & ~(stub_GPIOA.BSRR >> 16); stub_GPIOA.BSRR = 0; }
+	if(stub_GPIOB.BSRR){ stub_GPIOB.ODR = (stub_GPIOB.ODR | (stub_GPIOB.BSRR & 0xFFFFU)) & ~(stub_GPIOB.BSRR >> 16); stub_GPIOB.BSRR = 0; }
+	if(stub_GPIOC.BSRR){ stub_GPIOC.ODR = (stub_GPIOC.ODR | (stub_GPIOC.BSRR & 0xFFFFU)) & ~(stub_GPIOC.BSRR >> 16); stub_GPIOC.BSRR = 0; }
+
+	if((stub_CoreDebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (stub_DWT.CTRL & DWT_CTRL_CYCCNTENA_Msk))
+		stub_DWT.CYCCNT = (uint32_t)now - stub_cyccnt_base;
+	else
+		stub_cyccnt_base = (uint32_t)now - stub_DWT.CYCCNT;
+
+	while(stub_next_input < stub_ninputs && now >= stub_inputs[stub_next_input].at_ns){
+		stub_set_input(stub_inputs[stub_next_input].port, stub_inputs[stub_next_input].pin,
+		               stub_inputs[stub_next_input].level);
+		stub_next_input++;
+	}
+	stub_exti_retire();
+	stub_rtc(now);
+	stub_uart_dma();
+	stub_timers_advance(now);
+	stub_pins_sample(now);
+
+	if(primask == 0) __enable_irq();
+	if(stub_end_ns && now >= stub_end_ns) stub_finish();
+}
+
+void TIM4_IRQHandler(void){
+	STUB_TICK->SR = 0;
+	stub_sync();
+}
+
+/////////////////////////////// ITM ///////////////////////////////
+
+static void stub_itm_flush(void){
+	if(stub_itm_len == 0) return;
+	stub_itm_line[stub_itm_len] = 0;
+	stub_puts(stub_itm_line);
+	stub_itm_len = 0;
+}
+
+// Stimulus port 0, line-buffered to the semihosting console
+uint32_t stub_itm_putc(uint32_t ch){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	stub_itm_line[stub_itm_len++] = (char)ch;
+	if(ch == '\n' || stub_itm_len >= STUB_LINE_BYTES - 1U) stub_itm_flush();
+	if(primask == 0) __enable_irq();
+	return ch;
+}
+
+/////////////////////////////// Start / end ///////////////////////////////
+
+// "run_ms=<n> input=PC13@50=0,PC13@70=1"
+static void stub_parse_args(char *cmd){
+	char *p, *s;
+	unsigned long pin, ms, level;
+	if((p = strstr(cmd, "run_ms=")) != 0) stub_end_ns = strtoul(p + 7, 0, 10) * 1000000ULL;
+	if((p = strstr(cmd, "input=")) == 0) return;
+	s = p + 6;
+	while(*s == 'P' && stub_ninputs < STUB_MAX_INPUTS){
+		stub_inputs[stub_ninputs].port = s[1];
+		pin = strtoul(s + 2, &s, 10);
+		if(*s++ != '@') break;
+		ms = strtoul(s, &s, 10);
+		if(*s++ != '=') break;
+		level = strtoul(s, &s, 10);
+		stub_inputs[stub_ninputs].pin   = (uint8_t)pin;
+		stub_inputs[stub_ninputs].at_ns = ms * 1000000ULL;
+		stub_inputs[stub_ninputs].level = (uint8_t)(level != 0);
+		stub_ninputs++;
+		if(*s == ',') s++;
+	}
+}
+
+/*
+ Before main() (constructor, after .data/.bss): reset values of the
+ stub registers (RM0390), arguments, the QEMU time base and the tick.
+*/
+__attribute__((constructor)) static void stub_init(void){
+	static char cmd[256];
+	struct { char *buf; int len; } arg = { cmd, sizeof cmd - 1 };
+
+	stub_GPIOA.MODER = 0xA8000000UL;
+	stub_GPIOB.MODER = 0x00000280UL;
+	stub_GPIOC.IDR   = 1UL << 13;                 // B1 released, external pull-up
+	stub_RCC.CR      = RCC_CR_HSION | RCC_CR_HSIRDY | 0x80UL;
+	stub_RCC.PLLCFGR = 0x24003010UL;
+	stub_PWR.CR      = PWR_CR_VOS;
+	stub_RTC.PRER    = 0x007F00FFUL;
+	stub_RTC.ISR     = 0x00000007UL;
+	stub_USART2.SR   = USART_SR_TXE | USART_SR_TC;
+	stub_ITM.TCR     = ITM_TCR_ITMENA_Msk;
+	stub_ITM.TER     = 1UL;
+	stub_ITM.PORT[0].u32 = 1UL;                   // FIFO never full
+
+	if(stub_semihost(SYS_GET_CMDLINE, &arg) == 0) stub_parse_args(cmd);
+
+	STUB_CLOCK->PSC = 0;
+	STUB_CLOCK->ARR = 0xFFFFFFFFUL;
+	STUB_CLOCK->EGR = TIM_EGR_UG;
+	STUB_CLOCK->CR1 = TIM_CR1_CEN;
+	STUB_TICK->PSC  = 0;
+	STUB_TICK->ARR  = (uint32_t)(STUB_TICK_NS * QEMU_TIM_HZ / 1000000000ULL) - 1U;
+	STUB_TICK->DIER = TIM_DIER_UIE;
+	STUB_TICK->CR1  = TIM_CR1_CEN;
+	NVIC_SetPriority(TIM4_IRQn, 0);
+	NVIC_EnableIRQ(TIM4_IRQn);
+	stub_started = 1;
+	stub_puts("QEMU START\n");
+}
+
+// End of run: profile, final state, exit QEMU
+static void stub_finish(void){
+	char line[80], *s = line;
+	stub_end_ns = 0;
+	stub_itm_flush();
+	if(prof_dump) prof_dump();
+	stub_itm_flush();
+	memcpy(s, "QEMU END ", 9);  s += 9;
+	s = stub_putu(s, stub_now_ns);        *s++ = ' ';
+	s = stub_putu(s, stub_core_hz());     *s++ = ' ';
+	s = stub_puthex(s, stub_GPIOA.ODR & 0xFFFFU, 4);  *s++ = ' ';
+	s = stub_puthex(s, stub_GPIOC.ODR & 0xFFFFU, 4);  *s++ = '\n';
+	*s = 0;
+	stub_puts(line);
+	stub_semihost(SYS_EXIT, (void *)ADP_STOPPED_APPLICATION_EXIT);
+	for(;;);
+}
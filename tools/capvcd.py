@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Turn a logic analyzer capture (common/capture.h) into a value change dump.
+
+    tools/capvcd.py capture.bin -o capture.vcd
+    tools/capvcd.py capture.bin -o capture.vcd --name PA6=A1 --name PC13=B1
+    tools/vcdstat.py capture.vcd --bus coils=PA6,PA7,PA8,PA9
+
+The capture is the byte stream of capture_to_log() as it left the board
+(a serial log of the ST-LINK virtual COM port, an SWO dump), with any
+printf() text between the frames, or the -o file of
+build-host/capture_bench. Frames are found by their sync byte and kept
+when their sum is right.
+
+Sample numbers become ns with the timing of the last 'H' frame: timer
+clock / ticks per sample from its first sample on. 'B' frames before
+the first 'H' are skipped. Samples no frame carries (refused by a full
+log buffer, lost on the wire) are 'x' on every wire until the next
+frame. Wires are named after their pin, --name renames them.
+
+The summary on stdout gives frames, bad frames, samples, lost samples,
+the span and the compression against the 4 bytes per sample the DMA
+writes (two IDR half-words).
+"""
+
+import argparse
+import sys
+
+SYNC = 0xA5
+HEADER, DATA = ord("H"), ord("B")
+FRAME_MAX = 120
+
+
+def frames(data):
+    """[(type, payload)] of the frames with a good sum, and the number of bad ones"""
+    out, bad, i = [], 0, 0
+    while i + 6 <= len(data):
+        if data[i] != SYNC or data[i + 1] not in (HEADER, DATA):
+            i += 1
+            continue
+        n = data[i + 2] | (data[i + 3] << 8)
+        end = i + 4 + n
+        if n + 6 > FRAME_MAX or end + 2 > len(data):
+            i += 1
+            continue
+        if (sum(data[i + 1:end]) & 0xFFFF) != (data[end] | (data[end + 1] << 8)):
+            bad += 1
+            i += 1
+            continue
+        out.append((data[i + 1], bytes(data[i + 4:end])))
+        i = end + 2
+    return out, bad
+
+
+def u16(p, at):
+    return p[at] | (p[at + 1] << 8)
+
+
+def u32(p, at):
+    return u16(p, at) | (u16(p, at + 2) << 16)
+
+
+def channels(mask_a, mask_c):
+    return ["PA%d" % b for b in range(16) if mask_a >> b & 1] + ["PC%d" % b for b in range(16) if mask_c >> b & 1]
+
+
+def runs(payload, vbytes):
+    """[(packed value, samples)] of a 'B' payload"""
+    out, i = [], 6
+    while i < len(payload):
+        v = 0
+        for k in range(vbytes):
+            v |= payload[i + k] << (8 * k)
+        i += vbytes
+        n, shift = 0, 0
+        while True:
+            b = payload[i]
+            i += 1
+            n |= (b & 0x7F) << shift
+            shift += 7
+            if b < 0x80:
+                break
+        out.append((v, n))
+    return out
+
+
+class Timeline:
+    """Sample numbers (u32, wrapping) to ns through the 'H' frames"""
+
+    def __init__(self):
+        self.base_n = self.base_ns = 0
+        self.period_ns = None
+        self.last = None
+
+    def unwrap(self, n):
+        if self.last is None:
+            self.last = n
+        else:
+            self.last += (n - self.last) & 0xFFFFFFFF
+        return self.last
+
+    def header(self, n, tim_hz, ticks):
+        n = self.unwrap(n)
+        if self.period_ns is not None:
+            self.base_ns = self.ns(n)
+        self.base_n = n
+        self.period_ns = ticks * 1e9 / tim_hz
+
+    def ns(self, n):
+        return int(round(self.base_ns + (n - self.base_n) * self.period_ns))
+
+
+def decode(data):
+    """{"names", "changes": [(t_ns, [0/1/None per wire])], stats}"""
+    fr, bad = frames(data)
+    tl = Timeline()
+    names, vbytes = None, 0
+    changes, expect = [], None
+    samples = lost = skipped = 0
+    for kind, p in fr:
+        if kind == HEADER and len(p) >= 16:
+            first, tim_hz, ticks = u32(p, 0), u32(p, 4), u32(p, 8)
+            names = channels(u16(p, 12), u16(p, 14))
+            vbytes = (len(names) + 7) // 8
+            tl.header(first, tim_hz, ticks)
+            continue
+        if kind != DATA or names is None or len(p) < 6:
+            skipped += 1
+            continue
+        n = tl.unwrap(u32(p, 0))
+        if expect is not None and n > expect:
+            lost += n - expect
+            changes.append((tl.ns(expect), [None] * len(names)))
+        for v, k in runs(p, vbytes):
+            changes.append((tl.ns(n), [v >> b & 1 for b in range(len(names))]))
+            n += k
+        samples += u16(p, 4)
+        expect = n
+    end_ns = tl.ns(expect) if expect is not None else 0
+    return {"names": names or [], "changes": changes, "end_ns": end_ns, "frames": len(fr), "bad": bad,
+            "samples": samples, "lost": lost, "skipped": skipped}
+
+
+def vcd_id(i):
+    s = ""
+    i += 1
+    while i:
+        i, r = divmod(i - 1, 94)
+        s += chr(33 + r)
+    return s
+
+
+def write_vcd(path, names, changes, end_ns):
+    ids = [vcd_id(i) for i in range(len(names))]
+    last = [object()] * len(names)
+    with open(path, "w") as f:
+        f.write("$timescale 1 ns $end\n$scope module capture $end\n")
+        for i, name in enumerate(names):
+            f.write("$var wire 1 %s %s $end\n" % (ids[i], name))
+        f.write("$upscope $end\n$enddefinitions $end\n")
+        t_out = None
+        for t, vals in changes:
+            for i, v in enumerate(vals):
+                if v == last[i]:
+                    continue
+                if t != t_out:
+                    f.write("#%d\n" % t)
+                    t_out = t
+                f.write("%s%s\n" % ("x" if v is None else v, ids[i]))
+                last[i] = v
+        if t_out is None or end_ns > t_out:
+            f.write("#%d\n" % end_ns)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Decode a logic analyzer capture to VCD")
+    ap.add_argument("capture")
+    ap.add_argument("-o", "--out", help="VCD file (default: summary only)")
+    ap.add_argument("--name", action="append", default=[], metavar="PIN=NAME", help="rename a wire")
+    args = ap.parse_args()
+
+    with open(args.capture, "rb") as f:
+        data = f.read()
+    d = decode(data)
+    if not d["names"]:
+        print("no capture header in %s" % args.capture)
+        return 1
+    rename = dict(s.split("=", 1) for s in args.name)
+    names = [rename.get(n, n) for n in d["names"]]
+    raw = 4 * d["samples"]
+    print("%d frames, %d bad, %d skipped, %d samples, %d lost, %.3f ms" %
+          (d["frames"], d["bad"], d["skipped"], d["samples"], d["lost"], d["end_ns"] / 1e6))
+    print("%d bytes, %.1f:1 against the DMA words, wires %s" %
+          (len(data), raw / float(len(data) or 1), " ".join(names)))
+    if args.out:
+        write_vcd(args.out, names, d["changes"], d["end_ns"])
+        print("-> %s" % args.out)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,71 @@
+#!/bin/sh
+# Default layout against the tools/placement.json layout (tools/memplace.py)
+#
+#   tools/compare_placement.sh [CMSIS_DIR]
+#
+# Firmware (arm-none-eabi-gcc and CMSIS_DIR): both layouts are built with
+# PROFILE, sizes are tabulated and the placement is checked against the
+# map. The .elf files are left in $OUT/arm-default and $OUT/arm-placed;
+# flash each, capture the ITM output and compare the two captures with
+# tools/profdiff.py for the on-target cycles.
+#
+# Host: both configurations (PROFILE, PROFILE;MEM_PLACE) run on the
+# peripheral model and the profiled regions are compared. The model has
+# no flash wait states and the section attributes are empty on the host,
+# so this part checks that the placed build behaves the same; the cycle
+# difference only shows on target.
+
+set -e
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${OUT:-$ROOT/build-placement}
+CMSIS_DIR=${1:-$CMSIS_DIR}
+PLACEMENT=${PLACEMENT:-$ROOT/tools/placement.json}
+RUN_MS=${MODEL_RUN_MS:-100}
+
+mkdir -p "$OUT"
+
+if command -v arm-none-eabi-gcc >/dev/null 2>&1 && [ -n "$CMSIS_DIR" ]; then
+	for layout in default placed; do
+		placement=""
+		[ "$layout" = placed ] && placement="$PLACEMENT"
+		cmake -S "$ROOT" -B "$OUT/arm-$layout" -DCMAKE_TOOLCHAIN_FILE="$ROOT/cmake/arm-none-eabi.cmake" \
+			-DCMSIS_DIR="$CMSIS_DIR" -DFW_DEFINES=PROFILE -DFW_PLACEMENT="$placement" >/dev/null
+		cmake --build "$OUT/arm-$layout" -j >/dev/null
+	done
+	echo "== firmware size (bytes) =="
+	printf "%-14s %-8s %8s %8s %8s\n" experiment layout text data bss
+	for elf in "$OUT/arm-default"/*.elf; do
+		n=$(basename "$elf" .elf)
+		for layout in default placed; do
+			arm-none-eabi-size "$OUT/arm-$layout/$n.elf" | awk -v n="$n" -v l="$layout" \
+				'NR==2 { printf "%-14s %-8s %8s %8s %8s\n", n, l, $1, $2, $3 }'
+		done
+	done
+	echo
+	for map in "$OUT/arm-placed"/*.map; do
+		n=$(basename "$map" .map)
+		echo "== placement $n =="
+		python3 "$ROOT/tools/memplace.py" "$PLACEMENT" --name "$n" --check "$map" || true
+		echo
+	done
+else
+	echo "(arm-none-eabi-gcc or CMSIS_DIR missing, skipping firmware)"
+	echo
+fi
+
+for layout in default placed; do
+	defines=PROFILE
+	[ "$layout" = placed ] && defines="PROFILE;MEM_PLACE"
+	cmake -S "$ROOT" -B "$OUT/host-$layout" -DFW_DEFINES="$defines" >/dev/null
+	cmake --build "$OUT/host-$layout" -j >/dev/null
+done
+for exe in "$OUT/host-default"/*_host; do
+	n=$(basename "$exe" _host)
+	for layout in default placed; do
+		MODEL_RUN_MS=$RUN_MS MODEL_INPUT="PC13@20=0,PC13@40=1" "$OUT/host-$layout/${n}_host" \
+			>"$OUT/host-$layout/$n.txt" 2>/dev/null
+	done
+	echo "== host model $n =="
+	python3 "$ROOT/tools/profdiff.py" "$OUT/host-default/$n.txt" "$OUT/host-placed/$n.txt"
+	echo
+done
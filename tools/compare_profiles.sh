@@ -0,0 +1,50 @@
+#!/bin/sh
+# Size and speed of every experiment under the O2 / Os / O3LTO profiles
+#
+#   tools/compare_profiles.sh [CMSIS_DIR]
+#
+# With arm-none-eabi-gcc on PATH and CMSIS_DIR given, the firmware is built
+# per profile and text/data/bss are tabulated (arm-none-eabi-size).
+# The host configuration is always built with PROFILE and each experiment
+# is run on the peripheral model; the average cycles of the profiled
+# regions (common/prof.h) are tabulated per profile.
+
+set -e
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${OUT:-$ROOT/build-profiles}
+CMSIS_DIR=${1:-$CMSIS_DIR}
+PROFILES="O2 Os O3LTO"
+RUN_MS=${MODEL_RUN_MS:-100}
+
+mkdir -p "$OUT"
+
+if command -v arm-none-eabi-gcc >/dev/null 2>&1 && [ -n "$CMSIS_DIR" ]; then
+	echo "== firmware size (bytes) =="
+	printf "%-14s %-6s %8s %8s %8s\n" experiment profile text data bss
+	for p in $PROFILES; do
+		cmake -S "$ROOT" -B "$OUT/arm-$p" -DCMAKE_TOOLCHAIN_FILE="$ROOT/cmake/arm-none-eabi.cmake" \
+			-DCMSIS_DIR="$CMSIS_DIR" -DFW_PROFILE="$p" >/dev/null
+		cmake --build "$OUT/arm-$p" -j >/dev/null
+		for elf in "$OUT/arm-$p"/*.elf; do
+			arm-none-eabi-size "$elf" | awk -v n="$(basename "$elf" .elf)" -v p="$p" \
+				'NR==2 { printf "%-14s %-6s %8s %8s %8s\n", n, p, $1, $2, $3 }'
+		done
+	done
+	echo
+else
+	echo "(arm-none-eabi-gcc or CMSIS_DIR missing, skipping firmware size)"
+	echo
+fi
+
+echo "== host model, average cycles per profiled region =="
+printf "%-14s %-6s %-14s %10s %10s %10s\n" experiment profile region count avg max
+for p in $PROFILES; do
+	cmake -S "$ROOT" -B "$OUT/host-$p" -DFW_PROFILE="$p" -DFW_DEFINES=PROFILE >/dev/null
+	cmake --build "$OUT/host-$p" -j >/dev/null
+	for exe in "$OUT/host-$p"/*_host; do
+		n=$(basename "$exe" _host)
+		MODEL_RUN_MS=$RUN_MS MODEL_INPUT="PC13@20=0,PC13@40=1" "$exe" 2>/dev/null | \
+			awk -v n="$n" -v p="$p" '$1 != "region" && NF == 5 && $2 ~ /^[0-9]+$/ {
+				printf "%-14s %-6s %-14s %10s %10s %10s\n", n, p, $1, $2, $4, $5 }'
+	done
+done
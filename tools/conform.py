@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+"""Golden-trace conformance of the experiments on the host model.
+
+    tools/conform.py --build build-host                  # check against tools/golden/
+    tools/conform.py --build build-host --record         # write the golden traces
+    tools/conform.py --build build-host music toggle -v  # some experiments, show the diff
+    cmake --build build-host --target conform
+
+Each experiment of tools/conform.json runs as <build>/<name>_host with
+MODEL_VCD, its run time and input script, all in parallel on virtual time
+(host/model.h), so the result does not depend on host load. The dump is
+reduced to a canonical trace (tools/golden/<name>.trace):
+
+  cycle <bus> <wires> <states>   the state cycle a group of software-driven
+                                 pins repeats (first wire = bit 0), e.g. the
+                                 coil order of a stepper, with the levels
+                                 the pins pass through between two steps
+  span <signal> <min> <max>      the range a value sweeps through, for
+                                 registers a busy-wait loop ramps (fade)
+  <t_ms> <signal> <value>        every change of a pin or of the timer
+                                 registers latched at update events
+                                 (TIMx_PSC, TIMx_ARR, TIMx_CCR1)
+
+The model records every GPIO write, so a bus repeats its golden cycle
+exactly after start-up. A basic block stands for a fixed number of
+core cycles, so the step time of a software delay is only an estimate
+and is not compared. Events must have the golden values in the
+golden order per signal, each within tol_ms + tol_pct of the golden
+time since the signal's previous event (the first one since the
+start); events within that tolerance of the end of the run may be
+missing. A span may differ by tol_pct of the golden maximum.
+"""
+
+import argparse
+import concurrent.futures
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import vcdstat  # noqa: E402
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+
+
+def load_spec(path):
+    with open(path) as f:
+        spec = json.load(f)
+    default = spec.pop("default", {})
+    return {name: dict(default, **cfg) for name, cfg in spec.items()}
+
+
+def run(build, name, cfg):
+    """{signal: [(t_ns, value)]} of one run, or an error string"""
+    exe = os.path.join(build, name + "_host")
+    if not os.path.exists(exe):
+        return "no %s" % exe
+    fd, vcd = tempfile.mkstemp(prefix=name + "_", suffix=".vcd")
+    os.close(fd)
+    env = dict(os.environ, MODEL_VCD=vcd, MODEL_RUN_MS=str(cfg["run_ms"]), MODEL_INPUT=cfg.get("input", ""))
+    try:
+        p = subprocess.run([exe], env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                           timeout=cfg["run_ms"] / 1000.0 + 20)
+        if p.returncode != 0:
+            return "exit code %d" % p.returncode
+        return vcdstat.parse(vcd)
+    except subprocess.TimeoutExpired:
+        return "timeout"
+    finally:
+        os.unlink(vcd)
+
+
+def bus_sequence(changes, wires):
+    """States of the joined wires in order, consecutive repeats removed"""
+    states = vcdstat.bus_states([changes[w] for w in wires], 0, float("inf"))
+    return [v for _, v in states]
+
+
+def rotate(cycle):
+    """The rotation of a cycle that starts lowest, so a cycle has one spelling"""
+    return min(cycle[k:] + cycle[:k] for k in range(len(cycle))) if cycle else []
+
+
+def find_cycle(seq):
+    """Shortest cycle the second half of the sequence repeats, [] when it does not"""
+    tail = seq[len(seq) // 2:]
+    for p in range(1, len(tail) // 2 + 1):
+        if all(tail[i] == tail[i + p] for i in range(len(tail) - p)):
+            return rotate(tail[:p])
+    return []
+
+
+def canonical(changes, cfg):
+    """Golden trace lines of one run"""
+    lines = ["# run_ms=%d input=%s" % (cfg["run_ms"], cfg.get("input", ""))]
+    for bus, wires in sorted(cfg.get("cycles", {}).items()):
+        cycle = find_cycle(bus_sequence(changes, wires))
+        width = (len(wires) + 3) // 4
+        lines.append("cycle %s %s %s" % (bus, ",".join(wires), " ".join("%0*x" % (width, v) for v in cycle)))
+    for sig in cfg.get("spans", []):
+        values = [v for _, v in changes.get(sig, []) if v is not None]
+        if values:
+            lines.append("span %s %d %d" % (sig, min(values), max(values)))
+    events = []
+    for sig in cfg.get("events", []):
+        last = None
+        for t, v in changes.get(sig, []):
+            if v is not None and v != last:
+                events.append((t, sig, v))
+                last = v
+    for t, sig, v in sorted(events):
+        lines.append("%.3f %s %d" % (t / 1e6, sig, v))
+    return lines
+
+
+def parse_trace(lines):
+    """({bus: (wires, [states])}, {signal: (min, max)}, {signal: [(t_ms, value)]})"""
+    cycles, spans, events = {}, {}, {}
+    for line in lines:
+        parts = line.split()
+        if not parts or parts[0].startswith("#"):
+            continue
+        if parts[0] == "cycle":
+            cycles[parts[1]] = (parts[2].split(","), [int(s, 16) for s in parts[3:]])
+        elif parts[0] == "span":
+            spans[parts[1]] = (int(parts[2]), int(parts[3]))
+        else:
+            events.setdefault(parts[1], []).append((float(parts[0]), int(parts[2])))
+    return cycles, spans, events
+
+
+def check_cycle(golden, seq):
+    """Problems of an observed bus sequence against the golden cycle, and a summary"""
+    n = len(golden)
+    for start in range(len(seq)):                # start-up states before the cycle
+        if seq[start] not in golden:
+            continue
+        k = golden.index(seq[start])
+        if all(seq[start + i] == golden[(k + i) % n] for i in range(min(n, len(seq) - start))):
+            break
+    else:
+        return ["never runs the cycle"], "0 steps"
+    for i in range(start, len(seq)):
+        if seq[i] != golden[(k + i - start) % n]:
+            return ["%x instead of %x after %d steps" % (seq[i], golden[(k + i - start) % n], i - start)], ""
+    steps = len(seq) - start - 1
+    return (["%d steps, less than one cycle" % steps] if steps < n else []), "%d steps" % steps
+
+
+def check_events(golden, new, cfg):
+    problems = []
+    end = cfg["run_ms"]
+
+    def tol(t):
+        return cfg["tol_ms"] + cfg["tol_pct"] / 100.0 * t
+
+    for sig in sorted(set(golden) | set(new)):
+        g, n = golden.get(sig, []), new.get(sig, [])
+        t_g = t_n = 0.0
+        for i in range(max(len(g), len(n))):
+            if i >= len(g):
+                if n[i][0] < end - tol(n[i][0]):
+                    problems.append("%s: extra %d at %.1f ms" % (sig, n[i][1], n[i][0]))
+                break
+            if i >= len(n):
+                if g[i][0] < end - tol(g[i][0]):
+                    problems.append("%s: missing %d at %.1f ms" % (sig, g[i][1], g[i][0]))
+                break
+            if g[i][1] != n[i][1]:
+                problems.append("%s: %d at %.1f ms, golden %d at %.1f ms" % (sig, n[i][1], n[i][0], g[i][1], g[i][0]))
+                break
+            if abs((n[i][0] - t_n) - (g[i][0] - t_g)) > tol(g[i][0] - t_g):
+                problems.append("%s: %d at %.1f ms, golden at %.1f ms" % (sig, n[i][1], n[i][0], g[i][0]))
+                break
+            t_g, t_n = g[i][0], n[i][0]
+    return problems
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Golden-trace conformance of the experiments on the host model")
+    ap.add_argument("names", nargs="*", help="experiments (default: all in the spec)")
+    ap.add_argument("--build", default="build-host", help="host build directory")
+    ap.add_argument("--spec", default=os.path.join(TOOLS, "conform.json"))
+    ap.add_argument("--golden", default=os.path.join(TOOLS, "golden"))
+    ap.add_argument("--record", action="store_true", help="write the golden traces instead of checking")
+    ap.add_argument("-j", "--jobs", type=int, default=max(1, (os.cpu_count() or 2) // 2))
+    ap.add_argument("-v", "--verbose", action="store_true", help="print the canonical traces")
+    args = ap.parse_args()
+
+    spec = load_spec(args.spec)
+    names = args.names or list(spec)
+    unknown = [n for n in names if n not in spec]
+    if unknown:
+        print("not in %s: %s" % (args.spec, ", ".join(unknown)))
+        return 2
+
+    with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        runs = dict(zip(names, pool.map(lambda n: run(args.build, n, spec[n]), names)))
+
+    failed = 0
+    for name in names:
+        cfg, changes = spec[name], runs[name]
+        if isinstance(changes, str):
+            print("%-14s FAIL  %s" % (name, changes))
+            failed += 1
+            continue
+        lines = canonical(changes, cfg)
+        if args.verbose:
+            print("\n".join("  " + line for line in lines))
+        path = os.path.join(args.golden, name + ".trace")
+        if args.record:
+            os.makedirs(args.golden, exist_ok=True)
+            with open(path, "w") as f:
+                f.write("\n".join(lines) + "\n")
+            print("%-14s recorded %d lines" % (name, len(lines) - 1))
+            continue
+        if not os.path.exists(path):
+            print("%-14s FAIL  no %s, run with --record" % (name, path))
+            failed += 1
+            continue
+        with open(path) as f:
+            g_cycles, g_spans, g_events = parse_trace(f)
+        _, n_spans, n_events = parse_trace(lines)
+        problems, notes = check_events(g_events, n_events, cfg), []
+        for sig, (lo, hi) in sorted(g_spans.items()):
+            span = n_spans.get(sig)
+            slack = cfg["tol_pct"] / 100.0 * abs(hi) + 1
+            if span is None or abs(span[0] - lo) > slack or abs(span[1] - hi) > slack:
+                problems.append("%s: span %s, golden %d..%d" % (sig, "%d..%d" % span if span else "-", lo, hi))
+        for bus, (wires, golden) in sorted(g_cycles.items()):
+            missing = [w for w in wires if w not in changes]
+            if missing:
+                problems.append("%s: no wire %s" % (bus, ", ".join(missing)))
+                continue
+            p, summary = check_cycle(golden, bus_sequence(changes, wires))
+            problems += ["%s: %s" % (bus, s) for s in p]
+            notes.append("%s %s" % (bus, summary))
+        nevents = sum(len(e) for e in n_events.values())
+        print("%-14s %s  %d events%s" % (name, "FAIL" if problems else "ok  ", nevents,
+                                         "".join(", " + s for s in notes)))
+        for s in problems:
+            print("    " + s)
+        failed += bool(problems)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Turn an EVT_TRACE capture (common/evt.h) into a Chrome trace timeline.
+
+    tools/evtdecode.py capture.txt -o trace.json
+    tools/evtdecode.py evt_log.bin --hz 84000000
+
+The capture is EVT_DUMP() text (ITM/SWO or host stdout, mixed with other
+output) or a binary debugger dump of evt_log, e.g.
+
+    (gdb) dump binary value evt_log.bin evt_log
+
+Cycle stamps become microseconds with the clock each stretch ran at:
+the EVT_HZ header, then every EVT_CLOCK record. CYCCNT wraps after
+2^32 cycles (51 s at 84 MHz); events further apart than that are placed
+one wrap too early. DWT does not count in Stop mode, so time spent in
+idle_enter() Stop is missing from the timeline.
+
+The JSON opens in chrome://tracing or ui.perfetto.dev: ISR enter/exit
+pairs are slices on the "isr" track, the other events instants on
+"thread", EVT_CLOCK a sysclk counter. The summary on stdout lists the
+ISR durations and the interval between events of each kind.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import evtdefs  # noqa: E402
+
+TID_THREAD, TID_ISR = 1, 2
+
+_FIELD = re.compile(r"(\w+)=%\w\[(val1|val2)\]")
+
+
+def _args(event, val1, val2):
+    if event is None:
+        return {"val1": val1, "val2": val2}
+    vals = {"val1": val1, "val2": val2}
+    return {label: vals[src] for label, src in _FIELD.findall(event["value"])}
+
+
+def timeline(hz, records, events):
+    """[(t_us, seq, event name, val1, val2)] with the cycle stamps unwrapped."""
+    out = []
+    t, prev = 0.0, None
+    for seq, ts, ident, val1, val2 in records:
+        if prev is not None:
+            t += ((ts - prev) & 0xFFFFFFFF) * 1e6 / hz
+        prev = ts
+        event = events.get(ident)
+        name = event["name"] if event else "0x%04x" % ident
+        out.append((t, seq, name, val1, val2))
+        if name == "EVT_CLOCK" and val2:
+            hz = val2
+    return out
+
+
+def chrome(timeline_, events_by_name):
+    trace = [
+        {"name": "thread_name", "ph": "M", "pid": 1, "tid": TID_THREAD, "args": {"name": "thread"}},
+        {"name": "thread_name", "ph": "M", "pid": 1, "tid": TID_ISR, "args": {"name": "isr"}},
+    ]
+    for t, seq, name, val1, val2 in timeline_:
+        args = _args(events_by_name.get(name), val1, val2)
+        args["seq"] = seq
+        if name == "EVT_ISR_ENTER":
+            trace.append({"name": "IRQ %d" % val1, "ph": "B", "ts": t, "pid": 1, "tid": TID_ISR, "args": args})
+        elif name == "EVT_ISR_EXIT":
+            trace.append({"name": "IRQ %d" % val1, "ph": "E", "ts": t, "pid": 1, "tid": TID_ISR})
+        elif name == "EVT_CLOCK":
+            trace.append({"name": "sysclk", "ph": "C", "ts": t, "pid": 1, "args": {"MHz": val2 / 1e6}})
+        else:
+            label = events_by_name[name]["property"] if name in events_by_name else name
+            trace.append({"name": label, "ph": "i", "s": "t", "ts": t, "pid": 1, "tid": TID_THREAD, "args": args})
+    return {"traceEvents": trace, "displayTimeUnit": "ns"}
+
+
+def _row(label, samples):
+    if not samples:
+        return
+    print("%-18s %6d %10.2f %10.2f %10.2f" % (label, len(samples), min(samples),
+                                              sum(samples) / len(samples), max(samples)))
+
+
+def summary(timeline_):
+    isr_open, isr = {}, {}
+    last, gaps = {}, {}
+    for t, _, name, val1, _ in timeline_:
+        if name == "EVT_ISR_ENTER":
+            isr_open[val1] = t
+        elif name == "EVT_ISR_EXIT" and val1 in isr_open:
+            isr.setdefault(val1, []).append(t - isr_open.pop(val1))
+        if name in last:
+            gaps.setdefault(name, []).append(t - last[name])
+        last[name] = t
+    print("%-18s %6s %10s %10s %10s" % ("us", "count", "min", "avg", "max"))
+    for irq in sorted(isr):
+        _row("isr %d" % irq, isr[irq])
+    for name in sorted(gaps):
+        _row(name[4:].lower() + " interval", gaps[name])
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Decode an EVT_TRACE capture to Chrome trace JSON")
+    ap.add_argument("capture")
+    ap.add_argument("-o", "--out", help="Chrome trace JSON (default: summary only)")
+    ap.add_argument("--hz", type=int, help="core clock at the first record when the capture has no EVT HZ line")
+    ap.add_argument("--header", default=evtdefs.HEADER)
+    args = ap.parse_args()
+
+    events = evtdefs.events(args.header)
+    hz, records, lost = evtdefs.read_trace(args.capture)
+    hz = args.hz or hz or 16000000
+    if not records:
+        print("no EVT records in %s" % args.capture)
+        return 1
+
+    tl = timeline(hz, records, events)
+    print("%d records, %d lost, %.3f ms" % (len(records), lost, tl[-1][0] / 1000.0))
+    summary(tl)
+    if args.out:
+        by_name = {e["name"]: e for e in events.values()}
+        with open(args.out, "w") as f:
+            json.dump(chrome(tl, by_name), f, separators=(",", ":"))
+        print("-> %s" % args.out)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
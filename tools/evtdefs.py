@@ -0,0 +1,88 @@
+"""Event definitions and trace readers for common/evt.h.
+
+events() parses the EVT_EVENTS list of the header, so the SCVD file
+(tools/evtscvd.py) and the decoder (tools/evtdecode.py) always follow
+the firmware:
+
+    {id: {"name", "msg", "property", "value"}}     id = component << 8 | msg
+
+read_trace() takes either capture of a trace and returns
+(hz, [(seq, ts, id, val1, val2)], lost):
+
+    text    EVT_DUMP() output over ITM/SWO or host stdout; other lines
+            (printf, PROF_DUMP) are skipped, repeated dumps joined
+    binary  a debugger dump of evt_log, starting with EVT_MAGIC
+"""
+
+import os
+import re
+import struct
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HEADER = os.path.join(ROOT, "common", "evt.h")
+
+MAGIC = 0x31545645
+
+_EVENT = re.compile(r'X\((\w+),\s*(0x[0-9a-fA-F]+|\d+),\s*"([^"]*)",\s*"([^"]*)"\)')
+_DEFINE = re.compile(r"#define\s+(EVT_COMPONENT|EVT_RING_ENTRIES)\s+(0x[0-9a-fA-F]+|\d+)")
+
+
+def _int(text):
+    return int(text.rstrip("UuLl"), 0)
+
+
+def header(path=HEADER):
+    """EVT_COMPONENT, EVT_RING_ENTRIES and the event list of evt.h."""
+    with open(path) as f:
+        text = f.read()
+    consts = {m.group(1): _int(m.group(2)) for m in _DEFINE.finditer(text)}
+    comp = consts.get("EVT_COMPONENT", 1)
+    events = {}
+    for m in _EVENT.finditer(text):
+        msg = _int(m.group(2))
+        events[(comp << 8) | msg] = {"name": m.group(1), "msg": msg,
+                                     "property": m.group(3), "value": m.group(4)}
+    return comp, consts.get("EVT_RING_ENTRIES", 256), events
+
+
+def events(path=HEADER):
+    return header(path)[2]
+
+
+def _read_binary(data):
+    magic, entries, head, hz = struct.unpack_from("<4I", data, 0)
+    if magic != MAGIC:
+        raise ValueError("not an evt_log dump (magic %08x)" % magic)
+    count = min(head, entries)
+    records = []
+    for seq in range(head - count, head):
+        ts, ident, val1, val2 = struct.unpack_from("<IHHI", data, 16 + 12 * (seq % entries))
+        records.append((seq, ts, ident, val1, val2))
+    return hz, records, head - count
+
+
+def _read_text(text):
+    hz, lost, records = 0, 0, {}
+    for line in text.splitlines():
+        parts = line.split()
+        if len(parts) < 3 or parts[0] != "EVT":
+            continue
+        try:
+            if parts[1] == "HZ":
+                hz = int(parts[2], 16)
+            elif parts[1] == "LOST":
+                lost += int(parts[2], 16)
+            elif len(parts) == 6:
+                seq, ts, ident, val1, val2 = (int(p, 16) for p in parts[1:])
+                records[seq] = (seq, ts, ident, val1, val2)
+        except ValueError:
+            continue
+    return hz, [records[s] for s in sorted(records)], lost
+
+
+def read_trace(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) >= 16 and struct.unpack_from("<I", data, 0)[0] == MAGIC:
+        return _read_binary(data)
+    return _read_text(data.decode("latin-1"))
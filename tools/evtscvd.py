@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Write the Component Viewer description of common/evt.h events.
+
+    tools/evtscvd.py [-o common/keil/evt.scvd]
+
+The Event Recorder window of uVision decodes EventRecord2() records
+with it (Options for Target -> Debug -> Manage Component Viewer
+Description Files, add common/keil/evt.scvd). Run it after changing
+EVT_EVENTS; --check exits 1 when the file is out of date.
+"""
+
+import argparse
+import os
+import sys
+from xml.sax.saxutils import quoteattr
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import evtdefs  # noqa: E402
+
+OUT = os.path.join(evtdefs.ROOT, "common", "keil", "evt.scvd")
+
+
+def render(comp, events):
+    lines = [
+        '<?xml version="1.0" encoding="utf-8"?>',
+        '',
+        '<!-- Generated by tools/evtscvd.py from common/evt.h, do not edit -->',
+        '<component_viewer schemaVersion="0.1" xmlns:xs="http://www.w3.org/2001/XMLSchema-instance" '
+        'xs:noNamespaceSchemaLocation="Component_Viewer.xsd">',
+        '',
+        '<component name="DSMC events" version="1.0.0"/>',
+        '  <events>',
+        '    <group name="DSMC">',
+        '      <component name="DSMC" brief="DSMC" no="0x%02X" prefix="EvrDsmc_" '
+        'info="Experiment events (common/evt.h)"/>' % comp,
+        '    </group>',
+        '',
+    ]
+    for ident in sorted(events):
+        e = events[ident]
+        lines.append('    <event id="0x%04X" level="Op" property=%s value=%s info=%s/>' % (
+            ident, quoteattr(e["property"]), quoteattr(e["value"]), quoteattr(e["name"])))
+    lines += ['  </events>', '', '</component_viewer>', '']
+    return "\n".join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Generate the SCVD file of common/evt.h")
+    ap.add_argument("-o", "--out", default=OUT)
+    ap.add_argument("--header", default=evtdefs.HEADER)
+    ap.add_argument("--check", action="store_true", help="compare with --out instead of writing it")
+    args = ap.parse_args()
+
+    comp, _, events = evtdefs.header(args.header)
+    text = render(comp, events)
+    if args.check:
+        try:
+            with open(args.out) as f:
+                current = f.read()
+        except OSError:
+            current = ""
+        if current != text:
+            print("%s is out of date, run tools/evtscvd.py" % args.out)
+            return 1
+        return 0
+    with open(args.out, "w") as f:
+        f.write(text)
+    print("%d events -> %s" % (len(events), args.out))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
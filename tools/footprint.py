@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Flash/RAM footprint per object and library member, with budgets.
+
+    tools/footprint.py Listings/try2.map [--htm Objects/try2.htm]
+    tools/footprint.py build-arm/music.map --budget tools/budgets.json --name music
+    tools/footprint.py build-arm/music.map --save music.json
+    tools/footprint.py build-arm/music.map --baseline music.json --max-growth 64
+
+Inputs: Keil map (armlink), GCC map (ld -Map) or an ELF (.elf/.axf, totals only).
+The Keil call graph (--htm) adds the maximum stack depth reported by armlink.
+
+Exit status 1 when a budget is exceeded or, with --baseline, when ROM or RAM
+grew by more than --max-growth bytes. CMake runs it post-link when
+FW_BUDGET_FILE is set.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mapparse  # noqa: E402
+
+
+def print_table(title, table, top):
+    rows = sorted(table.items(), key=lambda kv: -(kv[1]["code"] + kv[1]["ro"] + kv[1]["rw"] + kv[1]["zi"]))
+    if top:
+        rows = rows[:top]
+    if not rows:
+        return
+    print("%-32s %8s %8s %8s %8s" % (title, "code", "ro", "rw", "zi"))
+    for name, s in rows:
+        print("%-32s %8d %8d %8d %8d" % (name[:32], s["code"], s["ro"], s["rw"], s["zi"]))
+    print()
+
+
+def check_budget(report, budget, name):
+    """Budget file: {"default": {...}, "<name>": {...}} with keys
+    rom, ram, stack and objects: {"main.o": {"code": n, ...}}."""
+    limits = dict(budget.get("default", {}))
+    limits.update(budget.get(name, {}) if name else {})
+    failures = []
+    t = report["totals"]
+    for key in ("rom", "ram", "code", "ro", "rw", "zi"):
+        if key in limits and t[key] > limits[key]:
+            failures.append("%s %d > budget %d" % (key, t[key], limits[key]))
+    if "stack" in limits and report.get("max_stack") is not None and report["max_stack"] > limits["stack"]:
+        failures.append("stack %d > budget %d" % (report["max_stack"], limits["stack"]))
+    for obj, obj_limits in limits.get("objects", {}).items():
+        sizes = report["objects"].get(obj) or report["members"].get(obj)
+        if sizes is None:
+            continue
+        for key, limit in obj_limits.items():
+            if sizes[key] > limit:
+                failures.append("%s %s %d > budget %d" % (obj, key, sizes[key], limit))
+    return failures
+
+
+def check_baseline(report, baseline, max_growth):
+    failures = []
+    for key in ("rom", "ram"):
+        grown = report["totals"][key] - baseline["totals"][key]
+        if grown > max_growth:
+            failures.append("%s grew by %d bytes (%d -> %d)" %
+                            (key, grown, baseline["totals"][key], report["totals"][key]))
+    return failures
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("input", help="Keil/GCC map file or ELF image")
+    ap.add_argument("--htm", help="Keil call graph (Objects/try2.htm) for the max stack depth")
+    ap.add_argument("--top", type=int, default=0, help="only the N largest rows per table")
+    ap.add_argument("--budget", help="JSON budget file")
+    ap.add_argument("--name", help="entry of the budget file to apply (default: 'default' only)")
+    ap.add_argument("--save", help="write the report as JSON for later --baseline runs")
+    ap.add_argument("--baseline", help="previous report saved with --save")
+    ap.add_argument("--max-growth", type=int, default=0, help="allowed ROM/RAM growth against --baseline")
+    ap.add_argument("--quiet", action="store_true", help="print totals and failures only")
+    args = ap.parse_args()
+
+    try:
+        report = mapparse.parse_any(args.input)
+    except (OSError, ValueError) as e:
+        print("footprint: %s" % e, file=sys.stderr)
+        return 2
+    report["max_stack"] = None
+    if args.htm:
+        report["max_stack"] = mapparse.parse_keil_htm(args.htm)["max_stack"]
+
+    if not args.quiet:
+        print_table("object", report["objects"], args.top)
+        print_table("library member", report["members"], args.top)
+        print_table("library", report["libraries"], args.top)
+    t = report["totals"]
+    print("%s: code %d  ro %d  rw %d  zi %d  ->  ROM %d  RAM %d%s" % (
+        os.path.basename(args.input), t["code"], t["ro"], t["rw"], t["zi"], t["rom"], t["ram"],
+        "" if report["max_stack"] is None else "  stack %d" % report["max_stack"]))
+
+    failures = []
+    if args.budget:
+        with open(args.budget) as f:
+            failures += check_budget(report, json.load(f), args.name)
+    if args.baseline:
+        with open(args.baseline) as f:
+            failures += check_baseline(report, json.load(f), args.max_growth)
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(report, f, indent=1, sort_keys=True)
+
+    for msg in failures:
+        print("footprint: FAIL %s" % msg, file=sys.stderr)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,301 @@
+"""Parsers for linker outputs of the Keil (armlink) and GCC builds.
+
+Keil : Listings/try2.map  (Image component sizes)
+       Objects/try2.htm   (static call graph with per-function stack)
+GCC  : <name>.map         (ld -Map)
+       <name>.elf         (section headers, ELF32 little endian)
+       *.ci               (-fcallgraph-info=su, call graph with stack usage)
+
+parse_symbols() reads symbol addresses from either map.
+
+Every size parser returns the same shape:
+
+    {"objects":   {name: {"code", "ro", "rw", "zi"}},   # own objects
+     "members":   {name: {...}},                         # library members
+     "libraries": {name: {...}},
+     "totals":    {"code", "ro", "rw", "zi", "rom", "ram"}}
+
+rom = code + ro + rw (RW init data is stored in flash), ram = rw + zi.
+"""
+
+import os
+import re
+import struct
+
+FIELDS = ("code", "ro", "rw", "zi")
+
+
+def _entry(code=0, ro=0, rw=0, zi=0):
+    return {"code": code, "ro": ro, "rw": rw, "zi": zi}
+
+
+def _add(table, name, kind, size):
+    table.setdefault(name, _entry())[kind] += size
+
+
+def _totals(result):
+    t = _entry()
+    for group in ("objects", "members"):
+        for sizes in result[group].values():
+            for f in FIELDS:
+                t[f] += sizes[f]
+    t["rom"] = t["code"] + t["ro"] + t["rw"]
+    t["ram"] = t["rw"] + t["zi"]
+    result["totals"] = t
+    return result
+
+
+def empty():
+    return {"objects": {}, "members": {}, "libraries": {}, "totals": {}}
+
+
+#################################### Keil ####################################
+
+_KEIL_ROW = re.compile(r"^\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\S.*?)\s*$")
+
+
+def parse_keil_map(path):
+    """Image component sizes of an armlink map.
+
+    Columns: Code (inc. data) | RO Data | RW Data | ZI Data | Debug | name.
+    'Code' already includes inline literal data, so the second column is
+    informational and not added again.
+    """
+    result = empty()
+    table = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            if "Object Name" in line:
+                table = result["objects"]
+                continue
+            if "Library Member Name" in line:
+                table = result["members"]
+                continue
+            if "Library Name" in line:
+                table = result["libraries"]
+                continue
+            if line.startswith("=========="):
+                table = None
+                continue
+            if table is None:
+                continue
+            m = _KEIL_ROW.match(line)
+            if not m:
+                continue
+            name = m.group(7)
+            if name.startswith("(") or name.endswith("Totals"):
+                continue
+            table[name] = _entry(int(m.group(1)), int(m.group(3)), int(m.group(4)), int(m.group(5)))
+    return _totals(result)
+
+
+_HTM_FUNC = re.compile(
+    r'<STRONG><a name="\[(\w+)\]"></a>([^<]+)</STRONG>\s*\((\w+), (\d+) bytes, Stack size (\w+) bytes, ([^)]*)\)')
+_HTM_CALL = re.compile(r'<a href="#\[(\w+)\]">&gt;&gt;</a>(?:&nbsp;)*\s*([^<\n]+)')
+_HTM_MAX = re.compile(r"Maximum Stack Usage =\s+(\d+) bytes")
+
+
+def parse_keil_htm(path):
+    """Static call graph of an armlink --callgraph output.
+
+    Returns {"max_stack": int or None,
+             "functions": {name: {"size", "stack", "object", "calls", "called_by"}}}
+    "stack" is None when armlink reports it as unknown.
+    """
+    functions = {}
+    max_stack = None
+    current = None
+    section = None
+    with open(path, errors="replace") as f:
+        text = f.read()
+    m = _HTM_MAX.search(text)
+    if m:
+        max_stack = int(m.group(1))
+    for line in text.split("\n"):
+        fm = _HTM_FUNC.search(line)
+        if fm:
+            current = fm.group(2).strip()
+            stack = fm.group(5)
+            functions[current] = {
+                "size": int(fm.group(4)),
+                "stack": int(stack) if stack.isdigit() else None,
+                "object": fm.group(6).split(",")[0].split("(")[0].strip(),
+                "calls": [],
+                "called_by": [],
+            }
+            section = None
+        if current is None:
+            continue
+        if "[Calls]" in line:
+            section = "calls"
+        elif "[Called By]" in line:
+            section = "called_by"
+        elif "[Address Reference" in line or "[Stack]" in line:
+            section = None
+        if section:
+            for cm in _HTM_CALL.finditer(line):
+                functions[current][section].append(cm.group(2).strip())
+    return {"max_stack": max_stack, "functions": functions}
+
+
+#################################### GCC ####################################
+
+_GCC_INPUT = re.compile(r"^\s(\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+_GCC_ARCHIVE = re.compile(r"^(.*\.a)\((.*)\)$")
+
+
+def _gcc_kind(out_section, in_section):
+    name = in_section or out_section
+    if name.startswith(".text") or name in (".init", ".fini", ".glue_7", ".glue_7t", ".vfp11_veneer"):
+        return "code"
+    if name.startswith(".data"):
+        return "rw"
+    if name.startswith(".bss") or name == "COMMON" or out_section == "._user_heap_stack":
+        return "zi"
+    return "ro"
+
+
+def parse_gcc_map(path):
+    """Input section placement of a GNU ld map (-Wl,-Map)."""
+    result = empty()
+    in_map = False
+    out_section = ""
+    pending = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_map = True
+                continue
+            if not in_map:
+                continue
+            if line.startswith("."):
+                out_section = line.split()[0]
+                pending = None
+                continue
+            if out_section in ("", ".comment", ".ARM.attributes") or out_section.startswith(".debug"):
+                continue
+            stripped = line.strip()
+            # Long input section names wrap onto the next line
+            if line.startswith(" ") and len(stripped.split()) == 1 and not stripped.startswith("0x"):
+                pending = stripped
+                continue
+            m = _GCC_INPUT.match(line)
+            if not m:
+                pending = None
+                continue
+            in_section = m.group(1) or pending
+            pending = None
+            if in_section is None or in_section == "*fill*":
+                continue
+            size = int(m.group(3), 16)
+            if size == 0:
+                continue
+            origin = m.group(4).strip()
+            if origin.startswith("0x"):
+                continue
+            kind = _gcc_kind(out_section, in_section)
+            am = _GCC_ARCHIVE.match(origin)
+            if am:
+                _add(result["members"], am.group(2), kind, size)
+                _add(result["libraries"], os.path.basename(am.group(1)), kind, size)
+            else:
+                _add(result["objects"], os.path.basename(origin), kind, size)
+    return _totals(result)
+
+
+_CI_NODE = re.compile(r'node: \{ title: "([^"]+)" label: "([^"]*)"')
+_CI_EDGE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+_CI_STACK = re.compile(r"(\d+) bytes \(([a-z,]+)\)")
+
+
+def parse_gcc_ci(paths):
+    """Merge GCC -fcallgraph-info=su files into the parse_keil_htm() shape.
+
+    Functions only seen as callees (library code) have stack None; a
+    dynamic (alloca/VLA) frame is also reported as None.
+    """
+    functions = {}
+
+    def node(name):
+        return functions.setdefault(name, {"size": 0, "stack": None, "object": "",
+                                           "calls": [], "called_by": []})
+
+    for path in paths:
+        with open(path, errors="replace") as f:
+            text = f.read()
+        obj = os.path.basename(path)[:-3] + ".o"
+        for m in _CI_NODE.finditer(text):
+            fn = node(m.group(1))
+            sm = _CI_STACK.search(m.group(2))
+            if sm and sm.group(2) == "static":
+                fn["stack"] = int(sm.group(1))
+                fn["object"] = obj
+        for m in _CI_EDGE.finditer(text):
+            src, dst = m.group(1), m.group(2)
+            if dst not in node(src)["calls"]:
+                node(src)["calls"].append(dst)
+                node(dst)["called_by"].append(src)
+    return {"max_stack": None, "functions": functions}
+
+
+def parse_elf(path):
+    """Section totals of an ELF32 image (no per-object attribution)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1:
+        raise ValueError("%s: not an ELF32 file" % path)
+    e_shoff, = struct.unpack_from("<I", data, 0x20)
+    e_shentsize, e_shnum, e_shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+    sections = []
+    for i in range(e_shnum):
+        sections.append(struct.unpack_from("<IIIIIIIIII", data, e_shoff + i * e_shentsize))
+    strtab = sections[e_shstrndx]
+    names = data[strtab[4]:strtab[4] + strtab[5]]
+
+    result = empty()
+    for name_off, sh_type, flags, _addr, _off, size, _l, _i, _a, _e in sections:
+        if not flags & 0x2:              # SHF_ALLOC
+            continue
+        name = names[name_off:names.index(b"\0", name_off)].decode()
+        if sh_type == 8:                 # SHT_NOBITS
+            kind = "zi"
+        elif flags & 0x1:                # SHF_WRITE
+            kind = "rw"
+        elif flags & 0x4:                # SHF_EXECINSTR
+            kind = "code"
+        else:
+            kind = "ro"
+        _add(result["objects"], name, kind, size)
+    return _totals(result)
+
+
+_GCC_SYMBOL = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_]\w*)$")
+_KEIL_SYMBOL = re.compile(r"^\s{4}(\w+)\s+0x([0-9a-fA-F]+)\s+(?:Thumb Code|ARM Code|Data)\b")
+
+
+def parse_symbols(path):
+    """{symbol: address} from a GNU ld map or the armlink Image Symbol Table."""
+    symbols = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = _KEIL_SYMBOL.match(line)
+            if m:
+                symbols.setdefault(m.group(1), int(m.group(2), 16) & ~1)
+                continue
+            m = _GCC_SYMBOL.match(line.rstrip("\n"))
+            if m:
+                symbols.setdefault(m.group(2), int(m.group(1), 16))
+    return symbols
+
+
+def parse_any(path):
+    """Pick the parser from the file name / content."""
+    with open(path, "rb") as f:
+        if f.read(4) == b"\x7fELF":
+            return parse_elf(path)
+    with open(path, errors="replace") as f:
+        head = f.read(4096)
+    if "Component:" in head or "armlink" in head.lower() or "Image component sizes" in head:
+        return parse_keil_map(path)
+    return parse_gcc_map(path)
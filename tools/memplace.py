@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Generate a placement linker script (GNU ld) or scatter file (armlink).
+
+    tools/memplace.py tools/placement.json --name music --ld build-arm/music.ld
+    tools/memplace.py tools/placement.json --name exti --sct exti.sct
+    tools/memplace.py tools/placement.json --name music --check build-arm/music.map
+
+Placement file: {"default": {...}, "<name>": {...}}, the entry of --name
+extends the default lists:
+
+    hot    functions linked into SRAM with .data (copied at startup)
+    cold   functions grouped away from the rest of the flash code
+    align  start of the code and const data sections, in bytes
+           (16 = one ART accelerator line)
+
+Functions are selected by input section, .text.<name>, which both GCC
+(-ffunction-sections, set by cmake/arm-none-eabi.cmake) and armclang
+emit. The RAMFUNC and COLDFUNC sections of common/place.h (.ramfunc,
+.coldtext) are always placed the same way. A static function that the
+compiler inlined has no section of its own; --check reports it.
+
+--ld rewrites common/gcc/stm32f446re.ld (or --base): .data moves ahead
+of .text, because ld gives an input section to the first pattern that
+matches it and *(.text*) would otherwise take the hot functions; the
+cold group follows it, then the remaining code. The load image order
+changes, the startup copy (_sidata/_sdata/_edata) does not.
+
+--check reads the map of a build and exits 1 when a hot function is not
+in SRAM or a cold one not in flash.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mapparse  # noqa: E402
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BASE_LD = os.path.join(ROOT, "common", "gcc", "stm32f446re.ld")
+
+FLASH = (0x08000000, 0x08080000)
+SRAM = (0x20000000, 0x20020000)
+
+_DATA_BLOCK = re.compile(r"\n\t\.data :\n\t\{\n.*?\n\t\} > RAM AT> FLASH\n", re.S)
+_RAMFUNC = re.compile(r"^(\t\t\*\(\.ramfunc\*\)[^\n]*\n)", re.M)
+
+
+def load(path, name):
+    with open(path) as f:
+        spec = json.load(f)
+    plan = {"hot": [], "cold": [], "align": 4}
+    for key in ("default", name):
+        entry = spec.get(key or "", {})
+        plan["hot"] += [n for n in entry.get("hot", []) if n not in plan["hot"]]
+        plan["cold"] += [n for n in entry.get("cold", []) if n not in plan["cold"]]
+        plan["align"] = entry.get("align", plan["align"])
+    both = set(plan["hot"]) & set(plan["cold"])
+    if both:
+        raise SystemExit("%s: both hot and cold: %s" % (path, ", ".join(sorted(both))))
+    return plan
+
+
+def selectors(names, indent):
+    return "".join("%s*(.text.%s)\n" % (indent, n) for n in names)
+
+
+def gen_ld(plan, base, header):
+    with open(base) as f:
+        script = f.read()
+    m = _DATA_BLOCK.search(script)
+    if not m or "\t.text :" not in script:
+        raise SystemExit("%s: no .data / .text output section to rearrange" % base)
+    data = m.group(0)
+    script = script[:m.start()] + "\n" + script[m.end():]
+    if not _RAMFUNC.search(data):
+        raise SystemExit("%s: .data has no *(.ramfunc*) line" % base)
+    data = _RAMFUNC.sub(lambda r: r.group(1) + selectors(plan["hot"], "\t\t"), data, count=1)
+
+    align = plan["align"]
+    cold = ("\n\t.cold :\n\t{\n\t\t. = ALIGN(%d);\n\t\t*(.coldtext*)\n%s\t\t. = ALIGN(%d);\n\t} > FLASH\n"
+            % (align, selectors(plan["cold"], "\t\t"), align))
+    moved = "\t/* Hot functions in SRAM: ahead of .text so its *(.text*) does not take them */" + data + cold + "\n"
+    script = script.replace("\t.text :", moved + "\t.text :", 1)
+
+    # Code and const tables start on a cache line
+    for section in (".text", ".rodata"):
+        script = re.sub(r"(\t%s :\n\t\{\n\t\t\. = ALIGN\()4(\);)" % re.escape(section),
+                        r"\g<1>%d\g<2>" % align, script, count=1)
+    return "/* %s */\n\n" % header + script
+
+
+def gen_sct(plan, header):
+    align = plan["align"]
+    return """; %s
+
+LR_IROM1 0x08000000 0x00080000 {
+  ER_IROM1 0x08000000 0x00080000 {
+    *.o (RESET, +First)
+    *(InRoot$$Sections)
+    .ANY (+RO)
+    .ANY (+XO)
+  }
+  ER_COLD +0 ALIGN %d {
+    * (.coldtext)
+%s  }
+  RW_IRAM1 0x20000000 0x00020000 {
+    * (.ramfunc)
+%s    .ANY (+RW +ZI)
+  }
+}
+""" % (header, align,
+       "".join("    * (.text.%s)\n" % n for n in plan["cold"]),
+       "".join("    * (.text.%s)\n" % n for n in plan["hot"]))
+
+
+def check(plan, map_path):
+    symbols = mapparse.parse_symbols(map_path)
+    bad = 0
+    print("%-24s %-5s %10s  %s" % ("function", "want", "address", "result"))
+    for kind, region, label in (("hot", SRAM, "sram"), ("cold", FLASH, "flash")):
+        for name in plan[kind]:
+            addr = symbols.get(name)
+            if addr is None:
+                result = "not linked (inlined or unused)"
+            elif region[0] <= addr < region[1]:
+                result = "ok"
+            else:
+                result = "MISPLACED"
+                bad += 1
+            print("%-24s %-5s %10s  %s" % (name, label, "0x%08x" % addr if addr is not None else "-", result))
+    return bad
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("placement", help="placement JSON, e.g. tools/placement.json")
+    ap.add_argument("--name", help="experiment entry to merge over the default")
+    ap.add_argument("--base", default=BASE_LD, help="GNU ld script to rearrange")
+    ap.add_argument("--ld", help="write the GNU ld script here")
+    ap.add_argument("--sct", help="write the armlink scatter file here")
+    ap.add_argument("--check", metavar="MAP", help="verify placement in a GNU ld or armlink map")
+    args = ap.parse_args()
+    if not (args.ld or args.sct or args.check):
+        ap.error("nothing to do, give --ld, --sct or --check")
+
+    plan = load(args.placement, args.name)
+    header = "Generated by tools/memplace.py from %s%s, do not edit" % (
+        os.path.basename(args.placement), " (%s)" % args.name if args.name else "")
+    if args.ld:
+        with open(args.ld, "w") as f:
+            f.write(gen_ld(plan, args.base, header))
+    if args.sct:
+        with open(args.sct, "w") as f:
+            f.write(gen_sct(plan, header))
+    if args.check:
+        return 1 if check(plan, args.check) else 0
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
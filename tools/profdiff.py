@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""Compare two PROF_DUMP captures (common/prof.h), region by region.
+
+    tools/profdiff.py before.txt after.txt
+
+A capture is the ITM/SWO text of a PROFILE build on the board, or the
+stdout of a host run. When a capture holds several dumps the last one
+of each region wins. Prints min/avg/max before and after and the change
+of the average; regions in only one capture are listed with "-".
+"""
+
+import sys
+
+_SKIP = ("region", "model:")
+
+
+def parse_lines(lines):
+    """{region: [count, min, avg, max]} from the lines of a capture"""
+    regions = {}
+    for line in lines:
+        parts = line.split()
+        if len(parts) != 5 or parts[0] in _SKIP or not all(p.isdigit() for p in parts[1:]):
+            continue
+        regions[parts[0]] = [int(p) for p in parts[1:]]
+    return regions
+
+
+def parse(path):
+    with open(path, errors="replace") as f:
+        return parse_lines(f)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+    before, after = parse(sys.argv[1]), parse(sys.argv[2])
+    names = list(before) + [n for n in after if n not in before]
+    print("%-14s %10s %10s %10s   %10s %10s %10s %8s" % (
+        "region", "min", "avg", "max", "min'", "avg'", "max'", "avg"))
+    for name in names:
+        b, a = before.get(name), after.get(name)
+        left = "%10d %10d %10d" % tuple(b[1:]) if b else "%10s %10s %10s" % ("-", "-", "-")
+        right = "%10d %10d %10d" % tuple(a[1:]) if a else "%10s %10s %10s" % ("-", "-", "-")
+        change = "%+7.1f%%" % (100.0 * (a[2] - b[2]) / b[2]) if a and b and b[2] else "%8s" % "-"
+        print("%-14s %s   %s %s" % (name, left, right, change))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""Run FW_QEMU firmware images under qemu-system-arm and compare runs.
+
+    cmake -S . -B build-qemu -DCMAKE_TOOLCHAIN_FILE=cmake/arm-none-eabi.cmake \\
+          -DCMSIS_DIR=... -DFW_QEMU=ON -DFW_DEFINES=PROFILE
+    cmake --build build-qemu
+    tools/qemu_run.py build-qemu/*.elf --run-ms 500 --save base.json
+    tools/qemu_run.py build-qemu/*.elf --run-ms 500 --compare base.json
+    tools/qemu_run.py build-qemu/exti.elf --input PC13@50=0 --input PC13@70=1 --vcd exti.vcd
+
+Each image runs on the netduinoplus2 machine with -icount shift=0: one
+instruction per virtual ns, the same result on every host. qemu/stub.c
+prints pin changes (QEMU PIN), the PROF_DUMP report of a PROFILE build
+and a final line (QEMU END) before it exits through semihosting.
+
+Per image the results hold the executed instructions (--plugin
+libinsn.so from the QEMU build, else the virtual run time, which is the
+same number under icount), the profile regions in instructions, the
+end state and rises/frequency/duty of every pin. --vcd writes the pin
+changes for GTKWave and tools/vcdstat.py (one file per image, the image
+name is put in front of the file name when several are run).
+
+--compare reports instruction count changes above --tolerance percent
+and every behaviour change (end state, pin rises, frequency or duty
+beyond the tolerance) and exits 1 on a behaviour change or on growth
+above --max-growth percent.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import profdiff  # noqa: E402
+import vcdstat  # noqa: E402
+
+_PIN = re.compile(r"^QEMU PIN (\d+) (\w+) ([01])$")
+_END = re.compile(r"^QEMU END (\d+) (\d+) ([0-9a-f]+) ([0-9a-f]+)$")
+_INSNS = re.compile(r"insns:\s*(\d+)")
+
+
+def run(elf, args):
+    """Text on the semihosting console and the QEMU log, None on a timeout"""
+    semi = ["enable=on", "target=native", "arg=" + os.path.basename(elf), "arg=run_ms=%d" % args.run_ms]
+    if args.input:
+        # QEMU option values escape ',' as ',,'
+        semi.append("arg=input=" + ",,".join(args.input))
+    cmd = [args.qemu, "-M", "netduinoplus2", "-nographic", "-monitor", "none", "-serial", "null",
+           "-icount", "shift=0,align=off,sleep=off",
+           "-semihosting-config", ",".join(semi), "-kernel", elf]
+    if args.plugin:
+        cmd += ["-plugin", args.plugin + ",inline=on", "-d", "plugin"]
+    try:
+        p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                           universal_newlines=True, errors="replace", timeout=args.timeout)
+    except subprocess.TimeoutExpired:
+        return None, None
+    return p.stdout, p.stderr
+
+
+def results(out, log):
+    """Result dict of one run and the pin changes {pin: [(t_ns, level)]}"""
+    changes, end = {}, None
+    lines = out.splitlines()
+    for line in lines:
+        m = _PIN.match(line)
+        if m:
+            changes.setdefault(m.group(2), []).append((int(m.group(1)), int(m.group(3))))
+            continue
+        m = _END.match(line)
+        if m:
+            end = m
+    r = {"finished": end is not None, "regions": profdiff.parse_lines(lines), "pins": {}}
+    if end:
+        r.update(end_ns=int(end.group(1)), core_hz=int(end.group(2)),
+                 odr_a=end.group(3), odr_c=end.group(4))
+    m = _INSNS.search(log or "")
+    if m:
+        r["insns"] = int(m.group(1))
+    elif end:
+        r["insns"] = r["end_ns"]                    # icount shift=0: 1 ns per instruction
+    t1 = r.get("end_ns", max((c[-1][0] for c in changes.values()), default=0)) + 1
+    for pin, c in changes.items():
+        if len(c) >= 2:
+            s = vcdstat.wire_stats(c, t1)
+            r["pins"][pin] = {k: round(s[k], 3) for k in ("rises", "freq", "duty") if k in s}
+        else:
+            r["pins"][pin] = {"rises": 0, "level": c[0][1]}
+    return r, changes
+
+
+def write_vcd(path, changes):
+    names = sorted(changes)
+    with open(path, "w") as f:
+        f.write("$timescale 1ns $end\n$scope module qemu $end\n")
+        for i, name in enumerate(names):
+            f.write("$var wire 1 %s %s $end\n" % (chr(33 + i), name))
+        f.write("$upscope $end\n$enddefinitions $end\n")
+        events = sorted((t, i, v) for i, name in enumerate(names) for t, v in changes[name])
+        t_last = None
+        for t, i, v in events:
+            if t != t_last:
+                f.write("#%d\n" % t)
+                t_last = t
+            f.write("%d%s\n" % (v, chr(33 + i)))
+
+
+def compare(old, new, tolerance):
+    """Printed report; (behaviour changes, largest instruction growth in %)"""
+    changed, growth = 0, 0.0
+    for name in sorted(set(old) | set(new)):
+        a, b = old.get(name), new.get(name)
+        if a is None or b is None:
+            print("%-16s %s" % (name, "new" if a is None else "gone"))
+            continue
+        if a.get("insns") and b.get("insns"):
+            d = 100.0 * (b["insns"] - a["insns"]) / a["insns"]
+            growth = max(growth, d)
+            print("%-16s insns %12d -> %12d %+7.2f%%" % (name, a["insns"], b["insns"], d))
+        for reg in sorted(set(a["regions"]) & set(b["regions"])):
+            ra, rb = a["regions"][reg][2], b["regions"][reg][2]
+            if ra and abs(rb - ra) * 100.0 > tolerance * ra:
+                print("%-16s   %-14s avg %8d -> %8d %+7.1f%%" % ("", reg, ra, rb, 100.0 * (rb - ra) / ra))
+        for key in ("finished", "core_hz", "odr_a", "odr_c"):
+            if a.get(key) != b.get(key):
+                print("%-16s   BEHAVIOUR %s %s -> %s" % ("", key, a.get(key), b.get(key)))
+                changed += 1
+        for pin in sorted(set(a["pins"]) | set(b["pins"])):
+            pa, pb = a["pins"].get(pin, {}), b["pins"].get(pin, {})
+            for key in sorted(set(pa) | set(pb)):
+                va, vb = pa.get(key), pb.get(key)
+                same = va == vb if key in ("rises", "level") else (
+                    va is not None and vb is not None and abs(vb - va) * 100.0 <= tolerance * max(abs(va), 1e-9))
+                if not same:
+                    print("%-16s   BEHAVIOUR %s.%s %s -> %s" % ("", pin, key, va, vb))
+                    changed += 1
+    return changed, growth
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Run FW_QEMU images under QEMU netduinoplus2")
+    ap.add_argument("elf", nargs="+")
+    ap.add_argument("--qemu", default="qemu-system-arm")
+    ap.add_argument("--plugin", help="path to QEMU's contrib/plugins libinsn.so")
+    ap.add_argument("--run-ms", type=int, default=500, help="virtual run time, ms")
+    ap.add_argument("--input", action="append", default=[], help="PIN@MS=LEVEL, e.g. PC13@50=0")
+    ap.add_argument("--timeout", type=float, default=60.0, help="wall-clock limit per image, s")
+    ap.add_argument("--vcd", help="pin changes as a value change dump")
+    ap.add_argument("--save", help="write the results as JSON")
+    ap.add_argument("--compare", help="results JSON of an earlier run")
+    ap.add_argument("--tolerance", type=float, default=0.5, help="percent, default 0.5")
+    ap.add_argument("--max-growth", type=float, help="fail above this instruction growth, percent")
+    ap.add_argument("-v", "--verbose", action="store_true", help="echo the console output")
+    args = ap.parse_args()
+
+    all_results, failed = {}, 0
+    for elf in args.elf:
+        name = os.path.basename(elf)
+        if name.endswith(".elf"):
+            name = name[:-4]
+        out, log = run(elf, args)
+        if out is None:
+            print("%-16s timeout after %.0f s" % (name, args.timeout))
+            all_results[name] = {"finished": False, "regions": {}, "pins": {}}
+            failed += 1
+            continue
+        if args.verbose:
+            sys.stdout.write(out)
+        r, changes = results(out, log)
+        all_results[name] = r
+        if not r["finished"]:
+            failed += 1
+        print("%-16s %s insns %s, %d pins, %d regions" % (
+            name, "ok  " if r["finished"] else "FAIL", r.get("insns", "-"), len(r["pins"]), len(r["regions"])))
+        if args.vcd:
+            path = args.vcd
+            if len(args.elf) > 1:
+                path = os.path.join(os.path.dirname(path), name + "_" + os.path.basename(path))
+            write_vcd(path, changes)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(all_results, f, indent=1, sort_keys=True)
+    if args.compare:
+        with open(args.compare) as f:
+            old = json.load(f)
+        changed, growth = compare(old, all_results, args.tolerance)
+        print("%d behaviour change(s), largest instruction growth %+.2f%%" % (changed, growth))
+        if changed or (args.max_growth is not None and growth > args.max_growth):
+            failed += 1
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Worst-case stack depth per entry point and under interrupt nesting.
+
+    tools/stackcheck.py "exp-03/3.4 EXTI/8.1 Push Button EXTI"
+    tools/stackcheck.py --htm Objects/try2.htm --startup RTE/.../startup_stm32f446xx.s --src main.c
+    tools/stackcheck.py --ci build-arm/CMakeFiles/exti.elf.dir/**/*.ci \\
+                             build-arm/CMakeFiles/fw_common.dir/**/*.ci \\
+                        --startup common/gcc/stm32f446re.ld --src main.c
+
+Call graph: Keil Objects/try2.htm, or GCC -fcallgraph-info=su (.ci files,
+FW_STACK_INFO=ON in the CMake build). fw_common holds every common/
+module, handlers of modules the experiment does not link included, so
+the GCC figure can only be higher than the linked image's.
+
+Entry points are main and every *_Handler / *_IRQHandler defined outside
+the startup file. Handlers preempt each other only across different
+NVIC priorities (taken from NVIC_SetPriority() calls in --src, 0 when
+not set), so the nested worst case is
+
+    main + sum over priority levels (deepest handler of the level + exception frame)
+
+The exception frame is 104 bytes (FP context stacked, Cortex-M4F) or 32
+with --no-fpu. Exit status 1 when the worst case exceeds Stack_Size
+(Keil startup file) or _Min_Stack_Size (GCC linker script).
+"""
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mapparse  # noqa: E402
+
+FRAME_FPU = 104
+FRAME_BASIC = 32
+
+_STACK_SIZE = re.compile(r"^(?:Stack_Size\s+EQU|\s*_Min_Stack_Size\s*=)\s*(0x[0-9a-fA-F]+|\d+)", re.M)
+_PRIORITY = re.compile(r"NVIC_SetPriority\s*\(\s*(\w+)_IRQn\s*,\s*(\d+)\s*\)")
+_HANDLER = re.compile(r"^\w+_(IRQ)?Handler$")
+
+
+class Graph:
+    def __init__(self, functions):
+        self.functions = functions
+        self.memo = {}
+        self.notes = set()
+
+    def depth(self, name, path=()):
+        """(bytes, chain) of the deepest call chain starting at name."""
+        if name in self.memo:
+            return self.memo[name]
+        fn = self.functions.get(name)
+        if fn is None:
+            self.notes.add("%s: not in call graph" % name)
+            return 0, [name]
+        if name in path:
+            self.notes.add("recursion through %s, counted once" % name)
+            return 0, [name]
+        own = fn["stack"]
+        if own is None:
+            own = 0
+            self.notes.add("%s: stack size unknown, counted as 0" % name)
+        best, chain = 0, []
+        for callee in fn["calls"]:
+            d, c = self.depth(callee, path + (name,))
+            if d > best:
+                best, chain = d, c
+        self.memo[name] = (own + best, [name] + chain)
+        return self.memo[name]
+
+
+def stack_size(path):
+    with open(path, errors="replace") as f:
+        m = _STACK_SIZE.search(f.read())
+    return int(m.group(1), 0) if m else None
+
+
+def priorities(paths):
+    prio = {}
+    for p in paths:
+        with open(p, errors="replace") as f:
+            for m in _PRIORITY.finditer(f.read()):
+                prio[m.group(1) + "_IRQHandler"] = int(m.group(2))
+    return prio
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("project", nargs="?", help="Keil project directory (fills --htm/--startup/--src)")
+    ap.add_argument("--htm", help="Keil call graph")
+    ap.add_argument("--ci", nargs="*", default=[], help="GCC .ci files (globs allowed)")
+    ap.add_argument("--startup", help="startup .s (Stack_Size) or linker script (_Min_Stack_Size)")
+    ap.add_argument("--stack-size", type=lambda v: int(v, 0), help="override the reserved stack size")
+    ap.add_argument("--src", nargs="*", default=[], help="sources scanned for NVIC_SetPriority()")
+    ap.add_argument("--prio", action="append", default=[], metavar="HANDLER=N", help="extra/override priority")
+    ap.add_argument("--no-fpu", action="store_true", help="32-byte exception frames (no FP context)")
+    ap.add_argument("--margin", type=int, default=64, help="headroom kept when suggesting Stack_Size")
+    args = ap.parse_args()
+
+    if args.project:
+        d = args.project
+        args.htm = args.htm or os.path.join(d, "Objects", "try2.htm")
+        args.startup = args.startup or os.path.join(d, "RTE", "Device", "STM32F446RETx", "startup_stm32f446xx.s")
+        args.src = args.src or [os.path.join(d, "main.c")]
+
+    if args.ci:
+        files = [p for pattern in args.ci for p in glob.glob(pattern, recursive=True)]
+        graph = Graph(mapparse.parse_gcc_ci(files)["functions"])
+    elif args.htm:
+        graph = Graph(mapparse.parse_keil_htm(args.htm)["functions"])
+    else:
+        ap.error("need a project directory, --htm or --ci")
+
+    prio = priorities(args.src)
+    for item in args.prio:
+        name, value = item.split("=")
+        prio[name] = int(value)
+
+    frame = FRAME_BASIC if args.no_fpu else FRAME_FPU
+    startup_objs = ("startup_stm32f446xx.o", "startup_stm32f446xx.s.o")
+    handlers = sorted(n for n, fn in graph.functions.items()
+                      if _HANDLER.match(n) and fn["object"] not in startup_objs and fn["stack"] is not None)
+
+    print("%-28s %5s %7s  %s" % ("entry", "prio", "depth", "deepest chain"))
+    main_depth, chain = graph.depth("main")
+    print("%-28s %5s %7d  %s" % ("main", "-", main_depth, " > ".join(chain)))
+
+    levels = {}
+    for h in handlers:
+        d, chain = graph.depth(h)
+        p = prio.get(h, 0)
+        print("%-28s %5d %7d  %s" % (h, p, d, " > ".join(chain)))
+        if d > levels.get(p, (0, ""))[0]:
+            levels[p] = (d, h)
+
+    worst = main_depth
+    print()
+    print("nesting (lowest urgency first, +%d bytes frame each):" % frame)
+    print("  main%s %d" % (" " * 24, main_depth))
+    for p in sorted(levels, reverse=True):
+        d, h = levels[p]
+        worst += d + frame
+        print("  %-27s %d  (prio %d)" % (h, d + frame, p))
+    print("worst case: %d bytes" % worst)
+
+    reserved = args.stack_size
+    if reserved is None and args.startup and os.path.exists(args.startup):
+        reserved = stack_size(args.startup)
+
+    for note in sorted(graph.notes):
+        print("note: %s" % note)
+
+    if reserved is None:
+        print("reserved stack unknown, pass --startup or --stack-size")
+        return 0
+    suggested = (worst + args.margin + 7) // 8 * 8
+    print("reserved: %d bytes, headroom %d, suggested Stack_Size 0x%X" % (reserved, reserved - worst, suggested))
+    if worst > reserved:
+        print("stackcheck: FAIL worst case %d > Stack_Size %d" % (worst, reserved), file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
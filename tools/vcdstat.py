@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+"""Timing statistics and checks on a host model dump (MODEL_VCD, host/vcd.h).
+
+    tools/vcdstat.py run.vcd
+    tools/vcdstat.py run.vcd --expect TIM2_CH1.freq=395:405 --expect PA5.duty=:60
+    tools/vcdstat.py run.vcd --bus coils=PA6,PA7,PA8,PA9 --from 50
+
+For every 1-bit signal with edges: rising edges, frequency, the
+rise-to-rise period (min/avg/max) and the duty cycle, all in the
+--from/--to window (ms). --bus joins wires into one value (first wire
+= bit 0) and prints the sequence of states with their dwell times,
+e.g. the coil pattern of a stepper.
+
+--expect SIGNAL.METRIC=LO:HI fails (exit 1) when the metric is outside
+[LO, HI]; either bound may be left out. Metrics: rises, freq (Hz),
+period_min, period_avg, period_max (us), duty (%), high_min,
+high_max (us), and for a bus: states, dwell_min, dwell_avg,
+dwell_max (us).
+"""
+
+import argparse
+import sys
+
+
+def parse(path, widths=None):
+    """{name: [(t_ns, value)]}, value None for x/z; widths (dict) gets the bits of each signal"""
+    ids, changes = {}, {}
+    t = 0
+    with open(path) as f:
+        in_defs = True
+        for line in f:
+            parts = line.split()
+            if not parts:
+                continue
+            if in_defs:
+                if parts[0] == "$var" and len(parts) >= 5:
+                    ids[parts[3]] = parts[4]
+                    changes[parts[4]] = []
+                    if widths is not None:
+                        widths[parts[4]] = int(parts[2])
+                elif parts[0] == "$enddefinitions":
+                    in_defs = False
+                continue
+            tok = parts[0]
+            if tok[0] == "#":
+                t = int(tok[1:])
+            elif tok[0] in "01xXzZ" and len(parts) == 1:
+                name = ids.get(tok[1:])
+                if name:
+                    changes[name].append((t, int(tok[0]) if tok[0] in "01" else None))
+            elif tok[0] in "bB" and len(parts) == 2:
+                name = ids.get(parts[1])
+                if name:
+                    bits = tok[1:]
+                    changes[name].append((t, int(bits, 2) if set(bits) <= set("01") else None))
+    return changes
+
+
+def window(changes, t0, t1):
+    """Changes inside [t0, t1), the value at t0 first."""
+    out, before = [], None
+    for t, v in changes:
+        if t < t0:
+            before = v
+        elif t < t1:
+            out.append((t, v))
+    if before is not None and (not out or out[0][0] > t0):
+        out.insert(0, (t0, before))
+    return out
+
+
+def wire_stats(changes, t1):
+    rises, highs = [], []
+    high_at = None
+    high_ns = 0
+    for i, (t, v) in enumerate(changes):
+        prev = changes[i - 1][1] if i else None
+        if v == 1 and prev == 0:
+            rises.append(t)
+        if v == 1 and high_at is None:
+            high_at = t
+        elif v != 1 and high_at is not None:
+            highs.append(t - high_at)
+            high_ns += t - high_at
+            high_at = None
+    if high_at is not None:
+        high_ns += t1 - high_at
+    start = changes[0][0]
+    periods = [(b - a) / 1000.0 for a, b in zip(rises, rises[1:])]
+    s = {"rises": len(rises)}
+    if periods:
+        s.update(period_min=min(periods), period_avg=sum(periods) / len(periods), period_max=max(periods),
+                 freq=1e6 * len(periods) / ((rises[-1] - rises[0]) / 1000.0))
+    if t1 > start:
+        s["duty"] = 100.0 * high_ns / (t1 - start)
+    if highs:
+        s.update(high_min=min(highs) / 1000.0, high_max=max(highs) / 1000.0)
+    return s
+
+
+def bus_states(changes_by_wire, t0, t1):
+    """[(t_ns, value)] of the joined wires, one entry per change of the whole bus."""
+    events = sorted({t for c in changes_by_wire for t, _ in c})
+    vals = [None] * len(changes_by_wire)
+    idx = [0] * len(changes_by_wire)
+    out = []
+    for t in events:
+        for k, c in enumerate(changes_by_wire):
+            while idx[k] < len(c) and c[idx[k]][0] <= t:
+                vals[k] = c[idx[k]][1]
+                idx[k] += 1
+        if any(v is None for v in vals):
+            continue
+        value = sum(v << k for k, v in enumerate(vals))
+        if not out or out[-1][1] != value:
+            out.append((t, value))
+    return [(t, v) for t, v in out if t0 <= t < t1]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Timing statistics and checks on a MODEL_VCD dump")
+    ap.add_argument("vcd")
+    ap.add_argument("--from", dest="t_from", type=float, default=0.0, help="window start, ms")
+    ap.add_argument("--to", dest="t_to", type=float, help="window end, ms (default: end of dump)")
+    ap.add_argument("--bus", action="append", default=[], help="NAME=WIRE,WIRE,... (first wire = bit 0)")
+    ap.add_argument("--expect", action="append", default=[], help="SIGNAL.METRIC=LO:HI")
+    args = ap.parse_args()
+
+    widths = {}
+    changes = parse(args.vcd, widths)
+    end = max((c[-1][0] for c in changes.values() if c), default=0)
+    t0 = int(args.t_from * 1e6)
+    t1 = int(args.t_to * 1e6) if args.t_to is not None else end + 1
+
+    stats = {}
+    print("%-14s %7s %10s %10s %10s %10s %7s" % ("signal", "rises", "freq Hz", "per min", "per avg", "per max", "duty%"))
+    for name, c in changes.items():
+        w = window(c, t0, t1)
+        if len(w) < 2 or widths[name] > 1:
+            continue
+        s = stats[name] = wire_stats(w, t1)
+        print("%-14s %7d %10s %10s %10s %10s %7s" % (
+            name, s["rises"],
+            "%.2f" % s["freq"] if "freq" in s else "-",
+            "%.1f" % s["period_min"] if "period_min" in s else "-",
+            "%.1f" % s["period_avg"] if "period_avg" in s else "-",
+            "%.1f" % s["period_max"] if "period_max" in s else "-",
+            "%.1f" % s["duty"] if "duty" in s else "-"))
+
+    for spec in args.bus:
+        name, _, wires = spec.partition("=")
+        wires = wires.split(",")
+        missing = [w for w in wires if w not in changes]
+        if missing:
+            print("bus %s: no wire %s" % (name, ", ".join(missing)))
+            return 2
+        states = bus_states([changes[w] for w in wires], t0, t1)
+        dwell = [(b[0] - a[0]) / 1000.0 for a, b in zip(states, states[1:])]
+        stats[name] = {"states": len(states)}
+        if dwell:
+            stats[name].update(dwell_min=min(dwell), dwell_avg=sum(dwell) / len(dwell), dwell_max=max(dwell))
+        width = (len(wires) + 3) // 4
+        print("\nbus %s (%s): %d states" % (name, ",".join(wires), len(states)))
+        seq = " ".join("%0*x" % (width, v) for _, v in states[:32])
+        print("  %s%s" % (seq, " ..." if len(states) > 32 else ""))
+        if dwell:
+            print("  dwell us min %.1f avg %.1f max %.1f" % (min(dwell), sum(dwell) / len(dwell), max(dwell)))
+
+    failed = 0
+    for spec in args.expect:
+        target, _, bounds = spec.partition("=")
+        sig, _, metric = target.rpartition(".")
+        lo, _, hi = bounds.partition(":")
+        value = stats.get(sig, {}).get(metric)
+        ok = value is not None and (lo == "" or value >= float(lo)) and (hi == "" or value <= float(hi))
+        print("%s %s = %s (expected %s)" % ("ok  " if ok else "FAIL", target,
+                                           "-" if value is None else "%.3f" % value, bounds))
+        failed += not ok
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Turn a WAV file into a common/pcm.h clip in C.
+
+    tools/wav2pcm.py clip.wav name [--format ima|u8] [--block 256] [-o clip.c]
+
+Stereo is mixed down; 8-bit and 16-bit PCM input. The rate stays that
+of the file (8 to 22.05 kHz plays well, pcm.h resamples to the DDS
+rate). IMA ADPCM is encoded in WAV blocks of --block bytes, the layout
+pcm_ima_block() decodes; u8 keeps one unsigned byte per sample. The
+output defines `const pcm_clip_t name` with its data in flash.
+"""
+
+import argparse
+import sys
+import wave
+
+STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+    4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+    22385, 24623, 27086, 29794, 32767,
+]
+ADJUST = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def read(path):
+    with wave.open(path, "rb") as w:
+        ch, width, rate, n = w.getnchannels(), w.getsampwidth(), w.getframerate(), w.getnframes()
+        raw = w.readframes(n)
+    if width == 1:
+        vals = [(b - 128) << 8 for b in raw]
+    elif width == 2:
+        vals = [int.from_bytes(raw[i:i + 2], "little", signed=True) for i in range(0, len(raw), 2)]
+    else:
+        sys.exit("wav2pcm: %d-bit samples, 8 or 16 only" % (8 * width))
+    return [sum(vals[i:i + ch]) // ch for i in range(0, len(vals), ch)], rate
+
+
+def decode(code, pred, index):
+    step = STEPS[index]
+    diff = step >> 3
+    if code & 4:
+        diff += step
+    if code & 2:
+        diff += step >> 1
+    if code & 1:
+        diff += step >> 2
+    pred = pred - diff if code & 8 else pred + diff
+    pred = max(-32768, min(32767, pred))
+    index = max(0, min(88, index + ADJUST[code & 7]))
+    return pred, index
+
+
+def ima(samples, block):
+    spb = (block - 4) * 2 + 1
+    out, index = bytearray(), 0
+    for i in range(0, len(samples), spb):
+        chunk = samples[i:i + spb]
+        pred = chunk[0]
+        blk = bytearray(pred.to_bytes(2, "little", signed=True) + bytes([index, 0])) + bytearray(block - 4)
+        for k in range(1, spb):
+            diff = (chunk[k] if k < len(chunk) else pred) - pred
+            step, code = STEPS[index], 0
+            if diff < 0:
+                code, diff = 8, -diff
+            for mask in (4, 2, 1):
+                if diff >= step:
+                    code |= mask
+                    diff -= step
+                step >>= 1
+            pred, index = decode(code, pred, index)
+            blk[4 + (k - 1) // 2] |= code << (((k - 1) & 1) * 4)
+        out += blk
+    return bytes(out)
+
+
+def render(name, data, rate, fmt, block, src):
+    lines = [
+        "// Generated by tools/wav2pcm.py from %s, do not edit" % src,
+        '#include "pcm.h"',
+        "",
+        "static const uint8_t %s_data[%d] = {" % (name, len(data)),
+    ]
+    for i in range(0, len(data), 16):
+        lines.append("\t" + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    lines += [
+        "};",
+        "",
+        "const pcm_clip_t %s = { %s_data, %dU, %dU, %dU, %s };" % (
+            name, name, len(data), rate, block if fmt == "ima" else 0, "PCM_IMA" if fmt == "ima" else "PCM_U8"),
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="WAV to a common/pcm.h clip")
+    ap.add_argument("wav")
+    ap.add_argument("name", help="C name of the pcm_clip_t")
+    ap.add_argument("--format", choices=("ima", "u8"), default="ima")
+    ap.add_argument("--block", type=int, default=256, help="IMA block bytes, 8..512")
+    ap.add_argument("-o", "--out")
+    args = ap.parse_args()
+    if not 8 <= args.block <= 512:
+        sys.exit("wav2pcm: --block %d out of 8..512" % args.block)
+
+    samples, rate = read(args.wav)
+    if not samples:
+        sys.exit("wav2pcm: no samples in %s" % args.wav)
+    if args.format == "ima":
+        data = ima(samples, args.block)
+    else:
+        data = bytes(((s >> 8) + 128) & 0xFF for s in samples)
+    text = render(args.name, data, rate, args.format, args.block, args.wav)
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+    print("%s: %d samples at %d Hz, %d bytes %s" % (args.name, len(samples), rate, len(data), args.format),
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()